@@ -5,6 +5,8 @@
 
 // Constructor
 AABBTreeBuilder::Node::Node() :
+	mTriangles(nullptr),
+	mNumTriangles(0),
 	mSplitDimension((uint)-1),
 	mSplitValue(0.0f)
 { 
@@ -12,85 +14,6 @@ AABBTreeBuilder::Node::Node() :
 	mChild[1] = nullptr; 
 }
 
-// Destructor
-AABBTreeBuilder::Node::~Node() 
-{ 
-	delete mChild[0]; 
-	delete mChild[1]; 
-}
-
-// Min depth of tree
-uint AABBTreeBuilder::Node::GetMinDepth() const
-{
-	if (HasChildren())
-	{
-		uint left = mChild[0]->GetMinDepth();
-		uint right = mChild[1]->GetMinDepth();
-		return min(left, right) + 1;
-	}
-	else
-		return 1;
-}
-
-// Max depth of tree
-uint AABBTreeBuilder::Node::GetMaxDepth() const
-{
-	if (HasChildren())
-	{
-		uint left = mChild[0]->GetMaxDepth();
-		uint right = mChild[1]->GetMaxDepth();
-		return max(left, right) + 1;
-	}
-	else
-		return 1;
-}
-
-// Number of nodes in tree
-uint AABBTreeBuilder::Node::GetNodeCount() const
-{
-	if (HasChildren())
-		return mChild[0]->GetNodeCount() + mChild[1]->GetNodeCount() + 1;
-	else
-		return 1;
-}
-
-// Number of leaf nodes in tree
-uint AABBTreeBuilder::Node::GetLeafNodeCount() const
-{
-	if (HasChildren())
-		return mChild[0]->GetLeafNodeCount() + mChild[1]->GetLeafNodeCount();
-	else
-		return 1;
-}
-
-// Get triangle count in tree
-uint AABBTreeBuilder::Node::GetTriangleCountInTree() const
-{
-	if (HasChildren())
-		return mChild[0]->GetTriangleCountInTree() + mChild[1]->GetTriangleCountInTree();
-	else
-		return GetTriangleCount();
-}
-
-// Calculate min and max triangles per node
-void AABBTreeBuilder::Node::GetTriangleCountPerNode(float &outAverage, uint &outMin, uint &outMax) const
-{
-	outMin = INT_MAX;
-	outMax = 0;
-	outAverage = 0;
-	uint avg_divisor = 0;
-	GetTriangleCountPerNodeInternal(outAverage, avg_divisor, outMin, outMax);
-	if (avg_divisor > 0)
-		outAverage /= avg_divisor;
-}
-
-// Calculate the total cost of the tree using the surface area heuristic
-float AABBTreeBuilder::Node::CalculateSAHCost(float inCostTraversal, float inCostLeaf) const
-{
-	float surface_area = mBounds.GetSurfaceArea();
-	return CalculateSAHCostInternal(inCostTraversal / surface_area, inCostLeaf / surface_area);
-}
-
 // Recursively get children (breadth first) to get in total inN children (or less if there are no more)
 void AABBTreeBuilder::Node::GetNChildren(uint inN, vector<const Node *> &outChildren) const
 {
@@ -134,34 +57,6 @@ void AABBTreeBuilder::Node::GetNChildren(uint inN, vector<const Node *> &outChil
 	}
 }
 
-// Recursive helper function to calculate cost of the tree
-float AABBTreeBuilder::Node::CalculateSAHCostInternal(float inCostTraversalDivSurfaceArea, float inCostLeafDivSurfaceArea) const
-{
-	if (HasChildren())
-		return inCostTraversalDivSurfaceArea * mBounds.GetSurfaceArea() 
-			+ mChild[0]->CalculateSAHCostInternal(inCostTraversalDivSurfaceArea, inCostLeafDivSurfaceArea) 
-			+ mChild[1]->CalculateSAHCostInternal(inCostTraversalDivSurfaceArea, inCostLeafDivSurfaceArea);
-	else
-		return inCostLeafDivSurfaceArea * mBounds.GetSurfaceArea() * GetTriangleCount();
-}
-
-// Recursive helper function to calculate min and max triangles per node
-void AABBTreeBuilder::Node::GetTriangleCountPerNodeInternal(float &outAverage, uint &outAverageDivisor, uint &outMin, uint &outMax) const
-{
-	if (HasChildren())
-	{
-		mChild[0]->GetTriangleCountPerNodeInternal(outAverage, outAverageDivisor, outMin, outMax);
-		mChild[1]->GetTriangleCountPerNodeInternal(outAverage, outAverageDivisor, outMin, outMax);
-	}
-	else
-	{
-		outAverage += GetTriangleCount();
-		outAverageDivisor++;
-		outMin = min(outMin, GetTriangleCount());
-		outMax = max(outMax, GetTriangleCount());
-	}
-}
-
 // Constructor
 AABBTreeBuilder::AABBTreeBuilder(TriangleSplitter &inSplitter, uint inMaxTrianglesPerLeaf) : 
 	mTriangleSplitter(inSplitter),
@@ -170,35 +65,58 @@ AABBTreeBuilder::AABBTreeBuilder(TriangleSplitter &inSplitter, uint inMaxTriangl
 }
 
 // Build the tree
-AABBTreeBuilder::Node *AABBTreeBuilder::Build(AABBTreeBuilderStats &outStats)
+void AABBTreeBuilder::Build(Tree &outTree, AABBTreeBuilderStats &outStats)
 {
 	TriangleSplitter::Range initial = mTriangleSplitter.GetInitialRange();
+	assert(initial.mBegin == 0);
 
-	ProgressIndicator progress("AABBTreeBuilder", initial.Count());
-	Node *root = BuildInternal(initial, progress);
+	// The triangles are stored in the order of the splitter so every leaf is a contiguous range
+	outTree.mNodes.clear();
+	outTree.mTriangles.resize(initial.Count());
 
-	float avg_triangles_per_leaf;
-	uint min_triangles_per_leaf, max_triangles_per_leaf;
-	root->GetTriangleCountPerNode(avg_triangles_per_leaf, min_triangles_per_leaf, max_triangles_per_leaf);
+	// A tree with N leaves has 2N - 1 nodes, estimate the amount of leaves assuming they are mostly full
+	outTree.mNodes.reserve(2 * (initial.Count() / max(1u, mMaxTrianglesPerLeaf / 2) + 1));
+
+	ProgressIndicator progress("AABBTreeBuilder", initial.Count());
+	vector<uint> right_child;
+	right_child.reserve(outTree.mNodes.capacity());
+	BuildStats stats;
+	BuildInternal(initial, 1, outTree, right_child, stats, progress);
+
+	// Now that the node array won't be reallocated anymore, link the nodes
+	for (uint n = 0; n < (uint)outTree.mNodes.size(); ++n)
+		if (right_child[n] != 0)
+		{
+			Node &node = outTree.mNodes[n];
+			node.mChild[0] = &outTree.mNodes[n + 1];
+			node.mChild[1] = &outTree.mNodes[right_child[n]];
+		}
+	outTree.mLeafNodeCount = stats.mLeafNodeCount;
+	outTree.mMaxDepth = stats.mMaxDepth;
 
 	mTriangleSplitter.GetStats(outStats.mSplitterStats);
 
-	outStats.mSAHCost = root->CalculateSAHCost(1.0f, 1.0f);
-	outStats.mMinDepth = root->GetMinDepth();
-	outStats.mMaxDepth = root->GetMaxDepth();
-	outStats.mNodeCount = root->GetNodeCount();
-	outStats.mLeafNodeCount = root->GetLeafNodeCount();
+	// Surface areas are relative to the root, traversal and leaf cost are 1
+	float root_surface_area = outTree.mNodes[0].mBounds.GetSurfaceArea();
+	outStats.mSAHCost = float((stats.mNodeSurfaceArea + stats.mLeafSurfaceAreaTimesTriangles) / root_surface_area);
+	outStats.mMinDepth = stats.mMinDepth;
+	outStats.mMaxDepth = stats.mMaxDepth;
+	outStats.mNodeCount = outTree.GetNodeCount();
+	outStats.mLeafNodeCount = stats.mLeafNodeCount;
 	outStats.mMaxTrianglesPerLeaf = mMaxTrianglesPerLeaf;
-	outStats.mTreeMinTrianglesPerLeaf = min_triangles_per_leaf;
-	outStats.mTreeMaxTrianglesPerLeaf = max_triangles_per_leaf;
-	outStats.mTreeAvgTrianglesPerLeaf = avg_triangles_per_leaf;
-
-	return root;
+	outStats.mTreeMinTrianglesPerLeaf = stats.mMinTrianglesPerLeaf;
+	outStats.mTreeMaxTrianglesPerLeaf = stats.mMaxTrianglesPerLeaf;
+	outStats.mTreeAvgTrianglesPerLeaf = float(initial.Count()) / stats.mLeafNodeCount;
 }
 
 // Recursive helper function to build the tree
-AABBTreeBuilder::Node *AABBTreeBuilder::BuildInternal(TriangleSplitter::Range &inTriangles, ProgressIndicator &inProgress)
+uint AABBTreeBuilder::BuildInternal(TriangleSplitter::Range &inTriangles, uint inDepth, Tree &ioTree, vector<uint> &ioRightChild, BuildStats &ioStats, ProgressIndicator &inProgress)
 {
+	// Allocate node, nodes are allocated depth first so the left child will directly follow this node
+	uint node_index = (uint)ioTree.mNodes.size();
+	ioTree.mNodes.emplace_back();
+	ioRightChild.push_back(0);
+
 	// Check if there are too many triangles left
 	if (inTriangles.Count() > mMaxTrianglesPerLeaf)
 	{
@@ -216,29 +134,46 @@ AABBTreeBuilder::Node *AABBTreeBuilder::BuildInternal(TriangleSplitter::Range &i
 		}
 
 		// Recursively build
-		Node *node = new Node();
-		node->mChild[0] = BuildInternal(left, inProgress);
-		node->mChild[1] = BuildInternal(right, inProgress);
-		node->mBounds = node->mChild[0]->mBounds;
-		node->mBounds.Encapsulate(node->mChild[1]->mBounds);
-		node->mSplitDimension = dimension;
-		node->mSplitValue = split;
-		return node;
+		uint left_index = BuildInternal(left, inDepth + 1, ioTree, ioRightChild, ioStats, inProgress);
+		uint right_index = BuildInternal(right, inDepth + 1, ioTree, ioRightChild, ioStats, inProgress);
+		assert(left_index == node_index + 1);
+		ioRightChild[node_index] = right_index;
+
+		// Node array may have been reallocated so get the node now
+		Node &node = ioTree.mNodes[node_index];
+		node.mBounds = ioTree.mNodes[left_index].mBounds;
+		node.mBounds.Encapsulate(ioTree.mNodes[right_index].mBounds);
+		node.mSplitDimension = dimension;
+		node.mSplitValue = split;
+
+		// Update stats
+		ioStats.mNodeSurfaceArea += node.mBounds.GetSurfaceArea();
+		return node_index;
 	}
 
 	// Create leaf node
-	Node *node = new Node();
-	node->mTriangles.reserve(inTriangles.Count());
+	Node &node = ioTree.mNodes[node_index];
+	IndexedTriangle *triangles = ioTree.mTriangles.data() + inTriangles.mBegin;
+	const VertexView &v = mTriangleSplitter.GetVertices();
 	for (uint i = inTriangles.mBegin; i < inTriangles.mEnd; ++i)
 	{
-		const IndexedTriangle &t = mTriangleSplitter.GetTriangle(i);
-		const VertexList &v = mTriangleSplitter.GetVertices();
-		node->mTriangles.push_back(t);
-		node->mBounds.Encapsulate(v, t);
+		IndexedTriangle t = mTriangleSplitter.GetTriangle(i);
+		triangles[i - inTriangles.mBegin] = t;
+		node.mBounds.Encapsulate(v, t);
 	}
+	node.mTriangles = triangles;
+	node.mNumTriangles = inTriangles.Count();
+
+	// Update stats
+	ioStats.mMinDepth = min(ioStats.mMinDepth, inDepth);
+	ioStats.mMaxDepth = max(ioStats.mMaxDepth, inDepth);
+	ioStats.mLeafNodeCount++;
+	ioStats.mMinTrianglesPerLeaf = min(ioStats.mMinTrianglesPerLeaf, node.mNumTriangles);
+	ioStats.mMaxTrianglesPerLeaf = max(ioStats.mMaxTrianglesPerLeaf, node.mNumTriangles);
+	ioStats.mLeafSurfaceAreaTimesTriangles += double(node.mBounds.GetSurfaceArea()) * node.mNumTriangles;
 
 	// Update progress
 	inProgress.Update(inTriangles.Count());
 
-	return node;
+	return node_index;
 }
@@ -34,71 +34,92 @@ public:
 	class Node
 	{
 	public:
-		// Constructor / destructor
+		// Constructor
 							Node();
-							~Node();
 
 		// Get number of triangles in this node
-		inline uint			GetTriangleCount() const				{ return uint(mTriangles.size()); }
+		inline uint			GetTriangleCount() const				{ return mNumTriangles; }
 
 		// Check if this node has any children
 		inline bool			HasChildren() const						{ return mChild[0] != nullptr || mChild[1] != nullptr; }
 
-		// Min depth of tree
-		uint				GetMinDepth() const;
-
-		// Max depth of tree
-		uint				GetMaxDepth() const;
-
-		// Number of nodes in tree
-		uint				GetNodeCount() const;
-
-		// Number of leaf nodes in tree
-		uint				GetLeafNodeCount() const;
-
-		// Get triangle count in tree
-		uint				GetTriangleCountInTree() const;
-
-		// Calculate min and max triangles per node
-		void				GetTriangleCountPerNode(float &outAverage, uint &outMin, uint &outMax) const;
-
-		// Calculate the total cost of the tree using the surface area heuristic
-		float				CalculateSAHCost(float inCostTraversal, float inCostLeaf) const;
-
 		// Recursively get children (breadth first) to get in total inN children (or less if there are no more)
 		void				GetNChildren(uint inN, vector<const Node *> &outChildren) const;
 
 		// Bounding box
 		AABox				mBounds;
 
-		// Triangles (if no child nodes)
-		IndexedTriangleList mTriangles;
+		// Triangles (if no child nodes), points into the triangle array of the tree
+		const IndexedTriangle *	mTriangles;
+		uint				mNumTriangles;
 
-		// Child nodes (if no triangles)
-		Node *				mChild[2];
+		// Child nodes (if no triangles), point into the node array of the tree
+		const Node *		mChild[2];
 
 		// Axis (dimension) and value along which the triangles were split
 		uint				mSplitDimension;
 		float				mSplitValue;
+	};
+
+	// The output of the builder. All nodes are stored in a single array (depth first, the root is the first node)
+	// and all triangles in another, leaf nodes reference a range of the triangles.
+	class Tree
+	{
+	public:
+		// Constructor
+							Tree() = default;
+							Tree(Tree &&) = default;
+							Tree(const Tree &) = delete;
+
+		// Operators
+		Tree &				operator = (Tree &&) = default;
+		Tree &				operator = (const Tree &) = delete;
+
+		// Get the root of the tree
+		inline const Node *	GetRoot() const							{ return mNodes.empty()? nullptr : &mNodes[0]; }
+
+		// Number of nodes in tree
+		inline uint			GetNodeCount() const					{ return uint(mNodes.size()); }
+
+		// Number of leaf nodes in tree
+		inline uint			GetLeafNodeCount() const				{ return mLeafNodeCount; }
+
+		// Get triangle count in tree
+		inline uint			GetTriangleCount() const				{ return uint(mTriangles.size()); }
+
+		// Max depth of tree
+		inline uint			GetMaxDepth() const						{ return mMaxDepth; }
 
 	private:
 		friend class AABBTreeBuilder;
 
-		// Recursive helper function to calculate cost of the tree
-		float				CalculateSAHCostInternal(float inCostTraversalDivSurfaceArea, float inCostLeafDivSurfaceArea) const;
-
-		// Recursive helper function to calculate min and max triangles per node
-		void				GetTriangleCountPerNodeInternal(float &outAverage, uint &outAverageDivisor, uint &outMin, uint &outMax) const;
+		vector<Node>		mNodes;
+		IndexedTriangleList	mTriangles;
+		uint				mLeafNodeCount = 0;
+		uint				mMaxDepth = 0;
 	};
 
 	// Constructor
 							AABBTreeBuilder(TriangleSplitter &inSplitter, uint inMaxTrianglesPerLeaf = 16);
 
-	// Recursively build tree, returns the root node of the tree
-	Node *					Build(AABBTreeBuilderStats &outStats);
+	// Build tree, the stats are collected while building
+	void					Build(Tree &outTree, AABBTreeBuilderStats &outStats);
 
 private:
-	Node *					BuildInternal(TriangleSplitter::Range &inTriangles, ProgressIndicator &inProgress);
+	// Stats that are accumulated during the build
+	struct BuildStats
+	{
+		uint				mMinDepth = UINT_MAX;
+		uint				mMaxDepth = 0;
+		uint				mLeafNodeCount = 0;
+		uint				mMinTrianglesPerLeaf = UINT_MAX;
+		uint				mMaxTrianglesPerLeaf = 0;
+		double				mNodeSurfaceArea = 0.0;				// Sum of the surface areas of all non-leaf nodes
+		double				mLeafSurfaceAreaTimesTriangles = 0.0;	// Sum of the surface area times the amount of triangles of all leaf nodes
+	};
+
+	// Recursive helper function to build the tree, returns the index of the node in ioTree.mNodes. The index of the right child is stored in ioRightChild until the node array is complete, the left child directly follows its parent.
+	uint					BuildInternal(TriangleSplitter::Range &inTriangles, uint inDepth, Tree &ioTree, vector<uint> &ioRightChild, BuildStats &ioStats, ProgressIndicator &inProgress);
 
 	TriangleSplitter &		mTriangleSplitter;
 	const uint				mMaxTrianglesPerLeaf;
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <Core/MappedFile.h>
+#include <Core/HashCombine.h>
+#include <fstream>
+
+// File that stores the output of AABBTreeToBuffer so that it can be memory mapped and traversed without rebuilding the tree.
+// The buffer only contains offsets relative to its start so it can be used at any address.
+// The file stores the vertex count, triangle count and a hash of the model that the tree was built from, a file that belongs to another model is rejected.
+//
+// File layout:
+//
+// AABBTreeFileHeaderV1
+// padding to AABB_TREE_FILE_ALIGNMENT
+// Buffer (node header, triangle header, nodes and triangles as produced by AABBTreeToBuffer)
+struct AABBTreeFileHeaderV1
+{
+	static inline const uint32	sVersion = uint32('A') + (uint32('T') << 8) + (uint32('V') << 16) + (uint32('1') << 24);
+
+	enum { NAME_LENGTH = 64 };
+
+								AABBTreeFileHeaderV1() : mVersion(sVersion), mHeaderSize(sizeof(AABBTreeFileHeaderV1)), mAlignment(0), mNodeHeaderSize(0), mTriangleHeaderSize(0), mNodesSize(0), mConvertMode(0), mVerticesPerTriangle(0.0f), mNumVertices(0), mNumTriangles(0), mBufferOffset(0), mBufferSize(0), mChecksum(0), mHeaderChecksum(0), mModelHash(0) { memset(mTreeType, 0, sizeof(mTreeType)); memset(mTriangleCodec, 0, sizeof(mTriangleCodec)); }
+
+	uint32						mVersion;
+	uint32						mHeaderSize;							// Size of this header, to detect mismatching struct layouts
+	uint32						mAlignment;								// Alignment of the buffer in the file
+	uint32						mNodeHeaderSize;						// Size of the header of the node codec
+	uint32						mTriangleHeaderSize;					// Size of the header of the triangle codec
+	uint32						mNodesSize;								// Amount of bytes in the buffer used by nodes
+	uint32						mConvertMode;							// EAABBTreeToBufferConvertMode used to create the buffer
+	float						mVerticesPerTriangle;					// Stats from the triangle codec
+	uint32						mNumVertices;							// Amount of vertices of the model that the tree was built from
+	uint32						mNumTriangles;							// Amount of triangles of the model that the tree was built from
+	uint64						mBufferOffset;							// Offset from start of file to the buffer
+	uint64						mBufferSize;							// Size of the buffer
+	uint64						mChecksum;								// HashBytes of the buffer
+	uint64						mHeaderChecksum;						// HashBytes of the node header and triangle header at the start of the buffer
+	uint64						mModelHash;								// AABBTreeFile::sHashModel of the model that the tree was built from
+	char						mTreeType[NAME_LENGTH];					// Identifies the node codec that was used to create the buffer
+	char						mTriangleCodec[NAME_LENGTH];			// Identifies the triangle codec that was used to create the buffer
+};
+
+// Read / write a converted AABB tree
+template <class TriangleCodec, class NodeCodec>
+class AABBTreeFile
+{
+public:
+	enum { AABB_TREE_FILE_ALIGNMENT = CACHE_LINE_SIZE };				// The buffer in memory is aligned to a cache line, so all alignment that the codecs did relative to the start of the buffer is preserved
+
+	// Header for the tree
+	using NodeHeader = typename NodeCodec::Header;
+	static const int HeaderSize = NodeCodec::HeaderSize;
+
+	// Header for the triangles
+	using TriangleHeader = typename TriangleCodec::TriangleHeader;
+	static const int TriangleHeaderSize = TriangleCodec::TriangleHeaderSize;
+
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// Get the name of the triangle codec as stored in the file
+	static string					sGetTriangleCodecName()
+	{
+		typename TriangleCodec::EncodingContext tri_ctx;
+		string name;
+		float vertices_per_triangle;
+		tri_ctx.GetStats(name, vertices_per_triangle);
+		return name;
+	}
+
+	// Hash the vertices and the vertex indices of a model, materials are not included
+	static uint64					sHashModel(const VertexView &inVertices, const IndexedTriangleView &inTriangles)
+	{
+		uint64 hash = HashBytes(inVertices.data(), inVertices.size() * sizeof(Float3));
+
+		// The triangles can have a different layout, hash the indices in batches
+		enum { BATCH_SIZE = 1024 };
+		uint32 indices[BATCH_SIZE * 3];
+		for (size_t t = 0; t < inTriangles.size(); t += BATCH_SIZE)
+		{
+			size_t num_triangles = min(size_t(BATCH_SIZE), inTriangles.size() - t);
+			for (size_t i = 0; i < num_triangles; ++i)
+			{
+				IndexedTriangle triangle = inTriangles[t + i];
+				for (int v = 0; v < 3; ++v)
+					indices[i * 3 + v] = triangle.mIdx[v];
+			}
+			hash = HashBytes(indices, num_triangles * 3 * sizeof(uint32), hash);
+		}
+
+		return hash;
+	}
+
+	// Write a converted tree to file, inTreeType identifies the node codec, inVertices and inTriangles are the model that the tree was built from
+	static void						sWriteToFile(const char *inFileName, const char *inTreeType, EAABBTreeToBufferConvertMode inConvertMode, const Buffer &inBuffer, const AABBTreeToBufferStats &inStats, const VertexView &inVertices, const IndexedTriangleView &inTriangles)
+	{
+		const ByteBuffer &buffer = inBuffer.GetBuffer();
+
+		// Fill in header
+		AABBTreeFileHeaderV1 header;
+		header.mAlignment = AABB_TREE_FILE_ALIGNMENT;
+		header.mNodeHeaderSize = HeaderSize;
+		header.mTriangleHeaderSize = TriangleHeaderSize;
+		header.mNodesSize = inBuffer.mNodesSize;
+		header.mConvertMode = (uint32)inConvertMode;
+		header.mVerticesPerTriangle = inStats.mVerticesPerTriangle;
+		header.mNumVertices = (uint32)inVertices.size();
+		header.mNumTriangles = (uint32)inTriangles.size();
+		header.mBufferOffset = AlignUp(uint64(sizeof(header)), uint64(AABB_TREE_FILE_ALIGNMENT));
+		header.mBufferSize = buffer.size();
+		header.mChecksum = HashBytes(&buffer[0], buffer.size());
+		header.mHeaderChecksum = HashBytes(&buffer[0], HeaderSize + TriangleHeaderSize);
+		header.mModelHash = sHashModel(inVertices, inTriangles);
+		sCopyName(header.mTreeType, inTreeType);
+		sCopyName(header.mTriangleCodec, inStats.mTriangleCodecName.c_str());
+
+		ofstream output(inFileName, ios::binary | ios::trunc);
+		if (!output)
+			FatalError("Unable to open file: %s", inFileName);
+
+		// Write header and padding
+		output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		static const char zeros[AABB_TREE_FILE_ALIGNMENT] = { };
+		output.write(zeros, streamsize(header.mBufferOffset - sizeof(header)));
+
+		// Write buffer
+		output.write(reinterpret_cast<const char *>(&buffer[0]), streamsize(buffer.size()));
+		if (!output)
+			FatalError("Unable to write file: %s", inFileName);
+	}
+
+	// Map a converted tree into memory, inTreeType must match the type used when writing the file and inVertices / inTriangles must be the model that the tree was built from.
+	// The model is always hashed, of the buffer only the node and triangle headers are verified by default. Verifying the checksum of the entire buffer reads the whole file,
+	// without it only the pages that are touched by the traversal are loaded.
+	void							ReadFromFile(const char *inFileName, const char *inTreeType, const VertexView &inVertices, const IndexedTriangleView &inTriangles, AABBTreeToBufferStats &outStats, bool inVerifyChecksum = false)
+	{
+		mBufferStart = nullptr;
+		mBufferSize = 0;
+
+		// Map the file
+		mFile.Open(inFileName);
+
+		// Check header
+		if (mFile.GetSize() < sizeof(AABBTreeFileHeaderV1))
+			FatalError("%s: File truncated", inFileName);
+		const AABBTreeFileHeaderV1 *header = mFile.Get<AABBTreeFileHeaderV1>(0);
+		if (header->mVersion != AABBTreeFileHeaderV1::sVersion || header->mHeaderSize != sizeof(AABBTreeFileHeaderV1))
+			FatalError("%s: Invalid header", inFileName);
+		if (strncmp(header->mTreeType, inTreeType, AABBTreeFileHeaderV1::NAME_LENGTH) != 0)
+			FatalError("%s: Tree type mismatch, expected %s", inFileName, inTreeType);
+		string codec_name = sGetTriangleCodecName();
+		if (strncmp(header->mTriangleCodec, codec_name.c_str(), AABBTreeFileHeaderV1::NAME_LENGTH) != 0)
+			FatalError("%s: Triangle codec mismatch, expected %s", inFileName, codec_name.c_str());
+		if (header->mNodeHeaderSize != HeaderSize || header->mTriangleHeaderSize != TriangleHeaderSize)
+			FatalError("%s: Header size mismatch", inFileName);
+
+		// Check that the tree belongs to this model
+		if (header->mNumVertices != inVertices.size() || header->mNumTriangles != inTriangles.size())
+			FatalError("%s: Model mismatch, tree was built for %u vertices and %u triangles, model has %u vertices and %u triangles", inFileName, header->mNumVertices, header->mNumTriangles, (uint)inVertices.size(), (uint)inTriangles.size());
+		if (header->mModelHash != sHashModel(inVertices, inTriangles))
+			FatalError("%s: Model mismatch, tree was built for a different model", inFileName);
+
+		// Check buffer
+		if (header->mAlignment < AABB_TREE_FILE_ALIGNMENT || !IsAligned(header->mBufferOffset, AABB_TREE_FILE_ALIGNMENT))
+			FatalError("%s: Invalid alignment", inFileName);
+		if (header->mBufferOffset < sizeof(AABBTreeFileHeaderV1) || header->mBufferOffset + header->mBufferSize > mFile.GetSize() || header->mBufferSize < uint64(HeaderSize + TriangleHeaderSize))
+			FatalError("%s: Invalid buffer offset", inFileName);
+		const uint8 *buffer_start = mFile.GetData() + header->mBufferOffset;
+		if (HashBytes(buffer_start, HeaderSize + TriangleHeaderSize) != header->mHeaderChecksum)
+			FatalError("%s: Header checksum mismatch", inFileName);
+		if (inVerifyChecksum && HashBytes(buffer_start, size_t(header->mBufferSize)) != header->mChecksum)
+			FatalError("%s: Checksum mismatch", inFileName);
+
+		mBufferStart = buffer_start;
+		mBufferSize = size_t(header->mBufferSize);
+		mConvertMode = EAABBTreeToBufferConvertMode(header->mConvertMode);
+
+		// Output stats
+		outStats.mTotalSize = (uint)header->mBufferSize;
+		outStats.mNodesSize = header->mNodesSize;
+		outStats.mTrianglesSize = (uint)header->mBufferSize - header->mNodesSize;
+		outStats.mTriangleCodecName = codec_name;
+		outStats.mVerticesPerTriangle = header->mVerticesPerTriangle;
+	}
+
+	// Get convert mode that was used to create the buffer
+	EAABBTreeToBufferConvertMode	GetConvertMode() const
+	{
+		return mConvertMode;
+	}
+
+	// Get mapped buffer
+	inline const uint8 *			GetBufferStart() const
+	{
+		return mBufferStart;
+	}
+
+	inline size_t					GetBufferSize() const
+	{
+		return mBufferSize;
+	}
+
+	// Get header for tree
+	inline const NodeHeader *		GetNodeHeader() const
+	{
+		return reinterpret_cast<const NodeHeader *>(mBufferStart);
+	}
+
+	// Get header for triangles
+	inline const TriangleHeader *	GetTriangleHeader() const
+	{
+		return reinterpret_cast<const TriangleHeader *>(mBufferStart + HeaderSize);
+	}
+
+	// Get root of tree
+	inline const void *				GetRoot() const
+	{
+		return mBufferStart + HeaderSize + TriangleHeaderSize;
+	}
+
+private:
+	// Copy a name into a fixed size, zero terminated field
+	static void						sCopyName(char *outName, const char *inName)
+	{
+		if (strlen(inName) >= AABBTreeFileHeaderV1::NAME_LENGTH)
+			FatalError("AABBTreeFile: Name too long: %s", inName);
+		strcpy(outName, inName);
+	}
+
+	MappedFile						mFile;
+	const uint8 *					mBufferStart = nullptr;
+	size_t							mBufferSize = 0;
+	EAABBTreeToBufferConvertMode	mConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST;
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <TriangleSplitter/TriangleSplitterBinning.h>
+#include <Core/Reference.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Rebuilds and converts a tree on a background thread while rays are cast against the previously converted tree.
+//
+// A converted tree is published as a reference counted snapshot. GetSnapshot never waits for a rebuild, it only
+// takes a reference to the latest snapshot, the snapshot stays alive until the last reference is released.
+// Taking a reference races with replacing the snapshot, so readers announce themselves in one of two counters
+// (selected by the current epoch) while they take the reference. After publishing, the rebuild thread advances
+// the epoch and waits until the counter of the previous epoch drops to zero before releasing the old snapshot.
+// That wait only covers readers that are in the middle of taking a reference, not readers that are casting rays.
+template <class TriangleCodec, class NodeCodec>
+class AABBTreeRebuilder
+{
+public:
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// A converted tree
+	class Snapshot : public RefTarget<Snapshot>
+	{
+	public:
+		Buffer						mBuffer;
+		AABBTreeToBufferStats		mStats;
+		uint64						mVersion = 0;							// Version that was returned by RequestRebuild
+	};
+
+	// Constructor, starts the rebuild thread
+									AABBTreeRebuilder(uint inMaxTrianglesPerLeaf = 8, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST) :
+		mMaxTrianglesPerLeaf(inMaxTrianglesPerLeaf),
+		mConvertMode(inConvertMode)
+	{
+		mThread = thread(&AABBTreeRebuilder::ThreadMain, this);
+	}
+
+	// Destructor, abandons a pending rebuild and waits for the rebuild thread to finish
+									~AABBTreeRebuilder()
+	{
+		{
+			lock_guard<mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mCondition.notify_all();
+		mThread.join();
+	}
+
+	// Request a rebuild with new geometry, returns the version of the snapshot that will contain it.
+	// When a rebuild is in progress the request is queued, a queued request is replaced by a newer request.
+	uint64							RequestRebuild(VertexList &&inVertices, IndexedTriangleList &&inTriangles)
+	{
+		assert(!inTriangles.empty());
+
+		uint64 version;
+		{
+			lock_guard<mutex> lock(mMutex);
+			mPendingVertices = std::move(inVertices);
+			mPendingTriangles = std::move(inTriangles);
+			mHasRequest = true;
+			version = ++mRequestedVersion;
+		}
+		mCondition.notify_all();
+		return version;
+	}
+
+	// Get the latest snapshot, returns nullptr when no rebuild has finished yet. Never waits for a rebuild.
+	RefConst<Snapshot>				GetSnapshot() const
+	{
+		for (;;)
+		{
+			// Announce that we're taking a reference in the current epoch
+			uint64 epoch = mEpoch.load();
+			atomic<uint32> &readers = mReaders[epoch & 1];
+			++readers;
+			if (mEpoch.load() == epoch)
+			{
+				// The snapshot can't be released until we leave the epoch
+				RefConst<Snapshot> snapshot = mCurrent.load();
+				--readers;
+				return snapshot;
+			}
+
+			// The epoch changed, the rebuild thread may not be waiting for us so try again
+			--readers;
+		}
+	}
+
+	// Wait until a snapshot with inVersion or later has been published
+	void							WaitForVersion(uint64 inVersion)
+	{
+		unique_lock<mutex> lock(mMutex);
+		mCondition.wait(lock, [this, inVersion] { return mPublishedVersion >= inVersion; });
+	}
+
+private:
+	// Main function of the rebuild thread
+	void							ThreadMain()
+	{
+		for (;;)
+		{
+			// Wait for a request
+			VertexList vertices;
+			IndexedTriangleList triangles;
+			uint64 version;
+			{
+				unique_lock<mutex> lock(mMutex);
+				mCondition.wait(lock, [this] { return mQuit || mHasRequest; });
+				if (mQuit)
+					break;
+				vertices = std::move(mPendingVertices);
+				triangles = std::move(mPendingTriangles);
+				mPendingVertices.clear();
+				mPendingTriangles.clear();
+				mHasRequest = false;
+				version = mRequestedVersion;
+			}
+
+			// Build and convert the tree
+			Snapshot *snapshot = new Snapshot;
+			snapshot->mVersion = version;
+			{
+				TriangleSplitterBinning splitter(vertices, triangles);
+				AABBTreeBuilderStats stats;
+				AABBTreeBuilder::Tree tree;
+				AABBTreeBuilder(splitter, mMaxTrianglesPerLeaf).Build(tree, stats);
+				snapshot->mBuffer.Convert(vertices, tree, snapshot->mStats, mConvertMode);
+			}
+
+			Publish(snapshot);
+
+			{
+				lock_guard<mutex> lock(mMutex);
+				mPublishedVersion = version;
+			}
+			mCondition.notify_all();
+		}
+	}
+
+	// Replace the current snapshot and release the old one when no reader can be taking a reference to it anymore
+	void							Publish(Snapshot *inSnapshot)
+	{
+		Ref<Snapshot> new_snapshot = inSnapshot;
+		Ref<Snapshot> old_snapshot = mSnapshot;
+		mSnapshot = new_snapshot;
+		mCurrent = inSnapshot;
+
+		// Readers that entered the old epoch may have loaded the old snapshot, new readers load the new snapshot
+		uint64 epoch = mEpoch++;
+		while (mReaders[epoch & 1].load() != 0)
+			this_thread::yield();
+
+		old_snapshot = nullptr;
+	}
+
+	uint							mMaxTrianglesPerLeaf;
+	EAABBTreeToBufferConvertMode	mConvertMode;
+
+	// Published snapshot, mSnapshot holds the reference and mCurrent is what readers load
+	Ref<Snapshot>					mSnapshot;
+	atomic<Snapshot *>				mCurrent { nullptr };
+	atomic<uint64>					mEpoch { 0 };
+	mutable atomic<uint32>			mReaders[2] { };
+
+	// Requests, protected by mMutex
+	mutex							mMutex;
+	condition_variable				mCondition;
+	VertexList						mPendingVertices;
+	IndexedTriangleList				mPendingTriangles;
+	uint64							mRequestedVersion = 0;
+	uint64							mPublishedVersion = 0;
+	bool							mHasRequest = false;
+	bool							mQuit = false;
+
+	thread							mThread;
+};
@@ -54,16 +54,18 @@ public:
 	using TriangleHeader = typename TriangleCodec::TriangleHeader;
 	static const int TriangleHeaderSize = TriangleCodec::TriangleHeaderSize;
 
-	// Convert AABB tree
-	void							Convert(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot, AABBTreeToBufferStats &outStats, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST)
+	// Convert AABB tree, if inAllowRefit is true the information that Refit needs is kept
+	void							Convert(const VertexView &inVertices, const AABBTreeBuilder::Tree &inTree, AABBTreeToBufferStats &outStats, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST, bool inAllowRefit = false)
 	{
+		const AABBTreeBuilder::Node *root_node = inTree.GetRoot();
+
 		const typename NodeCodec::EncodingContext node_ctx;
 		typename TriangleCodec::EncodingContext tri_ctx;
 
 		// Estimate the amount of memory required
-		uint tri_count = inRoot->GetTriangleCountInTree();
-		uint node_count = inRoot->GetNodeCount();
-		uint leaf_node_count = inRoot->GetLeafNodeCount();
+		uint tri_count = inTree.GetTriangleCount();
+		uint node_count = inTree.GetNodeCount();
+		uint leaf_node_count = inTree.GetLeafNodeCount();
 		uint nodes_size = node_ctx.GetPessimisticMemoryEstimate(node_count, leaf_node_count);
 		uint total_size = HeaderSize + TriangleHeaderSize + nodes_size + tri_ctx.GetPessimisticMemoryEstimate(tri_count);
 		mTree.reserve(total_size);
@@ -90,6 +92,7 @@ public:
 			uint							mNumChildren;								// Number of children
 			uint							mChildNodeStart[NumChildrenPerNode];		// Start of the children of the node in mTree
 			uint							mChildTrianglesStart[NumChildrenPerNode];	// Start of the triangle data in mTree
+			uint							mChildIndex[NumChildrenPerNode];			// Index of the children in node_list
 			uint *							mParentChildNodeStart;						// Where to store mNodeStart (to patch mChildNodeStart of my parent)
 			uint *							mParentTrianglesStart;						// Where to store mTriangleStart (to patch mChildTrianglesStart of my parent)
 		};
@@ -101,9 +104,9 @@ public:
 		node_list.reserve(node_count); // Needed to ensure that array is not reallocated, so we can keep pointers in the array
 		
 		NodeData root;
-		root.mNode = inRoot;
-		root.mNodeBoundsMin = inRoot->mBounds.mMin;
-		root.mNodeBoundsMax = inRoot->mBounds.mMax;
+		root.mNode = root_node;
+		root.mNodeBoundsMin = root_node->mBounds.mMin;
+		root.mNodeBoundsMax = root_node->mBounds.mMax;
 		node_list.push_back(root);
 		to_process.push_back(&node_list.back());
 
@@ -111,6 +114,12 @@ public:
 		vector<const AABBTreeBuilder::Node *> child_nodes;
 		child_nodes.reserve(NumChildrenPerNode);
 
+		// Triangles of a leaf, the codecs take a list
+		IndexedTriangleList leaf_triangles;
+
+		// Index in node_list of the leafs in the order in which their triangles were packed
+		vector<uint> packed_leafs;
+
 		for (;;)
 		{
 			while (!to_process.empty())
@@ -187,6 +196,7 @@ public:
 						node_list.push_back(child);
 						if (old != &node_list[0])
 							FatalError("AABBTreeToBuffer: Array reallocated, memory corruption!");
+						node_data->mChildIndex[idx] = (uint)node_list.size() - 1;
 
 						switch (inConvertMode)
 						{
@@ -208,7 +218,9 @@ public:
 				else
 				{				
 					// Add triangles
-					node_data->mTriangleStart = tri_ctx.Pack(inVertices, node_data->mNode->mTriangles, node_data->mNodeBoundsMin, node_data->mNodeBoundsMax, mTree);
+					leaf_triangles.assign(node_data->mNode->mTriangles, node_data->mNode->mTriangles + node_data->mNode->GetTriangleCount());
+					node_data->mTriangleStart = tri_ctx.Pack(inVertices, leaf_triangles, node_data->mNodeBoundsMin, node_data->mNodeBoundsMax, mTree);
+					packed_leafs.push_back(uint(node_data - &node_list[0]));
 
 					// Update progress
 					progress.Update(node_data->mNode->GetTriangleCount());
@@ -239,6 +251,32 @@ public:
 		// Get stats
 		tri_ctx.GetStats(outStats.mTriangleCodecName, outStats.mVerticesPerTriangle);
 
+		// Keep the layout of the nodes and the triangles of the leafs so we can refit
+		mRefitNodes.clear();
+		mRefitTriangles.clear();
+		mRefitLeafs.clear();
+		if (inAllowRefit)
+		{
+			mRefitNodes.reserve(node_list.size());
+			mRefitTriangles.reserve(tri_count);
+			for (const NodeData &n : node_list)
+			{
+				RefitNode node;
+				node.mNodeStart = n.mNodeStart;
+				node.mTriangleStart = n.mTriangleStart;
+				node.mNumChildren = n.mNumChildren;
+				for (uint i = 0; i < n.mNumChildren; ++i)
+					node.mChildIndex[i] = n.mChildIndex[i];
+				node.mTrianglesBegin = (uint)mRefitTriangles.size();
+				if (!n.mNode->HasChildren())
+					mRefitTriangles.insert(mRefitTriangles.end(), n.mNode->mTriangles, n.mNode->mTriangles + n.mNode->GetTriangleCount());
+				node.mTrianglesEnd = (uint)mRefitTriangles.size();
+				mRefitNodes.push_back(node);
+			}
+			mRefitLeafs = std::move(packed_leafs);
+			mRefitTriangleContext = std::move(tri_ctx);
+		}
+
 		// Validate that we reserved enough memory
 		if (nodes_size < mNodesSize)
 			FatalError("AABBTreeToBuffer: Not enough memory reserved for nodes!");
@@ -246,7 +284,7 @@ public:
 			FatalError("AABBTreeToBuffer: Not enough memory reserved for triangles!");
 
 		// Finalize the nodes
-		node_ctx.Finalize(header, inRoot, node_list[0].mNodeStart, node_list[0].mTriangleStart);
+		node_ctx.Finalize(header, root_node, node_list[0].mNodeStart, node_list[0].mTriangleStart);
 
 		// Shrink the tree, this will invalidate the header and triangle_header variables
 		mTree.shrink_to_fit();
@@ -258,6 +296,80 @@ public:
 		outStats.mBytesPerTriangle = (float)mTree.size() / tri_count;
 	}
 
+	// Update the tree after the vertices have moved, inVertices must contain the same vertices as the list passed to Convert (but at different positions).
+	// The structure of the tree stays the same, only the bounding boxes of the nodes and the triangle data are updated.
+	// The quality of the tree degrades when the vertices move a lot, so the tree should occasionally be rebuilt.
+	void							Refit(const VertexView &inVertices)
+	{
+		if (mRefitNodes.empty())
+			FatalError("AABBTreeToBuffer: Tree was not converted with inAllowRefit");
+
+		const typename NodeCodec::EncodingContext node_ctx;
+		uint num_nodes = (uint)mRefitNodes.size();
+
+		// Calculate the new bounds bottom up, children are always stored after their parent
+		mRefitBounds.resize(num_nodes);
+		for (uint n = num_nodes; n-- > 0; )
+		{
+			const RefitNode &node = mRefitNodes[n];
+			AABox bounds;
+			for (uint i = 0; i < node.mNumChildren; ++i)
+				bounds.Encapsulate(mRefitBounds[node.mChildIndex[i]]);
+			for (uint t = node.mTrianglesBegin; t < node.mTrianglesEnd; ++t)
+				bounds.Encapsulate(inVertices, mRefitTriangles[t]);
+			mRefitBounds[n] = bounds;
+		}
+
+		// Update the nodes and the triangles top down since, like in Convert, the node codec determines the bounds the children are encoded with
+		mRefitNodeBounds.resize(num_nodes);
+		mRefitNodeBounds[0] = mRefitBounds[0];
+		for (uint n = 0; n < num_nodes; ++n)
+		{
+			const RefitNode &node = mRefitNodes[n];
+			const AABox &node_bounds = mRefitNodeBounds[n];
+
+			// Fill in default child bounds
+			Vec3 child_bounds_min[NumChildrenPerNode], child_bounds_max[NumChildrenPerNode];
+			for (uint i = 0; i < NumChildrenPerNode; ++i)
+				if (i < node.mNumChildren)
+				{
+					child_bounds_min[i] = mRefitBounds[node.mChildIndex[i]].mMin;
+					child_bounds_max[i] = mRefitBounds[node.mChildIndex[i]].mMax;
+				}
+				else
+				{
+					child_bounds_min[i] = Vec3::sZero();
+					child_bounds_max[i] = Vec3::sZero();
+				}
+
+			// Update the node
+			node_ctx.NodeRefit(node.mNodeStart, mRefitBounds[n], node_bounds.mMin, node_bounds.mMax, node.mNumChildren, child_bounds_min, child_bounds_max, mTree);
+
+			for (uint i = 0; i < node.mNumChildren; ++i)
+			{
+				// Due to quantization box could have become bigger, not smaller
+				AABox child_bounds(child_bounds_min[i], child_bounds_max[i]);
+				if (!child_bounds.Contains(mRefitBounds[node.mChildIndex[i]]))
+					FatalError("AABBTreeToBuffer: Bounding box became smaller!");
+
+				mRefitNodeBounds[node.mChildIndex[i]] = child_bounds;
+			}
+		}
+
+		// Update the triangles in the same order as they were packed, so the triangle codec can keep state per call to Pack
+		for (uint n : mRefitLeafs)
+		{
+			const RefitNode &node = mRefitNodes[n];
+			const AABox &node_bounds = mRefitNodeBounds[n];
+			mRefitLeafTriangles.assign(mRefitTriangles.begin() + node.mTrianglesBegin, mRefitTriangles.begin() + node.mTrianglesEnd);
+			mRefitTriangleContext.Refit(inVertices, mRefitLeafTriangles, node_bounds.mMin, node_bounds.mMax, node.mTriangleStart, mTree);
+		}
+
+		// Finalize the triangles and the nodes
+		mRefitTriangleContext.RefitFinalize(inVertices, TriangleHeaderSize > 0? mTree.Get<TriangleHeader>(HeaderSize) : nullptr, mTree);
+		node_ctx.RefitFinalize(HeaderSize > 0? mTree.Get<NodeHeader>(0) : nullptr, mRefitBounds[0]);
+	}
+
 	// Get resulting data
 	inline const ByteBuffer &		GetBuffer() const
 	{
@@ -284,4 +396,26 @@ public:
 	
 	ByteBuffer						mTree;
 	uint							mNodesSize;
+
+private:
+	// Layout of a node in mTree, used to refit the tree
+	struct RefitNode
+	{
+		uint						mNodeStart;									// Start of node in mTree
+		uint						mTriangleStart;								// Start of the triangle data in mTree
+		uint						mNumChildren;								// Number of children, 0 for a leaf
+		uint						mChildIndex[NumChildrenPerNode];			// Index of the children in mRefitNodes
+		uint						mTrianglesBegin;							// Range of the triangles of a leaf in mRefitTriangles
+		uint						mTrianglesEnd;
+	};
+
+	vector<RefitNode>				mRefitNodes;								// Nodes in the order in which Convert processed them, a parent comes before its children
+	IndexedTriangleList				mRefitTriangles;							// Triangles of all leafs, for each leaf in the order in which they were passed to the triangle codec
+	vector<uint>					mRefitLeafs;								// Index in mRefitNodes of the leafs in the order in which their triangles were packed
+	typename TriangleCodec::EncodingContext mRefitTriangleContext;				// Triangle codec state after Convert
+
+	// Temporary data for Refit, kept to avoid allocating every refit
+	vector<AABox>					mRefitBounds;								// Bounds of the triangles in each node
+	vector<AABox>					mRefitNodeBounds;							// Bounds that the node codec passed to each node
+	IndexedTriangleList				mRefitLeafTriangles;
 };
@@ -0,0 +1,256 @@
+#include <pch.h> // IWYU pragma: keep
+
+#include <AABBTree/DynamicAABBTree.h>
+
+// Constructor
+DynamicAABBTree::DynamicAABBTree(const VertexList &inVertices) :
+	mVertices(inVertices)
+{
+}
+
+// Allocate a new node
+uint32 DynamicAABBTree::AllocateNode()
+{
+	uint32 node_index;
+	if (mFreeList != cInvalidNode)
+	{
+		node_index = mFreeList;
+		mFreeList = mNodes[node_index].mParent;
+	}
+	else
+	{
+		node_index = (uint32)mNodes.size();
+		mNodes.emplace_back();
+	}
+
+	Node &node = mNodes[node_index];
+	node.mParent = cInvalidNode;
+	node.mChild[0] = cInvalidNode;
+	node.mChild[1] = cInvalidNode;
+	node.mNumTriangles = 0;
+	node.mVersion = ++mVersion;
+	return node_index;
+}
+
+// Return a node to the free list
+void DynamicAABBTree::FreeNode(uint32 inNode)
+{
+	mNodes[inNode].mParent = mFreeList;
+	mFreeList = inNode;
+}
+
+// Insert a triangle
+uint32 DynamicAABBTree::Insert(const IndexedTriangle &inTriangle)
+{
+	uint32 leaf = AllocateNode();
+	Node &node = mNodes[leaf];
+	node.mTriangle = inTriangle;
+	node.mNumTriangles = 1;
+	node.mBounds = AABox();
+	node.mBounds.Encapsulate(mVertices, inTriangle);
+
+	InsertLeaf(leaf);
+	return leaf;
+}
+
+// Remove a triangle
+void DynamicAABBTree::Remove(uint32 inLeaf)
+{
+	assert(mNodes[inLeaf].IsLeaf());
+
+	RemoveLeaf(inLeaf);
+	FreeNode(inLeaf);
+}
+
+// Update a triangle after its vertices have moved
+void DynamicAABBTree::Update(uint32 inLeaf)
+{
+	assert(mNodes[inLeaf].IsLeaf());
+
+	// Reinsert the leaf, even if the bounds didn't change the triangle did so it needs a new version
+	RemoveLeaf(inLeaf);
+	Node &node = mNodes[inLeaf];
+	node.mBounds = AABox();
+	node.mBounds.Encapsulate(mVertices, node.mTriangle);
+	node.mVersion = ++mVersion;
+	InsertLeaf(inLeaf);
+}
+
+// Insert a leaf that is not part of the tree
+void DynamicAABBTree::InsertLeaf(uint32 inLeaf)
+{
+	if (mRoot == cInvalidNode)
+	{
+		mRoot = inLeaf;
+		mNodes[inLeaf].mParent = cInvalidNode;
+		return;
+	}
+
+	// Find the best sibling by descending the tree, at every node compare the cost of creating a new parent for the node and the leaf
+	// with the cost of inserting the leaf in one of the children. Inserting in a child enlarges this node, which is the inheritance cost.
+	const AABox &leaf_bounds = mNodes[inLeaf].mBounds;
+	uint32 sibling = mRoot;
+	while (!mNodes[sibling].IsLeaf())
+	{
+		const Node &node = mNodes[sibling];
+
+		AABox combined = node.mBounds;
+		combined.Encapsulate(leaf_bounds);
+		float combined_area = combined.GetSurfaceArea();
+		float new_parent_cost = 2.0f * combined_area;
+		float inheritance_cost = 2.0f * (combined_area - node.mBounds.GetSurfaceArea());
+
+		float child_cost[2];
+		for (int i = 0; i < 2; ++i)
+		{
+			const Node &child = mNodes[node.mChild[i]];
+			AABox child_combined = child.mBounds;
+			child_combined.Encapsulate(leaf_bounds);
+			child_cost[i] = child_combined.GetSurfaceArea() + inheritance_cost;
+			if (!child.IsLeaf())
+				child_cost[i] -= child.mBounds.GetSurfaceArea(); // The child will grow but doesn't need a new parent
+		}
+
+		if (new_parent_cost < child_cost[0] && new_parent_cost < child_cost[1])
+			break;
+
+		sibling = child_cost[0] < child_cost[1]? node.mChild[0] : node.mChild[1];
+	}
+
+	// Create a new parent for the sibling and the leaf
+	uint32 old_parent = mNodes[sibling].mParent;
+	uint32 new_parent = AllocateNode();
+	Node &parent = mNodes[new_parent];
+	parent.mParent = old_parent;
+	parent.mChild[0] = sibling;
+	parent.mChild[1] = inLeaf;
+	mNodes[sibling].mParent = new_parent;
+	mNodes[inLeaf].mParent = new_parent;
+	if (old_parent == cInvalidNode)
+		mRoot = new_parent;
+	else
+	{
+		Node &p = mNodes[old_parent];
+		p.mChild[p.mChild[0] == sibling? 0 : 1] = new_parent;
+	}
+
+	UpdateAncestors(new_parent);
+}
+
+// Remove a leaf from the tree
+void DynamicAABBTree::RemoveLeaf(uint32 inLeaf)
+{
+	if (inLeaf == mRoot)
+	{
+		mRoot = cInvalidNode;
+		return;
+	}
+
+	// Replace the parent by the sibling of the leaf
+	uint32 parent = mNodes[inLeaf].mParent;
+	uint32 grand_parent = mNodes[parent].mParent;
+	uint32 sibling = mNodes[parent].mChild[mNodes[parent].mChild[0] == inLeaf? 1 : 0];
+	mNodes[sibling].mParent = grand_parent;
+	FreeNode(parent);
+	if (grand_parent == cInvalidNode)
+		mRoot = sibling;
+	else
+	{
+		Node &g = mNodes[grand_parent];
+		g.mChild[g.mChild[0] == parent? 0 : 1] = sibling;
+		UpdateAncestors(grand_parent);
+	}
+}
+
+// Recalculate bounds and triangle count of a node from its children
+void DynamicAABBTree::UpdateNode(uint32 inNode)
+{
+	Node &node = mNodes[inNode];
+	const Node &child1 = mNodes[node.mChild[0]];
+	const Node &child2 = mNodes[node.mChild[1]];
+	node.mBounds = child1.mBounds;
+	node.mBounds.Encapsulate(child2.mBounds);
+	node.mNumTriangles = child1.mNumTriangles + child2.mNumTriangles;
+	node.mVersion = ++mVersion;
+}
+
+// Walk up the tree to update the bounds
+void DynamicAABBTree::UpdateAncestors(uint32 inNode)
+{
+	for (uint32 node = inNode; node != cInvalidNode; node = mNodes[node].mParent)
+	{
+		UpdateNode(node);
+
+		// Rotating doesn't change the bounds of this node, only the bounds of one of its children
+		Rotate(node);
+	}
+}
+
+// Try to reduce the surface area of the children of inNode
+void DynamicAABBTree::Rotate(uint32 inNode)
+{
+	// Consider swapping child c with grandchild g (a child of the other child), this changes the bounds of the other child
+	float best_gain = 0.0f;
+	int best_child = -1, best_grand_child = -1;
+	for (int c = 0; c < 2; ++c)
+	{
+		const Node &child = mNodes[mNodes[inNode].mChild[c]];
+		const Node &other = mNodes[mNodes[inNode].mChild[1 - c]];
+		if (other.IsLeaf())
+			continue;
+
+		float other_area = other.mBounds.GetSurfaceArea();
+		for (int g = 0; g < 2; ++g)
+		{
+			// After the swap, the other child contains this child and the grandchild that stays
+			AABox bounds = child.mBounds;
+			bounds.Encapsulate(mNodes[other.mChild[1 - g]].mBounds);
+			float gain = other_area - bounds.GetSurfaceArea();
+			if (gain > best_gain)
+			{
+				best_gain = gain;
+				best_child = c;
+				best_grand_child = g;
+			}
+		}
+	}
+
+	if (best_child < 0)
+		return;
+
+	// Swap the child and the grandchild, the swapped subtrees themselves don't change so keep their versions
+	Node &node = mNodes[inNode];
+	uint32 child = node.mChild[best_child];
+	uint32 other = node.mChild[1 - best_child];
+	uint32 grand_child = mNodes[other].mChild[best_grand_child];
+	node.mChild[best_child] = grand_child;
+	mNodes[grand_child].mParent = inNode;
+	mNodes[other].mChild[best_grand_child] = child;
+	mNodes[child].mParent = other;
+	UpdateNode(other);
+}
+
+// Calculate the SAH cost of the tree
+float DynamicAABBTree::GetSAHCost() const
+{
+	if (mRoot == cInvalidNode)
+		return 0.0f;
+
+	// Sum the surface areas of all non-leaf nodes and of the leafs times their triangle count (which is 1)
+	double surface_area = 0.0;
+	vector<uint32> to_process;
+	to_process.push_back(mRoot);
+	while (!to_process.empty())
+	{
+		const Node &node = mNodes[to_process.back()];
+		to_process.pop_back();
+		surface_area += node.mBounds.GetSurfaceArea();
+		if (!node.IsLeaf())
+		{
+			to_process.push_back(node.mChild[0]);
+			to_process.push_back(node.mChild[1]);
+		}
+	}
+
+	return float(surface_area / mNodes[mRoot].mBounds.GetSurfaceArea());
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Geometry/AABox.h>
+#include <Geometry/IndexedTriangle.h>
+
+// Binary AABB tree that can be modified after it has been built, every leaf contains a single triangle.
+//
+// Triangles are inserted next to the node where they increase the surface area of the tree the least (surface area heuristic)
+// and tree rotations on the path back to the root keep the tree from degrading when triangles are inserted and removed.
+// Every modification gives the modified nodes and all their ancestors a new version, subtrees that kept their version didn't change.
+// This allows a converted tree to only convert the subtrees that changed again (see DynamicAABBTreeToBuffer).
+class DynamicAABBTree
+{
+public:
+	// Index of a node that doesn't exist
+	static constexpr uint32	cInvalidNode = 0xffffffff;
+
+	// A node in the tree, nodes are identified by their index which doesn't change as long as the node is part of the tree
+	class Node
+	{
+	public:
+		// Check if this node is a leaf, leafs contain a triangle, other nodes always have 2 children
+		inline bool			IsLeaf() const							{ return mChild[0] == cInvalidNode; }
+
+		// Bounding box
+		AABox				mBounds;
+
+		// Parent node, cInvalidNode for the root (when the node is not in use this is the next free node)
+		uint32				mParent;
+
+		// Child nodes, cInvalidNode for a leaf
+		uint32				mChild[2];
+
+		// Number of triangles in this node and all of its children
+		uint32				mNumTriangles;
+
+		// Changes every time this node or one of its children is modified
+		uint64				mVersion;
+
+		// Triangle (if leaf)
+		IndexedTriangle		mTriangle;
+	};
+
+	// Constructor, inVertices is referenced by the tree and can be modified when the tree is updated with the new positions (see Update)
+	explicit				DynamicAABBTree(const VertexList &inVertices);
+
+	// Insert a triangle, returns the leaf that can be used to update or remove the triangle
+	uint32					Insert(const IndexedTriangle &inTriangle);
+
+	// Remove the triangle that was returned by Insert
+	void					Remove(uint32 inLeaf);
+
+	// Update the tree after the vertices of the triangle that was returned by Insert have moved. The leaf stays the same.
+	void					Update(uint32 inLeaf);
+
+	// Get the vertices of the tree
+	inline const VertexList &GetVertices() const					{ return mVertices; }
+
+	// Get the root of the tree, cInvalidNode if the tree is empty
+	inline uint32			GetRoot() const							{ return mRoot; }
+
+	// Access a node
+	inline const Node &		GetNode(uint32 inNode) const			{ return mNodes[inNode]; }
+
+	// Nodes are identified by an index below this value
+	inline uint32			GetNodeCapacity() const					{ return (uint32)mNodes.size(); }
+
+	// Get triangle count in tree
+	inline uint				GetTriangleCount() const				{ return mRoot != cInvalidNode? mNodes[mRoot].mNumTriangles : 0; }
+
+	// Get the Surface Area Heuristic cost of the tree, relative to the surface area of the root (traversal and leaf cost are 1)
+	float					GetSAHCost() const;
+
+private:
+	// Allocate a new node from the free list, the node gets a new version
+	uint32					AllocateNode();
+
+	// Return a node to the free list
+	void					FreeNode(uint32 inNode);
+
+	// Insert a leaf that is not part of the tree
+	void					InsertLeaf(uint32 inLeaf);
+
+	// Remove a leaf from the tree, the leaf is not freed
+	void					RemoveLeaf(uint32 inLeaf);
+
+	// Recalculate the bounds of inNode and its ancestors after one of their children changed and give them a new version
+	void					UpdateAncestors(uint32 inNode);
+
+	// Try to reduce the surface area of the children of inNode by swapping a child with a grandchild
+	void					Rotate(uint32 inNode);
+
+	// Recalculate bounds and triangle count of a node from its children and give it a new version
+	void					UpdateNode(uint32 inNode);
+
+	const VertexList &		mVertices;
+	vector<Node>			mNodes;
+	uint32					mRoot = cInvalidNode;
+	uint32					mFreeList = cInvalidNode;
+	uint64					mVersion = 0;
+};
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <AABBTree/DynamicAABBTree.h>
+#include <AABBTree/AABBTreeBuilder.h>
+#include <Core/ByteBuffer.h>
+
+// Converts a DynamicAABBTree to a buffer with the same layout as AABBTreeToBuffer (using CONVERT_DEPTH_FIRST) and keeps the buffer up to date when the tree is modified.
+//
+// The tree is split in clusters, the largest subtrees that have at most inClusterSize triangles. The nodes above the clusters are converted again on every
+// update and are stored in a region directly after the headers. Clusters are appended to the buffer and are only converted again when their version changed.
+// When more than half of the cluster data is no longer used, the whole tree is converted again to reclaim the memory.
+//
+// Within a cluster, subtrees that have at most inMaxTrianglesPerLeaf triangles are stored as a single leaf.
+// Triangle codecs that store data in a header depend on all triangles and can't be updated incrementally so they are not supported.
+template <class TriangleCodec, class NodeCodec>
+class DynamicAABBTreeToBuffer
+{
+public:
+	// Header for the tree
+	using NodeHeader = typename NodeCodec::Header;
+	static const int HeaderSize = NodeCodec::HeaderSize;
+	static const int NumChildrenPerNode = NodeCodec::NumChildrenPerNode;
+
+	// Header for the triangles
+	using TriangleHeader = typename TriangleCodec::TriangleHeader;
+	static const int TriangleHeaderSize = TriangleCodec::TriangleHeaderSize;
+
+	static_assert(TriangleHeaderSize == 0, "Triangle codecs with a header can't be updated incrementally");
+
+	// Constructor
+									DynamicAABBTreeToBuffer(uint inMaxTrianglesPerLeaf = 8, uint inClusterSize = 1024) :
+		mMaxTrianglesPerLeaf(inMaxTrianglesPerLeaf),
+		mClusterSize(max(inClusterSize, inMaxTrianglesPerLeaf))
+	{
+	}
+
+	// Update the buffer after the tree was modified, only the clusters that changed are converted again.
+	// The first update (or an update with inConvertAll) converts the entire tree.
+	void							Update(const DynamicAABBTree &inTree, bool inConvertAll = false)
+	{
+		uint32 root = inTree.GetRoot();
+		if (root == DynamicAABBTree::cInvalidNode)
+			FatalError("DynamicAABBTreeToBuffer: Tree is empty");
+		const DynamicAABBTree::Node &root_node = inTree.GetNode(root);
+
+		const typename NodeCodec::EncodingContext node_ctx;
+		mTriangleContext = typename TriangleCodec::EncodingContext();
+		mNumTrianglesConverted = 0;
+
+		// Determine if we need to convert everything
+		uint top_start = HeaderSize + TriangleHeaderSize;
+		uint top_size = node_ctx.GetPessimisticMemoryEstimate(CountTopNodes(inTree, root), 0);
+		bool convert_all = inConvertAll
+			|| mTree.empty()
+			|| !IsTopNode(inTree, root) // The entire tree is a single cluster, it's stored directly after the headers
+			|| top_size > mTopCapacity // The top nodes don't fit in their region anymore
+			|| (uint)mTree.size() - mClustersStart > 2 * mClustersSize; // More than half of the clusters are no longer used
+		if (convert_all)
+		{
+			// Reserve space for the top nodes with room to grow
+			mTopCapacity = 2 * top_size;
+			mTree.clear();
+			mTree.resize(top_start + mTopCapacity);
+			mClustersStart = (uint)mTree.size();
+			mClusters.clear();
+		}
+		mClusters.resize(inTree.GetNodeCapacity());
+		mClustersSize = 0;
+
+		AABBTreeBuilder::Node root_proxy;
+		uint root_node_start, root_triangles_start;
+		if (!IsTopNode(inTree, root))
+		{
+			// Small tree, the top region is empty so the cluster directly follows the headers
+			ConvertCluster(inTree, root, root_node.mBounds.mMin, root_node.mBounds.mMax, root_node_start, root_triangles_start);
+			root_proxy = mClusterNodes[0];
+		}
+		else
+		{
+			// Convert the top nodes into a separate buffer that has the same offsets as the top region
+			mTopBuffer.clear();
+			mTopBuffer.resize(top_start);
+			ConvertTopNode(inTree, root, root_node.mBounds.mMin, root_node.mBounds.mMax, root_node_start);
+			root_triangles_start = (uint)-1;
+			GetProxy(inTree, root, root_proxy);
+
+			// Copy the top nodes into their region
+			if ((uint)mTopBuffer.size() > top_start + mTopCapacity)
+				FatalError("DynamicAABBTreeToBuffer: Not enough memory reserved for top nodes!");
+			memcpy(&mTree[top_start], &mTopBuffer[top_start], mTopBuffer.size() - top_start);
+		}
+
+		// Finalize the triangles and the nodes
+		mTriangleContext.Finalize(nullptr, mTree);
+		node_ctx.Finalize(mTree.Get<NodeHeader>(0), &root_proxy, root_node_start, root_triangles_start);
+	}
+
+	// Get amount of triangles that were converted by the last update
+	inline uint						GetNumTrianglesConverted() const
+	{
+		return mNumTrianglesConverted;
+	}
+
+	// Get resulting data
+	inline const ByteBuffer &		GetBuffer() const
+	{
+		return mTree;
+	}
+
+	// Get header for tree
+	inline const NodeHeader *		GetNodeHeader() const
+	{
+		return mTree.Get<NodeHeader>(0);
+	}
+
+	// Get header for triangles
+	inline const TriangleHeader *	GetTriangleHeader() const
+	{
+		return mTree.Get<TriangleHeader>(HeaderSize);
+	}
+
+	// Get root of resulting tree
+	inline const void *				GetRoot() const
+	{
+		return mTree.Get<void>(HeaderSize + TriangleHeaderSize);
+	}
+
+private:
+	// A cluster that was written to mTree
+	struct Cluster
+	{
+		uint64						mVersion = 0;								// Version of the root of the cluster when it was converted, 0 if the cluster was not converted
+		Vec3						mBoundsMin;									// Bounds that were used to convert the cluster
+		Vec3						mBoundsMax;
+		uint						mNodeStart;									// Start of the root node of the cluster in mTree
+		uint						mTrianglesStart;							// Start of the triangle data of the root node of the cluster in mTree
+		uint						mSize;										// Amount of bytes used by the cluster
+	};
+
+	// Check if a node of the tree is above the clusters
+	inline bool						IsTopNode(const DynamicAABBTree &inTree, uint32 inNode) const
+	{
+		return inTree.GetNode(inNode).mNumTriangles > mClusterSize;
+	}
+
+	// Count the nodes above the clusters
+	uint							CountTopNodes(const DynamicAABBTree &inTree, uint32 inNode) const
+	{
+		if (!IsTopNode(inTree, inNode))
+			return 0;
+
+		const DynamicAABBTree::Node &node = inTree.GetNode(inNode);
+		return 1 + CountTopNodes(inTree, node.mChild[0]) + CountTopNodes(inTree, node.mChild[1]);
+	}
+
+	// Create a node that the node codec can use to convert a node of the tree that is not part of a cluster that is being converted.
+	// The node codec only looks at the bounds and the triangle count of the node and if the node has children, so the children point to the node itself.
+	void							GetProxy(const DynamicAABBTree &inTree, uint32 inNode, AABBTreeBuilder::Node &outProxy) const
+	{
+		const DynamicAABBTree::Node &node = inTree.GetNode(inNode);
+		outProxy.mBounds = node.mBounds;
+		if (node.mNumTriangles > mMaxTrianglesPerLeaf)
+		{
+			outProxy.mChild[0] = &outProxy;
+			outProxy.mChild[1] = &outProxy;
+		}
+		else
+			outProxy.mNumTriangles = node.mNumTriangles;
+	}
+
+	// Collect the first NumChildrenPerNode sub-nodes of a top node like AABBTreeBuilder::Node::GetNChildren, but don't expand clusters
+	uint							GetTopChildren(const DynamicAABBTree &inTree, uint32 inNode, uint32 outChildren[NumChildrenPerNode]) const
+	{
+		const DynamicAABBTree::Node &node = inTree.GetNode(inNode);
+		outChildren[0] = node.mChild[0];
+		outChildren[1] = node.mChild[1];
+		uint num_children = 2;
+
+		uint next = 0;
+		bool all_clusters = true;
+		while (num_children < NumChildrenPerNode)
+		{
+			// If we have looped over all nodes, start over with the first node again
+			if (next >= num_children)
+			{
+				// If there are only clusters left, we have to terminate
+				if (all_clusters)
+					break;
+				next = 0;
+				all_clusters = true;
+			}
+
+			// Try to expand this node into its two children
+			uint32 to_expand = outChildren[next];
+			if (IsTopNode(inTree, to_expand))
+			{
+				const DynamicAABBTree::Node &expand_node = inTree.GetNode(to_expand);
+				for (uint i = next + 1; i < num_children; ++i)
+					outChildren[i - 1] = outChildren[i];
+				outChildren[num_children - 1] = expand_node.mChild[0];
+				outChildren[num_children] = expand_node.mChild[1];
+				++num_children;
+				all_clusters = false;
+			}
+			else
+			{
+				++next;
+			}
+		}
+
+		return num_children;
+	}
+
+	// Convert a node above the clusters into mTopBuffer, the clusters below it are converted into mTree when they changed
+	void							ConvertTopNode(const DynamicAABBTree &inTree, uint32 inNode, const Vec3 &inNodeBoundsMin, const Vec3 &inNodeBoundsMax, uint &outNodeStart)
+	{
+		const typename NodeCodec::EncodingContext node_ctx;
+
+		// Collect the children and create the nodes that the node codec uses
+		uint32 children[NumChildrenPerNode];
+		uint num_children = GetTopChildren(inTree, inNode, children);
+		AABBTreeBuilder::Node proxy, child_proxies[NumChildrenPerNode];
+		GetProxy(inTree, inNode, proxy);
+		mChildNodes.clear();
+		for (uint i = 0; i < num_children; ++i)
+		{
+			GetProxy(inTree, children[i], child_proxies[i]);
+			mChildNodes.push_back(&child_proxies[i]);
+		}
+
+		// Fill in default child bounds
+		Vec3 child_bounds_min[NumChildrenPerNode], child_bounds_max[NumChildrenPerNode];
+		for (uint i = 0; i < NumChildrenPerNode; ++i)
+			if (i < num_children)
+			{
+				child_bounds_min[i] = child_proxies[i].mBounds.mMin;
+				child_bounds_max[i] = child_proxies[i].mBounds.mMax;
+			}
+			else
+			{
+				child_bounds_min[i] = Vec3::sZero();
+				child_bounds_max[i] = Vec3::sZero();
+			}
+
+		// Allocate the node, the node codec can reorder the children
+		outNodeStart = node_ctx.NodeAllocate(&proxy, inNodeBoundsMin, inNodeBoundsMax, mChildNodes, child_bounds_min, child_bounds_max, mTopBuffer);
+		uint32 ordered_children[NumChildrenPerNode];
+		for (uint i = 0; i < num_children; ++i)
+			ordered_children[i] = children[mChildNodes[i] - child_proxies];
+
+		// Convert the children
+		uint child_node_start[NumChildrenPerNode], child_triangles_start[NumChildrenPerNode];
+		for (uint i = 0; i < num_children; ++i)
+		{
+			// Due to quantization box could have become bigger, not smaller
+			if (!AABox(child_bounds_min[i], child_bounds_max[i]).Contains(inTree.GetNode(ordered_children[i]).mBounds))
+				FatalError("DynamicAABBTreeToBuffer: Bounding box became smaller!");
+
+			if (IsTopNode(inTree, ordered_children[i]))
+			{
+				ConvertTopNode(inTree, ordered_children[i], child_bounds_min[i], child_bounds_max[i], child_node_start[i]);
+				child_triangles_start[i] = (uint)-1;
+			}
+			else
+			{
+				// Reuse the cluster if it didn't change and the node codec wants to store it with the same bounds
+				Cluster &cluster = mClusters[ordered_children[i]];
+				if (cluster.mVersion != inTree.GetNode(ordered_children[i]).mVersion || !(cluster.mBoundsMin == child_bounds_min[i]) || !(cluster.mBoundsMax == child_bounds_max[i]))
+				{
+					uint cluster_start = (uint)mTree.size();
+					ConvertCluster(inTree, ordered_children[i], child_bounds_min[i], child_bounds_max[i], cluster.mNodeStart, cluster.mTrianglesStart);
+					cluster.mVersion = inTree.GetNode(ordered_children[i]).mVersion;
+					cluster.mBoundsMin = child_bounds_min[i];
+					cluster.mBoundsMax = child_bounds_max[i];
+					cluster.mSize = (uint)mTree.size() - cluster_start;
+				}
+				child_node_start[i] = cluster.mNodeStart;
+				child_triangles_start[i] = cluster.mTrianglesStart;
+				mClustersSize += cluster.mSize;
+			}
+		}
+
+		node_ctx.NodeFinalize(&proxy, outNodeStart, (uint)-1, num_children, child_node_start, child_triangles_start, mTopBuffer);
+	}
+
+	// Create the nodes of a cluster in mClusterNodes (root first) and collect its triangles in mClusterTriangles
+	void							CreateClusterNodes(const DynamicAABBTree &inTree, uint32 inNode)
+	{
+		const DynamicAABBTree::Node &node = inTree.GetNode(inNode);
+		AABBTreeBuilder::Node &cluster_node = mClusterNodes.emplace_back();
+		cluster_node.mBounds = node.mBounds;
+
+		if (node.mNumTriangles > mMaxTrianglesPerLeaf)
+		{
+			// Node, the left child directly follows its parent
+			CreateClusterNodes(inTree, node.mChild[0]);
+			const AABBTreeBuilder::Node *right = &mClusterNodes.back() + 1;
+			CreateClusterNodes(inTree, node.mChild[1]);
+			cluster_node.mChild[0] = &cluster_node + 1;
+			cluster_node.mChild[1] = right;
+		}
+		else
+		{
+			// Leaf, collect the triangles of all leafs of the tree below this node
+			uint begin = (uint)mClusterTriangles.size();
+			mToProcess.clear();
+			mToProcess.push_back(inNode);
+			while (!mToProcess.empty())
+			{
+				const DynamicAABBTree::Node &n = inTree.GetNode(mToProcess.back());
+				mToProcess.pop_back();
+				if (n.IsLeaf())
+					mClusterTriangles.push_back(n.mTriangle);
+				else
+				{
+					mToProcess.push_back(n.mChild[1]);
+					mToProcess.push_back(n.mChild[0]);
+				}
+			}
+			cluster_node.mTriangles = &mClusterTriangles[begin];
+			cluster_node.mNumTriangles = node.mNumTriangles;
+		}
+	}
+
+	// Append a cluster to mTree
+	void							ConvertCluster(const DynamicAABBTree &inTree, uint32 inNode, const Vec3 &inNodeBoundsMin, const Vec3 &inNodeBoundsMax, uint &outNodeStart, uint &outTrianglesStart)
+	{
+		// The arrays are reserved so that the nodes can point to each other and to the triangles
+		uint num_triangles = inTree.GetNode(inNode).mNumTriangles;
+		mClusterNodes.clear();
+		mClusterNodes.reserve(2 * num_triangles);
+		mClusterTriangles.clear();
+		mClusterTriangles.reserve(num_triangles);
+		CreateClusterNodes(inTree, inNode);
+
+		ConvertClusterNode(inTree.GetVertices(), &mClusterNodes[0], inNodeBoundsMin, inNodeBoundsMax, outNodeStart, outTrianglesStart);
+		mNumTrianglesConverted += num_triangles;
+	}
+
+	// Convert a node of a cluster and its children depth first
+	void							ConvertClusterNode(const VertexView &inVertices, const AABBTreeBuilder::Node *inNode, const Vec3 &inNodeBoundsMin, const Vec3 &inNodeBoundsMax, uint &outNodeStart, uint &outTrianglesStart)
+	{
+		const typename NodeCodec::EncodingContext node_ctx;
+
+		// Collect the first NumChildrenPerNode sub-nodes in the tree
+		mChildNodes.clear();
+		inNode->GetNChildren(NumChildrenPerNode, mChildNodes);
+		uint num_children = (uint)mChildNodes.size();
+
+		// Fill in default child bounds
+		Vec3 child_bounds_min[NumChildrenPerNode], child_bounds_max[NumChildrenPerNode];
+		for (uint i = 0; i < NumChildrenPerNode; ++i)
+			if (i < num_children)
+			{
+				child_bounds_min[i] = mChildNodes[i]->mBounds.mMin;
+				child_bounds_max[i] = mChildNodes[i]->mBounds.mMax;
+			}
+			else
+			{
+				child_bounds_min[i] = Vec3::sZero();
+				child_bounds_max[i] = Vec3::sZero();
+			}
+
+		// Allocate the node, mChildNodes is reused by the children so take a copy
+		outNodeStart = node_ctx.NodeAllocate(inNode, inNodeBoundsMin, inNodeBoundsMax, mChildNodes, child_bounds_min, child_bounds_max, mTree);
+		const AABBTreeBuilder::Node *children[NumChildrenPerNode];
+		for (uint i = 0; i < num_children; ++i)
+			children[i] = mChildNodes[i];
+
+		uint child_node_start[NumChildrenPerNode], child_triangles_start[NumChildrenPerNode];
+		if (inNode->HasChildren())
+		{
+			outTrianglesStart = (uint)-1;
+			for (uint i = 0; i < num_children; ++i)
+			{
+				// Due to quantization box could have become bigger, not smaller
+				if (!AABox(child_bounds_min[i], child_bounds_max[i]).Contains(children[i]->mBounds))
+					FatalError("DynamicAABBTreeToBuffer: Bounding box became smaller!");
+
+				ConvertClusterNode(inVertices, children[i], child_bounds_min[i], child_bounds_max[i], child_node_start[i], child_triangles_start[i]);
+			}
+		}
+		else
+		{
+			// Add triangles
+			mLeafTriangles.assign(inNode->mTriangles, inNode->mTriangles + inNode->GetTriangleCount());
+			outTrianglesStart = mTriangleContext.Pack(inVertices, mLeafTriangles, inNodeBoundsMin, inNodeBoundsMax, mTree);
+		}
+
+		node_ctx.NodeFinalize(inNode, outNodeStart, outTrianglesStart, num_children, child_node_start, child_triangles_start, mTree);
+	}
+
+	ByteBuffer						mTree;
+	uint							mMaxTrianglesPerLeaf;
+	uint							mClusterSize;
+	uint							mTopCapacity = 0;							// Size of the region after the headers that is reserved for the top nodes
+	uint							mClustersStart = 0;							// Start of the clusters in mTree
+	uint							mClustersSize = 0;							// Amount of bytes used by the clusters that are used by the tree
+	uint							mNumTrianglesConverted = 0;
+	vector<Cluster>					mClusters;									// Cluster data for each node of the tree, only valid for nodes that are the root of a cluster
+	typename TriangleCodec::EncodingContext mTriangleContext;
+
+	// Temporary data, kept to avoid allocating every update
+	ByteBuffer						mTopBuffer;
+	vector<const AABBTreeBuilder::Node *> mChildNodes;
+	vector<AABBTreeBuilder::Node>	mClusterNodes;
+	IndexedTriangleList				mClusterTriangles;
+	IndexedTriangleList				mLeafTriangles;
+	vector<uint32>					mToProcess;
+};
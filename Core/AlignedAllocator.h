@@ -45,15 +45,28 @@ public:
 		return &r;
 	}
 
-	// Allocate memory
+	// Allocate memory, large blocks are backed by huge pages when they have been enabled with SetHugePages
 	inline pointer			allocate(size_type n)
 	{
-		return (pointer)AlignedAlloc(n * sizeof(value_type), N);
+		static_assert(N <= 4096, "Huge page blocks are only aligned to 4096 bytes");
+
+		size_t size = n * sizeof(value_type);
+		if (size >= cHugePageMinAllocationSize)
+		{
+			void *block = HugePageAlloc(size);
+			if (block != nullptr)
+				return (pointer)block;
+		}
+
+		return (pointer)AlignedAlloc(size, N);
 	}
 
 	// Free memory
-	inline void				deallocate(pointer p, size_type)
+	inline void				deallocate(pointer p, size_type n)
 	{
+		if (n * sizeof(value_type) >= cHugePageMinAllocationSize && HugePageFree(p))
+			return;
+
 		AlignedFree(p);
 	}
 
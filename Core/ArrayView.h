@@ -0,0 +1,33 @@
+#pragma once
+
+// Read only view on a contiguous array that is owned by someone else (e.g. a vector or a memory mapped file).
+// Can be constructed implicitly from a vector so that functions taking a view also accept the lists they used to take.
+// The view is only valid as long as the data it points to.
+template <class T>
+class ArrayView
+{
+public:
+	// Constructor
+						ArrayView() = default;
+						ArrayView(const T *inData, size_t inSize) : mData(inData), mSize(inSize) { }
+	template <class Allocator>
+						ArrayView(const vector<T, Allocator> &inVector) : mData(inVector.data()), mSize(inVector.size()) { }
+
+	// Access an element
+	const T &			operator [] (size_t inIdx) const
+	{
+		assert(inIdx < mSize);
+		return mData[inIdx];
+	}
+
+	// Vector like interface
+	size_t				size() const									{ return mSize; }
+	bool				empty() const									{ return mSize == 0; }
+	const T *			data() const									{ return mData; }
+	const T *			begin() const									{ return mData; }
+	const T *			end() const										{ return mData + mSize; }
+
+private:
+	const T *			mData = nullptr;
+	size_t				mSize = 0;
+};
@@ -26,6 +26,18 @@ inline void hash_combine(std::size_t &ioSeed, const T &inValue, Rest... inRest)
     hash_combine(ioSeed, inRest...);
 }
 
+// 64 bit FNV-1a hash of a block of memory
+inline uint64 HashBytes(const void *inData, size_t inSize, uint64 inSeed = 0xcbf29ce484222325ULL)
+{
+	uint64 hash = inSeed;
+	for (const uint8 *data = reinterpret_cast<const uint8 *>(inData), *end = data + inSize; data < end; ++data)
+	{
+		hash ^= uint64(*data);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
 #define MAKE_HASH_STRUCT(type, name, ...)					\
 	struct name												\
 	{														\
@@ -0,0 +1,107 @@
+#include <pch.h> // IWYU pragma: keep
+
+#include <Core/MappedFile.h>
+
+#if defined(__linux__)
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+	mData(nullptr),
+	mSize(0)
+#if defined(_WIN32)
+	, mFile(INVALID_HANDLE_VALUE),
+	mMapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+void MappedFile::Open(const char *inFileName)
+{
+	Close();
+
+#if defined(_WIN32)
+	// Open file
+	mFile = CreateFileA(inFileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		FatalError("Unable to open file: %s", inFileName);
+
+	// Get size
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		FatalError("Unable to map empty file: %s", inFileName);
+	}
+
+	// Map the file
+	mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void *data = mMapping != nullptr? MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (data == nullptr)
+	{
+		Close();
+		FatalError("Unable to map file: %s", inFileName);
+	}
+
+	mData = reinterpret_cast<const uint8 *>(data);
+	mSize = size_t(size.QuadPart);
+#elif defined(__linux__)
+	// Open file
+	int fd = open(inFileName, O_RDONLY);
+	if (fd < 0)
+		FatalError("Unable to open file: %s", inFileName);
+
+	// Get size
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		FatalError("Unable to map empty file: %s", inFileName);
+	}
+
+	// Map the file, the mapping keeps its own reference to the file so we can close the descriptor
+	void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		FatalError("Unable to map file: %s", inFileName);
+
+	mData = reinterpret_cast<const uint8 *>(data);
+	mSize = size_t(st.st_size);
+#else
+	#error Undefined
+#endif
+}
+
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+	}
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+#elif defined(__linux__)
+	if (mData != nullptr)
+		munmap(const_cast<uint8 *>(mData), mSize);
+#else
+	#error Undefined
+#endif
+
+	mData = nullptr;
+	mSize = 0;
+}
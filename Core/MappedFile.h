@@ -0,0 +1,44 @@
+#pragma once
+
+// Maps a file read only into memory, the data remains valid until the file is closed or the object is destroyed.
+// The data starts at a page boundary so any offset in the file that is aligned is also aligned in memory.
+class MappedFile
+{
+public:
+	// Constructor / destructor
+								MappedFile();
+								MappedFile(const MappedFile &) = delete;
+								~MappedFile();
+
+	// Assignment operator
+	MappedFile &				operator = (const MappedFile &) = delete;
+
+	// Map inFileName into memory, calls FatalError when the file cannot be mapped
+	void						Open(const char *inFileName);
+
+	// Unmap the file
+	void						Close();
+
+	// Check if a file is mapped
+	bool						IsOpen() const							{ return mData != nullptr; }
+
+	// Access the mapped data
+	const uint8 *				GetData() const							{ return mData; }
+	size_t						GetSize() const							{ return mSize; }
+
+	// Get object at inPosition
+	template <class Type>
+	const Type *				Get(size_t inPosition) const
+	{
+		assert(inPosition + sizeof(Type) <= mSize);
+		return reinterpret_cast<const Type *>(mData + inPosition);
+	}
+
+private:
+	const uint8 *				mData;
+	size_t						mSize;
+#if defined(_WIN32)
+	HANDLE						mFile;
+	HANDLE						mMapping;
+#endif
+};
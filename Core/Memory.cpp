@@ -1,6 +1,14 @@
 #include <pch.h> // IWYU pragma: keep
 
 #include <Core/Memory.h>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(__linux__)
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#include <fstream>
+#endif
 
 // Allocate a block of memory aligned to inAlignment bytes of size inSize
 void *AlignedAlloc(size_t inSize, size_t inAlignment)
@@ -25,3 +33,141 @@ void AlignedFree(void *inBlock)
 	#error Undefined
 #endif
 }
+
+// Huge page mode selected by SetHugePages
+static EHugePages sHugePages = EHugePages::HUGE_PAGES_NONE;
+
+// A block allocated by HugePageAlloc
+struct HugePageBlock
+{
+	size_t				mSize;											// Size that was mapped
+	size_t				mPageSize;										// Size of the pages that are known to back the block
+	bool				mTransparent;									// If transparent huge pages were requested for the block
+};
+
+// All blocks allocated by HugePageAlloc
+static mutex sHugePageMutex;
+static unordered_map<void *, HugePageBlock> sHugePageBlocks;
+
+#if defined(__linux__)
+
+// Check if the kernel can back a block that was marked with MADV_HUGEPAGE with transparent huge pages ('always' or 'madvise', not 'never')
+static bool sTransparentHugePagesEnabled()
+{
+	static bool enabled = []() {
+		ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+		string setting;
+		getline(file, setting);
+		return setting.find("[always]") != string::npos || setting.find("[madvise]") != string::npos;
+	}();
+	return enabled;
+}
+
+#endif
+
+// Select which pages back blocks allocated by HugePageAlloc, only affects new allocations
+void SetHugePages(EHugePages inHugePages)
+{
+	sHugePages = inHugePages;
+}
+
+// Allocate a block of memory of size inSize that is backed by huge pages
+void *HugePageAlloc(size_t inSize)
+{
+	if (sHugePages == EHugePages::HUGE_PAGES_NONE || inSize < cHugePageMinAllocationSize)
+		return nullptr;
+
+	void *block = nullptr;
+	HugePageBlock info;
+	info.mTransparent = false;
+
+#if defined(_WIN32)
+	// Large pages require the 'Lock pages in memory' privilege, without it VirtualAlloc fails. Windows has no transparent huge pages.
+	size_t page_size = GetLargePageMinimum();
+	if (sHugePages != EHugePages::HUGE_PAGES_EXPLICIT || page_size == 0)
+		return nullptr;
+	info.mSize = AlignUp(inSize, page_size);
+	info.mPageSize = page_size;
+	block = VirtualAlloc(nullptr, info.mSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	if (block == nullptr)
+		return nullptr;
+#elif defined(__linux__)
+	const size_t page_size = 2 * 1024 * 1024;
+	info.mSize = AlignUp(inSize, page_size);
+	info.mPageSize = page_size;
+
+	// Try the reserved huge page pool first (see /proc/sys/vm/nr_hugepages)
+	if (sHugePages == EHugePages::HUGE_PAGES_EXPLICIT)
+	{
+		block = mmap(nullptr, info.mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (block == MAP_FAILED)
+			block = nullptr;
+	}
+
+	// Map regular pages and ask the kernel to back them with huge pages, this requires that the block is aligned to a huge page
+	if (block == nullptr)
+	{
+		size_t mapped_size = info.mSize + page_size;
+		uint8 *mapped = (uint8 *)mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapped == MAP_FAILED)
+			return nullptr;
+		uint8 *aligned = (uint8 *)AlignUp(size_t(mapped), page_size);
+		if (aligned > mapped)
+			munmap(mapped, aligned - mapped);
+		munmap(aligned + info.mSize, mapped + mapped_size - aligned - info.mSize);
+		block = aligned;
+
+		// The block uses regular pages until the kernel merges them, which it only does when transparent huge pages are enabled
+		info.mPageSize = size_t(sysconf(_SC_PAGESIZE));
+		info.mTransparent = madvise(block, info.mSize, MADV_HUGEPAGE) == 0 && sTransparentHugePagesEnabled();
+	}
+#else
+	#error Undefined
+#endif
+
+	lock_guard<mutex> lock(sHugePageMutex);
+	sHugePageBlocks[block] = info;
+	return block;
+}
+
+// Free memory block allocated with HugePageAlloc
+bool HugePageFree(void *inBlock)
+{
+	HugePageBlock info;
+	{
+		lock_guard<mutex> lock(sHugePageMutex);
+		unordered_map<void *, HugePageBlock>::iterator i = sHugePageBlocks.find(inBlock);
+		if (i == sHugePageBlocks.end())
+			return false;
+		info = i->second;
+		sHugePageBlocks.erase(i);
+	}
+
+#if defined(_WIN32)
+	VirtualFree(inBlock, 0, MEM_RELEASE);
+#elif defined(__linux__)
+	munmap(inBlock, info.mSize);
+#else
+	#error Undefined
+#endif
+
+	return true;
+}
+
+// Get the total size of the blocks that are currently allocated with HugePageAlloc, the size of the largest page that is known to back them
+// and the size of the blocks for which transparent huge pages were requested
+void GetHugePageStats(size_t &outAllocatedSize, size_t &outPageSize, size_t &outTransparentSize)
+{
+	lock_guard<mutex> lock(sHugePageMutex);
+
+	outAllocatedSize = 0;
+	outPageSize = 0;
+	outTransparentSize = 0;
+	for (const unordered_map<void *, HugePageBlock>::value_type &b : sHugePageBlocks)
+	{
+		outAllocatedSize += b.second.mSize;
+		outPageSize = max(outPageSize, b.second.mPageSize);
+		if (b.second.mTransparent)
+			outTransparentSize += b.second.mSize;
+	}
+}
@@ -5,3 +5,43 @@ void *AlignedAlloc(size_t inSize, size_t inAlignment);
 
 // Free memory block allocated with AlignedAlloc
 void AlignedFree(void *inBlock);
+
+// Which pages back large blocks allocated with AlignedAllocator (and therefore large ByteBuffers)
+enum class EHugePages
+{
+	HUGE_PAGES_NONE,													// Regular pages
+	HUGE_PAGES_TRANSPARENT,												// Regular pages with a hint that the OS should merge them into huge pages (Linux only)
+	HUGE_PAGES_EXPLICIT,												// Huge pages from the pool that was reserved by the OS, falls back to HUGE_PAGES_TRANSPARENT when the pool is empty
+};
+
+// Convert huge page mode to string
+inline string ConvertToString(EHugePages inHugePages)
+{
+	switch (inHugePages)
+	{
+	case EHugePages::HUGE_PAGES_NONE:			return "None";
+	case EHugePages::HUGE_PAGES_TRANSPARENT:	return "Transparent";
+	case EHugePages::HUGE_PAGES_EXPLICIT:		return "Explicit";
+	}
+
+	assert(false);
+	return "Invalid";
+}
+
+// Blocks smaller than this are never backed by huge pages
+constexpr size_t cHugePageMinAllocationSize = 2 * 1024 * 1024;
+
+// Select which pages back blocks allocated by HugePageAlloc, only affects new allocations
+void SetHugePages(EHugePages inHugePages);
+
+// Allocate a block of memory of size inSize that is backed by huge pages, aligned to at least 4096 bytes.
+// Returns nullptr when huge pages are disabled or not available, the caller should then fall back to AlignedAlloc.
+void *HugePageAlloc(size_t inSize);
+
+// Free memory block allocated with HugePageAlloc, returns false if the block was not allocated with HugePageAlloc
+bool HugePageFree(void *inBlock);
+
+// Get the total size of the blocks that are currently allocated with HugePageAlloc and the size of the largest page that is known to back them.
+// Transparent huge pages are only a request, the OS decides if it merges the pages. outTransparentSize receives the size of the blocks for which
+// they were requested while they are enabled (these blocks count as regular pages in outPageSize).
+void GetHugePageStats(size_t &outAllocatedSize, size_t &outPageSize, size_t &outTransparentSize);
@@ -29,3 +29,10 @@ vector<uint8> ReadData(const char *inFileName)
 		FatalError("Unable to read file: %s", inFileName);
 	return data;
 }
+
+// Check if file exists
+bool FileExists(const char *inFileName)
+{
+	ifstream input(inFileName, std::ios::binary);
+	return input.is_open();
+}
@@ -3,6 +3,9 @@
 // Read file contents into byte vector
 vector<uint8> ReadData(const char *inFileName);
 
+// Check if a file exists and can be opened for reading
+bool FileExists(const char *inFileName);
+
 // Output a line of text to the log / TTY.
 #define Trace printf
 
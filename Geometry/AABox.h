@@ -61,7 +61,7 @@ public:
 	}
 
 	// Encapsulate triangle in bounding box
-	void			Encapsulate(const VertexList &inVertices, const IndexedTriangle &inTriangle)
+	void			Encapsulate(const VertexView &inVertices, const IndexedTriangleNoMaterial &inTriangle)
 	{
 		for (uint32 idx : inTriangle.mIdx)
 			Encapsulate(Vec3(inVertices[idx]));
@@ -0,0 +1,97 @@
+#pragma once
+
+// Test an axis aligned box against 4 axis aligned boxes in SOA format, returns true for the boxes that overlap (touching counts as overlapping).
+// Boxes with min > max never overlap.
+f_inline UVec4 AABoxAABox4(const Vec3 &inMin, const Vec3 &inMax, const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ)
+{
+	UVec4 separated_x = UVec4::sOr(Vec4::sGreater(inBoundsMinX, inMax.SplatX()), Vec4::sLess(inBoundsMaxX, inMin.SplatX()));
+	UVec4 separated_y = UVec4::sOr(Vec4::sGreater(inBoundsMinY, inMax.SplatY()), Vec4::sLess(inBoundsMaxY, inMin.SplatY()));
+	UVec4 separated_z = UVec4::sOr(Vec4::sGreater(inBoundsMinZ, inMax.SplatZ()), Vec4::sLess(inBoundsMaxZ, inMin.SplatZ()));
+	return UVec4::sNot(UVec4::sOr(UVec4::sOr(separated_x, separated_y), separated_z));
+}
+
+// Test an oriented box against 4 axis aligned boxes in SOA format along the axis of the oriented box, returns false for the boxes that are separated.
+// inInvOrientation transforms from world space to the space of the oriented box, inHalfExtent is half the size of the oriented box.
+// Only the 3 axis of the oriented box are tested, this should be combined with AABoxAABox4 against the bounds of the oriented box to test the world axis too.
+// The remaining 9 separating axis (cross products of the edges) are not tested so the result can be a false positive.
+f_inline UVec4 OrientedBoxAABox4(const Mat44 &inInvOrientation, const Vec3 &inHalfExtent, const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ)
+{
+	// Center and half extent of the axis aligned boxes
+	Vec4 half = Vec4::sReplicate(0.5f);
+	Vec4 center_x = half * (inBoundsMinX + inBoundsMaxX);
+	Vec4 center_y = half * (inBoundsMinY + inBoundsMaxY);
+	Vec4 center_z = half * (inBoundsMinZ + inBoundsMaxZ);
+	Vec4 extent_x = half * (inBoundsMaxX - inBoundsMinX);
+	Vec4 extent_y = half * (inBoundsMaxY - inBoundsMinY);
+	Vec4 extent_z = half * (inBoundsMaxZ - inBoundsMinZ);
+
+	UVec4 separated = UVec4::sZero();
+	for (uint axis = 0; axis < 3; ++axis)
+	{
+		// Project the center of the boxes on the axis of the oriented box and the extent of the boxes on the same axis
+		Vec4 row_x = Vec4::sReplicate(inInvOrientation(axis, 0));
+		Vec4 row_y = Vec4::sReplicate(inInvOrientation(axis, 1));
+		Vec4 row_z = Vec4::sReplicate(inInvOrientation(axis, 2));
+		Vec4 center = row_x * center_x + row_y * center_y + row_z * center_z + Vec4::sReplicate(inInvOrientation(axis, 3));
+		Vec4 extent = row_x.Abs() * extent_x + row_y.Abs() * extent_y + row_z.Abs() * extent_z;
+
+		separated = UVec4::sOr(separated, Vec4::sGreater(center.Abs(), Vec4::sReplicate(inHalfExtent[axis]) + extent));
+	}
+	return UVec4::sNot(separated);
+}
+
+// Test an axis aligned box centered around the origin with half size inHalfExtent against 4 triangles in SOA format, returns true for the triangles that overlap.
+// Uses the separating axis theorem with the 13 axis of Akenine-Moller: the 3 box axis, the triangle normal and the 9 cross products of the box axis and the triangle edges.
+// See: Fast 3D Triangle-Box Overlap Testing - Tomas Akenine-Moller.
+f_inline UVec4 AABoxTriangle4(const Vec3 &inHalfExtent, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+{
+	Vec4 half_x = inHalfExtent.SplatX();
+	Vec4 half_y = inHalfExtent.SplatY();
+	Vec4 half_z = inHalfExtent.SplatZ();
+
+	// Box axis: compare the bounds of the triangles with the box
+	UVec4 separated = UVec4::sOr(Vec4::sGreater(Vec4::sMin(Vec4::sMin(inV0X, inV1X), inV2X), half_x), Vec4::sLess(Vec4::sMax(Vec4::sMax(inV0X, inV1X), inV2X), -half_x));
+	separated = UVec4::sOr(separated, UVec4::sOr(Vec4::sGreater(Vec4::sMin(Vec4::sMin(inV0Y, inV1Y), inV2Y), half_y), Vec4::sLess(Vec4::sMax(Vec4::sMax(inV0Y, inV1Y), inV2Y), -half_y)));
+	separated = UVec4::sOr(separated, UVec4::sOr(Vec4::sGreater(Vec4::sMin(Vec4::sMin(inV0Z, inV1Z), inV2Z), half_z), Vec4::sLess(Vec4::sMax(Vec4::sMax(inV0Z, inV1Z), inV2Z), -half_z)));
+
+	// Edges
+	Vec4 e0x = inV1X - inV0X, e0y = inV1Y - inV0Y, e0z = inV1Z - inV0Z;
+	Vec4 e1x = inV2X - inV1X, e1y = inV2Y - inV1Y, e1z = inV2Z - inV1Z;
+	Vec4 e2x = inV0X - inV2X, e2y = inV0Y - inV2Y, e2z = inV0Z - inV2Z;
+
+	// Triangle normal: the plane of the triangle is separated when the distance to the origin is bigger than the projected box.
+	// Skip this axis for degenerate triangles, the normal is only rounding noise then and the edge axis cover the remaining line segment.
+	Vec4 nx = e0y * e1z - e0z * e1y;
+	Vec4 ny = e0z * e1x - e0x * e1z;
+	Vec4 nz = e0x * e1y - e0y * e1x;
+	Vec4 plane_distance = nx * inV0X + ny * inV0Y + nz * inV0Z;
+	Vec4 plane_radius = half_x * nx.Abs() + half_y * ny.Abs() + half_z * nz.Abs();
+	Vec4 normal_len_sq = nx * nx + ny * ny + nz * nz;
+	Vec4 edge_len_sq = (e0x * e0x + e0y * e0y + e0z * e0z) * (e1x * e1x + e1y * e1y + e1z * e1z);
+	UVec4 degenerate = Vec4::sLessOrEqual(normal_len_sq, Vec4::sReplicate(1.0e-12f) * edge_len_sq);
+	separated = UVec4::sOr(separated, UVec4::sAnd(Vec4::sGreater(plane_distance.Abs(), plane_radius), UVec4::sNot(degenerate)));
+
+	// Test an axis (inAX, inAY, inAZ), a zero axis (parallel edges) never separates
+	auto separated_on_axis = [&](const Vec4 &inAX, const Vec4 &inAY, const Vec4 &inAZ)
+	{
+		Vec4 p0 = inAX * inV0X + inAY * inV0Y + inAZ * inV0Z;
+		Vec4 p1 = inAX * inV1X + inAY * inV1Y + inAZ * inV1Z;
+		Vec4 p2 = inAX * inV2X + inAY * inV2Y + inAZ * inV2Z;
+		Vec4 radius = half_x * inAX.Abs() + half_y * inAY.Abs() + half_z * inAZ.Abs();
+		return UVec4::sOr(Vec4::sGreater(Vec4::sMin(Vec4::sMin(p0, p1), p2), radius), Vec4::sLess(Vec4::sMax(Vec4::sMax(p0, p1), p2), -radius));
+	};
+
+	// Cross products of the box axis and the edges: X x e = (0, -e.z, e.y), Y x e = (e.z, 0, -e.x), Z x e = (-e.y, e.x, 0)
+	Vec4 zero = Vec4::sZero();
+	separated = UVec4::sOr(separated, separated_on_axis(zero, -e0z, e0y));
+	separated = UVec4::sOr(separated, separated_on_axis(zero, -e1z, e1y));
+	separated = UVec4::sOr(separated, separated_on_axis(zero, -e2z, e2y));
+	separated = UVec4::sOr(separated, separated_on_axis(e0z, zero, -e0x));
+	separated = UVec4::sOr(separated, separated_on_axis(e1z, zero, -e1x));
+	separated = UVec4::sOr(separated, separated_on_axis(e2z, zero, -e2x));
+	separated = UVec4::sOr(separated, separated_on_axis(-e0y, e0x, zero));
+	separated = UVec4::sOr(separated, separated_on_axis(-e1y, e1x, zero));
+	separated = UVec4::sOr(separated, separated_on_axis(-e2y, e2x, zero));
+
+	return UVec4::sNot(separated);
+}
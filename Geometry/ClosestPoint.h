@@ -0,0 +1,74 @@
+#pragma once
+
+// Get the closest point to inPoint on 4 line segments inA + t * inAB (t in [0, 1]) in SOA format, returns the squared distance to the closest point
+f_inline Vec4 ClosestPointOnSegment4(const Vec3 &inPoint, const Vec4 &inAX, const Vec4 &inAY, const Vec4 &inAZ, const Vec4 &inABX, const Vec4 &inABY, const Vec4 &inABZ, Vec4 &outX, Vec4 &outY, Vec4 &outZ)
+{
+	Vec4 apx = inPoint.SplatX() - inAX, apy = inPoint.SplatY() - inAY, apz = inPoint.SplatZ() - inAZ;
+
+	// Project on the segment, a segment of length zero projects on inA
+	Vec4 ab_len_sq = inABX * inABX + inABY * inABY + inABZ * inABZ;
+	Vec4 t = (apx * inABX + apy * inABY + apz * inABZ) / Vec4::sMax(ab_len_sq, Vec4::sReplicate(FLT_MIN));
+	t = Vec4::sMin(Vec4::sMax(t, Vec4::sZero()), Vec4::sReplicate(1.0f));
+
+	outX = inAX + t * inABX;
+	outY = inAY + t * inABY;
+	outZ = inAZ + t * inABZ;
+	Vec4 dx = apx - t * inABX, dy = apy - t * inABY, dz = apz - t * inABZ;
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Get the closest point to inPoint on 4 triangles in SOA format, returns the squared distance to the closest point.
+// The closest point is either the projection of inPoint on the plane of the triangle (when it is inside the triangle) or the closest point on one of the edges.
+// The edges are always tested so that degenerate triangles give the right answer too.
+f_inline Vec4 ClosestPointOnTriangle4(const Vec3 &inPoint, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z, Vec4 &outX, Vec4 &outY, Vec4 &outZ)
+{
+	// Edges
+	Vec4 e0x = inV1X - inV0X, e0y = inV1Y - inV0Y, e0z = inV1Z - inV0Z;
+	Vec4 e1x = inV2X - inV1X, e1y = inV2Y - inV1Y, e1z = inV2Z - inV1Z;
+	Vec4 e2x = inV0X - inV2X, e2y = inV0Y - inV2Y, e2z = inV0Z - inV2Z;
+
+	// Closest point on the edges
+	Vec4 x, y, z;
+	Vec4 dist_sq = ClosestPointOnSegment4(inPoint, inV0X, inV0Y, inV0Z, e0x, e0y, e0z, outX, outY, outZ);
+	Vec4 edge_dist_sq = ClosestPointOnSegment4(inPoint, inV1X, inV1Y, inV1Z, e1x, e1y, e1z, x, y, z);
+	UVec4 closer = Vec4::sLess(edge_dist_sq, dist_sq);
+	dist_sq = Vec4::sSelect(dist_sq, edge_dist_sq, closer);
+	outX = Vec4::sSelect(outX, x, closer);
+	outY = Vec4::sSelect(outY, y, closer);
+	outZ = Vec4::sSelect(outZ, z, closer);
+	edge_dist_sq = ClosestPointOnSegment4(inPoint, inV2X, inV2Y, inV2Z, e2x, e2y, e2z, x, y, z);
+	closer = Vec4::sLess(edge_dist_sq, dist_sq);
+	dist_sq = Vec4::sSelect(dist_sq, edge_dist_sq, closer);
+	outX = Vec4::sSelect(outX, x, closer);
+	outY = Vec4::sSelect(outY, y, closer);
+	outZ = Vec4::sSelect(outZ, z, closer);
+
+	// Normal (not normalized)
+	Vec4 nx = e0y * e1z - e0z * e1y;
+	Vec4 ny = e0z * e1x - e0x * e1z;
+	Vec4 nz = e0x * e1y - e0y * e1x;
+	Vec4 n_len_sq = nx * nx + ny * ny + nz * nz;
+
+	// The projection of the point on the plane is inside the triangle when the point is on the inside of all 3 edges
+	Vec4 px = inPoint.SplatX(), py = inPoint.SplatY(), pz = inPoint.SplatZ();
+	auto inside_edge = [&](const Vec4 &inVX, const Vec4 &inVY, const Vec4 &inVZ, const Vec4 &inEX, const Vec4 &inEY, const Vec4 &inEZ)
+	{
+		Vec4 vpx = px - inVX, vpy = py - inVY, vpz = pz - inVZ;
+		Vec4 cx = inEY * vpz - inEZ * vpy;
+		Vec4 cy = inEZ * vpx - inEX * vpz;
+		Vec4 cz = inEX * vpy - inEY * vpx;
+		return Vec4::sGreaterOrEqual(cx * nx + cy * ny + cz * nz, Vec4::sZero());
+	};
+	UVec4 inside = UVec4::sAnd(UVec4::sAnd(inside_edge(inV0X, inV0Y, inV0Z, e0x, e0y, e0z), inside_edge(inV1X, inV1Y, inV1Z, e1x, e1y, e1z)), inside_edge(inV2X, inV2Y, inV2Z, e2x, e2y, e2z));
+	inside = UVec4::sAnd(inside, Vec4::sGreater(n_len_sq, Vec4::sZero()));
+
+	// Project the point on the plane
+	Vec4 plane_distance = ((px - inV0X) * nx + (py - inV0Y) * ny + (pz - inV0Z) * nz) / Vec4::sMax(n_len_sq, Vec4::sReplicate(FLT_MIN));
+	Vec4 plane_dist_sq = plane_distance * plane_distance * n_len_sq;
+	closer = UVec4::sAnd(inside, Vec4::sLess(plane_dist_sq, dist_sq));
+	dist_sq = Vec4::sSelect(dist_sq, plane_dist_sq, closer);
+	outX = Vec4::sSelect(outX, px - plane_distance * nx, closer);
+	outY = Vec4::sSelect(outY, py - plane_distance * ny, closer);
+	outZ = Vec4::sSelect(outZ, pz - plane_distance * nz, closer);
+	return dist_sq;
+}
@@ -46,7 +46,7 @@ public:
 	}
 
 	// Get center of triangle
-	Vec3			GetCentroid(const VertexList &inVertices) const
+	Vec3			GetCentroid(const VertexView &inVertices) const
 	{
 		return (Vec3(inVertices[mIdx[0]]) + Vec3(inVertices[mIdx[1]]) + Vec3(inVertices[mIdx[2]])) / 3.0f;
 	}
@@ -74,3 +74,33 @@ public:
 
 using IndexedTriangleNoMaterialList = vector<IndexedTriangleNoMaterial>;
 using IndexedTriangleList = vector<IndexedTriangle>;
+
+// Read only view on triangles that are owned by someone else, stored either with material (an IndexedTriangleList)
+// or without (e.g. the triangles of a memory mapped model file). Triangles without material get material index 0.
+class IndexedTriangleView
+{
+public:
+	// Constructor
+					IndexedTriangleView() = default;
+					IndexedTriangleView(const IndexedTriangleList &inTriangles) : mData(reinterpret_cast<const uint8 *>(inTriangles.data())), mStride(sizeof(IndexedTriangle)), mSize(inTriangles.size()) { }
+					IndexedTriangleView(const IndexedTriangleNoMaterial *inTriangles, size_t inSize) : mData(reinterpret_cast<const uint8 *>(inTriangles)), mStride(sizeof(IndexedTriangleNoMaterial)), mSize(inSize) { }
+
+	// Get a triangle
+	IndexedTriangle	operator [] (size_t inIdx) const
+	{
+		assert(inIdx < mSize);
+		const uint8 *data = mData + inIdx * mStride;
+		const IndexedTriangleNoMaterial *t = reinterpret_cast<const IndexedTriangleNoMaterial *>(data);
+		uint32 material_index = mStride == sizeof(IndexedTriangle)? reinterpret_cast<const IndexedTriangle *>(data)->mMaterialIndex : 0;
+		return IndexedTriangle(t->mIdx[0], t->mIdx[1], t->mIdx[2], material_index);
+	}
+
+	// Number of triangles
+	size_t			size() const														{ return mSize; }
+	bool			empty() const														{ return mSize == 0; }
+
+private:
+	const uint8 *	mData = nullptr;
+	size_t			mStride = sizeof(IndexedTriangle);
+	size_t			mSize = 0;
+};
@@ -1,60 +1,315 @@
 #include <pch.h> // IWYU pragma: keep
 
 #include <Geometry/Indexify.h>
-#include <unordered_map>
+#include <Geometry/AABox.h>
+#include <thread>
 
-void Indexify(const TriangleList &inTriangles, VertexList &outVertices, IndexedTriangleList &outTriangles, float inVertexWeldDistance)
+namespace {
+
+const uint32 cInvalidIndex = 0xffffffff;
+
+// Open addressing hash table that stores indices into an external array.
+// Used instead of unordered_map since the tables can contain millions of entries and a node per entry is too slow.
+class IndexTable
+{
+public:
+	explicit					IndexTable(size_t inMaxEntries)
+	{
+		size_t size = 16;
+		while (size < 2 * inMaxEntries)
+			size <<= 1;
+		mMask = size - 1;
+		mIndices.resize(size, cInvalidIndex);
+	}
+
+	// Find the index for which inEquals(index) returns true, if not found inNewIndex is inserted. Returns the found or inserted index.
+	template <class Equals>
+	uint32						FindOrInsert(uint64 inHash, uint32 inNewIndex, const Equals &inEquals)
+	{
+		for (size_t slot = Mix(inHash) & mMask; ; slot = (slot + 1) & mMask)
+		{
+			uint32 &index = mIndices[slot];
+			if (index == cInvalidIndex)
+			{
+				index = inNewIndex;
+				return inNewIndex;
+			}
+			if (inEquals(index))
+				return index;
+		}
+	}
+
+	// Find the index for which inEquals(index) returns true, returns cInvalidIndex if not found
+	template <class Equals>
+	uint32						Find(uint64 inHash, const Equals &inEquals) const
+	{
+		for (size_t slot = Mix(inHash) & mMask; ; slot = (slot + 1) & mMask)
+		{
+			uint32 index = mIndices[slot];
+			if (index == cInvalidIndex || inEquals(index))
+				return index;
+		}
+	}
+
+private:
+	// Spread the bits of the hash so that the lower bits can be used as slot
+	static size_t				Mix(uint64 inHash)
+	{
+		return size_t((inHash * 0x9e3779b97f4a7c15ULL) >> 32);
+	}
+
+	size_t						mMask;
+	vector<uint32>				mIndices;
+};
+
+// Uniform grid that buckets vertices so that vertices within weld distance can be found by only checking the 3x3x3 neighbouring cells
+class WeldGrid
+{
+public:
+	// Amount of bits per cell coordinate, 3 coordinates are packed in a 64 bit key
+	enum { CELL_BITS = 21 };
+
+								WeldGrid(const VertexList &inVertices, float inWeldDistance) :
+		mVertices(inVertices),
+		mWeldDistance(1.001 * double(abs(inWeldDistance))),
+		mCells(inVertices.size())
+	{
+		AABox bounds;
+		for (const Float3 &v : inVertices)
+			bounds.Encapsulate(Vec3(v));
+		mMin = bounds.mMin;
+
+		// Cells must be at least twice the weld distance so that the weld range around a vertex overlaps with at most 2 cells per axis.
+		// The weld distance is made slightly bigger to compensate for rounding errors.
+		// Limit the amount of cells per axis so that the cell coordinates fit in CELL_BITS.
+		double cell_size = max(2.0 * mWeldDistance, double(bounds.GetSize().ReduceMax()) / double(1 << (CELL_BITS - 2)));
+		mInvCellSize = cell_size > 0.0? 1.0 / cell_size : 0.0;
+
+		// Sort vertices by cell, within a cell vertices are sorted by index
+		mSortedVertices.resize(inVertices.size());
+		for (uint32 i = 0; i < (uint32)inVertices.size(); ++i)
+		{
+			const Float3 &v = inVertices[i];
+			mSortedVertices[i] = { GetCellKey(GetCellCoordinate(v.x, 0), GetCellCoordinate(v.y, 1), GetCellCoordinate(v.z, 2)), i };
+		}
+		sort(mSortedVertices.begin(), mSortedVertices.end());
+
+		// Create lookup table from cell to first vertex in the sorted vertices
+		for (uint32 start = 0; start < (uint32)mSortedVertices.size(); ++start)
+			if (start == 0 || mSortedVertices[start].first != mSortedVertices[start - 1].first)
+				mCells.FindOrInsert(mSortedVertices[start].first, start, [](uint32) { return false; });
+	}
+
+	// Calls ioVisitor(other_index) for every vertex with a lower index than inIndex that is in a cell that overlaps with the weld distance around vertex inIndex.
+	// Visiting within a cell stops when ioVisitor returns true (vertices in a cell are visited in order of increasing index).
+	template <class Visitor>
+	void						VisitPreviousVertices(uint32 inIndex, Visitor &ioVisitor) const
+	{
+		// Determine range of cells to visit, since cells are bigger than the weld distance this is at most 2 cells per axis
+		const Float3 &v = mVertices[inIndex];
+		uint64 min_x = GetCellCoordinate(v.x - mWeldDistance, 0), max_x = GetCellCoordinate(v.x + mWeldDistance, 0);
+		uint64 min_y = GetCellCoordinate(v.y - mWeldDistance, 1), max_y = GetCellCoordinate(v.y + mWeldDistance, 1);
+		uint64 min_z = GetCellCoordinate(v.z - mWeldDistance, 2), max_z = GetCellCoordinate(v.z + mWeldDistance, 2);
+
+		for (uint64 z = min_z; z <= max_z; ++z)
+			for (uint64 y = min_y; y <= max_y; ++y)
+				for (uint64 x = min_x; x <= max_x; ++x)
+				{
+					uint64 key = GetCellKey(x, y, z);
+					uint32 start = mCells.Find(key, [this, key](uint32 inStart) { return mSortedVertices[inStart].first == key; });
+					if (start != cInvalidIndex)
+						for (uint32 s = start; s < (uint32)mSortedVertices.size() && mSortedVertices[s].first == key; ++s)
+						{
+							uint32 other_index = mSortedVertices[s].second;
+							if (other_index >= inIndex || ioVisitor(other_index))
+								break;
+						}
+				}
+	}
+
+private:
+	// Get coordinate of the cell along inAxis that contains inValue
+	uint64						GetCellCoordinate(double inValue, int inAxis) const
+	{
+		// Offset by 1 so that a coordinate that is slightly below the bounds doesn't become negative
+		return uint64(max(0.0, (inValue - double(mMin[inAxis])) * mInvCellSize + 1.0));
+	}
+
+	// Pack cell coordinates into a key
+	static uint64				GetCellKey(uint64 inX, uint64 inY, uint64 inZ)
+	{
+		return inX | (inY << CELL_BITS) | (inZ << (2 * CELL_BITS));
+	}
+
+	const VertexList &			mVertices;
+	double						mWeldDistance;
+	Vec3						mMin;
+	double						mInvCellSize;
+	vector<pair<uint64, uint32>> mSortedVertices;					// Cell key and vertex index
+	IndexTable					mCells;								// Cell key to first entry in mSortedVertices
+};
+
+// Weld a list of vertices that are all different, outOutputIndex receives the index in outVertices for every vertex in inUniqueVertices
+void WeldUniqueVertices(const VertexList &inUniqueVertices, VertexList &outVertices, vector<uint32> &outOutputIndex, float inVertexWeldDistance, uint inNumThreads)
 {
+	uint32 num_unique = (uint32)inUniqueVertices.size();
 	float weld_dist_sq = Square(inVertexWeldDistance);
 
 	// Ensure that output vertices are empty before we begin
 	outVertices.clear();
 
-	// Find unique vertices
-	unordered_map<Float3, uint32> vertex_map;
-	for (const Triangle &t : inTriangles)
-		for (const Float3 &v : t.mV)
+	// Bucket the unique vertices
+	WeldGrid grid(inUniqueVertices, inVertexWeldDistance);
+
+	// Check if a vertex is close enough to another to be welded
+	auto is_close = [&inUniqueVertices, weld_dist_sq](uint32 inOther, uint32 inVertex) {
+		const Float3 &other = inUniqueVertices[inOther];
+		const Float3 &v = inUniqueVertices[inVertex];
+		return Square(other.x - v.x) + Square(other.y - v.y) + Square(other.z - v.z) <= weld_dist_sq;
+	};
+
+	// For every vertex find the vertex with the lowest index before it that is within weld distance.
+	// This is the expensive part of welding and since it only reads shared data it can be done in parallel.
+	vector<uint32> first_close_vertex(num_unique, cInvalidIndex);
+	auto find_close_vertices = [&grid, &is_close, &first_close_vertex](uint32 inBegin, uint32 inEnd) {
+		for (uint32 i = inBegin; i < inEnd; ++i)
 		{
-			// Try to insert element
-			auto insert = vertex_map.insert(pair<Float3, uint32>(v, 0));
-			if (insert.second)
-			{
-				// Newly inserted, see if we can share
-				bool found = false;
-				for (size_t i = 0; i < outVertices.size(); ++i)
+			uint32 &first = first_close_vertex[i];
+			auto visitor = [&is_close, &first, i](uint32 inOther) {
+				if (is_close(inOther, i))
 				{
-					const Float3 &other = outVertices[i];
-					if (Square(other.x - v.x) + Square(other.y - v.y) + Square(other.z - v.z) <= weld_dist_sq)
-					{
-						insert.first->second = (uint32)i;
-						found = true;
-						break;
-					}
+					first = min(first, inOther);
+					return true;
 				}
+				return false;
+			};
+			grid.VisitPreviousVertices(i, visitor);
+		}
+	};
+	uint num_threads = inNumThreads > 0? inNumThreads : max(1u, thread::hardware_concurrency());
+	num_threads = min(num_threads, max(1u, num_unique / 1024));
+	if (num_threads <= 1)
+		find_close_vertices(0, num_unique);
+	else
+	{
+		vector<thread> threads;
+		uint32 block_size = (num_unique + num_threads - 1) / num_threads;
+		for (uint32 begin = block_size; begin < num_unique; begin += block_size)
+			threads.emplace_back(find_close_vertices, begin, min(num_unique, begin + block_size));
+		find_close_vertices(0, block_size);
+		for (thread &t : threads)
+			t.join();
+	}
 
-				if (!found)
-				{
-					// Can't share, add vertex
-					insert.first->second = (uint32)outVertices.size();
-					outVertices.push_back(v);
-				}
+	// Assign output vertices, this needs to be done in order since a vertex can only be welded to vertices that have been output.
+	// A vertex is welded to the output vertex with the lowest index within weld distance, which gives the same result as testing all output vertices in order.
+	outOutputIndex.assign(num_unique, cInvalidIndex);
+	vector<uint8> is_output(num_unique, 0);
+	for (uint32 i = 0; i < num_unique; ++i)
+	{
+		uint32 best = cInvalidIndex;
+		uint32 first = first_close_vertex[i];
+		if (first != cInvalidIndex)
+		{
+			if (is_output[first])
+			{
+				// The first close vertex was output so it has the lowest output index
+				best = outOutputIndex[first];
+			}
+			else
+			{
+				// The first close vertex was welded itself, search for other output vertices
+				auto visitor = [&is_close, &outOutputIndex, &is_output, &best, i](uint32 inOther) {
+					if (is_output[inOther] && is_close(inOther, i))
+					{
+						best = min(best, outOutputIndex[inOther]);
+						return true;
+					}
+					return false;
+				};
+				grid.VisitPreviousVertices(i, visitor);
 			}
 		}
 
+		if (best != cInvalidIndex)
+			outOutputIndex[i] = best;
+		else
+		{
+			// Can't share, add vertex
+			outOutputIndex[i] = (uint32)outVertices.size();
+			is_output[i] = 1;
+			outVertices.push_back(inUniqueVertices[i]);
+		}
+	}
+}
+
+} // namespace
+
+void Indexify(const TriangleList &inTriangles, VertexList &outVertices, IndexedTriangleList &outTriangles, float inVertexWeldDistance, uint inNumThreads)
+{
+	// Find unique vertices in order of first occurrence and remember for every triangle vertex which unique vertex it uses
+	VertexList unique_vertices;
+	vector<uint32> triangle_vertices;
+	triangle_vertices.reserve(inTriangles.size() * 3);
+	{
+		IndexTable vertex_map(inTriangles.size() * 3);
+		hash<Float3> hasher;
+		for (const Triangle &t : inTriangles)
+			for (const Float3 &v : t.mV)
+			{
+				uint32 new_index = (uint32)unique_vertices.size();
+				uint32 index = vertex_map.FindOrInsert(hasher(v), new_index, [&unique_vertices, &v](uint32 inIndex) { return unique_vertices[inIndex] == v; });
+				if (index == new_index)
+					unique_vertices.push_back(v);
+				triangle_vertices.push_back(index);
+			}
+	}
+
+	// Weld the unique vertices
+	vector<uint32> output_index;
+	WeldUniqueVertices(unique_vertices, outVertices, output_index, inVertexWeldDistance, inNumThreads);
+
 	// Create indexed triangles
 	outTriangles.clear();
 	outTriangles.reserve(inTriangles.size());
+	const uint32 *idx = triangle_vertices.data();
 	for (const Triangle &t : inTriangles)
 	{
 		IndexedTriangle it;
 		it.mMaterialIndex = t.mMaterialIndex;
 		for (int j = 0; j < 3; ++j)
-			it.mIdx[j] = vertex_map[t.mV[j]];
+			it.mIdx[j] = output_index[*idx++];
 		if (!it.IsDegenerate())
 			outTriangles.push_back(it);
 	}
 }
 
+void WeldVertices(const VertexList &inVertices, VertexList &outVertices, vector<uint32> &outVertexMap, float inVertexWeldDistance, uint inNumThreads)
+{
+	// Find unique vertices in order of first occurrence
+	VertexList unique_vertices;
+	outVertexMap.resize(inVertices.size());
+	{
+		IndexTable vertex_map(inVertices.size());
+		hash<Float3> hasher;
+		for (size_t i = 0; i < inVertices.size(); ++i)
+		{
+			const Float3 &v = inVertices[i];
+			uint32 new_index = (uint32)unique_vertices.size();
+			uint32 index = vertex_map.FindOrInsert(hasher(v), new_index, [&unique_vertices, &v](uint32 inIndex) { return unique_vertices[inIndex] == v; });
+			if (index == new_index)
+				unique_vertices.push_back(v);
+			outVertexMap[i] = index;
+		}
+	}
+
+	// Weld the unique vertices
+	vector<uint32> output_index;
+	WeldUniqueVertices(unique_vertices, outVertices, output_index, inVertexWeldDistance, inNumThreads);
+	for (uint32 &index : outVertexMap)
+		index = output_index[index];
+}
+
 void Deindexify(const VertexList &inVertices, const IndexedTriangleList &inTriangles, TriangleList &outTriangles)
 {
 	outTriangles.resize(inTriangles.size());
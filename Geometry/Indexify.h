@@ -5,7 +5,12 @@
 
 // Take a list of triangles and get the unique set of vertices and use them to create indexed triangles
 // Vertices that are less than inVertexWeldDistance apart will be combined to a single vertex
-void Indexify(const TriangleList &inTriangles, VertexList &outVertices, IndexedTriangleList &outTriangles, float inVertexWeldDistance = 1.0e-4f);
+// The search for vertices to weld can be spread over inNumThreads threads (0 = use all hardware threads), the result doesn't depend on the amount of threads
+void Indexify(const TriangleList &inTriangles, VertexList &outVertices, IndexedTriangleList &outTriangles, float inVertexWeldDistance = 1.0e-4f, uint inNumThreads = 1);
+
+// Weld the vertices of an indexed mesh without needing its triangles, outVertexMap receives the index in outVertices for every vertex in inVertices.
+// When inVertices is in order of first use by the triangles, remapping the triangles and removing the degenerate ones gives the same result as Indexify.
+void WeldVertices(const VertexList &inVertices, VertexList &outVertices, vector<uint32> &outVertexMap, float inVertexWeldDistance = 1.0e-4f, uint inNumThreads = 1);
 
 // Take a list of indexed triangles and unpack them
 void Deindexify(const VertexList &inVertices, const IndexedTriangleList &inTriangles, TriangleList &outTriangles);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Geometry/AABox.h>
+
+// Oriented box
+class OrientedBox
+{
+public:
+	// Constructor
+					OrientedBox() = default;
+					OrientedBox(const Mat44 &inOrientation, const Vec3 &inHalfExtent) : mOrientation(inOrientation), mHalfExtent(inHalfExtent) { }
+
+	// Get the axis aligned bounding box of this box
+	AABox			GetBounds() const
+	{
+		return AABox(-mHalfExtent, mHalfExtent).Transformed(mOrientation);
+	}
+
+	// Transform from box space to world space (rotation and translation only) and half the size of the box in box space
+	Mat44			mOrientation;
+	Vec3			mHalfExtent;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <Geometry/RayTriangle.h>
+
+// Sweep 4 points (relative to the center of 4 spheres) with velocity inD against the spheres, returns the first time t >= 0 where |inM + t * inD| <= radius or FLT_MAX if no hit.
+// Returns 0 if the point starts inside the sphere.
+f_inline Vec4 SweptPointSphere4(const Vec4 &inMX, const Vec4 &inMY, const Vec4 &inMZ, const Vec4 &inDX, const Vec4 &inDY, const Vec4 &inDZ, const Vec4 &inRadiusSq)
+{
+	Vec4 zero = Vec4::sZero();
+
+	// Solve |m + t d|^2 = r^2, a t^2 + 2 b t + c = 0
+	Vec4 a = inDX * inDX + inDY * inDY + inDZ * inDZ;
+	Vec4 b = inMX * inDX + inMY * inDY + inMZ * inDZ;
+	Vec4 c = inMX * inMX + inMY * inMY + inMZ * inMZ - inRadiusSq;
+	Vec4 discriminant = b * b - a * c;
+	Vec4 t = (-b - discriminant.Sqrt()) / a;
+
+	// No hit if we're not moving towards the sphere or if we miss it
+	UVec4 inside = Vec4::sLessOrEqual(c, zero);
+	UVec4 no_hit = UVec4::sOr(UVec4::sOr(Vec4::sGreaterOrEqual(b, zero), Vec4::sLess(discriminant, zero)), Vec4::sLessOrEqual(a, zero));
+	return Vec4::sSelect(Vec4::sSelect(t, Vec4::sReplicate(FLT_MAX), no_hit), zero, inside);
+}
+
+// Sweep 4 points (relative to the start of the axis of 4 cylinders) with velocity inD against the side of the cylinders with axis inE,
+// returns the first time t >= 0 where the point is within radius of the axis and between the end caps or FLT_MAX if no hit.
+// Returns 0 if the point starts inside the cylinder. Hits on the end caps are not reported, the caller should handle those with SweptPointSphere4.
+f_inline Vec4 SweptPointCylinder4(const Vec4 &inMX, const Vec4 &inMY, const Vec4 &inMZ, const Vec4 &inDX, const Vec4 &inDY, const Vec4 &inDZ, const Vec4 &inEX, const Vec4 &inEY, const Vec4 &inEZ, const Vec4 &inRadiusSq)
+{
+	Vec4 zero = Vec4::sZero();
+
+	// Project out the component along the axis, see: Real-Time Collision Detection - Christer Ericson, section 5.3.7
+	Vec4 ee = inEX * inEX + inEY * inEY + inEZ * inEZ;
+	Vec4 me = inMX * inEX + inMY * inEY + inMZ * inEZ;
+	Vec4 de = inDX * inEX + inDY * inEY + inDZ * inEZ;
+	Vec4 a = ee * (inDX * inDX + inDY * inDY + inDZ * inDZ) - de * de;
+	Vec4 b = ee * (inMX * inDX + inMY * inDY + inMZ * inDZ) - de * me;
+	Vec4 c = ee * (inMX * inMX + inMY * inMY + inMZ * inMZ - inRadiusSq) - me * me;
+	Vec4 discriminant = b * b - a * c;
+	Vec4 t = (-b - discriminant.Sqrt()) / a;
+
+	// No hit if we're not moving towards the axis or if we miss the cylinder
+	UVec4 inside = Vec4::sLessOrEqual(c, zero);
+	UVec4 no_hit = UVec4::sOr(UVec4::sOr(Vec4::sGreaterOrEqual(b, zero), Vec4::sLess(discriminant, zero)), Vec4::sLessOrEqual(a, zero));
+	no_hit = UVec4::sAnd(no_hit, UVec4::sNot(inside));
+	t = Vec4::sSelect(t, zero, inside);
+
+	// The hit needs to be between the end caps (s in [0, ee])
+	Vec4 s = me + t * de;
+	no_hit = UVec4::sOr(no_hit, UVec4::sOr(Vec4::sLess(s, zero), Vec4::sGreater(s, ee)));
+	no_hit = UVec4::sOr(no_hit, Vec4::sLessOrEqual(ee, zero));
+	return Vec4::sSelect(t, Vec4::sReplicate(FLT_MAX), no_hit);
+}
+
+// Test if 4 points that lie in the plane of 4 triangles are inside the triangles, inN is the (unnormalized) normal of the triangles
+f_inline UVec4 PointInTriangle4(const Vec4 &inPX, const Vec4 &inPY, const Vec4 &inPZ, const Vec4 &inNX, const Vec4 &inNY, const Vec4 &inNZ, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+{
+	// The point is on the inside of an edge if (edge x (point - edge start)) points in the same direction as the normal
+	auto inside_edge = [&inPX, &inPY, &inPZ, &inNX, &inNY, &inNZ](const Vec4 &inAX, const Vec4 &inAY, const Vec4 &inAZ, const Vec4 &inBX, const Vec4 &inBY, const Vec4 &inBZ)
+	{
+		Vec4 ex = inBX - inAX, ey = inBY - inAY, ez = inBZ - inAZ;
+		Vec4 px = inPX - inAX, py = inPY - inAY, pz = inPZ - inAZ;
+		Vec4 cx = ey * pz - ez * py, cy = ez * px - ex * pz, cz = ex * py - ey * px;
+		return Vec4::sGreaterOrEqual(cx * inNX + cy * inNY + cz * inNZ, Vec4::sZero());
+	};
+
+	return UVec4::sAnd(UVec4::sAnd(inside_edge(inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z), inside_edge(inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z)), inside_edge(inV2X, inV2Y, inV2Z, inV0X, inV0Y, inV0Z));
+}
+
+// Sweep a sphere from inCenter to inCenter + inDisplacement against 4 triangles in SOA format (triangles are double sided).
+// Returns the fraction t of inDisplacement where the sphere first touches each triangle or FLT_MAX if no hit, returns 0 if the sphere starts in contact.
+// The first contact is the earliest of: the sphere touching the inside of the triangle, touching one of the edges or touching one of the vertices.
+// See: Improved Collision detection and Response - Kasper Fauerby.
+f_inline Vec4 SweptSphereTriangle4(const Vec3 &inCenter, const Vec3 &inDisplacement, float inRadius, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+{
+	Vec4 zero = Vec4::sZero();
+	Vec4 flt_max = Vec4::sReplicate(FLT_MAX);
+	Vec4 radius = Vec4::sReplicate(inRadius);
+	Vec4 radius_sq = radius * radius;
+
+	Vec4 cx = inCenter.SplatX(), cy = inCenter.SplatY(), cz = inCenter.SplatZ();
+	Vec4 dx = inDisplacement.SplatX(), dy = inDisplacement.SplatY(), dz = inDisplacement.SplatZ();
+
+	// Edges
+	Vec4 e1x = inV1X - inV0X, e1y = inV1Y - inV0Y, e1z = inV1Z - inV0Z;
+	Vec4 e2x = inV2X - inV1X, e2y = inV2Y - inV1Y, e2z = inV2Z - inV1Z;
+	Vec4 e3x = inV0X - inV2X, e3y = inV0Y - inV2Y, e3z = inV0Z - inV2Z;
+
+	// Normal, degenerate triangles can only be hit on their edges and vertices
+	Vec4 nx = e3y * e1z - e3z * e1y, ny = e3z * e1x - e3x * e1z, nz = e3x * e1y - e3y * e1x; // (v1 - v0) x (v2 - v0) = e3 x e1
+	Vec4 n_len_sq = nx * nx + ny * ny + nz * nz;
+	UVec4 degenerate = Vec4::sLessOrEqual(n_len_sq, Vec4::sReplicate(1.0e-12f) * (e1x * e1x + e1y * e1y + e1z * e1z) * (e3x * e3x + e3y * e3y + e3z * e3z));
+	Vec4 inv_n_len = Vec4::sReplicate(1.0f) / n_len_sq.Sqrt();
+
+	// Signed distance to the plane at t = 0 and the speed along the normal
+	Vec4 distance = (nx * (cx - inV0X) + ny * (cy - inV0Y) + nz * (cz - inV0Z)) * inv_n_len;
+	Vec4 speed = (nx * dx + ny * dy + nz * dz) * inv_n_len;
+
+	// Time at which the sphere touches the plane on the side where it starts
+	UVec4 touching_plane = Vec4::sLessOrEqual(distance.Abs(), radius);
+	Vec4 side_radius = Vec4::sSelect(radius, -radius, Vec4::sLess(distance, zero));
+	Vec4 t_face = Vec4::sSelect((side_radius - distance) / speed, zero, touching_plane);
+	UVec4 no_face_hit = UVec4::sAnd(UVec4::sNot(touching_plane), Vec4::sGreaterOrEqual(speed * distance, zero));
+
+	// The contact point is the projection of the center on the plane, it needs to be inside the triangle
+	Vec4 contact_distance = (distance + t_face * speed) * inv_n_len;
+	Vec4 px = cx + t_face * dx - contact_distance * nx;
+	Vec4 py = cy + t_face * dy - contact_distance * ny;
+	Vec4 pz = cz + t_face * dz - contact_distance * nz;
+	no_face_hit = UVec4::sOr(no_face_hit, UVec4::sNot(PointInTriangle4(px, py, pz, nx, ny, nz, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z)));
+	no_face_hit = UVec4::sOr(no_face_hit, degenerate);
+	Vec4 t = Vec4::sSelect(t_face, flt_max, no_face_hit);
+
+	// Vertices
+	t = Vec4::sMin(t, SweptPointSphere4(cx - inV0X, cy - inV0Y, cz - inV0Z, dx, dy, dz, radius_sq));
+	t = Vec4::sMin(t, SweptPointSphere4(cx - inV1X, cy - inV1Y, cz - inV1Z, dx, dy, dz, radius_sq));
+	t = Vec4::sMin(t, SweptPointSphere4(cx - inV2X, cy - inV2Y, cz - inV2Z, dx, dy, dz, radius_sq));
+
+	// Edges
+	t = Vec4::sMin(t, SweptPointCylinder4(cx - inV0X, cy - inV0Y, cz - inV0Z, dx, dy, dz, e1x, e1y, e1z, radius_sq));
+	t = Vec4::sMin(t, SweptPointCylinder4(cx - inV1X, cy - inV1Y, cz - inV1Z, dx, dy, dz, e2x, e2y, e2z, radius_sq));
+	t = Vec4::sMin(t, SweptPointCylinder4(cx - inV2X, cy - inV2Y, cz - inV2Z, dx, dy, dz, e3x, e3y, e3z, radius_sq));
+
+	return t;
+}
+
+// Sweep segment inA + s * inU (s in [0, 1]) with velocity inD against 4 segments inP + s * inE, returns the first time t >= 0 where the
+// segments are inRadius apart with the closest points in the interior of both segments or FLT_MAX if no hit. Returns 0 if they start closer.
+// Parallel segments are never reported, in that case the end points touch first.
+f_inline Vec4 SweptSegmentSegment4(const Vec3 &inA, const Vec3 &inU, const Vec3 &inD, float inRadius, const Vec4 &inPX, const Vec4 &inPY, const Vec4 &inPZ, const Vec4 &inEX, const Vec4 &inEY, const Vec4 &inEZ)
+{
+	Vec4 zero = Vec4::sZero();
+	Vec4 one = Vec4::sReplicate(1.0f);
+	Vec4 radius = Vec4::sReplicate(inRadius);
+
+	Vec4 ux = inU.SplatX(), uy = inU.SplatY(), uz = inU.SplatZ();
+	Vec4 dx = inD.SplatX(), dy = inD.SplatY(), dz = inD.SplatZ();
+	Vec4 wx = inA.SplatX() - inPX, wy = inA.SplatY() - inPY, wz = inA.SplatZ() - inPZ;
+
+	// The lines are separated along n = u x e, the distance along n changes linearly with time
+	Vec4 nx = uy * inEZ - uz * inEY, ny = uz * inEX - ux * inEZ, nz = ux * inEY - uy * inEX;
+	Vec4 uu = ux * ux + uy * uy + uz * uz;
+	Vec4 ue = ux * inEX + uy * inEY + uz * inEZ;
+	Vec4 ee = inEX * inEX + inEY * inEY + inEZ * inEZ;
+	Vec4 n_len_sq = nx * nx + ny * ny + nz * nz; // Equal to uu * ee - ue^2
+	Vec4 inv_n_len = one / n_len_sq.Sqrt();
+	Vec4 distance = (nx * wx + ny * wy + nz * wz) * inv_n_len;
+	Vec4 speed = (nx * dx + ny * dy + nz * dz) * inv_n_len;
+
+	// Time at which the lines are inRadius apart when moving towards each other, or 0 if the lines start closer than that
+	UVec4 starts_close = Vec4::sLessOrEqual(distance.Abs(), radius);
+	Vec4 side_radius = Vec4::sSelect(radius, -radius, Vec4::sLess(distance, zero));
+	Vec4 t = Vec4::sSelect((side_radius - distance) / speed, zero, starts_close);
+	UVec4 no_hit = UVec4::sAnd(UVec4::sNot(starts_close), Vec4::sGreaterOrEqual(speed * distance, zero));
+	no_hit = UVec4::sOr(no_hit, Vec4::sLessOrEqual(n_len_sq, Vec4::sReplicate(1.0e-12f) * uu * ee));
+
+	// Closest points on both lines at time t, see: Real-Time Collision Detection - Christer Ericson, section 5.1.9
+	wx = wx + t * dx; wy = wy + t * dy; wz = wz + t * dz;
+	Vec4 uw = ux * wx + uy * wy + uz * wz;
+	Vec4 ew = inEX * wx + inEY * wy + inEZ * wz;
+	Vec4 s1 = (ue * ew - ee * uw) / n_len_sq;
+	Vec4 s2 = (uu * ew - ue * uw) / n_len_sq;
+	no_hit = UVec4::sOr(no_hit, UVec4::sOr(Vec4::sLess(s1, zero), Vec4::sGreater(s1, one)));
+	no_hit = UVec4::sOr(no_hit, UVec4::sOr(Vec4::sLess(s2, zero), Vec4::sGreater(s2, one)));
+
+	return Vec4::sSelect(t, Vec4::sReplicate(FLT_MAX), no_hit);
+}
+
+// Sweep a capsule (the points within inRadius of segment inPoint1 - inPoint2) by inDisplacement against 4 triangles in SOA format (triangles are double sided).
+// Returns the fraction t of inDisplacement where the capsule first touches each triangle or FLT_MAX if no hit, returns 0 if the capsule starts in contact.
+// The first contact is the earliest of: one of the end spheres touching the triangle, a vertex of the triangle touching the cylinder,
+// an edge of the triangle touching the cylinder or, only at t = 0, the axis of the capsule piercing the triangle.
+f_inline Vec4 SweptCapsuleTriangle4(const Vec3 &inPoint1, const Vec3 &inPoint2, float inRadius, const Vec3 &inDisplacement, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+{
+	Vec4 radius_sq = Vec4::sReplicate(inRadius * inRadius);
+	Vec3 axis = inPoint2 - inPoint1;
+
+	// End spheres
+	Vec4 t = Vec4::sMin(SweptSphereTriangle4(inPoint1, inDisplacement, inRadius, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z), SweptSphereTriangle4(inPoint2, inDisplacement, inRadius, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z));
+
+	// Vertices against the cylinder, relative to the capsule the vertices move with -inDisplacement
+	Vec4 p1x = inPoint1.SplatX(), p1y = inPoint1.SplatY(), p1z = inPoint1.SplatZ();
+	Vec4 dx = -inDisplacement.SplatX(), dy = -inDisplacement.SplatY(), dz = -inDisplacement.SplatZ();
+	Vec4 ax = axis.SplatX(), ay = axis.SplatY(), az = axis.SplatZ();
+	t = Vec4::sMin(t, SweptPointCylinder4(inV0X - p1x, inV0Y - p1y, inV0Z - p1z, dx, dy, dz, ax, ay, az, radius_sq));
+	t = Vec4::sMin(t, SweptPointCylinder4(inV1X - p1x, inV1Y - p1y, inV1Z - p1z, dx, dy, dz, ax, ay, az, radius_sq));
+	t = Vec4::sMin(t, SweptPointCylinder4(inV2X - p1x, inV2Y - p1y, inV2Z - p1z, dx, dy, dz, ax, ay, az, radius_sq));
+
+	// Edges against the cylinder
+	t = Vec4::sMin(t, SweptSegmentSegment4(inPoint1, axis, inDisplacement, inRadius, inV0X, inV0Y, inV0Z, inV1X - inV0X, inV1Y - inV0Y, inV1Z - inV0Z));
+	t = Vec4::sMin(t, SweptSegmentSegment4(inPoint1, axis, inDisplacement, inRadius, inV1X, inV1Y, inV1Z, inV2X - inV1X, inV2Y - inV1Y, inV2Z - inV1Z));
+	t = Vec4::sMin(t, SweptSegmentSegment4(inPoint1, axis, inDisplacement, inRadius, inV2X, inV2Y, inV2Z, inV0X - inV2X, inV0Y - inV2Y, inV0Z - inV2Z));
+
+	// Axis piercing the triangle
+	Vec4 pierce = RayTriangle4(inPoint1, axis, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+	t = Vec4::sSelect(t, Vec4::sZero(), Vec4::sLessOrEqual(pierce, Vec4::sReplicate(1.0f)));
+
+	return t;
+}
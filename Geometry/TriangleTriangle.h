@@ -0,0 +1,69 @@
+#pragma once
+
+// Test a triangle against 4 triangles in SOA format, returns true for the triangles that intersect (touching counts as intersecting).
+// Separating axis test with the normals of both triangles, the 9 cross products of the edges and the 6 edge normals that lie in the planes
+// of the triangles (the last ones are needed to separate coplanar triangles for which the cross products of the edges are zero).
+// An axis of length zero never separates, so degenerate triangles can be reported as intersecting when they are close.
+f_inline UVec4 TriangleTriangle4(const Vec3 &inV0, const Vec3 &inV1, const Vec3 &inV2, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+{
+	// Make everything relative to the first vertex of the single triangle to reduce rounding errors
+	Vec4 ox = inV0.SplatX(), oy = inV0.SplatY(), oz = inV0.SplatZ();
+	Vec4 a0x = inV0X - ox, a0y = inV0Y - oy, a0z = inV0Z - oz;
+	Vec4 a1x = inV1X - ox, a1y = inV1Y - oy, a1z = inV1Z - oz;
+	Vec4 a2x = inV2X - ox, a2y = inV2Y - oy, a2z = inV2Z - oz;
+	Vec3 b1 = inV1 - inV0, b2 = inV2 - inV0;
+
+	// Edges of the 4 triangles
+	Vec4 ea0x = a1x - a0x, ea0y = a1y - a0y, ea0z = a1z - a0z;
+	Vec4 ea1x = a2x - a1x, ea1y = a2y - a1y, ea1z = a2z - a1z;
+	Vec4 ea2x = a0x - a2x, ea2y = a0y - a2y, ea2z = a0z - a2z;
+
+	// Edges of the single triangle
+	Vec3 eb[3] = { b1, b2 - b1, -b2 };
+
+	// Normals
+	Vec4 nax = ea0y * ea1z - ea0z * ea1y;
+	Vec4 nay = ea0z * ea1x - ea0x * ea1z;
+	Vec4 naz = ea0x * ea1y - ea0y * ea1x;
+	Vec3 nb = eb[0].Cross(eb[1]);
+
+	// Test if the triangles are separated along an axis
+	UVec4 separated = UVec4::sZero();
+	auto test_axis = [&](const Vec4 &inAxisX, const Vec4 &inAxisY, const Vec4 &inAxisZ)
+	{
+		Vec4 pa0 = a0x * inAxisX + a0y * inAxisY + a0z * inAxisZ;
+		Vec4 pa1 = a1x * inAxisX + a1y * inAxisY + a1z * inAxisZ;
+		Vec4 pa2 = a2x * inAxisX + a2y * inAxisY + a2z * inAxisZ;
+		Vec4 pb1 = b1.SplatX() * inAxisX + b1.SplatY() * inAxisY + b1.SplatZ() * inAxisZ;
+		Vec4 pb2 = b2.SplatX() * inAxisX + b2.SplatY() * inAxisY + b2.SplatZ() * inAxisZ;
+
+		// The first vertex of the single triangle is at the origin so it projects to 0
+		Vec4 min_a = Vec4::sMin(Vec4::sMin(pa0, pa1), pa2), max_a = Vec4::sMax(Vec4::sMax(pa0, pa1), pa2);
+		Vec4 min_b = Vec4::sMin(Vec4::sMin(pb1, pb2), Vec4::sZero()), max_b = Vec4::sMax(Vec4::sMax(pb1, pb2), Vec4::sZero());
+		separated = UVec4::sOr(separated, UVec4::sOr(Vec4::sLess(max_a, min_b), Vec4::sLess(max_b, min_a)));
+	};
+
+	// Normals
+	test_axis(nax, nay, naz);
+	test_axis(nb.SplatX(), nb.SplatY(), nb.SplatZ());
+
+	// Cross products of the edges and the edge normals in the planes of the triangles
+	const Vec4 *ea[3][3] = { { &ea0x, &ea0y, &ea0z }, { &ea1x, &ea1y, &ea1z }, { &ea2x, &ea2y, &ea2z } };
+	for (int i = 0; i < 3; ++i)
+	{
+		const Vec4 &eax = *ea[i][0], &eay = *ea[i][1], &eaz = *ea[i][2];
+		Vec4 ebx = eb[i].SplatX(), eby = eb[i].SplatY(), ebz = eb[i].SplatZ();
+
+		for (int j = 0; j < 3; ++j)
+		{
+			Vec4 ex = eb[j].SplatX(), ey = eb[j].SplatY(), ez = eb[j].SplatZ();
+			test_axis(eay * ez - eaz * ey, eaz * ex - eax * ez, eax * ey - eay * ex);
+		}
+
+		test_axis(nay * eaz - naz * eay, naz * eax - nax * eaz, nax * eay - nay * eax);
+		Vec4 nbx = nb.SplatX(), nby = nb.SplatY(), nbz = nb.SplatZ();
+		test_axis(nby * ebz - nbz * eby, nbz * ebx - nbx * ebz, nbx * eby - nby * ebx);
+	}
+
+	return UVec4::sNot(separated);
+}
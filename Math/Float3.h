@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Core/HashCombine.h>
+#include <Core/ArrayView.h>
 
 class Float3
 {
@@ -30,6 +31,7 @@ public:
 };
 
 using VertexList = vector<Float3>;
+using VertexView = ArrayView<Float3>;
 
 // Create a std::hash for Float3
 MAKE_HASHABLE(Float3, t.x, t.y, t.z)
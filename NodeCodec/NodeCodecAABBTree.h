@@ -95,7 +95,7 @@ public:
 			inNode->mBounds.mMin.StoreFloat3(&node->mBoundsMin);
 			inNode->mBounds.mMax.StoreFloat3(&node->mBoundsMax);
 
-			if (!inNode->mTriangles.empty())
+			if (!inNode->HasChildren())
 			{
 				// Fill in node properties
 				uint32 tri_count = inNode->GetTriangleCount();
@@ -111,7 +111,7 @@ public:
 
 		void							NodeFinalize(const AABBTreeBuilder::Node *inNode, uint inNodeStart, uint inTrianglesStart, uint inNumChildren, const uint *inChildrenNodeStart, const uint *inChildrenTrianglesStart, ByteBuffer &ioBuffer) const
 		{
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Check number of children
 				if (inNumChildren != 2)
@@ -137,5 +137,17 @@ public:
 					FatalError("NodeCodecAABBTRee: Doesn't support offset between node and triangles");
 			}
 		}
+
+		void							NodeRefit(uint inNodeStart, const AABox &inBounds, const Vec3 &inNodeBoundsMin, const Vec3 &inNodeBoundsMax, uint inNumChildren, Vec3 ioChildBoundsMin[NumChildrenPerNode], Vec3 ioChildBoundsMax[NumChildrenPerNode], ByteBuffer &ioBuffer) const
+		{
+			// Every node stores its own bounds, the children keep their own bounds
+			Node *node = ioBuffer.Get<Node>(inNodeStart);
+			inBounds.mMin.StoreFloat3(&node->mBoundsMin);
+			inBounds.mMax.StoreFloat3(&node->mBoundsMax);
+		}
+
+		void							RefitFinalize(Header *ioHeader, const AABox &inRootBounds) const
+		{
+		}
 	};
 };
@@ -211,7 +211,7 @@ public:
 		{
 			uint node_start = (uint)ioBuffer.size();
 
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Fill in bounds
 				Node *node = ioBuffer.Allocate<Node>();
@@ -232,7 +232,7 @@ public:
 
 		void						NodeFinalize(const AABBTreeBuilder::Node *inNode, uint inNodeStart, uint inTrianglesStart, uint inNumChildren, const uint *inChildrenNodeStart, const uint *inChildrenTrianglesStart, ByteBuffer &ioBuffer) const
 		{
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Check number of children
 				if (inNumChildren != 2)
@@ -107,7 +107,7 @@ public:
 			inNode->mBounds.mMin.StoreFloat3(&node->mBoundsMin);
 			inNode->mBounds.mMax.StoreFloat3(&node->mBoundsMax);
 
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Fill in node properties
 				node->mNodeProperties = sCalculatePNSBits(inNode->mChild[0]->mBounds, inNode->mChild[1]->mBounds);
@@ -128,7 +128,7 @@ public:
 
 		void						NodeFinalize(const AABBTreeBuilder::Node *inNode, uint inNodeStart, uint inTrianglesStart, uint inNumChildren, const uint *inChildrenNodeStart, const uint *inChildrenTrianglesStart, ByteBuffer &ioBuffer) const
 		{
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Check number of children
 				if (inNumChildren != 2)
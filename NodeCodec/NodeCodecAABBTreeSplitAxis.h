@@ -108,7 +108,7 @@ public:
 			inNode->mBounds.mMin.StoreFloat3(&node->mBoundsMin);
 			inNode->mBounds.mMax.StoreFloat3(&node->mBoundsMax);
 
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Check that we have a valid split dimension (not all algorithms calculate this)
 				if (inNode->mSplitDimension >= 3)
@@ -133,7 +133,7 @@ public:
 
 		void						NodeFinalize(const AABBTreeBuilder::Node *inNode, uint inNodeStart, uint inTrianglesStart, uint inNumChildren, const uint *inChildrenNodeStart, const uint *inChildrenTrianglesStart, ByteBuffer &ioBuffer) const
 		{
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Check number of children
 				if (inNumChildren != 2)
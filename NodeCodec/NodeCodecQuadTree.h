@@ -18,6 +18,9 @@ public:
 	};
 
 	enum { HeaderSize = sizeof(Header) };
+
+	// Stack size to use during DecodingContext::sWalkTree
+	static constexpr int				StackSize = 128;
 	
 	// Node properties
 	enum
@@ -74,7 +77,7 @@ public:
 		uint							NodeAllocate(const AABBTreeBuilder::Node *inNode, const Vec3 &inNodeBoundsMin, const Vec3 &inNodeBoundsMax, vector<const AABBTreeBuilder::Node *> &ioChildren, Vec3 outChildBoundsMin[NumChildrenPerNode], Vec3 outChildBoundsMax[NumChildrenPerNode], ByteBuffer &ioBuffer) const
 		{
 			// We don't emit nodes for leafs
-			if (!inNode->mTriangles.empty())
+			if (!inNode->HasChildren())
 				return (uint)ioBuffer.size();
 				
 			// Align the buffer
@@ -130,7 +133,7 @@ public:
 
 		void							NodeFinalize(const AABBTreeBuilder::Node *inNode, uint inNodeStart, uint inTrianglesStart, uint inNumChildren, const uint *inChildrenNodeStart, const uint *inChildrenTrianglesStart, ByteBuffer &ioBuffer) const
 		{
-			if (!inNode->mTriangles.empty())
+			if (!inNode->HasChildren())
 				return;
 
 			Node *node = ioBuffer.Get<Node>(inNodeStart);
@@ -148,5 +151,104 @@ public:
 				node->mNodeProperties[i] |= offset;
 			}
 		}
+
+		void							NodeRefit(uint inNodeStart, const AABox &inBounds, const Vec3 &inNodeBoundsMin, const Vec3 &inNodeBoundsMax, uint inNumChildren, Vec3 ioChildBoundsMin[NumChildrenPerNode], Vec3 ioChildBoundsMax[NumChildrenPerNode], ByteBuffer &ioBuffer) const
+		{
+			// We don't emit nodes for leafs
+			if (inNumChildren == 0)
+				return;
+
+			// Update bounds, padding children keep their invalid bounding box
+			Node *node = ioBuffer.Get<Node>(inNodeStart);
+			for (uint i = 0; i < inNumChildren; ++i)
+			{
+				reinterpret_cast<float *>(&node->mBoundsMinX)[i] = ioChildBoundsMin[i].GetX();
+				reinterpret_cast<float *>(&node->mBoundsMinY)[i] = ioChildBoundsMin[i].GetY();
+				reinterpret_cast<float *>(&node->mBoundsMinZ)[i] = ioChildBoundsMin[i].GetZ();
+				reinterpret_cast<float *>(&node->mBoundsMaxX)[i] = ioChildBoundsMax[i].GetX();
+				reinterpret_cast<float *>(&node->mBoundsMaxY)[i] = ioChildBoundsMax[i].GetY();
+				reinterpret_cast<float *>(&node->mBoundsMaxZ)[i] = ioChildBoundsMax[i].GetZ();
+			}
+
+			// Keep the root bounds at all levels, like NodeAllocate
+			for (int i = 0; i < NumChildrenPerNode; ++i)
+			{
+				ioChildBoundsMin[i] = inNodeBoundsMin;
+				ioChildBoundsMax[i] = inNodeBoundsMax;
+			}
+		}
+
+		void							RefitFinalize(Header *ioHeader, const AABox &inRootBounds) const
+		{
+			inRootBounds.mMin.StoreFloat3(&ioHeader->mRootBoundsMin);
+			inRootBounds.mMax.StoreFloat3(&ioHeader->mRootBoundsMax);
+		}
+	};
+
+	// This class decodes quad tree nodes
+	class DecodingContext
+	{
+	public:
+		// Convert a triangle block ID to the start of the triangle buffer
+		inline static const void *		sGetTriangleBlockStart(const uint8 *inBufferStart, uint inTriangleBlockID)
+		{
+			return inBufferStart + (inTriangleBlockID << OFFSET_NON_SIGNIFICANT_BITS);
+		}
+
+		// Walk the node tree calling the Visitor::VisitNodes for each node encountered and Visitor::VisitTriangles for each triangle encountered,
+		// same interface as NodeCodecQuadTreeHalfFloat::DecodingContext::sWalkTree
+		template <class TriangleContext, class Visitor>
+		inline static void				sWalkTree(const Header *inHeader, const uint8 *inBufferStart, const TriangleContext &inTriangleContext, Visitor &ioVisitor)
+		{
+			const Vec3 root_bounds_min = Vec3::sLoadFloat3Unsafe(inHeader->mRootBoundsMin);
+			const Vec3 root_bounds_max = Vec3::sLoadFloat3Unsafe(inHeader->mRootBoundsMax);
+
+			uint32 node_stack[StackSize];
+			node_stack[0] = inHeader->mRootProperties;
+			int top = 0;
+			do
+			{
+				// Test if node contains triangles
+				uint32 node_properties = node_stack[top];
+				uint32 tri_count = node_properties >> TRIANGLE_COUNT_SHIFT;
+				if (tri_count == 0)
+				{
+					const Node *node = reinterpret_cast<const Node *>(inBufferStart + (node_properties << OFFSET_NON_SIGNIFICANT_BITS));
+					assert(IsAligned(node, Alignment));
+
+					// Load bounds and properties for 4 children
+					Vec4 bounds_minx = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(&node->mBoundsMinX);
+					Vec4 bounds_miny = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(&node->mBoundsMinY);
+					Vec4 bounds_minz = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(&node->mBoundsMinZ);
+					Vec4 bounds_maxx = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(&node->mBoundsMaxX);
+					Vec4 bounds_maxy = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(&node->mBoundsMaxY);
+					Vec4 bounds_maxz = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(&node->mBoundsMaxZ);
+					UVec4 properties = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(&node->mNodeProperties[0]);
+
+					// Check which sub nodes to visit
+					int num_results = ioVisitor.VisitNodes(bounds_minx, bounds_miny, bounds_minz, bounds_maxx, bounds_maxy, bounds_maxz, properties, top);
+
+					// Push them onto the stack
+					assert(top + 4 < StackSize);
+					properties.StoreInt4(&node_stack[top]);
+					top += num_results;
+				}
+				else if (tri_count != TRIANGLE_COUNT_MASK)
+				{
+					// Node contains triangles, do individual tests.
+					// Padding children are skipped here so that visitors don't need to filter them: their bounds are a point at FLT_MAX, which a big query can overlap.
+					uint32 triangle_block_id = node_properties & OFFSET_MASK;
+					const void *triangles = sGetTriangleBlockStart(inBufferStart, triangle_block_id);
+
+					ioVisitor.VisitTriangles(inTriangleContext, root_bounds_min, root_bounds_max, triangles, tri_count, triangle_block_id);
+				}
+
+				// Fetch next node until we find one that the visitor wants to see
+				do
+					--top;
+				while (top >= 0 && !ioVisitor.ShouldVisitNode(top));
+			}
+			while (top >= 0);
+		}
 	};
 };
@@ -144,6 +144,35 @@ public:
 			}
 		}
 
+		// Update the bounds of a node that was allocated by NodeAllocate after the vertices have moved (see AABBTreeToBuffer::Refit).
+		// inNumChildren is 0 for a leaf, ioChildBoundsMin, ioChildBoundsMax contain the new bounds of the children in the order in which they were stored.
+		// Like NodeAllocate this returns the bounds that should be used to encode the children in ioChildBoundsMin, ioChildBoundsMax.
+		void							NodeRefit(uint inNodeStart, const AABox &inBounds, const Vec3 &inNodeBoundsMin, const Vec3 &inNodeBoundsMax, uint inNumChildren, Vec3 ioChildBoundsMin[NumChildrenPerNode], Vec3 ioChildBoundsMax[NumChildrenPerNode], ByteBuffer &ioBuffer) const
+		{
+			// We don't emit nodes for leafs
+			if (inNumChildren == 0)
+				return;
+
+			// Update bounds, padding children keep their invalid bounding box
+			Node *node = ioBuffer.Get<Node>(inNodeStart);
+			for (uint i = 0; i < inNumChildren; ++i)
+			{
+				node->mBoundsMinX[i] = FloatToHalfFloat<ROUND_TO_NEG_INF>(ioChildBoundsMin[i].GetX());
+				node->mBoundsMinY[i] = FloatToHalfFloat<ROUND_TO_NEG_INF>(ioChildBoundsMin[i].GetY());
+				node->mBoundsMinZ[i] = FloatToHalfFloat<ROUND_TO_NEG_INF>(ioChildBoundsMin[i].GetZ());
+				node->mBoundsMaxX[i] = FloatToHalfFloat<ROUND_TO_POS_INF>(ioChildBoundsMax[i].GetX());
+				node->mBoundsMaxY[i] = FloatToHalfFloat<ROUND_TO_POS_INF>(ioChildBoundsMax[i].GetY());
+				node->mBoundsMaxZ[i] = FloatToHalfFloat<ROUND_TO_POS_INF>(ioChildBoundsMax[i].GetZ());
+			}
+
+			// Keep the root bounds at all levels, like NodeAllocate
+			for (int i = 0; i < NumChildrenPerNode; ++i)
+			{
+				ioChildBoundsMin[i] = inNodeBoundsMin;
+				ioChildBoundsMax[i] = inNodeBoundsMax;
+			}
+		}
+
 		// Once all nodes have been finalized, this will finalize the header of the nodes
 		void							Finalize(Header *outHeader, const AABBTreeBuilder::Node *inRoot, uint inRootNodeStart, uint inRootTrianglesStart) const
 		{
@@ -160,6 +189,13 @@ public:
 			if (inRoot->GetTriangleCount() & ~TRIANGLE_COUNT_MASK)
 				FatalError("NodeCodecQuadTreeHalfFloat: Too many triangles");
 		}		
+
+		// Once all nodes have been refitted, this will update the header of the nodes
+		void							RefitFinalize(Header *ioHeader, const AABox &inRootBounds) const
+		{
+			inRootBounds.mMin.StoreFloat3(&ioHeader->mRootBoundsMin);
+			inRootBounds.mMax.StoreFloat3(&ioHeader->mRootBoundsMax);
+		}
 	};
 
 	// This class decodes and decompresses quad tree nodes
@@ -178,6 +214,28 @@ public:
 			return inBufferStart + (inTriangleBlockID << OFFSET_NON_SIGNIFICANT_BITS);
 		}
 
+		// Decode the bounds and properties of the 4 children of the node with properties inNodeProperties (which should not contain triangles)
+		f_inline static void			sDecodeNode(const uint8 *inBufferStart, uint32 inNodeProperties, Vec4 &outBoundsMinX, Vec4 &outBoundsMinY, Vec4 &outBoundsMinZ, Vec4 &outBoundsMaxX, Vec4 &outBoundsMaxY, Vec4 &outBoundsMaxZ, UVec4 &outProperties)
+		{
+			const Node *node = reinterpret_cast<const Node *>(inBufferStart + (inNodeProperties << OFFSET_NON_SIGNIFICANT_BITS));
+
+			// Unpack bounds
+			UVec4 bounds_minxy = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(&node->mBoundsMinX[0]));
+			outBoundsMinX = bounds_minxy.HalfFloatToFloat();
+			outBoundsMinY = bounds_minxy.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
+			
+			UVec4 bounds_minzmaxx = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(&node->mBoundsMinZ[0]));
+			outBoundsMinZ = bounds_minzmaxx.HalfFloatToFloat();
+			outBoundsMaxX = bounds_minzmaxx.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
+
+			UVec4 bounds_maxyz = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(&node->mBoundsMaxY[0]));
+			outBoundsMaxY = bounds_maxyz.HalfFloatToFloat();
+			outBoundsMaxZ = bounds_maxyz.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
+
+			// Load properties for 4 children
+			outProperties = UVec4::sLoadInt4(&node->mNodeProperties[0]);
+		}
+
 		// Walk the node tree calling the Visitor::VisitNodes for each node encountered and Visitor::VisitTriangles for each triangle encountered
 		template <class TriangleContext, class Visitor>
 		inline static void				sWalkTree(const Header *inHeader, const uint8 *inBufferStart, const TriangleContext &inTriangleContext, Visitor &ioVisitor)
@@ -196,23 +254,10 @@ public:
 				uint32 tri_count = node_properties >> TRIANGLE_COUNT_SHIFT;
 				if (tri_count == 0)
 				{
-					const Node *node = reinterpret_cast<const Node *>(inBufferStart + (node_properties << OFFSET_NON_SIGNIFICANT_BITS));
-
-					// Unpack bounds
-					UVec4 bounds_minxy = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(&node->mBoundsMinX[0]));
-					Vec4 bounds_minx = bounds_minxy.HalfFloatToFloat();
-					Vec4 bounds_miny = bounds_minxy.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
-					
-					UVec4 bounds_minzmaxx = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(&node->mBoundsMinZ[0]));
-					Vec4 bounds_minz = bounds_minzmaxx.HalfFloatToFloat();
-					Vec4 bounds_maxx = bounds_minzmaxx.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
-
-					UVec4 bounds_maxyz = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(&node->mBoundsMaxY[0]));
-					Vec4 bounds_maxy = bounds_maxyz.HalfFloatToFloat();
-					Vec4 bounds_maxz = bounds_maxyz.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
-
-					// Load properties for 4 children
-					UVec4 properties = UVec4::sLoadInt4(&node->mNodeProperties[0]);
+					// Decode bounds and properties of 4 children
+					Vec4 bounds_minx, bounds_miny, bounds_minz, bounds_maxx, bounds_maxy, bounds_maxz;
+					UVec4 properties;
+					sDecodeNode(inBufferStart, node_properties, bounds_minx, bounds_miny, bounds_minz, bounds_maxx, bounds_maxy, bounds_maxz, properties);
 
 					// Check which sub nodes to visit
 					int num_results = ioVisitor.VisitNodes(bounds_minx, bounds_miny, bounds_minz, bounds_maxx, bounds_maxy, bounds_maxz, properties, top);
@@ -222,10 +267,10 @@ public:
 					properties.StoreInt4(&node_stack[top]);
 					top += num_results;
 				}
-				else
-				{	
-					// Node contains triangles, do individual tests
-					assert(tri_count != TRIANGLE_COUNT_MASK); // This is a padding node, it should have an invalid bounding box so we shouldn't get here
+				else if (tri_count != TRIANGLE_COUNT_MASK)
+				{
+					// Node contains triangles, do individual tests.
+					// Padding children are skipped here so that visitors don't need to filter them: their bounds are a point at HALF_FLT_MAX, which a big query can overlap.
 					uint32 triangle_block_id = node_properties & OFFSET_MASK;
 					const void *triangles = sGetTriangleBlockStart(inBufferStart, triangle_block_id);
 
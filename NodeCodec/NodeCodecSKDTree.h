@@ -111,7 +111,7 @@ public:
 		{
 			uint node_start = (uint)ioBuffer.size();
 
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Determine which axis has the biggest empty space between the left and right child
 				uint32 best_split_axis = 0;
@@ -171,7 +171,7 @@ public:
 
 		void						NodeFinalize(const AABBTreeBuilder::Node *inNode, uint inNodeStart, uint inTrianglesStart, uint inNumChildren, const uint *inChildrenNodeStart, const uint *inChildrenTrianglesStart, ByteBuffer &ioBuffer) const
 		{
-			if (inNode->mTriangles.empty())
+			if (inNode->HasChildren())
 			{
 				// Check number of children
 				if (inNumChildren != 2)
@@ -1,201 +1,787 @@
 // Converts a .ply file (https://en.wikipedia.org/wiki/PLY_(file_format)) to a .model format that is compatible with our Model class
-#include <pch.h>
+//
+// The input file is memory mapped and split in chunks that are parsed on all hardware threads.
+// Supports ascii, binary_little_endian and binary_big_endian files, any amount of extra properties and polygons (which are triangulated as a fan).
+#include <pch.h>
 #include <Geometry/Triangle.h>
 #include <Geometry/IndexedTriangle.h>
 #include <Geometry/Indexify.h>
 #include <Utils/Model.h>
 #include <Core/Utils.h>
-#include <fstream>
+#include <Core/MappedFile.h>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
-static void sBigEndianToLittleEndian(uint32 &ioValue)
+// Amount of vertices / faces / bytes of ascii data that are parsed as a single job
+static const uint cVerticesPerChunk = 1 << 16;
+static const uint cFacesPerChunk = 1 << 16;
+static const uint cAsciiBytesPerChunk = 1 << 22;
+
+enum class EPlyFormat
+{
+	Ascii,
+	BinaryLittleEndian,
+	BinaryBigEndian,
+};
+
+enum class EPlyType
+{
+	Int8,
+	UInt8,
+	Int16,
+	UInt16,
+	Int32,
+	UInt32,
+	Float32,
+	Float64,
+};
+
+struct PlyProperty
+{
+	string				mName;
+	EPlyType			mType;											// Type of the value or of the list elements
+	bool				mIsList = false;
+	EPlyType			mCountType = EPlyType::UInt8;					// Type of the list size
+};
+
+struct PlyElement
+{
+	string				mName;
+	uint64				mCount = 0;
+	vector<PlyProperty>	mProperties;
+	uint				mStride = 0;									// Size of an instance in a binary file, 0 if the element has list properties
+	uint64				mFirstLine = 0;									// Line in the body where this element starts (ascii only)
+	const uint8 *		mStart = nullptr;								// Start of the element data (binary only)
+	const uint8 *		mEnd = nullptr;
+};
+
+static EPlyType sParseType(const string &inName)
+{
+	if (inName == "char" || inName == "int8")
+		return EPlyType::Int8;
+	if (inName == "uchar" || inName == "uint8")
+		return EPlyType::UInt8;
+	if (inName == "short" || inName == "int16")
+		return EPlyType::Int16;
+	if (inName == "ushort" || inName == "uint16")
+		return EPlyType::UInt16;
+	if (inName == "int" || inName == "int32")
+		return EPlyType::Int32;
+	if (inName == "uint" || inName == "uint32")
+		return EPlyType::UInt32;
+	if (inName == "float" || inName == "float32")
+		return EPlyType::Float32;
+	if (inName == "double" || inName == "float64")
+		return EPlyType::Float64;
+	FatalError("Unknown property type: %s", inName.c_str());
+	return EPlyType::UInt8;
+}
+
+static uint sGetTypeSize(EPlyType inType)
 {
-	uint8 *tmp = reinterpret_cast<uint8 *>(&ioValue);
-	swap(tmp[0], tmp[3]);
-	swap(tmp[1], tmp[2]);
+	switch (inType)
+	{
+	case EPlyType::Int8:
+	case EPlyType::UInt8:
+		return 1;
+	case EPlyType::Int16:
+	case EPlyType::UInt16:
+		return 2;
+	case EPlyType::Int32:
+	case EPlyType::UInt32:
+	case EPlyType::Float32:
+		return 4;
+	case EPlyType::Float64:
+		return 8;
+	}
+	return 0;
 }
 
-static void sBigEndianToLittleEndian(float &ioValue)
+// Load a value from unaligned memory and convert its endianness if needed
+template <class T>
+static inline T sLoad(const uint8 *inData, bool inSwap)
 {
-	uint8 *tmp = reinterpret_cast<uint8 *>(&ioValue);
-	swap(tmp[0], tmp[3]);
-	swap(tmp[1], tmp[2]);
+	uint8 tmp[sizeof(T)];
+	memcpy(tmp, inData, sizeof(T));
+	if (inSwap)
+		reverse(tmp, tmp + sizeof(T));
+	T value;
+	memcpy(&value, tmp, sizeof(T));
+	return value;
 }
 
-int __cdecl main(int argc, const char *argv[])
+// Read a binary value of type inType and convert it to T
+template <class T>
+static inline T sReadBinary(const uint8 *inData, EPlyType inType, bool inSwap)
 {
-	try
+	switch (inType)
 	{
-		// Check parameters
-		if (argc != 3)
-			FatalError("Usage: PlyConverter <input> <output>");
+	case EPlyType::Int8:		return T(sLoad<int8_t>(inData, inSwap));
+	case EPlyType::UInt8:		return T(sLoad<uint8>(inData, inSwap));
+	case EPlyType::Int16:		return T(sLoad<int16_t>(inData, inSwap));
+	case EPlyType::UInt16:		return T(sLoad<uint16>(inData, inSwap));
+	case EPlyType::Int32:		return T(sLoad<int32_t>(inData, inSwap));
+	case EPlyType::UInt32:		return T(sLoad<uint32>(inData, inSwap));
+	case EPlyType::Float32:		return T(sLoad<float>(inData, inSwap));
+	case EPlyType::Float64:		return T(sLoad<double>(inData, inSwap));
+	}
+	return T(0);
+}
+
+// Get the size of a binary element instance, returns nullptr if it doesn't fit before inEnd
+static const uint8 *sSkipBinaryInstance(const PlyElement &inElement, const uint8 *inCur, const uint8 *inEnd, bool inSwap)
+{
+	if (inElement.mStride > 0)
+		return inEnd - inCur >= (ptrdiff_t)inElement.mStride? inCur + inElement.mStride : nullptr;
+
+	for (const PlyProperty &p : inElement.mProperties)
+		if (p.mIsList)
+		{
+			uint count_size = sGetTypeSize(p.mCountType);
+			if (inEnd - inCur < (ptrdiff_t)count_size)
+				return nullptr;
+			uint64 count = sReadBinary<uint64>(inCur, p.mCountType, inSwap);
+			uint64 size = count_size + count * sGetTypeSize(p.mType);
+			if (uint64(inEnd - inCur) < size)
+				return nullptr;
+			inCur += size;
+		}
+		else
+		{
+			uint size = sGetTypeSize(p.mType);
+			if (inEnd - inCur < (ptrdiff_t)size)
+				return nullptr;
+			inCur += size;
+		}
+	return inCur;
+}
+
+// Skip spaces and tabs
+static inline const char *sSkipSpace(const char *inCur, const char *inEnd)
+{
+	while (inCur < inEnd && (*inCur == ' ' || *inCur == '\t' || *inCur == '\r'))
+		++inCur;
+	return inCur;
+}
+
+// Skip to the end of the current token
+static inline const char *sSkipToken(const char *inCur, const char *inEnd)
+{
+	while (inCur < inEnd && *inCur != ' ' && *inCur != '\t' && *inCur != '\r')
+		++inCur;
+	return inCur;
+}
+
+// Parse an integer, returns false on failure
+static inline bool sParseInteger(const char *&ioCur, const char *inEnd, int64_t &outValue)
+{
+	const char *cur = sSkipSpace(ioCur, inEnd);
+	bool negative = cur < inEnd && *cur == '-';
+	if (cur < inEnd && (*cur == '-' || *cur == '+'))
+		++cur;
+	const char *digits = cur;
+	int64_t value = 0;
+	while (cur < inEnd && *cur >= '0' && *cur <= '9')
+		value = value * 10 + (*cur++ - '0');
+	if (cur == digits || (cur < inEnd && *cur != ' ' && *cur != '\t' && *cur != '\r'))
+		return false;
+	outValue = negative? -value : value;
+	ioCur = cur;
+	return true;
+}
+
+// Parse a floating point number, returns false on failure
+static inline bool sParseFloat(const char *&ioCur, const char *inEnd, float &outValue)
+{
+	// Copy the token so that strtof cannot read beyond the end of the mapped file
+	const char *start = sSkipSpace(ioCur, inEnd);
+	const char *end = sSkipToken(start, inEnd);
+	char buffer[64];
+	size_t length = end - start;
+	if (length == 0 || length >= sizeof(buffer))
+		return false;
+	memcpy(buffer, start, length);
+	buffer[length] = 0;
+	char *parse_end;
+	outValue = strtof(buffer, &parse_end);
+	if (parse_end != buffer + length)
+		return false;
+	ioCur = end;
+	return true;
+}
+
+// Run inFunction(i) for i in [0, inCount) on all hardware threads, rethrows the first error
+template <class Function>
+static void sParallelFor(uint inCount, const Function &inFunction)
+{
+	uint num_threads = min(inCount, max(1u, thread::hardware_concurrency()));
+	atomic<uint> next(0);
+	string error;
+	mutex error_mutex;
+	auto worker = [&]() {
+		try
+		{
+			for (uint i = next++; i < inCount; i = next++)
+				inFunction(i);
+		}
+		catch (string e)
+		{
+			lock_guard<mutex> lock(error_mutex);
+			if (error.empty())
+				error = e;
+			next = inCount;
+		}
+	};
 
-		// Read the entire file
-		vector<uint8> data = ReadData(argv[1]);
-		data.push_back(0); // Make sure it is zero terminated
-		char *cur = reinterpret_cast<char *>(&data[0]);
-		const char *end = cur + data.size();
+	vector<thread> threads;
+	for (uint t = 1; t < num_threads; ++t)
+		threads.emplace_back(worker);
+	worker();
+	for (thread &t : threads)
+		t.join();
 
-		bool is_binary = false;
-		int vertex_count = 0;
-		int triangle_count = 0;
+	if (!error.empty())
+		throw error;
+}
+
+// Triangulate a polygon as a fan and add it to ioTriangles
+static inline void sAddPolygon(const uint32 *inIndices, uint inNumIndices, uint64 inVertexCount, IndexedTriangleList &ioTriangles)
+{
+	for (uint i = 0; i < inNumIndices; ++i)
+		if (inIndices[i] >= inVertexCount)
+			FatalError("Vertex index out of range");
+
+	for (uint i = 2; i < inNumIndices; ++i)
+		ioTriangles.push_back(IndexedTriangle(inIndices[0], inIndices[i - 1], inIndices[i]));
+}
+
+class PlyReader
+{
+public:
+	// Map the file and parse the header
+	void				Open(const char *inFileName)
+	{
+		mFile.Open(inFileName);
+		const char *data = reinterpret_cast<const char *>(mFile.GetData());
+		const char *end = data + mFile.GetSize();
 
 		// Read header
+		const char *cur = data;
+		bool first_line = true;
+		PlyElement *element = nullptr;
 		for (;;)
 		{
 			// Read line
-			const char *str = cur;
-			cur = strchr(cur, '\n');
-			if (cur == nullptr)
+			const char *line_end = static_cast<const char *>(memchr(cur, '\n', end - cur));
+			if (line_end == nullptr)
 				FatalError("Unexpected end of file!");
-			*cur = 0;
-			++cur;
-
-			// Check header element type
-			if (strncmp(str, "element vertex ", 15) == 0)
-				vertex_count = atoi(str + 15);
-			else if (strncmp(str, "element face ", 13) == 0)
-				triangle_count = atoi(str + 13);
-			else if (strncmp(str, "format binary_big_endian", 24) == 0)
-				is_binary = true;
-			else if (strncmp(str, "end_header", 10) == 0)
+			istringstream line(string(cur, line_end));
+			cur = line_end + 1;
+
+			string keyword;
+			line >> keyword;
+			if (first_line)
+			{
+				if (keyword != "ply")
+					FatalError("Not a ply file");
+				first_line = false;
+			}
+			else if (keyword == "format")
+			{
+				string format;
+				line >> format;
+				if (format == "ascii")
+					mFormat = EPlyFormat::Ascii;
+				else if (format == "binary_little_endian")
+					mFormat = EPlyFormat::BinaryLittleEndian;
+				else if (format == "binary_big_endian")
+					mFormat = EPlyFormat::BinaryBigEndian;
+				else
+					FatalError("Unknown format: %s", format.c_str());
+			}
+			else if (keyword == "element")
+			{
+				mElements.emplace_back();
+				element = &mElements.back();
+				line >> element->mName >> element->mCount;
+				if (!line)
+					FatalError("Cannot parse element");
+			}
+			else if (keyword == "property")
+			{
+				if (element == nullptr)
+					FatalError("Property without element");
+				PlyProperty property;
+				string type;
+				line >> type;
+				if (type == "list")
+				{
+					string count_type;
+					line >> count_type >> type;
+					property.mIsList = true;
+					property.mCountType = sParseType(count_type);
+				}
+				property.mType = sParseType(type);
+				line >> property.mName;
+				if (!line)
+					FatalError("Cannot parse property");
+				element->mProperties.push_back(property);
+			}
+			else if (keyword == "end_header")
 				break;
 		}
+		mBodyStart = cur;
+		mBodyEnd = end;
 
-		// Check header validity
-		if (vertex_count <= 0)
+		// Determine stride of binary elements
+		for (PlyElement &e : mElements)
+		{
+			e.mStride = 0;
+			for (const PlyProperty &p : e.mProperties)
+			{
+				if (p.mIsList)
+				{
+					e.mStride = 0;
+					break;
+				}
+				e.mStride += sGetTypeSize(p.mType);
+			}
+		}
+
+		// Find the elements we need
+		mVertexElement = FindElement("vertex");
+		mFaceElement = FindElement("face");
+		if (mVertexElement->mCount == 0)
 			FatalError("No vertices found in model");
-		if (triangle_count <= 0)
+		if (mVertexElement->mCount > 0xffffffff)
+			FatalError("Too many vertices");
+		if (mFaceElement->mCount == 0)
 			FatalError("No triangles found in model");
+		for (int i = 0; i < 3; ++i)
+		{
+			mPositionProperty[i] = FindProperty(*mVertexElement, string(1, char('x' + i)));
+			if (mVertexElement->mProperties[mPositionProperty[i]].mIsList)
+				FatalError("Vertex position cannot be a list");
+		}
+		mIndicesProperty = FindProperty(*mFaceElement, "vertex_indices", "vertex_index");
+		if (!mFaceElement->mProperties[mIndicesProperty].mIsList)
+			FatalError("Vertex indices should be a list");
 
-		// Make room for data
-		VertexList vertices;
-		IndexedTriangleList indexed_triangles;
-		vertices.resize(vertex_count);
-		indexed_triangles.resize(triangle_count);
+		if (mFormat == EPlyFormat::Ascii)
+			LocateAsciiElements();
+		else
+			LocateBinaryElements();
+	}
+
+	// Get amount of vertices
+	uint				GetVertexCount() const
+	{
+		return (uint)mVertexElement->mCount;
+	}
 
-		if (!is_binary)
+	// Parse all vertices
+	void				ReadVertices(VertexList &outVertices)
+	{
+		outVertices.resize(GetVertexCount());
+
+		if (mFormat == EPlyFormat::Ascii)
+		{
+			sParallelFor((uint)mAsciiChunks.size(), [this, &outVertices](uint inChunk) {
+				ParseAsciiChunk(inChunk, *mVertexElement, [this, &outVertices](uint64 inIndex, const char *inCur, const char *inEnd) {
+					ParseAsciiVertex(inCur, inEnd, outVertices[inIndex]);
+				});
+			});
+		}
+		else
 		{
-			for (int i = 0; i < vertex_count; ++i)
+			const PlyElement &e = *mVertexElement;
+			if (e.mStride == 0)
+				FatalError("Vertex element with list properties is not supported in binary files");
+
+			// Determine offsets of x, y, z within a vertex
+			uint offset[3];
+			for (int i = 0; i < 3; ++i)
 			{
-				// Read line
-				const char *str = cur;
-				cur = strchr(cur, '\n');
-				if (cur == nullptr)
-					FatalError("Cannot parse vertex");
-				*cur = 0;
-				++cur;
+				offset[i] = 0;
+				for (int p = 0; p < mPositionProperty[i]; ++p)
+					offset[i] += sGetTypeSize(e.mProperties[p].mType);
+			}
 
-				// Parse vertex
-				float x, y, z;
-				if (sscanf(str, "%f %f %f", &x, &y, &z) != 3)
-					FatalError("Cannot parse vertex");
+			uint num_chunks = uint((e.mCount + cVerticesPerChunk - 1) / cVerticesPerChunk);
+			sParallelFor(num_chunks, [this, &e, &offset, &outVertices](uint inChunk) {
+				bool swap = mFormat == EPlyFormat::BinaryBigEndian;
+				uint begin = inChunk * cVerticesPerChunk, end = min(GetVertexCount(), begin + cVerticesPerChunk);
+				for (uint v = begin; v < end; ++v)
+				{
+					const uint8 *data = e.mStart + uint64(v) * e.mStride;
+					Float3 &out = outVertices[v];
+					out.x = sReadBinary<float>(data + offset[0], e.mProperties[mPositionProperty[0]].mType, swap);
+					out.y = sReadBinary<float>(data + offset[1], e.mProperties[mPositionProperty[1]].mType, swap);
+					out.z = sReadBinary<float>(data + offset[2], e.mProperties[mPositionProperty[2]].mType, swap);
+				}
+			});
+		}
+	}
 
-				// Set vertex
-				vertices[i] = Float3(x, y, z);
-			}
+	// Parse all faces and triangulate them. To limit memory usage the faces are parsed in batches and passed to
+	// ioConsumer(const IndexedTriangleList &) in the order in which they appear in the file.
+	template <class Consumer>
+	void				ReadTriangles(Consumer &ioConsumer)
+	{
+		uint num_threads = max(1u, thread::hardware_concurrency());
+		uint batch_size = 4 * num_threads;
 
-			for (int i = 0; i < triangle_count; ++i)
+		if (mFormat == EPlyFormat::Ascii)
+		{
+			vector<IndexedTriangleList> triangles(batch_size);
+			for (uint batch = 0; batch < (uint)mAsciiChunks.size(); batch += batch_size)
 			{
-				IndexedTriangle &tri = indexed_triangles[i];
-
-				// Read line
-				const char *str = cur;
-				cur = strchr(cur, '\n');
+				uint num_chunks = min(batch_size, (uint)mAsciiChunks.size() - batch);
+				sParallelFor(num_chunks, [this, batch, &triangles](uint inChunk) {
+					IndexedTriangleList &out = triangles[inChunk];
+					out.clear();
+					vector<uint32> indices;
+					ParseAsciiChunk(batch + inChunk, *mFaceElement, [this, &out, &indices](uint64, const char *inCur, const char *inEnd) {
+						ParseAsciiFace(inCur, inEnd, indices);
+						sAddPolygon(indices.data(), (uint)indices.size(), mVertexElement->mCount, out);
+					});
+				});
+				for (uint c = 0; c < num_chunks; ++c)
+					ioConsumer(triangles[c]);
+			}
+		}
+		else
+		{
+			// Find the start of every chunk, this only reads the list sizes
+			const PlyElement &e = *mFaceElement;
+			bool swap = mFormat == EPlyFormat::BinaryBigEndian;
+			vector<const uint8 *> chunk_start;
+			const uint8 *cur = e.mStart;
+			for (uint64 f = 0; f < e.mCount; ++f)
+			{
+				if (f % cFacesPerChunk == 0)
+					chunk_start.push_back(cur);
+				cur = sSkipBinaryInstance(e, cur, e.mEnd, swap);
 				if (cur == nullptr)
 					FatalError("Cannot parse triangle");
-				*cur = 0;
-				++cur;
+			}
+			chunk_start.push_back(cur);
 
-				// Read indexed_triangles of face
-				int c;
-				if (sscanf(str, "%d %d %d %d", &c, &tri.mIdx[0], &tri.mIdx[1], &tri.mIdx[2]) != 4)
-					FatalError("Cannot parse triangle");
-				if (c != 3)
-					FatalError("Cannot parse triangle");
+			vector<IndexedTriangleList> triangles(batch_size);
+			uint num_chunks_total = (uint)chunk_start.size() - 1;
+			for (uint batch = 0; batch < num_chunks_total; batch += batch_size)
+			{
+				uint num_chunks = min(batch_size, num_chunks_total - batch);
+				sParallelFor(num_chunks, [this, batch, swap, &e, &chunk_start, &triangles](uint inChunk) {
+					IndexedTriangleList &out = triangles[inChunk];
+					out.clear();
+					vector<uint32> indices;
+					for (const uint8 *cur = chunk_start[batch + inChunk], *end = chunk_start[batch + inChunk + 1]; cur < end; )
+					{
+						for (int p = 0; p < (int)e.mProperties.size(); ++p)
+						{
+							const PlyProperty &property = e.mProperties[p];
+							if (property.mIsList)
+							{
+								uint count = sReadBinary<uint>(cur, property.mCountType, swap);
+								cur += sGetTypeSize(property.mCountType);
+								uint size = sGetTypeSize(property.mType);
+								if (p == mIndicesProperty)
+								{
+									indices.resize(count);
+									for (uint i = 0; i < count; ++i, cur += size)
+									{
+										int64_t index = sReadBinary<int64_t>(cur, property.mType, swap);
+										if (index < 0)
+											FatalError("Vertex index out of range");
+										indices[i] = uint32(min<int64_t>(index, 0xffffffff));
+									}
+								}
+								else
+									cur += uint64(count) * size;
+							}
+							else
+								cur += sGetTypeSize(property.mType);
+						}
+						sAddPolygon(indices.data(), (uint)indices.size(), mVertexElement->mCount, out);
+					}
+				});
+				for (uint c = 0; c < num_chunks; ++c)
+					ioConsumer(triangles[c]);
 			}
 		}
-		else
+	}
+
+private:
+	struct AsciiChunk
+	{
+		const char *	mStart;
+		const char *	mEnd;
+		uint64			mFirstLine;
+	};
+
+	PlyElement *		FindElement(const char *inName)
+	{
+		for (PlyElement &e : mElements)
+			if (e.mName == inName)
+				return &e;
+		FatalError("Element '%s' not found", inName);
+		return nullptr;
+	}
+
+	int					FindProperty(const PlyElement &inElement, const string &inName, const string &inAlternativeName = string())
+	{
+		for (int p = 0; p < (int)inElement.mProperties.size(); ++p)
+			if (inElement.mProperties[p].mName == inName || inElement.mProperties[p].mName == inAlternativeName)
+				return p;
+		FatalError("Property '%s' not found in element '%s'", inName.c_str(), inElement.mName.c_str());
+		return -1;
+	}
+
+	// Determine where every element starts in a binary file
+	void				LocateBinaryElements()
+	{
+		bool swap = mFormat == EPlyFormat::BinaryBigEndian;
+		const uint8 *cur = reinterpret_cast<const uint8 *>(mBodyStart);
+		const uint8 *end = reinterpret_cast<const uint8 *>(mBodyEnd);
+		for (PlyElement &e : mElements)
 		{
-			for (int i = 0; i < vertex_count; ++i)
+			e.mStart = cur;
+			if (e.mStride > 0)
 			{
-				// Read vertex position
-				if (end - cur < (int)sizeof(Float3))
-					FatalError("Cannot parse vertex");
-				Float3 pos = *(const Float3 *)cur;
-				cur += sizeof(Float3);
-
-				// Convert endianness
-				sBigEndianToLittleEndian(pos.x);
-				sBigEndianToLittleEndian(pos.y);
-				sBigEndianToLittleEndian(pos.z);
+				if (uint64(end - cur) / e.mStride < e.mCount)
+					FatalError("Element '%s' truncated", e.mName.c_str());
+				cur += e.mCount * e.mStride;
+			}
+			else if (&e != mFaceElement || mFaceElement < &mElements.back())
+			{
+				// Elements with lists need to be walked to find where they end (the face element is walked when reading it unless other elements follow)
+				for (uint64 i = 0; i < e.mCount; ++i)
+				{
+					cur = sSkipBinaryInstance(e, cur, end, swap);
+					if (cur == nullptr)
+						FatalError("Element '%s' truncated", e.mName.c_str());
+				}
+			}
+			else
+				cur = end;
+			e.mEnd = cur;
+		}
+	}
 
-				// Set vertex
-				vertices[i] = pos;
+	// Split the body of an ascii file in chunks of lines and determine the first line of every element
+	void				LocateAsciiElements()
+	{
+		// Split in chunks that end at a line boundary
+		for (const char *cur = mBodyStart; cur < mBodyEnd; )
+		{
+			const char *chunk_end = cur + min<size_t>(cAsciiBytesPerChunk, mBodyEnd - cur);
+			if (chunk_end < mBodyEnd)
+			{
+				const char *line_end = static_cast<const char *>(memchr(chunk_end, '\n', mBodyEnd - chunk_end));
+				chunk_end = line_end != nullptr? line_end + 1 : mBodyEnd;
 			}
+			mAsciiChunks.push_back({ cur, chunk_end, 0 });
+			cur = chunk_end;
+		}
 
-			for (int i = 0; i < triangle_count; ++i)
+		// Count lines in parallel
+		vector<uint64> line_count(mAsciiChunks.size());
+		sParallelFor((uint)mAsciiChunks.size(), [this, &line_count](uint inChunk) {
+			const AsciiChunk &c = mAsciiChunks[inChunk];
+			uint64 count = count_if(c.mStart, c.mEnd, [](char inC) { return inC == '\n'; });
+			if (c.mEnd[-1] != '\n')
+				++count; // Last line without line ending
+			line_count[inChunk] = count;
+		});
+		uint64 total_lines = 0;
+		for (size_t c = 0; c < mAsciiChunks.size(); ++c)
+		{
+			mAsciiChunks[c].mFirstLine = total_lines;
+			total_lines += line_count[c];
+		}
+
+		// Every instance of an element is a line
+		uint64 line = 0;
+		for (PlyElement &e : mElements)
+		{
+			e.mFirstLine = line;
+			line += e.mCount;
+		}
+		if (line > total_lines)
+			FatalError("File truncated");
+	}
+
+	// Call inFunction(instance_index, line_start, line_end) for every line in chunk inChunk that belongs to inElement
+	template <class Function>
+	void				ParseAsciiChunk(uint inChunk, const PlyElement &inElement, const Function &inFunction) const
+	{
+		const AsciiChunk &c = mAsciiChunks[inChunk];
+		uint64 element_end = inElement.mFirstLine + inElement.mCount;
+		if (c.mFirstLine >= element_end)
+			return;
+
+		uint64 line = c.mFirstLine;
+		for (const char *cur = c.mStart; cur < c.mEnd && line < element_end; ++line)
+		{
+			const char *line_end = static_cast<const char *>(memchr(cur, '\n', c.mEnd - cur));
+			if (line_end == nullptr)
+				line_end = c.mEnd;
+			if (line >= inElement.mFirstLine)
+				inFunction(line - inElement.mFirstLine, cur, line_end);
+			cur = line_end + 1;
+		}
+	}
+
+	void				ParseAsciiVertex(const char *inCur, const char *inEnd, Float3 &outVertex) const
+	{
+		const vector<PlyProperty> &properties = mVertexElement->mProperties;
+		float position[3] = { 0, 0, 0 };
+		for (int p = 0; p < (int)properties.size(); ++p)
+		{
+			int axis = p == mPositionProperty[0]? 0 : (p == mPositionProperty[1]? 1 : (p == mPositionProperty[2]? 2 : -1));
+			if (axis >= 0)
 			{
-				IndexedTriangle &tri = indexed_triangles[i];
+				if (!sParseFloat(inCur, inEnd, position[axis]))
+					FatalError("Cannot parse vertex");
+			}
+			else
+				SkipAsciiProperty(inCur, inEnd, properties[p]);
+		}
+		outVertex = Float3(position[0], position[1], position[2]);
+	}
 
-				// Read vertex count
-				if (end - cur < (int)sizeof(uint8))
-					FatalError("Cannot parse triangle");
-				uint8 c = *(const uint8 *)cur;
-				cur += sizeof(uint8);
-				if (c != 3)
+	void				ParseAsciiFace(const char *inCur, const char *inEnd, vector<uint32> &outIndices) const
+	{
+		const vector<PlyProperty> &properties = mFaceElement->mProperties;
+		for (int p = 0; p < (int)properties.size(); ++p)
+			if (p == mIndicesProperty)
+			{
+				int64_t count = 0;
+				if (!sParseInteger(inCur, inEnd, count) || count < 0)
 					FatalError("Cannot parse triangle");
+				outIndices.resize(size_t(count));
+				for (uint32 &index : outIndices)
+				{
+					int64_t value = 0;
+					if (!sParseInteger(inCur, inEnd, value) || value < 0 || value > 0xffffffff)
+						FatalError("Cannot parse triangle");
+					index = uint32(value);
+				}
+			}
+			else
+				SkipAsciiProperty(inCur, inEnd, properties[p]);
+	}
 
-				// Read indexed triangles of face
-				if (end - cur < (int)sizeof(IndexedTriangleNoMaterial))
-					FatalError("Cannot parse triangle");
-				static_cast<IndexedTriangleNoMaterial &>(tri) = *reinterpret_cast<const IndexedTriangleNoMaterial *>(cur);
-				cur += sizeof(IndexedTriangleNoMaterial);
+	void				SkipAsciiProperty(const char *&ioCur, const char *inEnd, const PlyProperty &inProperty) const
+	{
+		int64_t count = 1;
+		if (inProperty.mIsList && (!sParseInteger(ioCur, inEnd, count) || count < 0))
+			FatalError("Cannot parse list");
+		for (int64_t i = 0; i < count; ++i)
+		{
+			const char *start = sSkipSpace(ioCur, inEnd);
+			ioCur = sSkipToken(start, inEnd);
+			if (ioCur == start)
+				FatalError("Missing property '%s'", inProperty.mName.c_str());
+		}
+	}
 
-				// Convert endianness
-				for (int j = 0; j < 3; ++j)
-					sBigEndianToLittleEndian(tri.mIdx[j]);
-			}
+	MappedFile			mFile;
+	EPlyFormat			mFormat = EPlyFormat::Ascii;
+	vector<PlyElement>	mElements;
+	const char *		mBodyStart = nullptr;
+	const char *		mBodyEnd = nullptr;
+	const PlyElement *	mVertexElement = nullptr;
+	const PlyElement *	mFaceElement = nullptr;
+	int					mPositionProperty[3];
+	int					mIndicesProperty = -1;
+	vector<AsciiChunk>	mAsciiChunks;
+};
+
+int __cdecl main(int argc, const char *argv[])
+{
+	try
+	{
+		// Check parameters
+		bool weld = true;
+		float weld_distance = 1.0e-4f;
+		int arg = 1;
+		for (; arg < argc && argv[arg][0] == '-'; ++arg)
+			if (strcmp(argv[arg], "-noweld") == 0)
+				weld = false;
+			else if (strcmp(argv[arg], "-weld") == 0 && arg + 1 < argc)
+				weld_distance = float(atof(argv[++arg]));
+			else
+				break;
+		if (argc - arg != 2)
+			FatalError("Usage: PlyConverter [-noweld] [-weld <distance>] <input> <output>\n"
+				"Without -noweld vertices closer than the weld distance (default 1.0e-4) are merged and unused vertices are removed,\n"
+				"with -noweld the original vertices are kept. Triangles are written while parsing, without -noweld the faces are parsed twice.");
+		const char *input_file = argv[arg];
+		const char *output_file = argv[arg + 1];
+
+		// Parse header
+		PlyReader reader;
+		reader.Open(input_file);
+
+		// Parse vertices
+		VertexList vertices;
+		reader.ReadVertices(vertices);
+
+		// Maps the vertex indices of the file to the vertices that are written
+		vector<uint32> vertex_map;
+		if (weld)
+		{
+			// Order the vertices by first use (like Indexify would) and drop unused vertices, this needs a pass over the faces
+			const uint32 cUnused = 0xffffffff;
+			vector<uint32> first_use(vertices.size(), cUnused);
+			VertexList used_vertices;
+			auto order = [&vertices, &first_use, &used_vertices, cUnused](const IndexedTriangleList &inTriangles) {
+				for (const IndexedTriangle &t : inTriangles)
+					for (uint32 idx : t.mIdx)
+						if (first_use[idx] == cUnused)
+						{
+							first_use[idx] = (uint32)used_vertices.size();
+							used_vertices.push_back(vertices[idx]);
+						}
+			};
+			reader.ReadTriangles(order);
+
+			// Weld the vertices, the triangles are not needed for this
+			vector<uint32> weld_map;
+			WeldVertices(used_vertices, vertices, weld_map, weld_distance, 0);
+			used_vertices = VertexList();
+
+			vertex_map.swap(first_use);
+			for (uint32 &idx : vertex_map)
+				if (idx != cUnused)
+					idx = weld_map[idx];
 		}
 
-		// Throw away temporary data
-		data.clear();
-
-		// Deindex triangles
-		TriangleList triangles;
-		triangles.reserve(indexed_triangles.size());
-		for (const IndexedTriangle &t : indexed_triangles)
-		{
-			Triangle out_t;
-			for (int v = 0; v < 3; ++v)
-				out_t.mV[v] = vertices[t.mIdx[v]];
-			triangles.push_back(out_t);
-		}
-
-		// Re-index triangles
-		vertices.clear();
-		indexed_triangles.clear();
-		Indexify(triangles, vertices, indexed_triangles);
-
-		// Open output
-		FILE *f = fopen(argv[2], "wb");
-		if (f == nullptr)
-			FatalError("Unable to open output file");
-		
-		// Write out header
-		Model::ModelHeaderV1 header;
-		header.mNumTriangles = (uint32)indexed_triangles.size();
-		header.mNumVertices = (uint32)vertices.size();
-		fwrite(&header, sizeof(header), 1, f);
-
-		// Write vertices
-		fwrite(&vertices[0], sizeof(Float3) * vertices.size(), 1, f);
-
-		// Write indices without material
-		for (uint32 t = 0; t < header.mNumTriangles; ++t)
-			fwrite(&indexed_triangles[t], sizeof(IndexedTriangleNoMaterial), 1, f);
-		
-		// Close file
-		fclose(f);
+		// Write the vertices and then the triangles as they are parsed, in a single chunk
+		ModelWriter writer;
+		writer.Open(output_file);
+		writer.AddChunk(vertices.data(), (uint)vertices.size(), nullptr, 0);
+		vertices = VertexList();
+		IndexedTriangleList valid_triangles;
+		auto write = [&writer, &vertex_map, &valid_triangles](const IndexedTriangleList &inTriangles) {
+			valid_triangles.clear();
+			for (const IndexedTriangle &t : inTriangles)
+			{
+				IndexedTriangle mapped = t;
+				if (!vertex_map.empty())
+					for (uint32 &idx : mapped.mIdx)
+						idx = vertex_map[idx];
+				if (!mapped.IsDegenerate())
+					valid_triangles.push_back(mapped);
+			}
+			writer.AddTriangles(valid_triangles.data(), (uint)valid_triangles.size());
+		};
+		reader.ReadTriangles(write);
+		writer.Close();
 
 		return 0;
 	}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <NodeCodec/NodeCodecQuadTreeHalfFloat.h>
+#include <Geometry/AABox.h>
+#include <Geometry/OrientedBox.h>
+#include <Geometry/BoxOverlap.h>
+
+// A triangle that overlaps with a box
+struct OverlapTriangle
+{
+	uint32							mTriangleBlockID;					// Triangle block that contains the triangle (see NodeCodec::DecodingContext::sGetTriangleBlockStart)
+	uint32							mTriangleIndex;						// Index of the triangle in the block
+	Float3							mTriangle[3];						// Vertices of the triangle
+};
+
+// Collect the triangles of a quad tree with half float bounds that overlap with an axis aligned or oriented box.
+//
+// The tree is walked with NodeCodecQuadTreeHalfFloat::DecodingContext::sWalkTree, the bounds of 4 children are tested against the box at a time.
+// Triangles are decoded 4 at a time with TriangleCodec::DecodingContext::DecodeTriangles4 and filtered with an exact triangle vs box test.
+template <class TriangleCodec, int Alignment>
+class BoxOverlapQuadTree
+{
+public:
+	using NodeCodec = NodeCodecQuadTreeHalfFloat<Alignment>;
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// Collect the triangles that overlap with inBox, returns the number of overlapping triangles.
+	// Only the first inMaxTriangles triangles are stored in outTriangles, if the return value is bigger than inMaxTriangles the caller can try again with a bigger buffer.
+	static uint						sCollideAABox(const Buffer &inBuffer, const AABox &inBox, OverlapTriangle *outTriangles, uint inMaxTriangles)
+	{
+		AABoxTest box_test(inBox);
+		return sCollide(inBuffer, box_test, outTriangles, inMaxTriangles);
+	}
+
+	// Collect the triangles that overlap with inBox, see sCollideAABox
+	static uint						sCollideOrientedBox(const Buffer &inBuffer, const OrientedBox &inBox, OverlapTriangle *outTriangles, uint inMaxTriangles)
+	{
+		OrientedBoxTest box_test(inBox);
+		return sCollide(inBuffer, box_test, outTriangles, inMaxTriangles);
+	}
+
+private:
+	// Tests for an axis aligned box
+	class AABoxTest
+	{
+	public:
+		explicit					AABoxTest(const AABox &inBox) :
+			mMin(inBox.mMin),
+			mMax(inBox.mMax),
+			mCenter(0.5f * (inBox.mMin + inBox.mMax)),
+			mHalfExtent(0.5f * (inBox.mMax - inBox.mMin))
+		{
+		}
+
+		// Test against the bounds of 4 children
+		f_inline UVec4				OverlapsBounds(const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ) const
+		{
+			return AABoxAABox4(mMin, mMax, inBoundsMinX, inBoundsMinY, inBoundsMinZ, inBoundsMaxX, inBoundsMaxY, inBoundsMaxZ);
+		}
+
+		// Test against 4 triangles
+		f_inline UVec4				OverlapsTriangles(const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z) const
+		{
+			Vec4 center_x = mCenter.SplatX(), center_y = mCenter.SplatY(), center_z = mCenter.SplatZ();
+			return AABoxTriangle4(mHalfExtent, inV0X - center_x, inV0Y - center_y, inV0Z - center_z, inV1X - center_x, inV1Y - center_y, inV1Z - center_z, inV2X - center_x, inV2Y - center_y, inV2Z - center_z);
+		}
+
+	private:
+		Vec3						mMin;
+		Vec3						mMax;
+		Vec3						mCenter;
+		Vec3						mHalfExtent;
+	};
+
+	// Tests for an oriented box, the triangles are transformed into the space of the box
+	class OrientedBoxTest
+	{
+	public:
+		explicit					OrientedBoxTest(const OrientedBox &inBox) :
+			mBounds(inBox.GetBounds()),
+			mInvOrientation(inBox.mOrientation.InversedRotationTranslation()),
+			mHalfExtent(inBox.mHalfExtent)
+		{
+		}
+
+		// Test against the bounds of 4 children, first along the world axis and then along the axis of the box
+		f_inline UVec4				OverlapsBounds(const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ) const
+		{
+			return UVec4::sAnd(AABoxAABox4(mBounds.mMin, mBounds.mMax, inBoundsMinX, inBoundsMinY, inBoundsMinZ, inBoundsMaxX, inBoundsMaxY, inBoundsMaxZ),
+				OrientedBoxAABox4(mInvOrientation, mHalfExtent, inBoundsMinX, inBoundsMinY, inBoundsMinZ, inBoundsMaxX, inBoundsMaxY, inBoundsMaxZ));
+		}
+
+		// Test against 4 triangles
+		f_inline UVec4				OverlapsTriangles(const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z) const
+		{
+			Vec4 v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z;
+			Transform(inV0X, inV0Y, inV0Z, v0x, v0y, v0z);
+			Transform(inV1X, inV1Y, inV1Z, v1x, v1y, v1z);
+			Transform(inV2X, inV2Y, inV2Z, v2x, v2y, v2z);
+			return AABoxTriangle4(mHalfExtent, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z);
+		}
+
+	private:
+		// Transform 4 points from world space to the space of the box
+		f_inline void				Transform(const Vec4 &inX, const Vec4 &inY, const Vec4 &inZ, Vec4 &outX, Vec4 &outY, Vec4 &outZ) const
+		{
+			const Mat44 &m = mInvOrientation;
+			outX = Vec4::sReplicate(m(0, 0)) * inX + Vec4::sReplicate(m(0, 1)) * inY + Vec4::sReplicate(m(0, 2)) * inZ + Vec4::sReplicate(m(0, 3));
+			outY = Vec4::sReplicate(m(1, 0)) * inX + Vec4::sReplicate(m(1, 1)) * inY + Vec4::sReplicate(m(1, 2)) * inZ + Vec4::sReplicate(m(1, 3));
+			outZ = Vec4::sReplicate(m(2, 0)) * inX + Vec4::sReplicate(m(2, 1)) * inY + Vec4::sReplicate(m(2, 2)) * inZ + Vec4::sReplicate(m(2, 3));
+		}
+
+		AABox						mBounds;
+		Mat44						mInvOrientation;
+		Vec3						mHalfExtent;
+	};
+
+	// Visitor for sWalkTree
+	template <class BoxTest>
+	class Visitor
+	{
+	public:
+									Visitor(const BoxTest &inBoxTest, OverlapTriangle *outTriangles, uint inMaxTriangles) :
+			mBoxTest(inBoxTest),
+			mTriangles(outTriangles),
+			mMaxTriangles(inMaxTriangles)
+		{
+		}
+
+		// Test the bounds of 4 children, returns the number of children to visit
+		f_inline int				VisitNodes(const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ, UVec4 &ioProperties, int inStackTop) const
+		{
+			UVec4 overlap = mBoxTest.OverlapsBounds(inBoundsMinX, inBoundsMinY, inBoundsMinZ, inBoundsMaxX, inBoundsMaxY, inBoundsMaxZ);
+
+			// Move the overlapping children to the front, they are pushed onto the stack
+			UVec4::sSort4True(overlap, ioProperties);
+			return overlap.CountTrues();
+		}
+
+		// All nodes on the stack need to be visited
+		f_inline bool				ShouldVisitNode(int inStackTop) const
+		{
+			return true;
+		}
+
+		// Test the triangles of a leaf and store the overlapping triangles
+		template <class TriangleContext>
+		f_inline void				VisitTriangles(const TriangleContext &inTriangleContext, const Vec3 &inRootBoundsMin, const Vec3 &inRootBoundsMax, const void *inTriangles, uint32 inNumTriangles, uint32 inTriangleBlockID)
+		{
+			inTriangleContext.DecodeTriangles4(inRootBoundsMin, inRootBoundsMax, inTriangles, inNumTriangles, [this, inNumTriangles, inTriangleBlockID](uint inTriangleIndex, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				// Ignore padding triangles
+				UVec4 overlap = mBoxTest.OverlapsTriangles(inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+				overlap = UVec4::sAnd(overlap, Vec4::sLess(Vec4(0, 1, 2, 3), Vec4::sReplicate(float(inNumTriangles - inTriangleIndex))));
+				int mask = overlap.GetTrues();
+				if (mask == 0)
+					return;
+
+				// Store the overlapping triangles
+				Float4 vertices[9];
+				inV0X.StoreFloat4(&vertices[0]); inV0Y.StoreFloat4(&vertices[1]); inV0Z.StoreFloat4(&vertices[2]);
+				inV1X.StoreFloat4(&vertices[3]); inV1Y.StoreFloat4(&vertices[4]); inV1Z.StoreFloat4(&vertices[5]);
+				inV2X.StoreFloat4(&vertices[6]); inV2Y.StoreFloat4(&vertices[7]); inV2Z.StoreFloat4(&vertices[8]);
+				do
+				{
+					uint lane = CountTrailingZeros((uint32)mask);
+					mask &= mask - 1;
+					if (mNumTriangles < mMaxTriangles)
+					{
+						OverlapTriangle &triangle = mTriangles[mNumTriangles];
+						triangle.mTriangleBlockID = inTriangleBlockID;
+						triangle.mTriangleIndex = inTriangleIndex + lane;
+						for (int v = 0; v < 3; ++v)
+							triangle.mTriangle[v] = Float3(vertices[3 * v][lane], vertices[3 * v + 1][lane], vertices[3 * v + 2][lane]);
+					}
+					++mNumTriangles;
+				}
+				while (mask != 0);
+			});
+		}
+
+		uint						mNumTriangles = 0;
+
+	private:
+		const BoxTest &				mBoxTest;
+		OverlapTriangle *			mTriangles;
+		uint						mMaxTriangles;
+	};
+
+	// Walk the tree with a box test
+	template <class BoxTest>
+	static uint						sCollide(const Buffer &inBuffer, const BoxTest &inBoxTest, OverlapTriangle *outTriangles, uint inMaxTriangles)
+	{
+		const typename TriangleCodec::DecodingContext ctx(inBuffer.GetTriangleHeader(), &inBuffer.GetBuffer()[0]);
+
+		Visitor<BoxTest> visitor(inBoxTest, outTriangles, inMaxTriangles);
+		NodeCodec::DecodingContext::sWalkTree(inBuffer.GetNodeHeader(), &inBuffer.GetBuffer()[0], ctx, visitor);
+		return visitor.mNumTriangles;
+	}
+};
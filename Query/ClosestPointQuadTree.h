@@ -0,0 +1,127 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <Geometry/ClosestPoint.h>
+
+// Result of a closest point query
+struct ClosestPointResult
+{
+	Float3							mPoint;								// Closest point on the mesh
+	float							mDistance;							// Distance from the query point to mPoint, FLT_MAX if there is no triangle within the maximum distance
+	uint32							mTriangleBlockID;					// Triangle block that contains the closest triangle (see NodeCodec::DecodingContext::sGetTriangleBlockStart)
+	uint32							mTriangleIndex;						// Index of the closest triangle in the block
+	Float3							mTriangle[3];						// Vertices of the closest triangle
+};
+
+// Find the closest point on the mesh for a batch of points in a quad tree (NodeCodecQuadTree or NodeCodecQuadTreeHalfFloat).
+//
+// Branch and bound: the tree is walked with NodeCodec::DecodingContext::sWalkTree, children are visited closest box first and
+// children (and nodes on the stack) that are further away than the closest triangle found so far are skipped.
+// Triangles are decoded 4 at a time with TriangleCodec::DecodingContext::DecodeTriangles4.
+template <class TriangleCodec, class NodeCodec>
+class ClosestPointQuadTree
+{
+public:
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// Find the closest point on the mesh for every point in [inPointsBegin, inPointsEnd), triangles further away than inMaxDistance are ignored
+	static void						sFindClosestPoints(const Buffer &inBuffer, const Float3 *inPointsBegin, const Float3 *inPointsEnd, ClosestPointResult *outResults, float inMaxDistance = FLT_MAX)
+	{
+		const typename TriangleCodec::DecodingContext ctx(inBuffer.GetTriangleHeader(), &inBuffer.GetBuffer()[0]);
+
+		// Squared distances are compared, FLT_MAX is the largest value that can be used since padding lanes use FLT_MAX
+		float max_dist_sq = inMaxDistance < sqrt(FLT_MAX)? Square(inMaxDistance) : FLT_MAX;
+
+		ClosestPointResult *out = outResults;
+		for (const Float3 *point = inPointsBegin; point < inPointsEnd; ++point, ++out)
+		{
+			Visitor visitor(Vec3(*point), max_dist_sq, *out);
+			NodeCodec::DecodingContext::sWalkTree(inBuffer.GetNodeHeader(), &inBuffer.GetBuffer()[0], ctx, visitor);
+			out->mDistance = out->mDistance < FLT_MAX? sqrt(out->mDistance) : FLT_MAX;
+		}
+	}
+
+private:
+	// Visitor for sWalkTree, keeps track of squared distances
+	class Visitor
+	{
+	public:
+									Visitor(const Vec3 &inPoint, float inMaxDistSq, ClosestPointResult &outResult) :
+			mPoint(inPoint),
+			mClosestDistSq(inMaxDistSq),
+			mResult(outResult)
+		{
+			mResult.mDistance = FLT_MAX;
+			mResult.mTriangleBlockID = 0;
+			mResult.mTriangleIndex = 0;
+		}
+
+		// Calculate the distance to the bounds of 4 children, returns the number of children to visit
+		f_inline int				VisitNodes(const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ, UVec4 &ioProperties, int inStackTop)
+		{
+			// Squared distance to the boxes, 0 when the point is inside
+			Vec4 px = mPoint.SplatX(), py = mPoint.SplatY(), pz = mPoint.SplatZ();
+			Vec4 dx = Vec4::sMax(Vec4::sMax(inBoundsMinX - px, px - inBoundsMaxX), Vec4::sZero());
+			Vec4 dy = Vec4::sMax(Vec4::sMax(inBoundsMinY - py, py - inBoundsMaxY), Vec4::sZero());
+			Vec4 dz = Vec4::sMax(Vec4::sMax(inBoundsMinZ - pz, pz - inBoundsMaxZ), Vec4::sZero());
+			Vec4 dist_sq = dx * dx + dy * dy + dz * dz;
+
+			// Sort so that highest values are first (we want to first process closer nodes and we process stack top to bottom)
+			Vec4::sSort4Reverse(dist_sq, ioProperties);
+
+			// Count how many results are closer
+			UVec4 closer = Vec4::sLess(dist_sq, Vec4::sReplicate(mClosestDistSq));
+			int num_results = closer.CountTrues();
+
+			// Shift the results so that only the closer ones remain
+			dist_sq = dist_sq.ReinterpretAsInt().ShiftComponents4Minus(num_results).ReinterpretAsFloat();
+			ioProperties = ioProperties.ShiftComponents4Minus(num_results);
+
+			assert(inStackTop + 4 < NodeCodec::StackSize);
+			dist_sq.StoreFloat4((Float4 *)&mDistanceStack[inStackTop]);
+			return num_results;
+		}
+
+		// Check if a node on the stack could still contain a closer point
+		f_inline bool				ShouldVisitNode(int inStackTop) const
+		{
+			return mDistanceStack[inStackTop] < mClosestDistSq;
+		}
+
+		// Find the closest point on the triangles of a leaf
+		template <class TriangleContext>
+		f_inline void				VisitTriangles(const TriangleContext &inTriangleContext, const Vec3 &inRootBoundsMin, const Vec3 &inRootBoundsMax, const void *inTriangles, uint32 inNumTriangles, uint32 inTriangleBlockID)
+		{
+			inTriangleContext.DecodeTriangles4(inRootBoundsMin, inRootBoundsMax, inTriangles, inNumTriangles, [this, inNumTriangles, inTriangleBlockID](uint inTriangleIndex, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				Vec4 x, y, z;
+				Vec4 dist_sq = ClosestPointOnTriangle4(mPoint, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z, x, y, z);
+
+				// Ignore padding triangles
+				UVec4 padding = Vec4::sGreaterOrEqual(Vec4(0, 1, 2, 3), Vec4::sReplicate(float(inNumTriangles - inTriangleIndex)));
+				dist_sq = Vec4::sSelect(dist_sq, Vec4::sReplicate(FLT_MAX), padding);
+
+				// Check if one of the triangles is closer
+				float closest = dist_sq.ReduceMin();
+				if (closest < mClosestDistSq)
+				{
+					uint lane = CountTrailingZeros((uint32)Vec4::sEquals(dist_sq, Vec4::sReplicate(closest)).GetTrues());
+					mClosestDistSq = closest;
+					mResult.mPoint = Float3(x[lane], y[lane], z[lane]);
+					mResult.mDistance = closest;
+					mResult.mTriangleBlockID = inTriangleBlockID;
+					mResult.mTriangleIndex = inTriangleIndex + lane;
+					mResult.mTriangle[0] = Float3(inV0X[lane], inV0Y[lane], inV0Z[lane]);
+					mResult.mTriangle[1] = Float3(inV1X[lane], inV1Y[lane], inV1Z[lane]);
+					mResult.mTriangle[2] = Float3(inV2X[lane], inV2Y[lane], inV2Z[lane]);
+				}
+			});
+		}
+
+	private:
+		Vec3						mPoint;
+		float						mClosestDistSq;
+		ClosestPointResult &		mResult;
+		float						mDistanceStack[NodeCodec::StackSize];
+	};
+};
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <NodeCodec/NodeCodecQuadTreeHalfFloat.h>
+#include <Geometry/AABox.h>
+#include <Geometry/BoxOverlap.h>
+#include <Geometry/TriangleTriangle.h>
+#include <thread>
+#include <atomic>
+
+// A pair of intersecting triangles of mesh A and mesh B
+struct TrianglePair
+{
+	uint32							mTriangleBlockIDA;					// Triangle block of mesh A that contains the triangle (see NodeCodec::DecodingContext::sGetTriangleBlockStart)
+	uint32							mTriangleIndexA;					// Index of the triangle in the block
+	uint32							mTriangleBlockIDB;					// Same for mesh B
+	uint32							mTriangleIndexB;
+	Float3							mTriangleA[3];						// Vertices of the triangle of A
+	Float3							mTriangleB[3];						// Vertices of the triangle of B in the space of A
+};
+
+// Find the intersecting triangles of two meshes stored in quad trees with half float bounds.
+//
+// Both trees are traversed at the same time, starting with the pair of roots. When both nodes of a pair have children, the 4 children
+// of the node of B are transformed into the space of A and tested against the 4 children of the node of A (4 x 4 box tests, 4 at a time).
+// When one of the nodes is a leaf only the other node is descended. Pairs of leaves are tested triangle against triangle, the triangles of A
+// are decoded 4 at a time with TriangleCodec::DecodingContext::DecodeTriangles4 and tested against one triangle of B at a time.
+//
+// To spread the work over multiple threads, the pairs are first expanded breadth first on the calling thread until there are enough of them.
+// The threads then take pairs from this frontier and traverse them depth first. The results are stored per pair of the frontier and
+// concatenated in order, so the result doesn't depend on the amount of threads.
+template <class TriangleCodec, int Alignment>
+class MeshIntersectQuadTree
+{
+public:
+	using NodeCodec = NodeCodecQuadTreeHalfFloat<Alignment>;
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// Find all pairs of intersecting triangles, inTransformBToA transforms mesh B into the space of mesh A (rotation and translation only).
+	// The work is spread over inNumThreads threads (0 = use all hardware threads).
+	static void						sCollide(const Buffer &inBufferA, const Buffer &inBufferB, const Mat44 &inTransformBToA, vector<TrianglePair> &outPairs, uint inNumThreads = 1)
+	{
+		outPairs.clear();
+
+		const Context context(inBufferA, inBufferB, inTransformBToA);
+
+		// Expand the pairs breadth first until the frontier is big enough or only pairs of leaves remain
+		vector<NodePair> frontier;
+		frontier.push_back(context.GetRootPair());
+		for (;;)
+		{
+			bool expanded = false;
+			vector<NodePair> next;
+			for (const NodePair &pair : frontier)
+				if (pair.IsLeafPair())
+					next.push_back(pair);
+				else
+				{
+					context.ExpandPair(pair, next);
+					expanded = true;
+				}
+			frontier.swap(next);
+			if (!expanded || frontier.size() >= cFrontierSize)
+				break;
+		}
+
+		// Traverse the pairs of the frontier
+		vector<vector<TrianglePair>> results(frontier.size());
+		atomic<uint> next_pair(0);
+		auto traverse = [&context, &frontier, &results, &next_pair]()
+		{
+			vector<NodePair> stack;
+			for (uint p = next_pair++; p < frontier.size(); p = next_pair++)
+				context.Traverse(frontier[p], stack, results[p]);
+		};
+		uint num_threads = inNumThreads > 0? inNumThreads : max(1u, thread::hardware_concurrency());
+		num_threads = min(num_threads, uint(frontier.size()));
+		if (num_threads <= 1)
+			traverse();
+		else
+		{
+			vector<thread> threads;
+			for (uint t = 1; t < num_threads; ++t)
+				threads.emplace_back(traverse);
+			traverse();
+			for (thread &t : threads)
+				t.join();
+		}
+
+		// Concatenate the results in the order of the frontier
+		size_t num_pairs = 0;
+		for (const vector<TrianglePair> &r : results)
+			num_pairs += r.size();
+		outPairs.reserve(num_pairs);
+		for (const vector<TrianglePair> &r : results)
+			outPairs.insert(outPairs.end(), r.begin(), r.end());
+	}
+
+private:
+	// Amount of pairs to expand to before starting the threads
+	static constexpr size_t			cFrontierSize = 1024;
+
+	// A pair of nodes that have overlapping bounds, a node can be a leaf (the properties contain a triangle count)
+	struct NodePair
+	{
+		// Check if both nodes are leaves
+		bool						IsLeafPair() const
+		{
+			return (mPropertiesA >> NodeCodec::TRIANGLE_COUNT_SHIFT) != 0 && (mPropertiesB >> NodeCodec::TRIANGLE_COUNT_SHIFT) != 0;
+		}
+
+		AABox						mBoundsA;							// Bounds of the node of A
+		AABox						mBoundsB;							// Bounds of the node of B in the space of A
+		uint32						mPropertiesA;						// Node properties of the node of A
+		uint32						mPropertiesB;						// Node properties of the node of B
+	};
+
+	// Everything needed to traverse the trees, shared between threads
+	class Context
+	{
+	public:
+									Context(const Buffer &inBufferA, const Buffer &inBufferB, const Mat44 &inTransformBToA) :
+			mBufferStartA(&inBufferA.GetBuffer()[0]),
+			mBufferStartB(&inBufferB.GetBuffer()[0]),
+			mNodeHeaderA(inBufferA.GetNodeHeader()),
+			mNodeHeaderB(inBufferB.GetNodeHeader()),
+			mTriangleContextA(inBufferA.GetTriangleHeader(), mBufferStartA),
+			mTriangleContextB(inBufferB.GetTriangleHeader(), mBufferStartB),
+			mRootBoundsMinA(Vec3::sLoadFloat3Unsafe(mNodeHeaderA->mRootBoundsMin)),
+			mRootBoundsMaxA(Vec3::sLoadFloat3Unsafe(mNodeHeaderA->mRootBoundsMax)),
+			mRootBoundsMinB(Vec3::sLoadFloat3Unsafe(mNodeHeaderB->mRootBoundsMin)),
+			mRootBoundsMaxB(Vec3::sLoadFloat3Unsafe(mNodeHeaderB->mRootBoundsMax)),
+			mTransformBToA(inTransformBToA)
+		{
+			for (int r = 0; r < 3; ++r)
+				for (int c = 0; c < 4; ++c)
+					mTransformRows[r][c] = Vec4::sReplicate(inTransformBToA(r, c));
+		}
+
+		// Get the pair of root nodes
+		NodePair					GetRootPair() const
+		{
+			NodePair pair;
+			pair.mBoundsA = AABox(mRootBoundsMinA, mRootBoundsMaxA);
+			pair.mPropertiesA = mNodeHeaderA->mRootProperties;
+			pair.mPropertiesB = mNodeHeaderB->mRootProperties;
+
+			// Transform the root bounds of B
+			Vec4 min_x = mRootBoundsMinB.SplatX(), min_y = mRootBoundsMinB.SplatY(), min_z = mRootBoundsMinB.SplatZ();
+			Vec4 max_x = mRootBoundsMaxB.SplatX(), max_y = mRootBoundsMaxB.SplatY(), max_z = mRootBoundsMaxB.SplatZ();
+			TransformBounds(min_x, min_y, min_z, max_x, max_y, max_z);
+			pair.mBoundsB = AABox(Vec3(min_x.GetX(), min_y.GetX(), min_z.GetX()), Vec3(max_x.GetX(), max_y.GetX(), max_z.GetX()));
+			return pair;
+		}
+
+		// Descend one or both nodes of a pair that is not a pair of leaves and add the overlapping child pairs to ioPairs
+		void						ExpandPair(const NodePair &inPair, vector<NodePair> &ioPairs) const
+		{
+			bool leaf_a = (inPair.mPropertiesA >> NodeCodec::TRIANGLE_COUNT_SHIFT) != 0;
+			bool leaf_b = (inPair.mPropertiesB >> NodeCodec::TRIANGLE_COUNT_SHIFT) != 0;
+			assert(!leaf_a || !leaf_b);
+
+			// Decode the children of A
+			Vec4 a_min_x, a_min_y, a_min_z, a_max_x, a_max_y, a_max_z;
+			UVec4 a_properties, a_valid;
+			if (!leaf_a)
+			{
+				NodeCodec::DecodingContext::sDecodeNode(mBufferStartA, inPair.mPropertiesA, a_min_x, a_min_y, a_min_z, a_max_x, a_max_y, a_max_z, a_properties);
+				a_valid = sIsNotPadding(a_properties);
+			}
+
+			// Decode the children of B and transform their bounds into the space of A
+			Vec4 b_min_x, b_min_y, b_min_z, b_max_x, b_max_y, b_max_z;
+			UVec4 b_properties, b_valid;
+			if (!leaf_b)
+			{
+				NodeCodec::DecodingContext::sDecodeNode(mBufferStartB, inPair.mPropertiesB, b_min_x, b_min_y, b_min_z, b_max_x, b_max_y, b_max_z, b_properties);
+				b_valid = sIsNotPadding(b_properties);
+				TransformBounds(b_min_x, b_min_y, b_min_z, b_max_x, b_max_y, b_max_z);
+			}
+
+			if (leaf_a)
+			{
+				// Test the leaf of A against the children of B
+				UVec4 overlap = UVec4::sAnd(b_valid, AABoxAABox4(inPair.mBoundsA.mMin, inPair.mBoundsA.mMax, b_min_x, b_min_y, b_min_z, b_max_x, b_max_y, b_max_z));
+				AddPairs(inPair.mBoundsA, inPair.mPropertiesA, overlap.GetTrues(), b_min_x, b_min_y, b_min_z, b_max_x, b_max_y, b_max_z, b_properties, false, ioPairs);
+			}
+			else if (leaf_b)
+			{
+				// Test the leaf of B against the children of A
+				UVec4 overlap = UVec4::sAnd(a_valid, AABoxAABox4(inPair.mBoundsB.mMin, inPair.mBoundsB.mMax, a_min_x, a_min_y, a_min_z, a_max_x, a_max_y, a_max_z));
+				AddPairs(inPair.mBoundsB, inPair.mPropertiesB, overlap.GetTrues(), a_min_x, a_min_y, a_min_z, a_max_x, a_max_y, a_max_z, a_properties, true, ioPairs);
+			}
+			else
+			{
+				// Test every child of A against the 4 children of B
+				Float4 min_x, min_y, min_z, max_x, max_y, max_z;
+				a_min_x.StoreFloat4(&min_x); a_min_y.StoreFloat4(&min_y); a_min_z.StoreFloat4(&min_z);
+				a_max_x.StoreFloat4(&max_x); a_max_y.StoreFloat4(&max_y); a_max_z.StoreFloat4(&max_z);
+				uint32 properties[4];
+				a_properties.StoreInt4(properties);
+				int valid = a_valid.GetTrues();
+				for (int a = 0; a < 4; ++a)
+					if (valid & (1 << a))
+					{
+						AABox bounds(Vec3(min_x[a], min_y[a], min_z[a]), Vec3(max_x[a], max_y[a], max_z[a]));
+						UVec4 overlap = UVec4::sAnd(b_valid, AABoxAABox4(bounds.mMin, bounds.mMax, b_min_x, b_min_y, b_min_z, b_max_x, b_max_y, b_max_z));
+						AddPairs(bounds, properties[a], overlap.GetTrues(), b_min_x, b_min_y, b_min_z, b_max_x, b_max_y, b_max_z, b_properties, false, ioPairs);
+					}
+			}
+		}
+
+		// Traverse a pair depth first and add the intersecting triangles to ioResults, ioStack is used as scratch space
+		void						Traverse(const NodePair &inPair, vector<NodePair> &ioStack, vector<TrianglePair> &ioResults) const
+		{
+			ioStack.clear();
+			ioStack.push_back(inPair);
+			do
+			{
+				NodePair pair = ioStack.back();
+				ioStack.pop_back();
+				if (pair.IsLeafPair())
+					CollideLeaves(pair, ioResults);
+				else
+					ExpandPair(pair, ioStack);
+			}
+			while (!ioStack.empty());
+		}
+
+	private:
+		// Padding children have properties with all triangle count bits set
+		static f_inline UVec4		sIsNotPadding(const UVec4 &inProperties)
+		{
+			return UVec4::sNot(UVec4::sEquals(inProperties, UVec4::sReplicate(uint32(NodeCodec::TRIANGLE_COUNT_MASK) << NodeCodec::TRIANGLE_COUNT_SHIFT)));
+		}
+
+		// Transform 4 bounding boxes from the space of B to the space of A, the result encloses the transformed boxes
+		f_inline void				TransformBounds(Vec4 &ioMinX, Vec4 &ioMinY, Vec4 &ioMinZ, Vec4 &ioMaxX, Vec4 &ioMaxY, Vec4 &ioMaxZ) const
+		{
+			Vec4 half = Vec4::sReplicate(0.5f);
+			Vec4 center[3] = { half * (ioMinX + ioMaxX), half * (ioMinY + ioMaxY), half * (ioMinZ + ioMaxZ) };
+			Vec4 extent[3] = { half * (ioMaxX - ioMinX), half * (ioMaxY - ioMinY), half * (ioMaxZ - ioMinZ) };
+
+			Vec4 new_center[3], new_extent[3];
+			for (int r = 0; r < 3; ++r)
+			{
+				const Vec4 *row = mTransformRows[r];
+				new_center[r] = row[0] * center[0] + row[1] * center[1] + row[2] * center[2] + row[3];
+				new_extent[r] = row[0].Abs() * extent[0] + row[1].Abs() * extent[1] + row[2].Abs() * extent[2];
+			}
+
+			ioMinX = new_center[0] - new_extent[0]; ioMaxX = new_center[0] + new_extent[0];
+			ioMinY = new_center[1] - new_extent[1]; ioMaxY = new_center[1] + new_extent[1];
+			ioMinZ = new_center[2] - new_extent[2]; ioMaxZ = new_center[2] + new_extent[2];
+		}
+
+		// Add a pair for every child in inChildMask, the other node of the pair is the same for all pairs
+		f_inline void				AddPairs(const AABox &inBounds, uint32 inProperties, int inChildMask, const Vec4 &inMinX, const Vec4 &inMinY, const Vec4 &inMinZ, const Vec4 &inMaxX, const Vec4 &inMaxY, const Vec4 &inMaxZ, const UVec4 &inChildProperties, bool inChildrenAreA, vector<NodePair> &ioPairs) const
+		{
+			if (inChildMask == 0)
+				return;
+
+			Float4 min_x, min_y, min_z, max_x, max_y, max_z;
+			inMinX.StoreFloat4(&min_x); inMinY.StoreFloat4(&min_y); inMinZ.StoreFloat4(&min_z);
+			inMaxX.StoreFloat4(&max_x); inMaxY.StoreFloat4(&max_y); inMaxZ.StoreFloat4(&max_z);
+			uint32 properties[4];
+			inChildProperties.StoreInt4(properties);
+
+			do
+			{
+				uint child = CountTrailingZeros((uint32)inChildMask);
+				inChildMask &= inChildMask - 1;
+
+				NodePair &pair = ioPairs.emplace_back();
+				AABox child_bounds(Vec3(min_x[child], min_y[child], min_z[child]), Vec3(max_x[child], max_y[child], max_z[child]));
+				if (inChildrenAreA)
+				{
+					pair.mBoundsA = child_bounds;
+					pair.mPropertiesA = properties[child];
+					pair.mBoundsB = inBounds;
+					pair.mPropertiesB = inProperties;
+				}
+				else
+				{
+					pair.mBoundsA = inBounds;
+					pair.mPropertiesA = inProperties;
+					pair.mBoundsB = child_bounds;
+					pair.mPropertiesB = properties[child];
+				}
+			}
+			while (inChildMask != 0);
+		}
+
+		// Test the triangles of two leaves against each other
+		void						CollideLeaves(const NodePair &inPair, vector<TrianglePair> &ioResults) const
+		{
+			uint32 block_id_a = inPair.mPropertiesA & NodeCodec::OFFSET_MASK;
+			uint32 num_triangles_a = inPair.mPropertiesA >> NodeCodec::TRIANGLE_COUNT_SHIFT;
+			uint32 block_id_b = inPair.mPropertiesB & NodeCodec::OFFSET_MASK;
+			uint32 num_triangles_b = inPair.mPropertiesB >> NodeCodec::TRIANGLE_COUNT_SHIFT;
+
+			// Decode the triangles of B, transform them into the space of A and keep the ones that overlap with the bounds of A
+			Vec3 triangles_b[NodeCodec::TRIANGLE_COUNT_MASK][3];
+			uint32 indices_b[NodeCodec::TRIANGLE_COUNT_MASK];
+			uint num_b = 0;
+			mTriangleContextB.DecodeTriangles4(mRootBoundsMinB, mRootBoundsMaxB, NodeCodec::DecodingContext::sGetTriangleBlockStart(mBufferStartB, block_id_b), num_triangles_b, [this, &inPair, num_triangles_b, &triangles_b, &indices_b, &num_b](uint inTriangleIndex, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				Float4 vertices[9];
+				inV0X.StoreFloat4(&vertices[0]); inV0Y.StoreFloat4(&vertices[1]); inV0Z.StoreFloat4(&vertices[2]);
+				inV1X.StoreFloat4(&vertices[3]); inV1Y.StoreFloat4(&vertices[4]); inV1Z.StoreFloat4(&vertices[5]);
+				inV2X.StoreFloat4(&vertices[6]); inV2Y.StoreFloat4(&vertices[7]); inV2Z.StoreFloat4(&vertices[8]);
+
+				uint num_lanes = min(4u, num_triangles_b - inTriangleIndex);
+				for (uint lane = 0; lane < num_lanes; ++lane)
+				{
+					Vec3 *triangle = triangles_b[num_b];
+					for (int v = 0; v < 3; ++v)
+						triangle[v] = mTransformBToA * Vec3(vertices[3 * v][lane], vertices[3 * v + 1][lane], vertices[3 * v + 2][lane]);
+
+					Vec3 triangle_min = Vec3::sMin(Vec3::sMin(triangle[0], triangle[1]), triangle[2]);
+					Vec3 triangle_max = Vec3::sMax(Vec3::sMax(triangle[0], triangle[1]), triangle[2]);
+					if (inPair.mBoundsA.Overlaps(AABox(triangle_min, triangle_max)))
+						indices_b[num_b++] = inTriangleIndex + lane;
+				}
+			});
+			if (num_b == 0)
+				return;
+
+			// Test the triangles of A, 4 at a time, against the triangles of B
+			mTriangleContextA.DecodeTriangles4(mRootBoundsMinA, mRootBoundsMaxA, NodeCodec::DecodingContext::sGetTriangleBlockStart(mBufferStartA, block_id_a), num_triangles_a, [block_id_a, num_triangles_a, block_id_b, &triangles_b, &indices_b, num_b, &ioResults](uint inTriangleIndex, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				// Bounds of the triangles of A
+				Vec4 min_x = Vec4::sMin(Vec4::sMin(inV0X, inV1X), inV2X), max_x = Vec4::sMax(Vec4::sMax(inV0X, inV1X), inV2X);
+				Vec4 min_y = Vec4::sMin(Vec4::sMin(inV0Y, inV1Y), inV2Y), max_y = Vec4::sMax(Vec4::sMax(inV0Y, inV1Y), inV2Y);
+				Vec4 min_z = Vec4::sMin(Vec4::sMin(inV0Z, inV1Z), inV2Z), max_z = Vec4::sMax(Vec4::sMax(inV0Z, inV1Z), inV2Z);
+
+				// Ignore padding triangles
+				UVec4 valid = Vec4::sLess(Vec4(0, 1, 2, 3), Vec4::sReplicate(float(num_triangles_a - inTriangleIndex)));
+
+				for (uint b = 0; b < num_b; ++b)
+				{
+					const Vec3 *triangle = triangles_b[b];
+
+					// Test the bounds first, the triangle test is a lot more expensive
+					Vec3 triangle_min = Vec3::sMin(Vec3::sMin(triangle[0], triangle[1]), triangle[2]);
+					Vec3 triangle_max = Vec3::sMax(Vec3::sMax(triangle[0], triangle[1]), triangle[2]);
+					UVec4 overlap = UVec4::sAnd(valid, AABoxAABox4(triangle_min, triangle_max, min_x, min_y, min_z, max_x, max_y, max_z));
+					if (!overlap.TestAnyTrue())
+						continue;
+
+					overlap = UVec4::sAnd(overlap, TriangleTriangle4(triangle[0], triangle[1], triangle[2], inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z));
+					int mask = overlap.GetTrues();
+					if (mask == 0)
+						continue;
+
+					// Store the intersecting pairs
+					Float4 vertices[9];
+					inV0X.StoreFloat4(&vertices[0]); inV0Y.StoreFloat4(&vertices[1]); inV0Z.StoreFloat4(&vertices[2]);
+					inV1X.StoreFloat4(&vertices[3]); inV1Y.StoreFloat4(&vertices[4]); inV1Z.StoreFloat4(&vertices[5]);
+					inV2X.StoreFloat4(&vertices[6]); inV2Y.StoreFloat4(&vertices[7]); inV2Z.StoreFloat4(&vertices[8]);
+					do
+					{
+						uint lane = CountTrailingZeros((uint32)mask);
+						mask &= mask - 1;
+						TrianglePair &result = ioResults.emplace_back();
+						result.mTriangleBlockIDA = block_id_a;
+						result.mTriangleIndexA = inTriangleIndex + lane;
+						result.mTriangleBlockIDB = block_id_b;
+						result.mTriangleIndexB = indices_b[b];
+						for (int v = 0; v < 3; ++v)
+						{
+							result.mTriangleA[v] = Float3(vertices[3 * v][lane], vertices[3 * v + 1][lane], vertices[3 * v + 2][lane]);
+							triangle[v].StoreFloat3(&result.mTriangleB[v]);
+						}
+					}
+					while (mask != 0);
+				}
+			});
+		}
+
+		const uint8 *				mBufferStartA;
+		const uint8 *				mBufferStartB;
+		const typename NodeCodec::Header *mNodeHeaderA;
+		const typename NodeCodec::Header *mNodeHeaderB;
+		const typename TriangleCodec::DecodingContext mTriangleContextA;
+		const typename TriangleCodec::DecodingContext mTriangleContextB;
+		Vec3						mRootBoundsMinA;
+		Vec3						mRootBoundsMaxA;
+		Vec3						mRootBoundsMinB;
+		Vec3						mRootBoundsMaxB;
+		Mat44						mTransformBToA;
+		Vec4						mTransformRows[3][4];				// Elements of the first 3 rows of mTransformBToA, replicated
+	};
+};
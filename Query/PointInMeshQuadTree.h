@@ -0,0 +1,131 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <Geometry/RayAABox.h>
+#include <Geometry/RayTriangle.h>
+
+// Test if points are inside a closed mesh stored in a quad tree (NodeCodecQuadTree or NodeCodecQuadTreeHalfFloat).
+//
+// A ray is cast from every point and all hits along the ray are counted, the point is inside when the number of hits is odd.
+// Points are processed 4 at a time: the 4 rays share one traversal of the tree (NodeCodec::DecodingContext::sWalkTree), a child is
+// visited when any of the rays hits it and the rays that hit it are stored with it on the stack. Points that are close together
+// visit mostly the same nodes, so the points should be ordered spatially (e.g. the order of a voxel grid).
+// Triangles are decoded 4 at a time with TriangleCodec::DecodingContext::DecodeTriangles4.
+//
+// All rays use the same direction, it is chosen to not be aligned with the axis or diagonals so that rays rarely hit an edge or a vertex
+// exactly (which can be counted twice or not at all). Points that are on the surface can be reported as inside or outside.
+template <class TriangleCodec, class NodeCodec>
+class PointInMeshQuadTree
+{
+public:
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// Test the points in [inPointsBegin, inPointsEnd), outInside receives true for the points that are inside the mesh
+	static void						sTestPoints(const Buffer &inBuffer, const Float3 *inPointsBegin, const Float3 *inPointsEnd, bool *outInside)
+	{
+		const typename TriangleCodec::DecodingContext ctx(inBuffer.GetTriangleHeader(), &inBuffer.GetBuffer()[0]);
+
+		bool *out = outInside;
+		for (const Float3 *point = inPointsBegin; point < inPointsEnd; point += 4, out += 4)
+		{
+			// Take the next 4 points, the last group can have less
+			uint num_points = uint(min<ptrdiff_t>(inPointsEnd - point, 4));
+			Visitor visitor(point, num_points);
+			NodeCodec::DecodingContext::sWalkTree(inBuffer.GetNodeHeader(), &inBuffer.GetBuffer()[0], ctx, visitor);
+
+			for (uint p = 0; p < num_points; ++p)
+				out[p] = (visitor.mNumHits[p] & 1) != 0;
+		}
+	}
+
+	// Direction of the rays
+	static Vec3						sGetRayDirection()
+	{
+		return Vec3(0.3421f, 0.8467f, 0.4075f).Normalized();
+	}
+
+private:
+	// Visitor for sWalkTree that counts all hits of 4 rays
+	class Visitor
+	{
+	public:
+									Visitor(const Float3 *inPoints, uint inNumPoints) :
+			mDirection(sGetRayDirection()),
+			mInvDirection(mDirection.Reciprocal()),
+			mIsParallel(RayIsParallel(mDirection))
+		{
+			for (uint p = 0; p < 4; ++p)
+			{
+				mOrigins[p] = Vec3(inPoints[min(p, inNumPoints - 1)]);
+				mNumHits[p] = 0;
+			}
+
+			// The root is visited by all rays
+			mRayMaskStack[0] = (1 << inNumPoints) - 1;
+			mRayMask = mRayMaskStack[0];
+		}
+
+		// Test the rays of the current node against the bounds of 4 children, returns the number of children that are hit by any ray
+		f_inline int				VisitNodes(const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ, UVec4 &ioProperties, int inStackTop)
+		{
+			// Determine for every child which rays hit it
+			UVec4 child_masks = UVec4::sZero();
+			for (uint r = 0; r < 4; ++r)
+				if (mRayMask & (1 << r))
+				{
+					Vec4 distance = RayAABox4(mOrigins[r], mInvDirection, mIsParallel, inBoundsMinX, inBoundsMinY, inBoundsMinZ, inBoundsMaxX, inBoundsMaxY, inBoundsMaxZ);
+					child_masks = UVec4::sOr(child_masks, UVec4::sAnd(Vec4::sLess(distance, Vec4::sReplicate(FLT_MAX)), UVec4::sReplicate(1 << r)));
+				}
+
+			// Move the children that are hit to the front and store the rays that hit them
+			uint32 masks[4], properties[4];
+			child_masks.StoreInt4(masks);
+			ioProperties.StoreInt4(properties);
+			int num_results = 0;
+			for (int c = 0; c < 4; ++c)
+				if (masks[c] != 0)
+				{
+					properties[num_results] = properties[c];
+					mRayMaskStack[inStackTop + num_results] = masks[c];
+					++num_results;
+				}
+			ioProperties = UVec4::sLoadInt4(properties);
+			return num_results;
+		}
+
+		// All nodes on the stack are visited, this is the node that will be visited next so take the rays that hit it
+		f_inline bool				ShouldVisitNode(int inStackTop)
+		{
+			mRayMask = mRayMaskStack[inStackTop];
+			return true;
+		}
+
+		// Count the hits of the rays of the current node with the triangles of a leaf
+		template <class TriangleContext>
+		f_inline void				VisitTriangles(const TriangleContext &inTriangleContext, const Vec3 &inRootBoundsMin, const Vec3 &inRootBoundsMax, const void *inTriangles, uint32 inNumTriangles, uint32 inTriangleBlockID)
+		{
+			inTriangleContext.DecodeTriangles4(inRootBoundsMin, inRootBoundsMax, inTriangles, inNumTriangles, [this, inNumTriangles](uint inTriangleIndex, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				// Ignore padding triangles
+				UVec4 valid = Vec4::sLess(Vec4(0, 1, 2, 3), Vec4::sReplicate(float(inNumTriangles - inTriangleIndex)));
+
+				for (uint r = 0; r < 4; ++r)
+					if (mRayMask & (1 << r))
+					{
+						Vec4 distance = RayTriangle4(mOrigins[r], mDirection, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+						mNumHits[r] += UVec4::sAnd(Vec4::sLess(distance, Vec4::sReplicate(FLT_MAX)), valid).CountTrues();
+					}
+			});
+		}
+
+		uint32						mNumHits[4];
+
+	private:
+		Vec3						mOrigins[4];
+		Vec3						mDirection;
+		Vec3						mInvDirection;
+		UVec4						mIsParallel;
+		uint32						mRayMask;							// Rays that hit the node that is being visited
+		uint32						mRayMaskStack[NodeCodec::StackSize];
+	};
+};
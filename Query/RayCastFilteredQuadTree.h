@@ -0,0 +1,101 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <RayCastTest/RayCastTest.h>
+#include <Geometry/RayAABox.h>
+
+// Materials that a ray can hit, material index m corresponds to bit 1 << m
+struct RayMaterialFilter
+{
+	// Mask of the materials that can be hit
+	uint32							GetMaterialMask() const				{ return mIncludeMask & ~mExcludeMask; }
+
+	uint32							mIncludeMask = 0xffffffff;			// Materials that can be hit
+	uint32							mExcludeMask = 0;					// Materials that are ignored, takes precedence over mIncludeMask
+};
+
+// Cast rays against a quad tree (NodeCodecQuadTree or NodeCodecQuadTreeHalfFloat) and find the closest hit with a triangle that passes the filter of the ray.
+//
+// The triangle codec should store materials (TriangleCodecFloat3SOA4Material or TriangleCodecIndexed8BitPackSOA4Material) and provide TestRayFiltered, which skips a leaf
+// when none of its triangles has one of the materials. The tree is walked with NodeCodec::DecodingContext::sWalkTree, closest child first.
+template <class TriangleCodec, class NodeCodec>
+class RayCastFilteredQuadTree
+{
+public:
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// Cast rays, inFilters contains a filter for every ray, outRayCasts receives FLT_MAX for rays that don't hit anything
+	static void						sCastRays(const Buffer &inBuffer, const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, const RayMaterialFilter *inFilters, RayCastTestOut *outRayCasts)
+	{
+		const typename TriangleCodec::DecodingContext ctx(inBuffer.GetTriangleHeader(), &inBuffer.GetBuffer()[0]);
+
+		const RayMaterialFilter *filter = inFilters;
+		RayCastTestOut *out = outRayCasts;
+		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++filter, ++out)
+		{
+			Visitor visitor(Vec3(ray->mOrigin), Vec3(ray->mDirection), filter->GetMaterialMask());
+			if (visitor.mMaterialMask != 0)
+				NodeCodec::DecodingContext::sWalkTree(inBuffer.GetNodeHeader(), &inBuffer.GetBuffer()[0], ctx, visitor);
+			out->mDistance = visitor.mClosest;
+		}
+	}
+
+private:
+	// Visitor for sWalkTree that finds the closest hit
+	class Visitor
+	{
+	public:
+									Visitor(const Vec3 &inOrigin, const Vec3 &inDirection, uint32 inMaterialMask) :
+			mMaterialMask(inMaterialMask),
+			mOrigin(inOrigin),
+			mDirection(inDirection),
+			mInvDirection(inDirection.Reciprocal()),
+			mIsParallel(RayIsParallel(inDirection))
+		{
+		}
+
+		// Test the ray against the bounds of 4 children, returns the number of children to visit
+		f_inline int				VisitNodes(const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ, UVec4 &ioProperties, int inStackTop)
+		{
+			Vec4 distance = RayAABox4(mOrigin, mInvDirection, mIsParallel, inBoundsMinX, inBoundsMinY, inBoundsMinZ, inBoundsMaxX, inBoundsMaxY, inBoundsMaxZ);
+
+			// Sort so that highest values are first (we want to first process closer hits and we process stack top to bottom)
+			Vec4::sSort4Reverse(distance, ioProperties);
+
+			// Count how many results are closer
+			UVec4 closer = Vec4::sLess(distance, Vec4::sReplicate(mClosest));
+			int num_results = closer.CountTrues();
+
+			// Shift the results so that only the closer ones remain
+			distance = distance.ReinterpretAsInt().ShiftComponents4Minus(num_results).ReinterpretAsFloat();
+			ioProperties = ioProperties.ShiftComponents4Minus(num_results);
+
+			assert(inStackTop + 4 < NodeCodec::StackSize);
+			distance.StoreFloat4((Float4 *)&mDistanceStack[inStackTop]);
+			return num_results;
+		}
+
+		// Check if a node on the stack can still contain a closer hit
+		f_inline bool				ShouldVisitNode(int inStackTop) const
+		{
+			return mDistanceStack[inStackTop] < mClosest;
+		}
+
+		// Test the ray against the triangles of a leaf that pass the filter
+		template <class TriangleContext>
+		f_inline void				VisitTriangles(const TriangleContext &inTriangleContext, const Vec3 &inRootBoundsMin, const Vec3 &inRootBoundsMax, const void *inTriangles, uint32 inNumTriangles, uint32 inTriangleBlockID)
+		{
+			inTriangleContext.TestRayFiltered(mOrigin, mDirection, inRootBoundsMin, inRootBoundsMax, inTriangles, inNumTriangles, mMaterialMask, mClosest);
+		}
+
+		float						mClosest = FLT_MAX;
+		uint32						mMaterialMask;
+
+	private:
+		Vec3						mOrigin;
+		Vec3						mDirection;
+		Vec3						mInvDirection;
+		UVec4						mIsParallel;
+		float						mDistanceStack[NodeCodec::StackSize];
+	};
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <RayCastTest/RayCastTest.h>
+#include <Geometry/RayAABox.h>
+#include <Geometry/RayTriangle.h>
+
+// A hit of a ray with a triangle
+struct RayHit
+{
+	float							mDistance;							// Distance along the ray (in units of the length of the direction)
+	uint32							mTriangleBlockID;					// Triangle block that contains the triangle (see NodeCodec::DecodingContext::sGetTriangleBlockStart)
+	uint32							mTriangleIndex;						// Index of the triangle in the block
+};
+
+// Fixed capacity max heap on distance that keeps the nearest Capacity hits
+template <uint Capacity>
+class RayHitHeap
+{
+public:
+	static_assert(Capacity > 0, "Capacity should be at least 1");
+
+	// Add a hit, if the heap is full the hit replaces the furthest hit when it is nearer
+	void							Add(const RayHit &inHit)
+	{
+		if (mNumStored < Capacity)
+		{
+			mHits[mNumStored++] = inHit;
+			push_heap(mHits, mHits + mNumStored, sCompareDistance);
+		}
+		else if (inHit.mDistance < mHits[0].mDistance)
+		{
+			pop_heap(mHits, mHits + Capacity, sCompareDistance);
+			mHits[Capacity - 1] = inHit;
+			push_heap(mHits, mHits + Capacity, sCompareDistance);
+		}
+	}
+
+	// Check if the heap is full
+	bool							IsFull() const						{ return mNumStored == Capacity; }
+
+	// Distance of the furthest hit that is stored
+	float							GetFurthestDistance() const			{ assert(mNumStored > 0); return mHits[0].mDistance; }
+
+	// Sort the stored hits nearest first, after this no more hits can be added
+	void							Sort()								{ sort_heap(mHits, mHits + mNumStored, sCompareDistance); }
+
+	// Stored hits, sorted after calling Sort
+	uint							GetNumStored() const				{ return mNumStored; }
+	const RayHit &					GetHit(uint inIndex) const			{ assert(inIndex < mNumStored); return mHits[inIndex]; }
+
+private:
+	static bool						sCompareDistance(const RayHit &inLHS, const RayHit &inRHS) { return inLHS.mDistance < inRHS.mDistance; }
+
+	uint							mNumStored = 0;
+	RayHit							mHits[Capacity];
+};
+
+// Hit collection policy for RayHitsQuadTree that collects all hits along the ray segment.
+// All hits are counted, when there are more than Capacity hits only the nearest Capacity hits are stored.
+template <uint Capacity>
+class RayAllHits : public RayHitHeap<Capacity>
+{
+public:
+	// Nodes and triangles further away than this are skipped
+	float							GetEarlyOutDistance(float inMaxDistance) const
+	{
+		return inMaxDistance;
+	}
+
+	// Add a hit
+	void							AddHit(const RayHit &inHit)
+	{
+		++mNumHits;
+		RayHitHeap<Capacity>::Add(inHit);
+	}
+
+	uint							mNumHits = 0;						// Total number of hits, can be more than the number of stored hits
+};
+
+// Hit collection policy for RayHitsQuadTree that collects the K nearest hits along the ray segment.
+// Once K hits have been found, nodes that are further away than the furthest of them are skipped.
+template <uint K>
+class RayKNearestHits : public RayHitHeap<K>
+{
+public:
+	// Nodes and triangles further away than this are skipped
+	float							GetEarlyOutDistance(float inMaxDistance) const
+	{
+		return RayHitHeap<K>::IsFull()? min(inMaxDistance, RayHitHeap<K>::GetFurthestDistance()) : inMaxDistance;
+	}
+
+	// Add a hit
+	void							AddHit(const RayHit &inHit)
+	{
+		RayHitHeap<K>::Add(inHit);
+	}
+};
+
+// Cast rays against a quad tree (NodeCodecQuadTree or NodeCodecQuadTreeHalfFloat) and collect multiple hits per ray in a single traversal.
+//
+// The HitCollector policy (RayAllHits or RayKNearestHits) receives the hits and determines which nodes can be skipped.
+// The tree is walked with NodeCodec::DecodingContext::sWalkTree, closest child first, and triangles are decoded 4 at a time with
+// TriangleCodec::DecodingContext::DecodeTriangles4. This doesn't touch the TestRay functions of the triangle codecs so the closest hit path is unaffected.
+template <class TriangleCodec, class NodeCodec>
+class RayHitsQuadTree
+{
+public:
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// Cast rays and collect the hits with a distance in [0, inMaxDistance] in outCollectors (one per ray), the hits are sorted nearest first
+	template <class HitCollector>
+	static void						sCastRays(const Buffer &inBuffer, const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, HitCollector *outCollectors, float inMaxDistance = FLT_MAX)
+	{
+		const typename TriangleCodec::DecodingContext ctx(inBuffer.GetTriangleHeader(), &inBuffer.GetBuffer()[0]);
+
+		HitCollector *out = outCollectors;
+		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
+		{
+			*out = HitCollector();
+			Visitor<HitCollector> visitor(Vec3(ray->mOrigin), Vec3(ray->mDirection), inMaxDistance, *out);
+			NodeCodec::DecodingContext::sWalkTree(inBuffer.GetNodeHeader(), &inBuffer.GetBuffer()[0], ctx, visitor);
+			out->Sort();
+		}
+	}
+
+private:
+	// Visitor for sWalkTree
+	template <class HitCollector>
+	class Visitor
+	{
+	public:
+									Visitor(const Vec3 &inOrigin, const Vec3 &inDirection, float inMaxDistance, HitCollector &ioCollector) :
+			mOrigin(inOrigin),
+			mDirection(inDirection),
+			mInvDirection(inDirection.Reciprocal()),
+			mIsParallel(RayIsParallel(inDirection)),
+			mMaxDistance(inMaxDistance),
+			mCollector(ioCollector)
+		{
+		}
+
+		// Test the ray against the bounds of 4 children, returns the number of children to visit
+		f_inline int				VisitNodes(const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ, UVec4 &ioProperties, int inStackTop)
+		{
+			Vec4 distance = RayAABox4(mOrigin, mInvDirection, mIsParallel, inBoundsMinX, inBoundsMinY, inBoundsMinZ, inBoundsMaxX, inBoundsMaxY, inBoundsMaxZ);
+
+			// Sort so that highest values are first (we want to first process closer hits and we process stack top to bottom)
+			Vec4::sSort4Reverse(distance, ioProperties);
+
+			// Count how many results are within the early out distance, a ray that misses returns FLT_MAX
+			UVec4 closer = UVec4::sAnd(Vec4::sLessOrEqual(distance, Vec4::sReplicate(mCollector.GetEarlyOutDistance(mMaxDistance))), Vec4::sLess(distance, Vec4::sReplicate(FLT_MAX)));
+			int num_results = closer.CountTrues();
+
+			// Shift the results so that only the closer ones remain
+			distance = distance.ReinterpretAsInt().ShiftComponents4Minus(num_results).ReinterpretAsFloat();
+			ioProperties = ioProperties.ShiftComponents4Minus(num_results);
+
+			assert(inStackTop + 4 < NodeCodec::StackSize);
+			distance.StoreFloat4((Float4 *)&mDistanceStack[inStackTop]);
+			return num_results;
+		}
+
+		// Check if a node on the stack can still contain a hit that the collector wants
+		f_inline bool				ShouldVisitNode(int inStackTop) const
+		{
+			return mDistanceStack[inStackTop] <= mCollector.GetEarlyOutDistance(mMaxDistance);
+		}
+
+		// Test the ray against the triangles of a leaf and pass the hits to the collector
+		template <class TriangleContext>
+		f_inline void				VisitTriangles(const TriangleContext &inTriangleContext, const Vec3 &inRootBoundsMin, const Vec3 &inRootBoundsMax, const void *inTriangles, uint32 inNumTriangles, uint32 inTriangleBlockID)
+		{
+			inTriangleContext.DecodeTriangles4(inRootBoundsMin, inRootBoundsMax, inTriangles, inNumTriangles, [this, inNumTriangles, inTriangleBlockID](uint inTriangleIndex, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				Vec4 distance = RayTriangle4(mOrigin, mDirection, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+
+				// Ignore padding triangles and hits beyond the end of the segment
+				UVec4 valid = Vec4::sLess(Vec4(0, 1, 2, 3), Vec4::sReplicate(float(inNumTriangles - inTriangleIndex)));
+				UVec4 hit = UVec4::sAnd(UVec4::sAnd(Vec4::sLessOrEqual(distance, Vec4::sReplicate(mMaxDistance)), Vec4::sLess(distance, Vec4::sReplicate(FLT_MAX))), valid);
+				int mask = hit.GetTrues();
+				if (mask == 0)
+					return;
+
+				Float4 distances;
+				distance.StoreFloat4(&distances);
+				do
+				{
+					uint lane = CountTrailingZeros((uint32)mask);
+					mask &= mask - 1;
+					mCollector.AddHit({ distances[lane], inTriangleBlockID, inTriangleIndex + lane });
+				}
+				while (mask != 0);
+			});
+		}
+
+	private:
+		Vec3						mOrigin;
+		Vec3						mDirection;
+		Vec3						mInvDirection;
+		UVec4						mIsParallel;
+		float						mMaxDistance;
+		HitCollector &				mCollector;
+		float						mDistanceStack[NodeCodec::StackSize];
+	};
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <AABBTree/AABBTreeToBuffer.h>
+#include <NodeCodec/NodeCodecQuadTreeHalfFloat.h>
+#include <Geometry/RayAABox.h>
+#include <Geometry/SweptSphereTriangle.h>
+
+// A sphere that moves from mCenter to mCenter + mDisplacement
+struct SphereCast
+{
+	Float3							mCenter;
+	float							mRadius;
+	Float3							mDisplacement;
+};
+
+// A capsule (all points within mRadius of the line segment mPoint1 - mPoint2) that moves by mDisplacement
+struct CapsuleCast
+{
+	Float3							mPoint1;
+	Float3							mPoint2;
+	float							mRadius;
+	Float3							mDisplacement;
+};
+
+// Result of a sphere or capsule cast
+struct ShapeCastResult
+{
+	float							mFraction;							// Fraction of the displacement where the shape first touches the mesh, FLT_MAX if there is no contact
+	uint32							mTriangleBlockID;					// Triangle block that contains the contact triangle (see NodeCodec::DecodingContext::sGetTriangleBlockStart)
+	uint32							mTriangleIndex;						// Index of the contact triangle in the block
+	Float3							mTriangle[3];						// Vertices of the contact triangle
+};
+
+// Sweep spheres and capsules through a quad tree with half float bounds and find the first contact.
+//
+// The tree is walked with NodeCodecQuadTreeHalfFloat::DecodingContext::sWalkTree. The bounds of the children are expanded by the extent of the
+// bounding box of the shape (the Minkowski sum of the box and the shape is inside the expanded box) and tested against the path of the
+// center of the shape 4 at a time, closest first. Triangles are decoded 4 at a time with TriangleCodec::DecodingContext::DecodeTriangles4.
+template <class TriangleCodec, int Alignment>
+class ShapeCastQuadTree
+{
+public:
+	using NodeCodec = NodeCodecQuadTreeHalfFloat<Alignment>;
+	using Buffer = AABBTreeToBuffer<TriangleCodec, NodeCodec>;
+
+	// Cast spheres against a buffer that was created with AABBTreeToBuffer
+	static void						sCastSpheres(const Buffer &inBuffer, const SphereCast *inSphereCastsBegin, const SphereCast *inSphereCastsEnd, ShapeCastResult *outResults)
+	{
+		const typename TriangleCodec::DecodingContext ctx(inBuffer.GetTriangleHeader(), &inBuffer.GetBuffer()[0]);
+
+		ShapeCastResult *out = outResults;
+		for (const SphereCast *cast = inSphereCastsBegin; cast < inSphereCastsEnd; ++cast, ++out)
+		{
+			Vec3 center(cast->mCenter);
+			Vec3 displacement(cast->mDisplacement);
+			float radius = cast->mRadius;
+
+			auto triangle_test = [center, displacement, radius](const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				return SweptSphereTriangle4(center, displacement, radius, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+			};
+
+			Visitor<decltype(triangle_test)> visitor(center, displacement, Vec3::sReplicate(radius), triangle_test, *out);
+			NodeCodec::DecodingContext::sWalkTree(inBuffer.GetNodeHeader(), &inBuffer.GetBuffer()[0], ctx, visitor);
+		}
+	}
+
+	// Cast capsules against a buffer that was created with AABBTreeToBuffer
+	static void						sCastCapsules(const Buffer &inBuffer, const CapsuleCast *inCapsuleCastsBegin, const CapsuleCast *inCapsuleCastsEnd, ShapeCastResult *outResults)
+	{
+		const typename TriangleCodec::DecodingContext ctx(inBuffer.GetTriangleHeader(), &inBuffer.GetBuffer()[0]);
+
+		ShapeCastResult *out = outResults;
+		for (const CapsuleCast *cast = inCapsuleCastsBegin; cast < inCapsuleCastsEnd; ++cast, ++out)
+		{
+			Vec3 point1(cast->mPoint1);
+			Vec3 point2(cast->mPoint2);
+			Vec3 displacement(cast->mDisplacement);
+			float radius = cast->mRadius;
+
+			auto triangle_test = [point1, point2, displacement, radius](const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				return SweptCapsuleTriangle4(point1, point2, radius, displacement, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+			};
+
+			// The bounding box of the capsule around its center
+			Vec3 center = 0.5f * (point1 + point2);
+			Vec3 extent = 0.5f * (point2 - point1).Abs() + Vec3::sReplicate(radius);
+
+			Visitor<decltype(triangle_test)> visitor(center, displacement, extent, triangle_test, *out);
+			NodeCodec::DecodingContext::sWalkTree(inBuffer.GetNodeHeader(), &inBuffer.GetBuffer()[0], ctx, visitor);
+		}
+	}
+
+private:
+	// Visitor for sWalkTree, TriangleTest returns the fraction at which the shape touches 4 triangles
+	template <class TriangleTest>
+	class Visitor
+	{
+	public:
+									Visitor(const Vec3 &inCenter, const Vec3 &inDisplacement, const Vec3 &inExtent, const TriangleTest &inTriangleTest, ShapeCastResult &outResult) :
+			mCenter(inCenter),
+			mInvDisplacement(inDisplacement.Reciprocal()),
+			mIsParallel(RayIsParallel(inDisplacement)),
+			mExtent(inExtent),
+			mTriangleTest(inTriangleTest),
+			mResult(outResult)
+		{
+			mResult.mFraction = FLT_MAX;
+			mResult.mTriangleBlockID = 0;
+			mResult.mTriangleIndex = 0;
+		}
+
+		// Test the path of the center against the expanded bounds of 4 children, returns the number of children to visit
+		f_inline int				VisitNodes(const Vec4 &inBoundsMinX, const Vec4 &inBoundsMinY, const Vec4 &inBoundsMinZ, const Vec4 &inBoundsMaxX, const Vec4 &inBoundsMaxY, const Vec4 &inBoundsMaxZ, UVec4 &ioProperties, int inStackTop)
+		{
+			Vec4 extent_x = mExtent.SplatX(), extent_y = mExtent.SplatY(), extent_z = mExtent.SplatZ();
+			Vec4 distance = RayAABox4(mCenter, mInvDisplacement, mIsParallel, inBoundsMinX - extent_x, inBoundsMinY - extent_y, inBoundsMinZ - extent_z, inBoundsMaxX + extent_x, inBoundsMaxY + extent_y, inBoundsMaxZ + extent_z);
+
+			// Sort so that highest values are first (we want to first process closer hits and we process stack top to bottom)
+			Vec4::sSort4Reverse(distance, ioProperties);
+
+			// Count how many results are closer and within the displacement
+			UVec4 closer = UVec4::sAnd(Vec4::sLess(distance, Vec4::sReplicate(mResult.mFraction)), Vec4::sLessOrEqual(distance, Vec4::sReplicate(1.0f)));
+			int num_results = closer.CountTrues();
+
+			// Shift the results so that only the closer ones remain
+			distance = distance.ReinterpretAsInt().ShiftComponents4Minus(num_results).ReinterpretAsFloat();
+			ioProperties = ioProperties.ShiftComponents4Minus(num_results);
+
+			assert(inStackTop + 4 < NodeCodec::StackSize);
+			distance.StoreFloat4((Float4 *)&mDistanceStack[inStackTop]);
+			return num_results;
+		}
+
+		// Check if a node on the stack could still give a closer hit
+		f_inline bool				ShouldVisitNode(int inStackTop) const
+		{
+			return mDistanceStack[inStackTop] < mResult.mFraction;
+		}
+
+		// Test the shape against the triangles of a leaf
+		template <class TriangleContext>
+		f_inline void				VisitTriangles(const TriangleContext &inTriangleContext, const Vec3 &inRootBoundsMin, const Vec3 &inRootBoundsMax, const void *inTriangles, uint32 inNumTriangles, uint32 inTriangleBlockID)
+		{
+			inTriangleContext.DecodeTriangles4(inRootBoundsMin, inRootBoundsMax, inTriangles, inNumTriangles, [this, inNumTriangles, inTriangleBlockID](uint inTriangleIndex, const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				Vec4 fraction = mTriangleTest(inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+
+				// Ignore padding triangles and contacts beyond the end of the displacement
+				UVec4 padding = Vec4::sGreaterOrEqual(Vec4(0, 1, 2, 3), Vec4::sReplicate(float(inNumTriangles - inTriangleIndex)));
+				fraction = Vec4::sSelect(fraction, Vec4::sReplicate(FLT_MAX), UVec4::sOr(padding, Vec4::sGreater(fraction, Vec4::sReplicate(1.0f))));
+
+				// Check if one of the triangles is closer
+				float closest = fraction.ReduceMin();
+				if (closest < mResult.mFraction)
+				{
+					uint lane = CountTrailingZeros((uint32)Vec4::sEquals(fraction, Vec4::sReplicate(closest)).GetTrues());
+					mResult.mFraction = closest;
+					mResult.mTriangleBlockID = inTriangleBlockID;
+					mResult.mTriangleIndex = inTriangleIndex + lane;
+					mResult.mTriangle[0] = Float3(inV0X[lane], inV0Y[lane], inV0Z[lane]);
+					mResult.mTriangle[1] = Float3(inV1X[lane], inV1Y[lane], inV1Z[lane]);
+					mResult.mTriangle[2] = Float3(inV2X[lane], inV2Y[lane], inV2Z[lane]);
+				}
+			});
+		}
+
+	private:
+		Vec3						mCenter;
+		Vec3						mInvDisplacement;
+		UVec4						mIsParallel;
+		Vec3						mExtent;
+		const TriangleTest &		mTriangleTest;
+		ShapeCastResult &			mResult;
+		float						mDistanceStack[NodeCodec::StackSize];
+	};
+};
@@ -0,0 +1,92 @@
+#include <pch.h> // IWYU pragma: keep
+
+#include <Query/VisibilityMatrix.h>
+#include <Geometry/AABox.h>
+#include <Geometry/MortonCode.h>
+#include <thread>
+#include <atomic>
+
+namespace {
+
+// Amount of rays that are passed to RayCastTest::CastRays at a time
+const uint cBatchSize = 256;
+
+} // namespace
+
+void VisibilityMatrix::Compute(RayCastTest &inTest, const Float3 *inSourcesBegin, const Float3 *inSourcesEnd, const Float3 *inTargetsBegin, const Float3 *inTargetsEnd, float inSegmentMargin, uint inNumThreads)
+{
+	mNumSources = uint(inSourcesEnd - inSourcesBegin);
+	mNumTargets = uint(inTargetsEnd - inTargetsBegin);
+	mWordsPerRow = (mNumTargets + 63) >> 6;
+	mBits.assign(size_t(mNumSources) * mWordsPerRow, 0);
+	if (mNumSources == 0 || mNumTargets == 0)
+		return;
+
+	// Sort the targets on morton code so that consecutive rays of a source have similar directions
+	AABox bounds;
+	for (const Float3 *t = inTargetsBegin; t < inTargetsEnd; ++t)
+		bounds.Encapsulate(Vec3(*t));
+	bounds.mMax = Vec3::sMax(bounds.mMax, bounds.mMin + Vec3::sReplicate(1.0e-6f)); // Avoid dividing by zero for a flat set of targets
+	vector<uint64> order(mNumTargets);
+	for (uint t = 0; t < mNumTargets; ++t)
+		order[t] = (uint64(MortonCode::sGetMortonCode(Vec3(inTargetsBegin[t]), bounds)) << 32) | t;
+	sort(order.begin(), order.end());
+
+	// Cast the rays of a source in batches
+	atomic<uint> next_source(0);
+	auto cast_rays = [this, &inTest, inSourcesBegin, inTargetsBegin, inSegmentMargin, &order, &next_source]()
+	{
+		RayCastTestIn rays[cBatchSize];
+		RayCastTestOut out[cBatchSize];
+		for (uint s = next_source++; s < mNumSources; s = next_source++)
+		{
+			Vec3 source(inSourcesBegin[s]);
+			uint64 *row = &mBits[s * mWordsPerRow];
+
+			for (uint batch_start = 0; batch_start < mNumTargets; batch_start += cBatchSize)
+			{
+				// Create a segment from the source to every target, shortened by inSegmentMargin at both ends
+				uint batch_size = min(cBatchSize, mNumTargets - batch_start);
+				for (uint i = 0; i < batch_size; ++i)
+				{
+					Vec3 delta = Vec3(inTargetsBegin[uint32(order[batch_start + i])]) - source;
+					(source + inSegmentMargin * delta).StoreFloat3(&rays[i].mOrigin);
+					((1.0f - 2.0f * inSegmentMargin) * delta).StoreFloat3(&rays[i].mDirection);
+				}
+
+				inTest.CastOcclusionRays(rays, rays + batch_size, out);
+
+				// The target is visible when the segment doesn't hit anything
+				for (uint i = 0; i < batch_size; ++i)
+					if (out[i].mDistance >= 1.0f)
+					{
+						uint32 t = uint32(order[batch_start + i]);
+						row[t >> 6] |= uint64(1) << (t & 63);
+					}
+			}
+		}
+	};
+
+	// Each thread takes the next source, a source writes to its own row only
+	uint num_threads = inNumThreads > 0? inNumThreads : max(1u, thread::hardware_concurrency());
+	num_threads = min(num_threads, mNumSources);
+	if (num_threads <= 1)
+		cast_rays();
+	else
+	{
+		vector<thread> threads;
+		for (uint t = 1; t < num_threads; ++t)
+			threads.emplace_back(cast_rays);
+		cast_rays();
+		for (thread &t : threads)
+			t.join();
+	}
+}
+
+uint64 VisibilityMatrix::GetNumVisible() const
+{
+	uint64 num_visible = 0;
+	for (uint64 word : mBits)
+		num_visible += CountBits(uint32(word)) + CountBits(uint32(word >> 32));
+	return num_visible;
+}
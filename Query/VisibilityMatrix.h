@@ -0,0 +1,44 @@
+#pragma once
+
+#include <RayCastTest/RayCastTest.h>
+
+// Line of sight between every pair of a set of sources and a set of targets (e.g. sensors and the points they should see).
+//
+// A segment is cast from every source to every target with RayCastTest::CastOcclusionRays, the pair is visible when nothing is hit along the segment.
+// Tests that don't override CastOcclusionRays find the closest hit of the unbounded ray, which gives the same result but doesn't stop early.
+// The rays of a source all start at the same point, so a source is processed in one go and the targets are sorted spatially (by morton code)
+// to make consecutive rays go in similar directions. The sources are spread over inNumThreads threads.
+// The result is stored as a bit matrix with a row per source.
+class VisibilityMatrix
+{
+public:
+	// Compute the visibility of all pairs, replaces the previous result.
+	// inSegmentMargin is the fraction of the segment at both ends that is ignored so that points on the surface don't occlude themselves.
+	// When inNumThreads != 1, inTest.CastOcclusionRays is called from multiple threads at the same time (0 = use all hardware threads), so
+	// it can only be used with tests that don't modify their state while casting rays (e.g. the CPU tree tests).
+	void							Compute(RayCastTest &inTest, const Float3 *inSourcesBegin, const Float3 *inSourcesEnd, const Float3 *inTargetsBegin, const Float3 *inTargetsEnd, float inSegmentMargin = 1.0e-4f, uint inNumThreads = 1);
+
+	// Number of sources and targets
+	uint							GetNumSources() const				{ return mNumSources; }
+	uint							GetNumTargets() const				{ return mNumTargets; }
+
+	// Check if inTarget can be seen from inSource
+	bool							IsVisible(uint inSource, uint inTarget) const
+	{
+		assert(inSource < mNumSources && inTarget < mNumTargets);
+		return (mBits[inSource * mWordsPerRow + (inTarget >> 6)] & (uint64(1) << (inTarget & 63))) != 0;
+	}
+
+	// Get the row of a source, bit t of the row (bit t & 63 of word t >> 6) is set when target t is visible
+	const uint64 *					GetRow(uint inSource) const			{ assert(inSource < mNumSources); return &mBits[inSource * mWordsPerRow]; }
+	uint							GetWordsPerRow() const				{ return mWordsPerRow; }
+
+	// Number of visible pairs
+	uint64							GetNumVisible() const;
+
+private:
+	uint							mNumSources = 0;
+	uint							mNumTargets = 0;
+	uint							mWordsPerRow = 0;
+	vector<uint64>					mBits;
+};
@@ -7,6 +7,7 @@
 #include <Utils/Model.h>
 #include <TriangleGrouper/TriangleGrouperMorton.h>
 #include <TriangleGrouper/TriangleGrouperClosestCentroid.h>
+#include <TriangleGrouper/TriangleGrouperClosestCentroidKDTree.h>
 #include <Geometry/RayAABox8.h>
 
 enum class ERayCastCPUAABBListVariant
@@ -21,6 +22,7 @@ enum class ERayCastCPUAABBGrouper
 {
 	GROUPER_MORTON,
 	GROUPER_CLOSEST_CENTROID,
+	GROUPER_CLOSEST_CENTROID_KD_TREE,
 };
 
 // Divide triangles in batches, 1 aabb per batch
@@ -59,6 +61,9 @@ public:
 		case ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID:
 			grouper = "GrouperClosestCentroid";
 			break;
+		case ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID_KD_TREE:
+			grouper = "GrouperClosestCentroidKDTree";
+			break;
 		default:
 			assert(false);
 			break;
@@ -99,7 +104,7 @@ public:
 
 	virtual void						Initialize() override
 	{
-		const IndexedTriangleList &triangle_list = mModel->mIndexedTriangles;
+		const IndexedTriangleList &triangle_list = mModel->GetIndexedTriangles();
 		const uint triangle_count = (uint)triangle_list.size();
 		const uint num_batches = (triangle_count + mTrianglesPerBatch - 1) / mTrianglesPerBatch;
 
@@ -108,12 +113,17 @@ public:
 		if (mGrouper == ERayCastCPUAABBGrouper::GROUPER_MORTON)
 		{
 			TriangleGrouperMorton grouper;
-			grouper.Group(mModel->mTriangleVertices, triangle_list, mTrianglesPerBatch, sorted_triangle_idx);
+			grouper.Group(mModel->GetTriangleVertices(), triangle_list, mTrianglesPerBatch, sorted_triangle_idx);
 		}
 		else if (mGrouper == ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID)
 		{
 			TriangleGrouperClosestCentroid grouper;
-			grouper.Group(mModel->mTriangleVertices, triangle_list, mTrianglesPerBatch, sorted_triangle_idx);
+			grouper.Group(mModel->GetTriangleVertices(), triangle_list, mTrianglesPerBatch, sorted_triangle_idx);
+		}
+		else if (mGrouper == ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID_KD_TREE)
+		{
+			TriangleGrouperClosestCentroidKDTree grouper;
+			grouper.Group(mModel->GetTriangleVertices(), triangle_list, mTrianglesPerBatch, sorted_triangle_idx);
 		}
 
 		// Calculate bounds for each group and split up triangles
@@ -124,7 +134,7 @@ public:
 		for (uint t = 0; t < triangle_count; ++t)
 		{
 			const IndexedTriangle &triangle = triangle_list[sorted_triangle_idx[t]];
-			mBounds[t / mTrianglesPerBatch].Encapsulate(mModel->mTriangleVertices, triangle);
+			mBounds[t / mTrianglesPerBatch].Encapsulate(mModel->GetTriangleVertices(), triangle);
 			containers[t / mTrianglesPerBatch].push_back(triangle);
 		}
 
@@ -221,7 +231,7 @@ public:
 
 		// Add triangles
 		for (uint b = 0; b < num_batches; ++b)
-			mTrianglesStart[b] = tri_ctx.Pack(mModel->mTriangleVertices, containers[b], mBounds[b].mMin, mBounds[b].mMax, mTriangles);
+			mTrianglesStart[b] = tri_ctx.Pack(mModel->GetTriangleVertices(), containers[b], mBounds[b].mMin, mBounds[b].mMax, mTriangles);
 
 		// Finalize the triangles
 		tri_ctx.Finalize(&mTriangleHeader, mTriangles);
@@ -252,7 +262,7 @@ public:
 
 	virtual void						CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
 	{
-		const typename TriangleCodec::DecodingContext ctx(&mTriangleHeader, mTriangles);
+		const typename TriangleCodec::DecodingContext ctx(&mTriangleHeader, &mTriangles[0]);
 
 		RayCastTestOut *out = outRayCasts;
 
@@ -12,7 +12,7 @@ class RayCastCPUAABBTree1 : public RayCastTest
 	static const int stack_size = 64;
 
 public:
-									RayCastCPUAABBTree1(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot) : mVertices(inVertices), mRoot(inRoot) { }
+									RayCastCPUAABBTree1(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree, bool inAllowRefit = false) : mVertices(inVertices), mTree(inTree), mAllowRefit(inAllowRefit) { }
 
 	virtual void					GetStats(StatsRow &ioRow) const override
 	{
@@ -23,14 +23,20 @@ public:
 	virtual void					Initialize() override
 	{
 		// Check if stack is big enough
-		if (mRoot->GetMaxDepth() >= (uint)stack_size)
+		if (mTree->GetMaxDepth() >= (uint)stack_size)
 			FatalError("RayCastCPUAABBTree1: Tree too deep");
 
 		AABBTreeToBufferStats stats;
-		mBuffer.Convert(mVertices, mRoot, stats);
+		mBuffer.Convert(mVertices, *mTree, stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST, mAllowRefit);
 		mStats.Set(stats);
 	}
 
+	// Update the tree after the vertices that were passed to the constructor have moved, the test must have been created with inAllowRefit
+	void							Refit()
+	{
+		mBuffer.Refit(mVertices);
+	}
+
 	virtual void					TrashCache() override
 	{
 		CacheTrasher::sTrash(mBuffer.GetBuffer());
@@ -38,7 +44,7 @@ public:
 
 	virtual void					CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
 	{
-		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), mBuffer.GetBuffer());
+		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), &mBuffer.GetBuffer()[0]);
 
 		RayCastTestOut *out = outRayCasts;
 		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
@@ -90,8 +96,9 @@ public:
 	}
 
 private:
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
+	bool							mAllowRefit;
 	AABBTreeToBuffer<TriangleCodec, NodeCodecAABBTree> mBuffer;
 	StatsRow						mStats;
 };
@@ -12,7 +12,7 @@ class RayCastCPUAABBTree3 : public RayCastTest
 	static const int stack_size = 64;
 
 public:
-									RayCastCPUAABBTree3(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot) : mVertices(inVertices), mRoot(inRoot) { }
+									RayCastCPUAABBTree3(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree) : mVertices(inVertices), mTree(inTree) { }
 
 	virtual void					GetStats(StatsRow &ioRow) const override
 	{
@@ -23,11 +23,11 @@ public:
 	virtual void					Initialize() override
 	{
 		// Check if stack is big enough
-		if (mRoot->GetMaxDepth() >= (uint)stack_size)
+		if (mTree->GetMaxDepth() >= (uint)stack_size)
 			FatalError("RayCastCPUAABBTree3: Tree too deep");
 
 		AABBTreeToBufferStats stats;
-		mBuffer.Convert(mVertices, mRoot, stats);
+		mBuffer.Convert(mVertices, *mTree, stats);
 		mStats.Set(stats);
 	}
 
@@ -38,7 +38,7 @@ public:
 
 	virtual void					CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
 	{
-		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), mBuffer.GetBuffer());
+		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), &mBuffer.GetBuffer()[0]);
 
 		RayCastTestOut *out = outRayCasts;
 		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
@@ -117,8 +117,8 @@ public:
 	}
 
 private:
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
 	AABBTreeToBuffer<TriangleCodec, NodeCodecAABBTree> mBuffer;
 	StatsRow						mStats;
 };
@@ -11,7 +11,7 @@ class RayCastCPUAABBTreeCompressed : public RayCastTest
 	static const int stack_size = 64;
 
 public:
-								RayCastCPUAABBTreeCompressed(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot) : mVertices(inVertices), mRoot(inRoot) { }
+								RayCastCPUAABBTreeCompressed(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree) : mVertices(inVertices), mTree(inTree) { }
 
 	virtual void				GetStats(StatsRow &ioRow) const override
 	{
@@ -22,11 +22,11 @@ public:
 	virtual void				Initialize() override
 	{
 		// Check if stack is big enough
-		if (mRoot->GetMaxDepth() >= (uint)stack_size)
+		if (mTree->GetMaxDepth() >= (uint)stack_size)
 			FatalError("RayCastCPUAABBTreeCompressed: Tree too deep");
 
 		AABBTreeToBufferStats stats;
-		mBuffer.Convert(mVertices, mRoot, stats);
+		mBuffer.Convert(mVertices, *mTree, stats);
 		mStats.Set(stats);
 	}
 
@@ -39,7 +39,7 @@ public:
 	{
 		const NodeCodecAABBTreeCompressed::Header *header = mBuffer.GetNodeHeader();
 
-		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), mBuffer.GetBuffer());
+		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), &mBuffer.GetBuffer()[0]);
 
 		RayCastTestOut *out = outRayCasts;
 		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
@@ -156,8 +156,8 @@ public:
 	}
 
 private:
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
 	AABBTreeToBuffer<TriangleCodec, NodeCodecAABBTreeCompressed> mBuffer;
 	StatsRow						mStats;
 };
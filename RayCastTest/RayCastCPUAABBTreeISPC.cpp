@@ -9,11 +9,11 @@ extern "C" { void __cdecl RayVsAABBTree(const RayCastTestIn raycasts[], const ui
 void RayCastCPUAABBTreeISPC::Initialize()
 {
 	// Check if stack is big enough
-	if (mRoot->GetMaxDepth() >= 64)
+	if (mTree->GetMaxDepth() >= 64)
 		FatalError("RayCastCPUAABBTreeISPC: Tree too deep");
 
 	AABBTreeToBufferStats stats;
-	mBuffer.Convert(mVertices, mRoot, stats);
+	mBuffer.Convert(mVertices, *mTree, stats);
 	mStats.Set(stats);
 }
 
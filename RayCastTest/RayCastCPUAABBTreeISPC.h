@@ -11,7 +11,7 @@
 class RayCastCPUAABBTreeISPC : public RayCastTest
 {
 public:
-									RayCastCPUAABBTreeISPC(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot) : mVertices(inVertices), mRoot(inRoot) { }
+									RayCastCPUAABBTreeISPC(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree) : mVertices(inVertices), mTree(inTree) { }
 
 	virtual void					GetStats(StatsRow &ioRow) const override
 	{
@@ -29,8 +29,8 @@ public:
 	virtual void					CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override;
 
 private:
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
 	AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree> mBuffer;
 	StatsRow						mStats;
 };
@@ -9,11 +9,11 @@ extern "C" { void __cdecl RayVsAABBTreeStripped(const RayCastTestIn raycasts[],
 void RayCastCPUAABBTreeStripISPC::Initialize()
 {
 	// Check if stack is big enough
-	if (mRoot->GetMaxDepth() >= 64)
+	if (mTree->GetMaxDepth() >= 64)
 		FatalError("RayCastCPUAABBTreeStripISPC: Tree too deep");
 
 	AABBTreeToBufferStats stats;
-	mBuffer.Convert(mVertices, mRoot, stats);
+	mBuffer.Convert(mVertices, *mTree, stats);
 	mStats.Set(stats);
 }
 
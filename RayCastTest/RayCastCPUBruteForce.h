@@ -41,17 +41,17 @@ public:
 		mBounds.EnsureMinimalEdgeLength(1.0e-5f);
 
 		// Divide triangles into blocks
-		for (size_t v = 0; v < mModel->mIndexedTriangles.size(); v += MaxVerticesPerBlock)
+		for (size_t v = 0; v < mModel->GetTriangleCount(); v += MaxVerticesPerBlock)
 		{
 			// Calculate amount of triangles in this block
-			uint32 num_triangles = min((uint32)(mModel->mIndexedTriangles.size() - v), MaxVerticesPerBlock);
+			uint32 num_triangles = min((uint32)(mModel->GetTriangleCount() - v), MaxVerticesPerBlock);
 
 			// Fetch block of triangles
 			IndexedTriangleList block;
-			block.assign(mModel->mIndexedTriangles.begin() + v, mModel->mIndexedTriangles.begin() + v + num_triangles);
+			block.assign(mModel->GetIndexedTriangles().begin() + v, mModel->GetIndexedTriangles().begin() + v + num_triangles);
 
 			// Convert triangles
-			uint32 offset = tri_ctx.Pack(mModel->mTriangleVertices, block, mBounds.mMin, mBounds.mMax, mBuffer);
+			uint32 offset = tri_ctx.Pack(mModel->GetTriangleVertices(), block, mBounds.mMin, mBounds.mMax, mBuffer);
 			mBlocks.push_back({ offset, num_triangles });
 		}
 
@@ -82,10 +82,10 @@ public:
 
 	virtual void				CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
 	{
-		const typename TriangleCodec::DecodingContext ctx(&mHeader, mBuffer);
-
 		const uint8 *triangles = &mBuffer[0];
 
+		const typename TriangleCodec::DecodingContext ctx(&mHeader, triangles);
+
 		RayCastTestOut *out = outRayCasts;
 		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
 		{
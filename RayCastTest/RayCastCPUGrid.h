@@ -0,0 +1,509 @@
+#pragma once
+
+#include <RayCastTest/RayCastTest.h>
+#include <Core/ByteBuffer.h>
+#include <Utils/Model.h>
+#include <Utils/PerfTimer.h>
+#include <TriangleGrouper/TriangleGrouperMorton.h>
+#include <Geometry/RayAABox.h>
+#include <thread>
+
+enum class ERayCastCPUGridVariant
+{
+	GRID_UNIFORM,														// Every cell has an entry in a dense array
+	GRID_HASHED,														// Only the non empty cells are stored, in a hash table
+};
+
+// Uniform grid over the model, the cells are visited in the order in which the ray passes through them (3D-DDA).
+//
+// The triangles are grouped in batches by morton code (like RayCastCPUAABBList) and every batch is packed once with the triangle codec.
+// A cell stores the indices of the batches whose bounds overlap the cell, the indices of all cells are stored one after the other.
+// A batch that overlaps multiple cells is tested only once per ray because of mailboxing: the last tested batches are remembered in
+// a small direct mapped table on the stack, so CastRays doesn't modify the test and can be called from multiple threads.
+//
+// The grid has about inCellsPerBatch * number of batches cells. GRID_UNIFORM stores the start of the batch indices for every cell,
+// GRID_HASHED only stores the non empty cells, which takes less memory for surface meshes where most cells are empty but needs a hash
+// table lookup for every visited cell. Both variants use the same resolution: a finer hashed grid tests fewer batches per cell, but the
+// extra hash table lookups along the ray cost more than that saves. The grid is built on inNumThreads threads (0 = use all hardware threads).
+template <class TriangleCodec>
+class RayCastCPUGrid : public RayCastTest
+{
+public:
+	// Header for the triangles
+	typedef typename TriangleCodec::TriangleHeader TriangleHeader;
+
+										RayCastCPUGrid(ERayCastCPUGridVariant inVariant, uint inTrianglesPerBatch, float inCellsPerBatch, uint inNumThreads = 0) :
+		mVariant(inVariant),
+		mTrianglesPerBatch(inTrianglesPerBatch),
+		mCellsPerBatch(inCellsPerBatch),
+		mNumThreads(inNumThreads > 0? inNumThreads : max(1u, thread::hardware_concurrency()))
+	{
+		// Must be power of 2
+		if (!IsPowerOf2(mTrianglesPerBatch))
+			FatalError("RayCastCPUGrid: Triangles per batch not power of 2");
+	}
+
+	virtual void						GetStats(StatsRow &ioRow) const override
+	{
+		size_t triangles_size = sizeof(mTriangleHeader) + mTriangles.size();
+		size_t nodes_size = mBounds.size() * sizeof(AABox) + mTrianglesStart.size() * sizeof(uint) + mCellBatches.size() * sizeof(uint32) + mCellStart.size() * sizeof(uint32) + mHashTable.size() * sizeof(HashEntry);
+		size_t total_size = triangles_size + nodes_size;
+
+		string resolution = ConvertToString(mResolution[0]) + "x" + ConvertToString(mResolution[1]) + "x" + ConvertToString(mResolution[2]);
+		ioRow.Set(StatsColumn::TestName, "RayCastCPUGrid");
+		ioRow.Set(StatsColumn::TestVariant, (mVariant == ERayCastCPUGridVariant::GRID_UNIFORM? "Uniform_" : "Hashed_") + resolution);
+		ioRow.Set(StatsColumn::TrianglesPerLeaf, mTrianglesPerBatch);
+		ioRow.Set(StatsColumn::TreeNodeCount, mResolution[0] * mResolution[1] * mResolution[2]);
+		ioRow.Set(StatsColumn::TreeLeafNodeCount, mNumNonEmptyCells);
+		ioRow.Set(StatsColumn::TreeMaxTrianglesPerLeaf, mMaxBatchesPerCell * mTrianglesPerBatch);
+		ioRow.Set(StatsColumn::TreeAvgTrianglesPerLeaf, mNumNonEmptyCells > 0? float(mCellBatches.size() * mTrianglesPerBatch) / mNumNonEmptyCells : 0.0f);
+		ioRow.Set(StatsColumn::BufferTotalSize, total_size);
+		ioRow.Set(StatsColumn::BufferNodesSize, nodes_size);
+		ioRow.Set(StatsColumn::BufferTrianglesSize, triangles_size);
+		ioRow.Set(StatsColumn::BufferBytesPerTriangle, (float)total_size / mModel->GetTriangleCount());
+		ioRow += mStats;
+	}
+
+	virtual void						Initialize() override
+	{
+		// Start timer
+		PerfTimer timer("RayCastCPUGrid::Initialize");
+		timer.Start();
+
+		const VertexList &vertices = mModel->GetTriangleVertices();
+		const IndexedTriangleList &triangle_list = mModel->GetIndexedTriangles();
+		const uint triangle_count = (uint)triangle_list.size();
+		const uint num_batches = (triangle_count + mTrianglesPerBatch - 1) / mTrianglesPerBatch;
+
+		// Group triangles according to locality
+		vector<uint> sorted_triangle_idx;
+		TriangleGrouperMorton grouper;
+		grouper.Group(vertices, triangle_list, mTrianglesPerBatch, sorted_triangle_idx);
+
+		// Calculate bounds for each batch and split up triangles
+		mBounds.resize(num_batches);
+		vector<IndexedTriangleList> containers;
+		containers.resize(num_batches);
+		for (uint t = 0; t < triangle_count; ++t)
+		{
+			const IndexedTriangle &triangle = triangle_list[sorted_triangle_idx[t]];
+			mBounds[t / mTrianglesPerBatch].Encapsulate(vertices, triangle);
+			containers[t / mTrianglesPerBatch].push_back(triangle);
+		}
+
+		// Make the bounding boxes a bit bigger to avoid missing hits due to numerical imprecision
+		for (AABox &bounds : mBounds)
+		{
+			bounds.WidenByFactor(0.002f);
+			bounds.EnsureMinimalEdgeLength(1.0e-5f);
+		}
+
+		// Fill up the last container to the right batch size
+		while (containers[num_batches - 1].size() < mTrianglesPerBatch)
+			containers[num_batches - 1].push_back(triangle_list[sorted_triangle_idx[triangle_count - 1]]);
+
+		typename TriangleCodec::EncodingContext tri_ctx;
+
+		// Reserve enough memory for the triangles
+		uint total_size = tri_ctx.GetPessimisticMemoryEstimate(AlignUp(triangle_count, mTrianglesPerBatch));
+		mTriangles.reserve(total_size);
+
+		// Add triangles
+		mTrianglesStart.resize(num_batches);
+		for (uint b = 0; b < num_batches; ++b)
+			mTrianglesStart[b] = tri_ctx.Pack(vertices, containers[b], mBounds[b].mMin, mBounds[b].mMax, mTriangles);
+
+		// Finalize the triangles
+		tri_ctx.Finalize(&mTriangleHeader, mTriangles);
+
+		// Get stats
+		string triangle_codec_name;
+		float vertices_per_triangle;
+		tri_ctx.GetStats(triangle_codec_name, vertices_per_triangle);
+		mStats.Set(StatsColumn::TriangleCodec, triangle_codec_name);
+		mStats.Set(StatsColumn::BufferVerticesPerTriangle, vertices_per_triangle);
+
+		// Validate that we reserved enough memory
+		if (total_size < (uint)mTriangles.size())
+			FatalError("RayCastCPUGrid: Not enough memory reserved");
+		mTriangles.shrink_to_fit();
+
+		// Determine the cells and fill them
+		CalculateResolution();
+		BuildCells();
+
+		// Stop timer
+		timer.Stop(1);
+		timer.Output();
+	}
+
+	virtual void						TrashCache() override
+	{
+		CacheTrasher::sTrash(mBounds);
+		CacheTrasher::sTrash(mTrianglesStart);
+		CacheTrasher::sTrash(mCellStart);
+		CacheTrasher::sTrash(mHashTable);
+		CacheTrasher::sTrash(mCellBatches);
+		CacheTrasher::sTrash(&mTriangleHeader);
+		CacheTrasher::sTrash(mTriangles);
+	}
+
+	virtual void						CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
+	{
+		if (mVariant == ERayCastCPUGridVariant::GRID_UNIFORM)
+			CastRaysInternal<ERayCastCPUGridVariant::GRID_UNIFORM>(inRayCastsBegin, inRayCastsEnd, outRayCasts);
+		else
+			CastRaysInternal<ERayCastCPUGridVariant::GRID_HASHED>(inRayCastsBegin, inRayCastsEnd, outRayCasts);
+	}
+
+private:
+	// Amount of batches that are remembered per ray to avoid testing them again (power of 2)
+	static constexpr uint32				cMailboxSize = 64;
+
+	// Maximum amount of cells along an axis and in total for GRID_UNIFORM (GRID_HASHED only stores the non empty cells so is only limited by cMaxResolution)
+	static constexpr uint				cMaxResolution = 1024;
+	static constexpr uint				cMaxUniformCells = 1 << 24;
+
+	// Margin in cells around the bounds of a batch when determining the cells it overlaps so that the 3D-DDA can't step past a hit due to rounding
+	static constexpr float				cCellMargin = 1.0e-3f;
+
+	// Value of an empty hash table entry or mailbox
+	static constexpr uint32				cInvalidIndex = 0xffffffff;
+
+	// Non empty cell for GRID_HASHED
+	struct HashEntry
+	{
+		uint32							mCell;								// Index of the cell (x + y * resolution x + z * resolution x * resolution y), cInvalidIndex if entry is empty
+		uint32							mStart;								// First batch index in mCellBatches
+		uint32							mCount;								// Number of batch indices
+	};
+
+	// Determine the size of the cells so that the grid has about mCellsPerBatch cells for every batch
+	void								CalculateResolution()
+	{
+		AABox grid_bounds;
+		for (const AABox &bounds : mBounds)
+			grid_bounds.Encapsulate(bounds);
+		Vec3 size = grid_bounds.GetSize();
+
+		// Cubic cells, axis that are thinner than a cell get a single cell and the cell size is recalculated for the other axis
+		float num_cells = Clamp(mCellsPerBatch * mBounds.size(), 1.0f, mVariant == ERayCastCPUGridVariant::GRID_UNIFORM? float(cMaxUniformCells) : FLT_MAX);
+		bool single_cell[3] = { false, false, false };
+		float cell_size = 0.0f;
+		for (bool changed = true; changed; )
+		{
+			float volume = 1.0f;
+			int num_axis = 0;
+			for (uint a = 0; a < 3; ++a)
+				if (!single_cell[a])
+				{
+					volume *= size[a];
+					++num_axis;
+				}
+			cell_size = pow(volume / num_cells, 1.0f / num_axis);
+
+			changed = false;
+			for (uint a = 0; a < 3; ++a)
+				if (!single_cell[a] && size[a] < cell_size)
+				{
+					single_cell[a] = true;
+					changed = true;
+				}
+		}
+
+		for (uint a = 0; a < 3; ++a)
+		{
+			mResolution[a] = single_cell[a]? 1 : Clamp(uint(size[a] / cell_size + 0.5f), 1u, cMaxResolution);
+			mCellSize[a] = size[a] / mResolution[a];
+			mInvCellSize[a] = mResolution[a] / size[a];
+		}
+		mGridMin = grid_bounds.mMin;
+		mGridMax = grid_bounds.mMax;
+	}
+
+	// Get the range of cells that overlap a box
+	void								GetCellRange(const AABox &inBounds, uint *outMin, uint *outMax) const
+	{
+		Vec3 min = (inBounds.mMin - mGridMin) * mInvCellSize - Vec3::sReplicate(cCellMargin);
+		Vec3 max = (inBounds.mMax - mGridMin) * mInvCellSize + Vec3::sReplicate(cCellMargin);
+		for (uint a = 0; a < 3; ++a)
+		{
+			outMin[a] = uint(Clamp(int(floor(min[a])), 0, int(mResolution[a]) - 1));
+			outMax[a] = uint(Clamp(int(floor(max[a])), 0, int(mResolution[a]) - 1));
+		}
+	}
+
+	// Fill the cells with the batches that overlap them
+	void								BuildCells()
+	{
+		const uint num_batches = (uint)mBounds.size();
+
+		// Count the cells that every batch overlaps
+		vector<uint> first_pair(num_batches + 1);
+		first_pair[0] = 0;
+		sParallelFor(num_batches, mNumThreads, [this, &first_pair](uint inBegin, uint inEnd)
+		{
+			for (uint b = inBegin; b < inEnd; ++b)
+			{
+				uint min[3], max[3];
+				GetCellRange(mBounds[b], min, max);
+				first_pair[b + 1] = (max[0] - min[0] + 1) * (max[1] - min[1] + 1) * (max[2] - min[2] + 1);
+			}
+		});
+		for (uint b = 0; b < num_batches; ++b)
+			first_pair[b + 1] += first_pair[b];
+
+		// Create a (cell, batch) pair for every cell that a batch overlaps and sort them on cell
+		vector<uint64> pairs(first_pair[num_batches]);
+		sParallelFor(num_batches, mNumThreads, [this, &first_pair, &pairs](uint inBegin, uint inEnd)
+		{
+			for (uint b = inBegin; b < inEnd; ++b)
+			{
+				uint min[3], max[3];
+				GetCellRange(mBounds[b], min, max);
+				uint64 *pair = &pairs[first_pair[b]];
+				for (uint z = min[2]; z <= max[2]; ++z)
+					for (uint y = min[1]; y <= max[1]; ++y)
+						for (uint x = min[0]; x <= max[0]; ++x)
+							*pair++ = (uint64(x + mResolution[0] * (y + mResolution[1] * z)) << 32) | b;
+			}
+		});
+		sParallelSort(pairs, mNumThreads);
+
+		// Store the batch indices, the batches of a cell are now consecutive
+		mCellBatches.resize(pairs.size());
+		for (size_t i = 0; i < pairs.size(); ++i)
+			mCellBatches[i] = uint32(pairs[i]);
+
+		// Find the ranges of the non empty cells
+		vector<HashEntry> cells;
+		for (uint i = 0, n = (uint)pairs.size(); i < n; )
+		{
+			uint32 cell = uint32(pairs[i] >> 32);
+			uint start = i;
+			while (i < n && uint32(pairs[i] >> 32) == cell)
+				++i;
+			cells.push_back({ cell, start, i - start });
+		}
+		mNumNonEmptyCells = (uint)cells.size();
+		mMaxBatchesPerCell = 0;
+		for (const HashEntry &cell : cells)
+			mMaxBatchesPerCell = max(mMaxBatchesPerCell, cell.mCount);
+
+		if (mVariant == ERayCastCPUGridVariant::GRID_UNIFORM)
+		{
+			// Store the start of every cell, the end is the start of the next cell
+			uint num_cells = mResolution[0] * mResolution[1] * mResolution[2];
+			mCellStart.assign(num_cells + 1, 0);
+			for (const HashEntry &cell : cells)
+				mCellStart[cell.mCell + 1] = cell.mCount;
+			for (uint c = 0; c < num_cells; ++c)
+				mCellStart[c + 1] += mCellStart[c];
+		}
+		else
+		{
+			// Hash table with linear probing that is at most half full
+			uint table_size = 2;
+			while (table_size < 2 * cells.size())
+				table_size <<= 1;
+			mHashShift = 32 - CountTrailingZeros(table_size);
+			mHashTable.assign(table_size, { cInvalidIndex, 0, 0 });
+			for (const HashEntry &cell : cells)
+			{
+				uint32 index = sHashCell(cell.mCell, mHashShift);
+				while (mHashTable[index].mCell != cInvalidIndex)
+					index = (index + 1) & (table_size - 1);
+				mHashTable[index] = cell;
+			}
+		}
+	}
+
+	// Hash of a cell index (fibonacci hashing), returns a number in the range [0, 2^(32 - inShift))
+	static f_inline uint32				sHashCell(uint32 inCell, uint inShift)
+	{
+		return (inCell * 0x9e3779b1u) >> inShift;
+	}
+
+	// Get the batch indices of a cell
+	template <ERayCastCPUGridVariant Variant>
+	f_inline void						GetCellBatches(uint32 inCell, const uint32 *&outBegin, const uint32 *&outEnd) const
+	{
+		if (Variant == ERayCastCPUGridVariant::GRID_UNIFORM)
+		{
+			outBegin = mCellBatches.data() + mCellStart[inCell];
+			outEnd = mCellBatches.data() + mCellStart[inCell + 1];
+		}
+		else
+		{
+			outBegin = outEnd = mCellBatches.data();
+			uint32 mask = uint32(mHashTable.size() - 1);
+			for (uint32 index = sHashCell(inCell, mHashShift); mHashTable[index].mCell != cInvalidIndex; index = (index + 1) & mask)
+				if (mHashTable[index].mCell == inCell)
+				{
+					outBegin += mHashTable[index].mStart;
+					outEnd = outBegin + mHashTable[index].mCount;
+					break;
+				}
+		}
+	}
+
+	// Walk the cells along the rays with a 3D-DDA
+	template <ERayCastCPUGridVariant Variant>
+	void								CastRaysInternal(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) const
+	{
+		const typename TriangleCodec::DecodingContext ctx(&mTriangleHeader, &mTriangles[0]);
+
+		RayCastTestOut *out = outRayCasts;
+		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
+		{
+			Vec3 origin(ray->mOrigin);
+			Vec3 direction(ray->mDirection);
+			Vec3 inv_direction = direction.Reciprocal();
+			UVec4 is_parallel = RayIsParallel(direction);
+
+			float closest = FLT_MAX;
+
+			// Find where the ray enters the grid
+			float t_enter, t_exit;
+			RayAABox(origin, inv_direction, is_parallel, mGridMin, mGridMax, t_enter, t_exit);
+			if (t_enter <= t_exit)
+			{
+				t_enter = max(t_enter, 0.0f);
+				Vec3 start = (origin + t_enter * direction - mGridMin) * mInvCellSize;
+
+				// Determine the first cell and the distances along the ray to the next cell boundary for every axis
+				int cell[3], step[3], end[3];
+				float t_next[3], t_delta[3];
+				for (uint a = 0; a < 3; ++a)
+				{
+					cell[a] = Clamp(int(floor(start[a])), 0, int(mResolution[a]) - 1);
+					if (direction[a] > 0.0f)
+					{
+						step[a] = 1;
+						end[a] = int(mResolution[a]);
+						t_next[a] = (mGridMin[a] + (cell[a] + 1) * mCellSize[a] - origin[a]) * inv_direction[a];
+						t_delta[a] = mCellSize[a] * inv_direction[a];
+					}
+					else if (direction[a] < 0.0f)
+					{
+						step[a] = -1;
+						end[a] = -1;
+						t_next[a] = (mGridMin[a] + cell[a] * mCellSize[a] - origin[a]) * inv_direction[a];
+						t_delta[a] = -mCellSize[a] * inv_direction[a];
+					}
+					else
+					{
+						step[a] = 0;
+						end[a] = -1;
+						t_next[a] = FLT_MAX;
+						t_delta[a] = 0.0f;
+					}
+				}
+
+				// Batches that have already been tested against this ray
+				uint32 mailbox[cMailboxSize];
+				for (uint32 &m : mailbox)
+					m = cInvalidIndex;
+
+				for (;;)
+				{
+					// Test the batches in the cell
+					const uint32 *batch, *batch_end;
+					GetCellBatches<Variant>(uint32(cell[0] + mResolution[0] * (cell[1] + mResolution[1] * cell[2])), batch, batch_end);
+					for (; batch < batch_end; ++batch)
+					{
+						uint32 b = *batch;
+						uint32 &mailbox_entry = mailbox[b & (cMailboxSize - 1)];
+						if (mailbox_entry == b)
+							continue;
+						mailbox_entry = b;
+
+						const AABox &bounds = mBounds[b];
+						if (RayAABoxHits(origin, inv_direction, is_parallel, bounds.mMin, bounds.mMax, closest))
+							ctx.TestRay(origin, direction, bounds.mMin, bounds.mMax, &mTriangles[mTrianglesStart[b]], mTrianglesPerBatch, closest);
+					}
+
+					// Step to the next cell along the axis with the closest boundary, a hit before that boundary can't be beaten by the next cells
+					uint a = t_next[0] < t_next[1]? (t_next[0] < t_next[2]? 0 : 2) : (t_next[1] < t_next[2]? 1 : 2);
+					if (closest <= t_next[a])
+						break;
+					cell[a] += step[a];
+					if (cell[a] == end[a])
+						break;
+					t_next[a] += t_delta[a];
+				}
+			}
+
+			out->mDistance = closest;
+		}
+	}
+
+	// Call inFunction(begin, end) for blocks of the range [0, inCount) on inNumThreads threads
+	template <class Function>
+	static void							sParallelFor(uint inCount, uint inNumThreads, const Function &inFunction)
+	{
+		uint num_threads = min(inNumThreads, inCount);
+		if (num_threads <= 1)
+		{
+			inFunction(0, inCount);
+			return;
+		}
+
+		vector<thread> threads;
+		uint block_size = (inCount + num_threads - 1) / num_threads;
+		for (uint begin = block_size; begin < inCount; begin += block_size)
+			threads.emplace_back([&inFunction, begin, end = min(inCount, begin + block_size)]() { inFunction(begin, end); });
+		inFunction(0, block_size);
+		for (thread &t : threads)
+			t.join();
+	}
+
+	// Sort on inNumThreads threads, blocks are sorted in parallel and then merged pairwise
+	static void							sParallelSort(vector<uint64> &ioValues, uint inNumThreads)
+	{
+		uint count = (uint)ioValues.size();
+		uint num_blocks = min(inNumThreads, max(1u, count / 4096));
+		uint block_size = (count + num_blocks - 1) / num_blocks;
+		if (block_size == 0)
+			return;
+
+		sParallelFor(num_blocks, num_blocks, [&ioValues, count, block_size](uint inBegin, uint inEnd)
+		{
+			for (uint b = inBegin; b < inEnd; ++b)
+				sort(ioValues.begin() + b * block_size, ioValues.begin() + min(count, (b + 1) * block_size));
+		});
+
+		for (uint width = block_size; width < count; width *= 2)
+			sParallelFor((count + 2 * width - 1) / (2 * width), inNumThreads, [&ioValues, count, width](uint inBegin, uint inEnd)
+			{
+				for (uint m = inBegin; m < inEnd; ++m)
+				{
+					uint start = m * 2 * width;
+					inplace_merge(ioValues.begin() + start, ioValues.begin() + min(count, start + width), ioValues.begin() + min(count, start + 2 * width));
+				}
+			});
+	}
+
+	vector<AABox>						mBounds;
+	vector<uint>						mTrianglesStart;
+	vector<uint32>						mCellStart;							// GRID_UNIFORM: Start of the batch indices of every cell in mCellBatches
+	vector<HashEntry>					mHashTable;							// GRID_HASHED: Non empty cells
+	uint								mHashShift = 32;					// GRID_HASHED: Shift of sHashCell for the size of mHashTable
+	vector<uint32>						mCellBatches;						// Indices of the batches that overlap a cell, consecutive per cell
+	TriangleHeader						mTriangleHeader;
+	ByteBuffer							mTriangles;
+
+	Vec3								mGridMin;
+	Vec3								mGridMax;
+	Vec3								mCellSize;
+	Vec3								mInvCellSize;
+	uint								mResolution[3] = { 0, 0, 0 };
+	uint								mNumNonEmptyCells = 0;
+	uint								mMaxBatchesPerCell = 0;
+
+	ERayCastCPUGridVariant				mVariant;
+	uint								mTrianglesPerBatch;
+	float								mCellsPerBatch;
+	uint								mNumThreads;
+	StatsRow							mStats;
+};
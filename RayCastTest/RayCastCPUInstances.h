@@ -0,0 +1,284 @@
+#pragma once
+
+#include <RayCastTest/RayCastTest.h>
+#include <Geometry/AABox.h>
+#include <Geometry/RayAABox.h>
+#include <Core/AlignedAllocator.h>
+#include <Core/StringTools.h>
+
+// Raycast against instances of meshes on CPU (two level tree)
+//
+// Every mesh is a ray cast test of its own (the bottom level), it can use any of the trees and codecs.
+// The instances place the meshes in the world with a transform, a quad tree over the world space bounds of the instances (the top level)
+// finds the instances that a ray can hit. The ray is transformed into the space of the mesh and cast against the mesh.
+// The direction of the ray is not normalized after transforming so that the distance along the ray is the same in both spaces.
+class RayCastCPUInstances : public RayCastTest
+{
+public:
+	// An instance of a mesh
+	struct Instance
+	{
+		Mat44						mTransform;							// Transform from mesh space to world space
+		uint						mMesh;								// Index of the mesh
+	};
+
+	// Constructor, takes ownership of the meshes. The meshes should have been initialized, inMeshBounds are the bounds of the meshes in mesh space.
+									RayCastCPUInstances(const vector<RayCastTest *> &inMeshes, const vector<AABox> &inMeshBounds, const vector<Instance> &inInstances) : mMeshes(inMeshes), mMeshBounds(inMeshBounds), mInstances(inInstances) { }
+
+	virtual							~RayCastCPUInstances() override
+	{
+		for (RayCastTest *mesh : mMeshes)
+			delete mesh;
+	}
+
+	virtual void					GetStats(StatsRow &ioRow) const override
+	{
+		// Get the stats of the first mesh and sum the sizes of all meshes
+		uint64 total_size = 0, nodes_size = 0;
+		for (const RayCastTest *mesh : mMeshes)
+		{
+			StatsRow row;
+			mesh->GetStats(row);
+			total_size += strtoull(row.Get(StatsColumn::BufferTotalSize).c_str(), nullptr, 10);
+			nodes_size += strtoull(row.Get(StatsColumn::BufferNodesSize).c_str(), nullptr, 10);
+			if (mesh == mMeshes.front())
+				ioRow += row;
+		}
+
+		// Add the top level tree
+		uint64 top_level_size = mNodes.size() * sizeof(Node) + mInstanceData.size() * sizeof(InstanceData);
+		ioRow.Set(StatsColumn::TestName, "RayCastCPUInstances");
+		ioRow.Set(StatsColumn::TestVariant, "Meshes" + ConvertToString(mMeshes.size()) + "_Instances" + ConvertToString(mInstances.size()));
+		ioRow.Set(StatsColumn::BufferTotalSize, ConvertToString(total_size + top_level_size));
+		ioRow.Set(StatsColumn::BufferNodesSize, ConvertToString(nodes_size + top_level_size));
+	}
+
+	virtual void					Initialize() override
+	{
+		// Calculate world space bounds and the transforms to mesh space
+		mInstanceData.clear();
+		mInstanceData.reserve(mInstances.size());
+		mInstanceBounds.clear();
+		mInstanceBounds.reserve(mInstances.size());
+		for (const Instance &instance : mInstances)
+		{
+			if (instance.mMesh >= mMeshes.size())
+				FatalError("RayCastCPUInstances: Invalid mesh index %u", instance.mMesh);
+			mInstanceData.push_back({ instance.mTransform.Inversed(), mMeshes[instance.mMesh] });
+			mInstanceBounds.push_back(mMeshBounds[instance.mMesh].Transformed(instance.mTransform));
+		}
+
+		// Build the top level tree
+		mNodes.clear();
+		if (mInstances.empty())
+			return;
+		if (mInstances.size() >= (UNUSED_CHILD & ~INSTANCE_FLAG))
+			FatalError("RayCastCPUInstances: Too many instances");
+		vector<uint> instances;
+		instances.reserve(mInstances.size());
+		for (uint i = 0; i < (uint)mInstances.size(); ++i)
+			instances.push_back(i);
+		mNodes.reserve(mInstances.size()); // Every node has at least 2 children so this is enough
+		BuildNode(&instances[0], &instances[0] + instances.size());
+	}
+
+	virtual void					TrashCache() override
+	{
+		CacheTrasher::sTrash(mNodes);
+		CacheTrasher::sTrash(mInstanceData);
+		for (RayCastTest *mesh : mMeshes)
+			mesh->TrashCache();
+	}
+
+	virtual void					CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
+	{
+		RayCastTestOut *out = outRayCasts;
+		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
+		{
+			float closest = FLT_MAX;
+
+			if (!mNodes.empty())
+			{
+				Vec3 origin(ray->mOrigin);
+				Vec3 direction(ray->mDirection);
+				Vec3 inv_direction = direction.Reciprocal();
+				UVec4 is_parallel = RayIsParallel(direction);
+
+				const int stack_size = 128;
+				uint32 node_stack[stack_size];
+				float distance_stack[stack_size];
+				node_stack[0] = 0;
+				distance_stack[0] = 0;
+				int top = 0;
+				do
+				{
+					uint32 node_properties = node_stack[top];
+					if ((node_properties & INSTANCE_FLAG) == 0)
+					{
+						assert(node_properties < mNodes.size());
+						const Node &node = mNodes[node_properties];
+
+						// Test bounds of 4 children
+						Vec4 bounds_minx = Vec4LoadFloat4ConditionallyAligned<true>(&node.mBoundsMinX);
+						Vec4 bounds_miny = Vec4LoadFloat4ConditionallyAligned<true>(&node.mBoundsMinY);
+						Vec4 bounds_minz = Vec4LoadFloat4ConditionallyAligned<true>(&node.mBoundsMinZ);
+						Vec4 bounds_maxx = Vec4LoadFloat4ConditionallyAligned<true>(&node.mBoundsMaxX);
+						Vec4 bounds_maxy = Vec4LoadFloat4ConditionallyAligned<true>(&node.mBoundsMaxY);
+						Vec4 bounds_maxz = Vec4LoadFloat4ConditionallyAligned<true>(&node.mBoundsMaxZ);
+						Vec4 distance = RayAABox4(origin, inv_direction, is_parallel, bounds_minx, bounds_miny, bounds_minz, bounds_maxx, bounds_maxy, bounds_maxz);
+
+						// Load properties for 4 children
+						UVec4 properties = UVec4LoadInt4ConditionallyAligned<true>(&node.mNodeProperties[0]);
+
+						// Sort so that highest values are first (we want to first process closer hits and we process stack top to bottom)
+						Vec4::sSort4Reverse(distance, properties);
+
+						// Count how many results are closer
+						UVec4 closer = Vec4::sLess(distance, Vec4::sReplicate(closest));
+						int num_results = closer.CountTrues();
+
+						// Shift the results so that only the closer ones remain
+						distance = distance.ReinterpretAsInt().ShiftComponents4Minus(num_results).ReinterpretAsFloat();
+						properties = properties.ShiftComponents4Minus(num_results);
+
+						// Push them onto the stack
+						assert(top + 4 < stack_size);
+						distance.StoreFloat4((Float4 *)&distance_stack[top]);
+						properties.StoreInt4(&node_stack[top]);
+						top += num_results;
+					}
+					else if (node_properties != UNUSED_CHILD)
+					{
+						// Transform the ray to mesh space and cast it against the mesh
+						// Unused children are skipped here, their bounds are at FLT_MAX so a ray shouldn't reach them in the first place
+						assert((node_properties & ~INSTANCE_FLAG) < mInstanceData.size());
+						const InstanceData &instance = mInstanceData[node_properties & ~INSTANCE_FLAG];
+						RayCastTestIn mesh_ray;
+						(instance.mInvTransform * origin).StoreFloat3(&mesh_ray.mOrigin);
+						instance.mInvTransform.Multiply3x3(direction).StoreFloat3(&mesh_ray.mDirection);
+						RayCastTestOut mesh_out;
+						instance.mMesh->CastRays(&mesh_ray, &mesh_ray + 1, &mesh_out);
+						closest = min(closest, mesh_out.mDistance);
+					}
+
+					// Fetch next node that could give a closer hit
+					do
+						--top;
+					while (top >= 0 && distance_stack[top] >= closest);
+				}
+				while (top >= 0);
+			}
+
+			out->mDistance = closest;
+		}
+	}
+
+private:
+	// Node properties with INSTANCE_FLAG set refer to an instance, otherwise to a node.
+	// UNUSED_CHILD pads nodes with less than 4 children, Initialize makes sure that it is never a valid instance index.
+	enum : uint32
+	{
+		INSTANCE_FLAG					= 0x80000000,
+		UNUSED_CHILD					= 0xffffffff,
+	};
+
+	// Node of the top level tree, the bounds of 4 children are stored in SOA form
+	struct alignas(16) Node
+	{
+		Float4						mBoundsMinX;
+		Float4						mBoundsMinY;
+		Float4						mBoundsMinZ;
+		Float4						mBoundsMaxX;
+		Float4						mBoundsMaxY;
+		Float4						mBoundsMaxZ;
+		uint32						mNodeProperties[4];					// Index of the child node, INSTANCE_FLAG + index of the instance or UNUSED_CHILD
+	};
+
+	// Data needed to cast a ray against an instance
+	struct InstanceData
+	{
+		Mat44						mInvTransform;						// Transform from world space to mesh space
+		RayCastTest *				mMesh;
+	};
+
+	// Reorder [inBegin, inEnd) so that the first half is below the second half along the longest axis of the centers of the instances, returns the middle
+	uint *							Split(uint *inBegin, uint *inEnd) const
+	{
+		AABox centers;
+		for (const uint *i = inBegin; i < inEnd; ++i)
+			centers.Encapsulate(mInstanceBounds[*i].GetCenter());
+		Vec3 size = centers.GetSize();
+		uint axis = size.GetX() > size.GetY()? (size.GetX() > size.GetZ()? 0 : 2) : (size.GetY() > size.GetZ()? 1 : 2);
+
+		uint *middle = inBegin + (inEnd - inBegin) / 2;
+		nth_element(inBegin, middle, inEnd, [this, axis](uint inLHS, uint inRHS) { return mInstanceBounds[inLHS].GetCenter()[axis] < mInstanceBounds[inRHS].GetCenter()[axis]; });
+		return middle;
+	}
+
+	// Build a node for the instances in [inBegin, inEnd) and its children, returns the index of the node
+	uint							BuildNode(uint *inBegin, uint *inEnd)
+	{
+		uint node_index = (uint)mNodes.size();
+		mNodes.emplace_back();
+
+		// Split the instances in 4 groups, or give every instance its own child when there are 4 or less
+		uint *groups[5];
+		int num_groups;
+		if (inEnd - inBegin <= 4)
+		{
+			num_groups = int(inEnd - inBegin);
+			for (int g = 0; g <= num_groups; ++g)
+				groups[g] = inBegin + g;
+		}
+		else
+		{
+			uint *middle = Split(inBegin, inEnd);
+			groups[0] = inBegin;
+			groups[1] = Split(inBegin, middle);
+			groups[2] = middle;
+			groups[3] = Split(middle, inEnd);
+			groups[4] = inEnd;
+			num_groups = 4;
+		}
+
+		// Build the children first, this can resize mNodes
+		uint32 properties[4];
+		AABox bounds[4];
+		for (int g = 0; g < num_groups; ++g)
+			if (groups[g + 1] - groups[g] == 1)
+			{
+				properties[g] = INSTANCE_FLAG | *groups[g];
+				bounds[g] = mInstanceBounds[*groups[g]];
+			}
+			else
+			{
+				properties[g] = BuildNode(groups[g], groups[g + 1]);
+				for (const uint *i = groups[g]; i < groups[g + 1]; ++i)
+					bounds[g].Encapsulate(mInstanceBounds[*i]);
+			}
+
+		// Unused children get bounds at FLT_MAX so that a ray never hits them and are marked with UNUSED_CHILD
+		Node &node = mNodes[node_index];
+		for (int g = 0; g < 4; ++g)
+		{
+			Vec3 bounds_min = g < num_groups? bounds[g].mMin : Vec3::sReplicate(FLT_MAX);
+			Vec3 bounds_max = g < num_groups? bounds[g].mMax : Vec3::sReplicate(FLT_MAX);
+			reinterpret_cast<float *>(&node.mBoundsMinX)[g] = bounds_min.GetX();
+			reinterpret_cast<float *>(&node.mBoundsMinY)[g] = bounds_min.GetY();
+			reinterpret_cast<float *>(&node.mBoundsMinZ)[g] = bounds_min.GetZ();
+			reinterpret_cast<float *>(&node.mBoundsMaxX)[g] = bounds_max.GetX();
+			reinterpret_cast<float *>(&node.mBoundsMaxY)[g] = bounds_max.GetY();
+			reinterpret_cast<float *>(&node.mBoundsMaxZ)[g] = bounds_max.GetZ();
+			node.mNodeProperties[g] = g < num_groups? properties[g] : UNUSED_CHILD;
+		}
+
+		return node_index;
+	}
+
+	vector<RayCastTest *>			mMeshes;
+	vector<AABox>					mMeshBounds;
+	vector<Instance>				mInstances;
+	vector<AABox>					mInstanceBounds;
+	vector<InstanceData>			mInstanceData;
+	vector<Node, AlignedAllocator<Node, 16>> mNodes;
+};
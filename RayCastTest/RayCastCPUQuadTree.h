@@ -13,7 +13,7 @@ public:
 
 	typedef NodeCodecQuadTree<Alignment> NodeCodec;
 
-									RayCastCPUQuadTree(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST) : mVertices(inVertices), mRoot(inRoot), mConvertMode(inConvertMode) { }
+									RayCastCPUQuadTree(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST, bool inAllowRefit = false) : mVertices(inVertices), mTree(inTree), mConvertMode(inConvertMode), mAllowRefit(inAllowRefit) { }
 
 	virtual void					GetStats(StatsRow &ioRow) const override
 	{
@@ -25,10 +25,16 @@ public:
 	virtual void					Initialize() override
 	{
 		AABBTreeToBufferStats stats;
-		mBuffer.Convert(mVertices, mRoot, stats, mConvertMode);
+		mBuffer.Convert(mVertices, *mTree, stats, mConvertMode, mAllowRefit);
 		mStats.Set(stats);
 	}
 
+	// Update the tree after the vertices that were passed to the constructor have moved, the test must have been created with inAllowRefit
+	void							Refit()
+	{
+		mBuffer.Refit(mVertices);
+	}
+
 	virtual void					TrashCache() override
 	{
 		CacheTrasher::sTrash(mBuffer.GetBuffer());
@@ -36,13 +42,25 @@ public:
 
 	virtual void					CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
 	{
-		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), mBuffer.GetBuffer());
+		sCastRays(&mBuffer.GetBuffer()[0], mBuffer.GetNodeHeader(), mBuffer.GetTriangleHeader(), inRayCastsBegin, inRayCastsEnd, outRayCasts);
+	}
+
+	virtual void					CastOcclusionRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
+	{
+		sCastRays<true>(&mBuffer.GetBuffer()[0], mBuffer.GetNodeHeader(), mBuffer.GetTriangleHeader(), inRayCastsBegin, inRayCastsEnd, outRayCasts, 1.0f);
+	}
+
+	// Cast rays against a buffer that was created with NodeCodec and TriangleCodec (by AABBTreeToBuffer or DynamicAABBTreeToBuffer).
+	// Hits at or beyond inMaxDistance are ignored, when AnyHit is true a ray stops at the first hit that is found instead of the closest hit.
+	template <bool AnyHit = false>
+	static void						sCastRays(const uint8 *inBufferStart, const typename NodeCodec::Header *inHeader, const typename TriangleCodec::TriangleHeader *inTriangleHeader, const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts, float inMaxDistance = FLT_MAX)
+	{
+		const typename TriangleCodec::DecodingContext ctx(inTriangleHeader, inBufferStart);
 
-		const typename NodeCodec::Header *header = mBuffer.GetNodeHeader();
-		const Vec3 root_bounds_min(header->mRootBoundsMin);
-		const Vec3 root_bounds_max(header->mRootBoundsMax);
-		const uint8 *buffer_start = &mBuffer.GetBuffer()[0];
-		uint root_properties = header->mRootProperties;
+		const Vec3 root_bounds_min(inHeader->mRootBoundsMin);
+		const Vec3 root_bounds_max(inHeader->mRootBoundsMax);
+		const uint8 *buffer_start = inBufferStart;
+		uint root_properties = inHeader->mRootProperties;
 		
 		RayCastTestOut *out = outRayCasts;
 		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
@@ -52,7 +70,7 @@ public:
 			Vec3 inv_direction = direction.Reciprocal();
 			UVec4 is_parallel = RayIsParallel(direction);
 
-			float closest = FLT_MAX;
+			float closest = inMaxDistance;
 			const int stack_size = 128;
 			uint32 node_stack[stack_size];
 			float distance_stack[stack_size];
@@ -111,16 +129,17 @@ public:
 					--top;
 				while (top >= 0 && distance_stack[top] >= closest);
 			}
-			while (top >= 0);
+			while (top >= 0 && (!AnyHit || closest >= inMaxDistance));
 
 			out->mDistance = closest;
 		}
 	}
 
 private:
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
 	EAABBTreeToBufferConvertMode	mConvertMode;
+	bool							mAllowRefit;
 	AABBTreeToBuffer<TriangleCodec, NodeCodec> mBuffer;
 	StatsRow						mStats;
 };
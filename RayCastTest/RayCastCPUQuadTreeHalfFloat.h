@@ -2,9 +2,41 @@
 
 #include <RayCastTest/RayCastTest.h>
 #include <AABBTree/AABBTreeToBuffer.h>
+#include <AABBTree/AABBTreeFile.h>
 #include <NodeCodec/NodeCodecQuadTreeHalfFloat.h>
 #include <Geometry/RayAABox.h>
 
+// Which data to prefetch while traversing the tree
+enum class EQuadTreePrefetch
+{
+	NONE,
+	NEAREST_CHILD,												// The child that will be visited next
+	HIT_CHILDREN,												// All children that the ray hits
+	HIT_CHILDREN_AND_VERTICES,									// All children that the ray hits and the vertices of the next triangle block (if the triangle codec supports it)
+};
+
+// Convert prefetch policy to string
+inline string ConvertToString(EQuadTreePrefetch inPrefetch)
+{
+	switch (inPrefetch)
+	{
+	case EQuadTreePrefetch::NONE:						return "None";
+	case EQuadTreePrefetch::NEAREST_CHILD:				return "NearestChild";
+	case EQuadTreePrefetch::HIT_CHILDREN:				return "HitChildren";
+	case EQuadTreePrefetch::HIT_CHILDREN_AND_VERTICES:	return "HitChildrenAndVertices";
+	}
+
+	assert(false);
+	return "Invalid";
+}
+
+// Checks if a triangle decoding context has a PrefetchVertices function
+template <class T, class = void>
+struct HasPrefetchVertices : false_type { };
+
+template <class T>
+struct HasPrefetchVertices<T, void_t<decltype(&T::PrefetchVertices)>> : true_type { };
+
 // Raycast against Quad tree on CPU
 template <class TriangleCodec, int Alignment>
 class RayCastCPUQuadTreeHalfFloat : public RayCastTest
@@ -14,121 +46,331 @@ public:
 
 	typedef NodeCodecQuadTreeHalfFloat<Alignment> NodeCodec;
 
-									RayCastCPUQuadTreeHalfFloat(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST) : mVertices(inVertices), mRoot(inRoot), mConvertMode(inConvertMode) { }
+	// Maximum amount of rays that can be traversed at the same time
+	static constexpr uint			cMaxRaysInFlight = 32;
+
+	// If inTreeFileName is specified and the file exists, the tree is memory mapped from this file and inTree is not used.
+	// If the file doesn't exist, the tree is converted from inTree and written to the file.
+	// The file is tied to inVertices and the triangles of the model set with SetSubSystems, a file that was built from another model is rejected.
+	// If inAllowRefit is true, the converted tree can be updated with Refit (a mapped tree can't be refitted).
+	// If inRaysInFlight is more than 1, the traversal of that many rays is interleaved to hide the latency of fetching nodes from memory.
+	// inPrefetch determines which data is prefetched when a node has been visited.
+									RayCastCPUQuadTreeHalfFloat(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST, const char *inTreeFileName = nullptr, bool inAllowRefit = false, uint inRaysInFlight = 1, EQuadTreePrefetch inPrefetch = EQuadTreePrefetch::NONE) : mVertices(inVertices), mTree(inTree), mConvertMode(inConvertMode), mTreeFileName(inTreeFileName), mAllowRefit(inAllowRefit), mRaysInFlight(inRaysInFlight), mPrefetch(inPrefetch)
+	{
+		if (mRaysInFlight < 1 || mRaysInFlight > cMaxRaysInFlight)
+			FatalError("RayCastCPUQuadTreeHalfFloat: Rays in flight should be between 1 and %d", cMaxRaysInFlight);
+	}
 
 	virtual void					GetStats(StatsRow &ioRow) const override
 	{
 		ioRow.Set(StatsColumn::TestName, "RayCastCPUQuadTreeHalfFloat");
-		ioRow.Set(StatsColumn::TestVariant, "NodeAlign" + ConvertToString(Alignment) + "_" + ConvertToString(mConvertMode));
+		ioRow.Set(StatsColumn::TestVariant, "NodeAlign" + ConvertToString(Alignment) + "_" + ConvertToString(mConvertMode) + (mTreeFile.GetBufferStart() != nullptr? "_Mapped" : "") + (mRaysInFlight > 1? "_InFlight" + ConvertToString(mRaysInFlight) : "") + (mPrefetch != EQuadTreePrefetch::NONE? "_Prefetch" + ConvertToString(mPrefetch) : ""));
 		ioRow += mStats;
 	}
 
 	virtual void					Initialize() override
 	{
+		string tree_type = "QuadTreeHalfFloatAlign" + ConvertToString(Alignment);
+
+		// The tree file stores which model it was built from
+		if (mTreeFileName != nullptr && mModel == nullptr)
+			FatalError("RayCastCPUQuadTreeHalfFloat: Need a model to use a tree file");
+
 		AABBTreeToBufferStats stats;
-		mBuffer.Convert(mVertices, mRoot, stats, mConvertMode);
+		if (mTreeFileName != nullptr && FileExists(mTreeFileName))
+		{
+			// Use the prebuilt tree, the traversal runs directly on the mapped file
+			mTreeFile.ReadFromFile(mTreeFileName, tree_type.c_str(), mVertices, mModel->GetIndexedTriangleView(), stats);
+			mConvertMode = mTreeFile.GetConvertMode();
+			mBufferStart = mTreeFile.GetBufferStart();
+			mBufferSize = mTreeFile.GetBufferSize();
+			mNodeHeader = mTreeFile.GetNodeHeader();
+			mTriangleHeader = mTreeFile.GetTriangleHeader();
+		}
+		else
+		{
+			if (mTree == nullptr)
+				FatalError("RayCastCPUQuadTreeHalfFloat: No tree to convert");
+
+			mBuffer.Convert(mVertices, *mTree, stats, mConvertMode, mAllowRefit);
+			if (mTreeFileName != nullptr)
+				AABBTreeFile<TriangleCodec, NodeCodec>::sWriteToFile(mTreeFileName, tree_type.c_str(), mConvertMode, mBuffer, stats, mVertices, mModel->GetIndexedTriangleView());
+			mBufferStart = &mBuffer.GetBuffer()[0];
+			mBufferSize = mBuffer.GetBuffer().size();
+			mNodeHeader = mBuffer.GetNodeHeader();
+			mTriangleHeader = mBuffer.GetTriangleHeader();
+		}
 		mStats.Set(stats);
 	}
 
+	// Update the tree after the vertices that were passed to the constructor have moved, the test must have been created with inAllowRefit
+	void							Refit()
+	{
+		if (mTreeFile.GetBufferStart() != nullptr)
+			FatalError("RayCastCPUQuadTreeHalfFloat: Can't refit a mapped tree");
+
+		mBuffer.Refit(mVertices);
+	}
+
 	virtual void					TrashCache() override
 	{
-		CacheTrasher::sTrash(mBuffer.GetBuffer());
+		CacheTrasher::sTrash(mBufferStart, mBufferSize);
 	}
 
 	virtual void					CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
 	{
-		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), mBuffer.GetBuffer());
+		if (mRaysInFlight > 1)
+		{
+			CastRaysInterleaved(inRayCastsBegin, inRayCastsEnd, outRayCasts);
+			return;
+		}
 
-		const typename NodeCodec::Header *header = mBuffer.GetNodeHeader();
+		const typename TriangleCodec::DecodingContext ctx(mTriangleHeader, mBufferStart);
+
+		const typename NodeCodec::Header *header = mNodeHeader;
 		const Vec3 root_bounds_min(header->mRootBoundsMin);
 		const Vec3 root_bounds_max(header->mRootBoundsMax);
-		const uint8 *buffer_start = &mBuffer.GetBuffer()[0];
-		uint root_properties = header->mRootProperties;
 		
 		RayCastTestOut *out = outRayCasts;
 		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
 		{
-			Vec3 origin(ray->mOrigin);
-			Vec3 direction(ray->mDirection);
-			Vec3 inv_direction = direction.Reciprocal();
-			UVec4 is_parallel = RayIsParallel(direction);
-
-			float closest = FLT_MAX;
-			const int stack_size = 128;
-			uint32 node_stack[stack_size];
-			float distance_stack[stack_size];
-			node_stack[0] = root_properties;
-			distance_stack[0] = 0;
-			int top = 0;
+			RayState state;
+			StartRay(*ray, out, state);
 			do
+				VisitNode(ctx, root_bounds_min, root_bounds_max, state);
+			while (state.mTop >= 0);
+			out->mDistance = state.mClosest;
+		}
+	}
+
+	// Segments only visit nodes that start before the end of the segment and stop at the first hit
+	virtual void					CastOcclusionRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
+	{
+		const typename TriangleCodec::DecodingContext ctx(mTriangleHeader, mBufferStart);
+
+		const typename NodeCodec::Header *header = mNodeHeader;
+		const Vec3 root_bounds_min(header->mRootBoundsMin);
+		const Vec3 root_bounds_max(header->mRootBoundsMax);
+		
+		RayCastTestOut *out = outRayCasts;
+		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray, ++out)
+		{
+			RayState state;
+			StartRay(*ray, out, state);
+			state.mClosest = 1.0f;
+			do
+				VisitNode(ctx, root_bounds_min, root_bounds_max, state);
+			while (state.mTop >= 0 && state.mClosest >= 1.0f);
+			out->mDistance = state.mClosest;
+		}
+	}
+
+private:
+	static constexpr int			cStackSize = 128;
+
+	// Traversal state of a single ray
+	struct RayState
+	{
+		Vec3						mOrigin;
+		Vec3						mDirection;
+		Vec3						mInvDirection;
+		UVec4						mIsParallel;
+		float						mClosest;
+		int							mTop;
+		RayCastTestOut *			mOut;
+		uint32						mNodeStack[cStackSize];
+		float						mDistanceStack[cStackSize];
+	};
+
+	// Initialize the state for a ray, the root is pushed on the stack
+	f_inline void					StartRay(const RayCastTestIn &inRay, RayCastTestOut *inOut, RayState &outState) const
+	{
+		outState.mOrigin = Vec3(inRay.mOrigin);
+		outState.mDirection = Vec3(inRay.mDirection);
+		outState.mInvDirection = outState.mDirection.Reciprocal();
+		outState.mIsParallel = RayIsParallel(outState.mDirection);
+		outState.mClosest = FLT_MAX;
+		outState.mTop = 0;
+		outState.mOut = inOut;
+		outState.mNodeStack[0] = mNodeHeader->mRootProperties;
+		outState.mDistanceStack[0] = 0;
+	}
+
+	// Process the node on top of the stack and pop until the next node that could give a closer hit (mTop becomes negative when the ray is done)
+	f_inline void					VisitNode(const typename TriangleCodec::DecodingContext &inCtx, const Vec3 &inRootBoundsMin, const Vec3 &inRootBoundsMax, RayState &ioState) const
+	{
+		const uint8 *buffer_start = mBufferStart;
+		uint32 *node_stack = ioState.mNodeStack;
+		float *distance_stack = ioState.mDistanceStack;
+		int top = ioState.mTop;
+		float closest = ioState.mClosest;
+
+		// Test if node contains triangles
+		uint32 node_properties = node_stack[top];
+		uint32 tri_count = node_properties >> NodeCodec::TRIANGLE_COUNT_SHIFT;
+		if (tri_count == 0)
+		{
+			const typename NodeCodec::Node *node = reinterpret_cast<const typename NodeCodec::Node *>(buffer_start + (node_properties << NodeCodec::OFFSET_NON_SIGNIFICANT_BITS));
+			assert(IsAligned(node, Alignment));
+
+			// Unpack bounds
+			UVec4 bounds_minxy = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const uint32 *>(&node->mBoundsMinX[0]));
+			Vec4 bounds_minx = bounds_minxy.HalfFloatToFloat();
+			Vec4 bounds_miny = bounds_minxy.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
+			
+			UVec4 bounds_minzmaxx = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const uint32 *>(&node->mBoundsMinZ[0]));
+			Vec4 bounds_minz = bounds_minzmaxx.HalfFloatToFloat();
+			Vec4 bounds_maxx = bounds_minzmaxx.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
+
+			UVec4 bounds_maxyz = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const uint32 *>(&node->mBoundsMaxY[0]));
+			Vec4 bounds_maxy = bounds_maxyz.HalfFloatToFloat();
+			Vec4 bounds_maxz = bounds_maxyz.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
+
+			// Test bounds of 4 children
+			Vec4 distance = RayAABox4(ioState.mOrigin, ioState.mInvDirection, ioState.mIsParallel, bounds_minx, bounds_miny, bounds_minz, bounds_maxx, bounds_maxy, bounds_maxz);
+
+			// Load properties for 4 children
+			UVec4 properties = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(&node->mNodeProperties[0]);
+
+			// Sort so that highest values are first (we want to first process closer hits and we process stack top to bottom)
+			Vec4::sSort4Reverse(distance, properties);
+
+			// Count how many results are closer
+			UVec4 closer = Vec4::sLess(distance, Vec4::sReplicate(closest));
+			int num_results = closer.CountTrues();
+
+			// Shift the results so that only the closer ones remain
+			distance = distance.ReinterpretAsInt().ShiftComponents4Minus(num_results).ReinterpretAsFloat();
+			properties = properties.ShiftComponents4Minus(num_results);
+
+			// Push them onto the stack
+			assert(top + 4 < cStackSize);
+			distance.StoreFloat4((Float4 *)&distance_stack[top]);
+			properties.StoreInt4(&node_stack[top]);
+			top += num_results;
+
+			// Prefetch the children, the nearest child is on top of the stack
+			switch (mPrefetch)
 			{
-				// Test if node contains triangles
-				uint32 node_properties = node_stack[top];
-				uint32 tri_count = node_properties >> NodeCodec::TRIANGLE_COUNT_SHIFT;
-				if (tri_count == 0)
-				{
-					const typename NodeCodec::Node *node = reinterpret_cast<const typename NodeCodec::Node *>(buffer_start + (node_properties << NodeCodec::OFFSET_NON_SIGNIFICANT_BITS));
-					assert(IsAligned(node, Alignment));
-
-					// Unpack bounds
-					UVec4 bounds_minxy = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const uint32 *>(&node->mBoundsMinX[0]));
-					Vec4 bounds_minx = bounds_minxy.HalfFloatToFloat();
-					Vec4 bounds_miny = bounds_minxy.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
-					
-					UVec4 bounds_minzmaxx = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const uint32 *>(&node->mBoundsMinZ[0]));
-					Vec4 bounds_minz = bounds_minzmaxx.HalfFloatToFloat();
-					Vec4 bounds_maxx = bounds_minzmaxx.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
-
-					UVec4 bounds_maxyz = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const uint32 *>(&node->mBoundsMaxY[0]));
-					Vec4 bounds_maxy = bounds_maxyz.HalfFloatToFloat();
-					Vec4 bounds_maxz = bounds_maxyz.Swizzle<SWIZZLE_Z, SWIZZLE_W, SWIZZLE_UNUSED, SWIZZLE_UNUSED>().HalfFloatToFloat();
-
-					// Test bounds of 4 children
-					Vec4 distance = RayAABox4(origin, inv_direction, is_parallel, bounds_minx, bounds_miny, bounds_minz, bounds_maxx, bounds_maxy, bounds_maxz);
-
-					// Load properties for 4 children
-					UVec4 properties = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(&node->mNodeProperties[0]);
-
-					// Sort so that highest values are first (we want to first process closer hits and we process stack top to bottom)
-					Vec4::sSort4Reverse(distance, properties);
-
-					// Count how many results are closer
-					UVec4 closer = Vec4::sLess(distance, Vec4::sReplicate(closest));
-					int num_results = closer.CountTrues();
-
-					// Shift the results so that only the closer ones remain
-					distance = distance.ReinterpretAsInt().ShiftComponents4Minus(num_results).ReinterpretAsFloat();
-					properties = properties.ShiftComponents4Minus(num_results);
-
-					// Push them onto the stack
-					assert(top + 4 < stack_size);
-					distance.StoreFloat4((Float4 *)&distance_stack[top]);
-					properties.StoreInt4(&node_stack[top]);
-					top += num_results;
-				}
-				else
-				{	
-					// Node contains triangles, do individual tests
-					assert(tri_count != NodeCodec::TRIANGLE_COUNT_MASK); // This is a padding node, it should have an invalid bounding box so we shouldn't get here
-					const void *triangles = buffer_start + ((node_properties & NodeCodec::OFFSET_MASK) << NodeCodec::OFFSET_NON_SIGNIFICANT_BITS);
-					ctx.TestRay(origin, direction, root_bounds_min, root_bounds_max, triangles, tri_count, closest);
-				}
+			case EQuadTreePrefetch::NONE:
+				break;
+
+			case EQuadTreePrefetch::NEAREST_CHILD:
+				if (num_results > 0)
+					PrefetchChild(node_stack[top - 1]);
+				break;
+
+			case EQuadTreePrefetch::HIT_CHILDREN:
+			case EQuadTreePrefetch::HIT_CHILDREN_AND_VERTICES:
+				for (int i = top - num_results; i < top; ++i)
+					PrefetchChild(node_stack[i]);
+				break;
+			}
+		}
+		else
+		{	
+			// Node contains triangles, do individual tests
+			assert(tri_count != NodeCodec::TRIANGLE_COUNT_MASK); // This is a padding node, it should have an invalid bounding box so we shouldn't get here
+			const void *triangles = buffer_start + ((node_properties & NodeCodec::OFFSET_MASK) << NodeCodec::OFFSET_NON_SIGNIFICANT_BITS);
+			inCtx.TestRay(ioState.mOrigin, ioState.mDirection, inRootBoundsMin, inRootBoundsMax, triangles, tri_count, closest);
+		}
 
-				// Fetch next node that could give a closer hit
-				do 
-					--top;
-				while (top >= 0 && distance_stack[top] >= closest);
+		// Fetch next node that could give a closer hit
+		do 
+			--top;
+		while (top >= 0 && distance_stack[top] >= closest);
+
+		// The triangle block of the next node was prefetched when it was pushed, by now its header should be available to find the vertices
+		if constexpr (HasPrefetchVertices<typename TriangleCodec::DecodingContext>::value)
+			if (mPrefetch == EQuadTreePrefetch::HIT_CHILDREN_AND_VERTICES && top >= 0)
+			{
+				uint32 next_properties = node_stack[top];
+				if ((next_properties >> NodeCodec::TRIANGLE_COUNT_SHIFT) != 0)
+					inCtx.PrefetchVertices(buffer_start + ((next_properties & NodeCodec::OFFSET_MASK) << NodeCodec::OFFSET_NON_SIGNIFICANT_BITS));
 			}
-			while (top >= 0);
 
-			out->mDistance = closest;
+		ioState.mTop = top;
+		ioState.mClosest = closest;
+	}
+
+	// Prefetch a node or triangle block
+	f_inline void					PrefetchChild(uint32 inNodeProperties) const
+	{
+		uint32 node_properties = inNodeProperties;
+		if ((node_properties >> NodeCodec::TRIANGLE_COUNT_SHIFT) == 0)
+			_mm_prefetch(reinterpret_cast<const char *>(mBufferStart + (node_properties << NodeCodec::OFFSET_NON_SIGNIFICANT_BITS)), _MM_HINT_T0);
+		else
+		{
+			// Prefetch the first 2 cache lines of the triangles, usually the block is not much bigger
+			const char *triangles = reinterpret_cast<const char *>(mBufferStart + ((node_properties & NodeCodec::OFFSET_MASK) << NodeCodec::OFFSET_NON_SIGNIFICANT_BITS));
+			_mm_prefetch(triangles, _MM_HINT_T0);
+			_mm_prefetch(triangles + CACHE_LINE_SIZE, _MM_HINT_T0);
 		}
 	}
 
-private:
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	// Traverse mRaysInFlight rays at the same time. Each ray visits a single node and then prefetches its next node,
+	// by the time the other rays have visited a node the next node of the ray should be in the cache.
+	void							CastRaysInterleaved(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts)
+	{
+		const typename TriangleCodec::DecodingContext ctx(mTriangleHeader, mBufferStart);
+
+		const typename NodeCodec::Header *header = mNodeHeader;
+		const Vec3 root_bounds_min(header->mRootBoundsMin);
+		const Vec3 root_bounds_max(header->mRootBoundsMax);
+
+		// Start the first rays
+		RayState states[cMaxRaysInFlight];
+		uint active[cMaxRaysInFlight];
+		uint num_active = 0;
+		const RayCastTestIn *next_ray = inRayCastsBegin;
+		RayCastTestOut *next_out = outRayCasts;
+		for (; num_active < mRaysInFlight && next_ray < inRayCastsEnd; ++num_active, ++next_ray, ++next_out)
+		{
+			StartRay(*next_ray, next_out, states[num_active]);
+			active[num_active] = num_active;
+		}
+
+		while (num_active > 0)
+			for (uint i = 0; i < num_active; )
+			{
+				RayState &state = states[active[i]];
+				VisitNode(ctx, root_bounds_min, root_bounds_max, state);
+				if (state.mTop < 0)
+				{
+					// Ray is done, replace it with the next ray or remove it from the active list
+					state.mOut->mDistance = state.mClosest;
+					if (next_ray < inRayCastsEnd)
+					{
+						StartRay(*next_ray, next_out, state);
+						++next_ray;
+						++next_out;
+					}
+					else
+					{
+						active[i] = active[--num_active];
+						continue;
+					}
+				}
+
+				PrefetchChild(state.mNodeStack[state.mTop]);
+				++i;
+			}
+	}
+
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
 	EAABBTreeToBufferConvertMode	mConvertMode;
+	const char *					mTreeFileName;
+	bool							mAllowRefit;
+	uint							mRaysInFlight;
+	EQuadTreePrefetch				mPrefetch;
 	AABBTreeToBuffer<TriangleCodec, NodeCodec> mBuffer;
+	AABBTreeFile<TriangleCodec, NodeCodec> mTreeFile;
 	StatsRow						mStats;
+
+	// Buffer that is traversed, points either to mBuffer or to mTreeFile
+	const uint8 *					mBufferStart = nullptr;
+	size_t							mBufferSize = 0;
+	const typename NodeCodec::Header *mNodeHeader = nullptr;
+	const typename TriangleCodec::TriangleHeader *mTriangleHeader = nullptr;
 };
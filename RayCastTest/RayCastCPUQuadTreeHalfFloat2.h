@@ -13,7 +13,7 @@ public:
 
 	typedef NodeCodecQuadTreeHalfFloat<Alignment> NodeCodec;
 
-									RayCastCPUQuadTreeHalfFloat2(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST) : mVertices(inVertices), mRoot(inRoot), mConvertMode(inConvertMode) { }
+									RayCastCPUQuadTreeHalfFloat2(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree, EAABBTreeToBufferConvertMode inConvertMode = EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST) : mVertices(inVertices), mTree(inTree), mConvertMode(inConvertMode) { }
 
 	virtual void					GetStats(StatsRow &ioRow) const override
 	{
@@ -25,7 +25,7 @@ public:
 	virtual void					Initialize() override
 	{
 		AABBTreeToBufferStats stats;
-		mBuffer.Convert(mVertices, mRoot, stats, mConvertMode);
+		mBuffer.Convert(mVertices, *mTree, stats, mConvertMode);
 		mStats.Set(stats);
 	}
 
@@ -36,7 +36,7 @@ public:
 
 	virtual void					CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
 	{
-		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), mBuffer.GetBuffer());
+		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), &mBuffer.GetBuffer()[0]);
 
 		const typename NodeCodec::Header *header = mBuffer.GetNodeHeader();
 		const Vec3 root_bounds_min(header->mRootBoundsMin);
@@ -123,8 +123,8 @@ public:
 	}
 
 private:
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
 	EAABBTreeToBufferConvertMode	mConvertMode;
 	AABBTreeToBuffer<TriangleCodec, NodeCodec> mBuffer;
 	StatsRow						mStats;
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <RayCastTest/RayCastTest.h>
+#include <Geometry/MortonCode.h>
+
+enum class ERayReorder
+{
+	ORIGIN_MORTON,												// Sort on morton code of the origin
+	OCTANT_ORIGIN_MORTON,										// Sort on direction octant first and then on morton code of the origin
+};
+
+// Convert reorder mode to string
+inline string ConvertToString(ERayReorder inReorder)
+{
+	switch (inReorder)
+	{
+	case ERayReorder::ORIGIN_MORTON:			return "OriginMorton";
+	case ERayReorder::OCTANT_ORIGIN_MORTON:		return "OctantOriginMorton";
+	}
+
+	assert(false);
+	return "Invalid";
+}
+
+// Sorts rays so that rays that are close together and point in a similar direction are cast after each other,
+// the rays are cast in that order by another test and the results are scattered back to the original order.
+// Consecutive rays then visit mostly the same nodes and triangles, which helps when the input rays are incoherent (e.g. secondary rays).
+class RayCastCPUReordered : public RayCastTest
+{
+public:
+	// Constructor, takes ownership of inTest
+									RayCastCPUReordered(RayCastTest *inTest, ERayReorder inReorder = ERayReorder::OCTANT_ORIGIN_MORTON) : mTest(inTest), mReorder(inReorder) { }
+
+	virtual							~RayCastCPUReordered() override
+	{
+		delete mTest;
+	}
+
+	virtual void					GetStats(StatsRow &ioRow) const override
+	{
+		mTest->GetStats(ioRow);
+		ioRow.Set(StatsColumn::TestVariant, ioRow.Get(StatsColumn::TestVariant) + "_Reorder" + ConvertToString(mReorder));
+	}
+
+	virtual void					SetSubSystems(Model *inModel, Renderer *inRenderer) override
+	{
+		RayCastTest::SetSubSystems(inModel, inRenderer);
+		mTest->SetSubSystems(inModel, inRenderer);
+	}
+
+	virtual void					Initialize() override
+	{
+		mTest->Initialize();
+	}
+
+	virtual void					TrashCache() override
+	{
+		CacheTrasher::sTrash(mOrder);
+		CacheTrasher::sTrash(mOrderTemp);
+		CacheTrasher::sTrash(mSortedRays);
+		CacheTrasher::sTrash(mSortedOut);
+		mTest->TrashCache();
+	}
+
+	virtual void					CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
+	{
+		Reorder(inRayCastsBegin, inRayCastsEnd);
+		CastReorderedRays(outRayCasts);
+	}
+
+	// First half of CastRays, sorts the rays. Split off so that the cost of sorting can be measured.
+	void							Reorder(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd)
+	{
+		uint num_rays = uint(inRayCastsEnd - inRayCastsBegin);
+		mOrder.resize(num_rays);
+		mSortedRays.resize(num_rays);
+		mSortedOut.resize(num_rays);
+		if (num_rays == 0)
+			return;
+
+		// Determine the bounds of the origins, the bounds should not be empty in any axis
+		AABox bounds;
+		for (const RayCastTestIn *ray = inRayCastsBegin; ray < inRayCastsEnd; ++ray)
+			bounds.Encapsulate(Vec3(ray->mOrigin));
+		bounds.mMax = Vec3::sMax(bounds.mMax, bounds.mMin + Vec3::sReplicate(1.0e-6f));
+
+		// Sort on a 32 bit key, the ray index is stored in the low 32 bits
+		for (uint i = 0; i < num_rays; ++i)
+		{
+			const RayCastTestIn &ray = inRayCastsBegin[i];
+			uint32 key = MortonCode::sGetMortonCode(Vec3(ray.mOrigin), bounds);
+			if (mReorder == ERayReorder::OCTANT_ORIGIN_MORTON)
+			{
+				// 3 octant bits followed by the 29 most significant bits of the morton code
+				uint32 octant = (ray.mDirection.x < 0.0f? 4 : 0) | (ray.mDirection.y < 0.0f? 2 : 0) | (ray.mDirection.z < 0.0f? 1 : 0);
+				key = (octant << 29) | (key >> 1);
+			}
+			mOrder[i] = (uint64(key) << 32) | i;
+		}
+
+		// Radix sort on the key, 8 bits per pass
+		mOrderTemp.resize(num_rays);
+		for (int shift = 32; shift < 64; shift += 8)
+		{
+			uint offsets[256] = { };
+			for (uint64 o : mOrder)
+				++offsets[(o >> shift) & 0xff];
+			uint start = 0;
+			for (uint &offset : offsets)
+			{
+				uint count = offset;
+				offset = start;
+				start += count;
+			}
+			for (uint64 o : mOrder)
+				mOrderTemp[offsets[(o >> shift) & 0xff]++] = o;
+			mOrder.swap(mOrderTemp);
+		}
+
+		// Gather the rays in sorted order
+		for (uint i = 0; i < num_rays; ++i)
+			mSortedRays[i] = inRayCastsBegin[uint32(mOrder[i])];
+	}
+
+	// Second half of CastRays, casts the rays that were sorted by Reorder and scatters the results to outRayCasts
+	void							CastReorderedRays(RayCastTestOut *outRayCasts)
+	{
+		if (mSortedRays.empty())
+			return;
+
+		mTest->CastRays(&mSortedRays[0], &mSortedRays[0] + mSortedRays.size(), &mSortedOut[0]);
+
+		for (size_t i = 0; i < mSortedOut.size(); ++i)
+			outRayCasts[uint32(mOrder[i])] = mSortedOut[i];
+	}
+
+private:
+	RayCastTest *					mTest;
+	ERayReorder						mReorder;
+	vector<uint64>					mOrder;
+	vector<uint64>					mOrderTemp;
+	RayCasts						mSortedRays;
+	RayCastsOut						mSortedOut;
+};
@@ -11,7 +11,7 @@ class RayCastCPUSKDTree : public RayCastTest
 	static const int stack_size = 64;
 
 public:
-								RayCastCPUSKDTree(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot) : mVertices(inVertices), mRoot(inRoot) { }
+								RayCastCPUSKDTree(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree) : mVertices(inVertices), mTree(inTree) { }
 
 	virtual void				GetStats(StatsRow &ioRow) const override
 	{
@@ -22,11 +22,11 @@ public:
 	virtual void				Initialize() override
 	{
 		// Check if stack is big enough
-		if (mRoot->GetMaxDepth() >= (uint)stack_size)
+		if (mTree->GetMaxDepth() >= (uint)stack_size)
 			FatalError("RayCastCPUSKDTree: Tree too deep");
 
 		AABBTreeToBufferStats stats;
-		mBuffer.Convert(mVertices, mRoot, stats);
+		mBuffer.Convert(mVertices, *mTree, stats);
 		mStats.Set(stats);
 	}
 
@@ -37,7 +37,7 @@ public:
 
 	virtual void				CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override
 	{
-		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), mBuffer.GetBuffer());
+		const typename TriangleCodec::DecodingContext ctx(mBuffer.GetTriangleHeader(), &mBuffer.GetBuffer()[0]);
 
 		const NodeCodecSKDTree::Header *header = mBuffer.GetNodeHeader();
 		const Vec3 root_bounds_min(header->mRootBoundsMin);
@@ -173,8 +173,8 @@ private:
 		}
 	}
 
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
 	AABBTreeToBuffer<TriangleCodec, NodeCodecSKDTree> mBuffer;
 	StatsRow						mStats;
 };
@@ -7,6 +7,7 @@
 #include <Utils/Model.h>
 #include <TriangleGrouper/TriangleGrouperMorton.h>
 #include <TriangleGrouper/TriangleGrouperClosestCentroid.h>
+#include <TriangleGrouper/TriangleGrouperClosestCentroidKDTree.h>
 
 const uint max_rays = 16384;		// Maximum supported number of raycasts
 const uint group_size = 64;
@@ -18,7 +19,7 @@ void RayCastGPUAABBList::Initialize()
 	mShader1 = mRenderer->CreateComputeShader("Shaders/RayCastGPUAABBListStage1.hlsl");
 	mShader2 = mRenderer->CreateComputeShader("Shaders/RayCastGPUAABBListStage2.hlsl");
 
-	const vector<Triangle> &triangle_list = mModel->mTriangles;
+	const vector<Triangle> &triangle_list = mModel->GetTriangles();
 	const uint triangle_count = (uint)triangle_list.size();
 	const uint num_batches = (triangle_count + triangles_per_batch - 1) / triangles_per_batch;
 	const uint num_groups = (num_batches + group_size - 1) / group_size;
@@ -28,12 +29,17 @@ void RayCastGPUAABBList::Initialize()
 	if (mVariant == GROUPER_MORTON)
 	{
 		TriangleGrouperMorton grouper;
-		grouper.Group(mModel->mTriangleVertices, mModel->mIndexedTriangles, triangles_per_batch, sorted_triangle_idx);
+		grouper.Group(mModel->GetTriangleVertices(), mModel->GetIndexedTriangles(), triangles_per_batch, sorted_triangle_idx);
 	}
 	else if (mVariant == GROUPER_CLOSEST_CENTROID)
 	{
 		TriangleGrouperClosestCentroid grouper;
-		grouper.Group(mModel->mTriangleVertices, mModel->mIndexedTriangles, triangles_per_batch, sorted_triangle_idx);
+		grouper.Group(mModel->GetTriangleVertices(), mModel->GetIndexedTriangles(), triangles_per_batch, sorted_triangle_idx);
+	}
+	else if (mVariant == GROUPER_CLOSEST_CENTROID_KD_TREE)
+	{
+		TriangleGrouperClosestCentroidKDTree grouper;
+		grouper.Group(mModel->GetTriangleVertices(), mModel->GetIndexedTriangles(), triangles_per_batch, sorted_triangle_idx);
 	}
 	
 	// Calculate bounds for each group
@@ -14,6 +14,7 @@ public:
 	{
 		GROUPER_MORTON,
 		GROUPER_CLOSEST_CENTROID,
+		GROUPER_CLOSEST_CENTROID_KD_TREE,
 	};
 
 										RayCastGPUAABBList(EVariant inVariant) : mVariant(inVariant), mSurfaceArea(0) { }
@@ -31,6 +32,10 @@ public:
 			ioRow.Set(StatsColumn::TestVariant, "TriangleGrouperClosestCentroid");
 			break;
 
+		case GROUPER_CLOSEST_CENTROID_KD_TREE:
+			ioRow.Set(StatsColumn::TestVariant, "TriangleGrouperClosestCentroidKDTree");
+			break;
+
 		default:
 			assert(false);
 			break;
@@ -16,7 +16,7 @@ class RayCastGPUTree : public RayCastTest
 	};
 
 public:
-									RayCastGPUTree(const VertexList &inVertices, const AABBTreeBuilder::Node *inRoot, const char *inShader) : mVertices(inVertices), mRoot(inRoot), mShaderName(inShader) { }
+									RayCastGPUTree(const VertexView &inVertices, const AABBTreeBuilder::Tree *inTree, const char *inShader) : mVertices(inVertices), mTree(inTree), mShaderName(inShader) { }
 
 	virtual void					GetStats(StatsRow &ioRow) const override
 	{
@@ -29,7 +29,7 @@ public:
 	{
 		// Convert tree
 		AABBTreeToBufferStats stats;
-		mBuffer.Convert(mVertices, mRoot, stats);
+		mBuffer.Convert(mVertices, *mTree, stats);
 		mStats.Set(stats);
 
 		// Load shader
@@ -73,8 +73,8 @@ public:
 	}
 
 private:
-	const VertexList &				mVertices;
-	const AABBTreeBuilder::Node *	mRoot;
+	VertexView						mVertices;
+	const AABBTreeBuilder::Tree *	mTree;
 	TreeBuilder						mBuffer;
 	StatsRow						mStats;
 	const char *					mShaderName;
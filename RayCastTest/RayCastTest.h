@@ -45,6 +45,10 @@ public:
 	// Cast a number of rays and get the closest collision point
 	virtual void		CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) = 0;
 
+	// Cast a number of segments from mOrigin to mOrigin + mDirection and check if they hit anything, mDistance is < 1 when the segment hits a triangle and >= 1 otherwise.
+	// The distance is not necessarily that of the closest hit: tests can override this to ignore everything beyond the end of the segment and to stop at the first hit.
+	virtual void		CastOcclusionRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) { CastRays(inRayCastsBegin, inRayCastsEnd, outRayCasts); }
+
 protected:
 	Model *				mModel;
 	Renderer *			mRenderer;
@@ -25,6 +25,19 @@
 #include <RayCastTest/RayCastCPUQuadTree.h>
 #include <RayCastTest/RayCastCPUQuadTreeHalfFloat.h>
 #include <RayCastTest/RayCastCPUQuadTreeHalfFloat2.h>
+#include <RayCastTest/RayCastCPUInstances.h>
+#include <RayCastTest/RayCastCPUReordered.h>
+#include <RayCastTest/RayCastCPUGrid.h>
+#include <AABBTree/DynamicAABBTreeToBuffer.h>
+#include <AABBTree/AABBTreeRebuilder.h>
+#include <Query/ShapeCastQuadTree.h>
+#include <Query/BoxOverlapQuadTree.h>
+#include <Query/ClosestPointQuadTree.h>
+#include <Query/PointInMeshQuadTree.h>
+#include <Query/RayHitsQuadTree.h>
+#include <Query/MeshIntersectQuadTree.h>
+#include <Query/VisibilityMatrix.h>
+#include <Query/RayCastFilteredQuadTree.h>
 #include <TriangleSplitter/TriangleSplitterBinning.h>
 #include <TriangleSplitter/TriangleSplitterMean.h>
 #include <TriangleSplitter/TriangleSplitterMorton.h>
@@ -37,17 +50,22 @@
 #include <TriangleCodec/TriangleCodecFloat3.h>
 #include <TriangleCodec/TriangleCodecFloat3SOA4.h>
 #include <TriangleCodec/TriangleCodecFloat3SOA4Packed.h>
+#include <TriangleCodec/TriangleCodecFloat3SOA4Material.h>
 #include <TriangleCodec/TriangleCodecFloat3SOA8.h>
 #include <TriangleCodec/TriangleCodecStrip.h>
 #include <TriangleCodec/TriangleCodecBitPack.h>
 #include <TriangleCodec/TriangleCodecBitPackSOA4.h>
 #include <TriangleCodec/TriangleCodecIndexed8BitPackSOA4.h>
+#include <TriangleCodec/TriangleCodecIndexed8BitPackSOA4Material.h>
 #include <Application/Application.h>
 #include <Application/EntryPoint.h>
 #include <Utils/CacheTrasher.h>
 #include <Utils/StatsWriter.h>
 #include <Utils/PerfTimer.h>
 #include <Utils/Model.h>
+#include <Utils/RayStream.h>
+#include <Geometry/Indexify.h>
+#include <Core/StringTools.h>
 #include <random>
 
 //-----------------------------------------------------------------------------
@@ -79,29 +97,32 @@
 //#define TEST_TYPE RayCastCPUAABBList<TEST_CODEC, 1>(ERayCastCPUAABBListVariant::BOUNDS_PLAIN, ERayCastCPUAABBGrouper::GROUPER_MORTON, 64)
 //#define TEST_TYPE RayCastCPUAABBList<TEST_CODEC, 16>(ERayCastCPUAABBListVariant::BOUNDS_SOA4, ERayCastCPUAABBGrouper::GROUPER_MORTON, 64)
 //#define TEST_TYPE RayCastCPUAABBList<TEST_CODEC, 32>(ERayCastCPUAABBListVariant::BOUNDS_SOA8, ERayCastCPUAABBGrouper::GROUPER_MORTON, 64)
+//#define TEST_TYPE RayCastCPUAABBList<TEST_CODEC, 32>(ERayCastCPUAABBListVariant::BOUNDS_SOA8, ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID_KD_TREE, 64)
 //#define TEST_TYPE RayCastCPUAABBList<TEST_CODEC, 16>(ERayCastCPUAABBListVariant::BOUNDS_HALFFLOAT_SOA4, ERayCastCPUAABBGrouper::GROUPER_MORTON, 64)
+//#define TEST_TYPE RayCastCPUGrid<TEST_CODEC>(ERayCastCPUGridVariant::GRID_UNIFORM, 4, 2.0f)
+//#define TEST_TYPE RayCastCPUGrid<TEST_CODEC>(ERayCastCPUGridVariant::GRID_HASHED, 4, 2.0f)
 //#define TEST_TYPE RayCastGPUAABBList(RayCastGPUAABBList::GROUPER_MORTON)
-//#define TEST_TYPE RayCastCPUAABBTree1<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTree2<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTree3<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTree4<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTree5<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTreePNS<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTreeSplitAxis<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTreeISPC(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTreeStripISPC(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUAABBTreeCompressed<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>>(mModel->mTriangleVertices, mAABBTreeRoot, "RayCastGPUAABBTree1.hlsl")
-//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>>(mModel->mTriangleVertices, mAABBTreeRoot, "RayCastGPUAABBTree2.hlsl")
-//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>>(mModel->mTriangleVertices, mAABBTreeRoot, "RayCastGPUAABBTree3.hlsl")
-//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecStripUncompressed, NodeCodecAABBTree>>(mModel->mTriangleVertices, mAABBTreeRoot, "RayCastGPUAABBTreeStrip.hlsl")
-//#define TEST_TYPE RayCastCPUSKDTree<TEST_CODEC>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecSKDTree>>(mModel->mTriangleVertices, mAABBTreeRoot, "RayCastGPUSKDTree.hlsl"); 
-//#define TEST_TYPE RayCastCPUQuadTree<TEST_CODEC, 1>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUQuadTree<TEST_CODEC, 128>(mModel->mTriangleVertices, mAABBTreeRoot)
-//#define TEST_TYPE RayCastCPUQuadTreeHalfFloat<TEST_CODEC, 1>(mModel->mTriangleVertices, mAABBTreeRoot)
-#define TEST_TYPE RayCastCPUQuadTreeHalfFloat<TEST_CODEC, 16>(mModel->mTriangleVertices, mAABBTreeRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST)
-//#define TEST_TYPE RayCastCPUQuadTreeHalfFloat2<TEST_CODEC, 16>(mModel->mTriangleVertices, mAABBTreeRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST)
+//#define TEST_TYPE RayCastCPUAABBTree1<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTree2<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTree3<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTree4<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTree5<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTreePNS<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTreeSplitAxis<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTreeISPC(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTreeStripISPC(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUAABBTreeCompressed<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>>(mModel->GetVertexView(), mAABBTree, "RayCastGPUAABBTree1.hlsl")
+//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>>(mModel->GetVertexView(), mAABBTree, "RayCastGPUAABBTree2.hlsl")
+//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>>(mModel->GetVertexView(), mAABBTree, "RayCastGPUAABBTree3.hlsl")
+//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecStripUncompressed, NodeCodecAABBTree>>(mModel->GetVertexView(), mAABBTree, "RayCastGPUAABBTreeStrip.hlsl")
+//#define TEST_TYPE RayCastCPUSKDTree<TEST_CODEC>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecSKDTree>>(mModel->GetVertexView(), mAABBTree, "RayCastGPUSKDTree.hlsl"); 
+//#define TEST_TYPE RayCastCPUQuadTree<TEST_CODEC, 1>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUQuadTree<TEST_CODEC, 128>(mModel->GetVertexView(), mAABBTree)
+//#define TEST_TYPE RayCastCPUQuadTreeHalfFloat<TEST_CODEC, 1>(mModel->GetVertexView(), mAABBTree)
+#define TEST_TYPE RayCastCPUQuadTreeHalfFloat<TEST_CODEC, 16>(mModel->GetVertexView(), mAABBTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST, TREE_FILE)
+//#define TEST_TYPE RayCastCPUQuadTreeHalfFloat2<TEST_CODEC, 16>(mModel->GetVertexView(), mAABBTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST)
 
 //#define RUN_ALL_TESTS
 #define DRAW_MODEL
@@ -117,193 +138,2247 @@
 #define RANDOM_RAYS
 #define NUM_RAYS_PER_AXIS 32
 //#define TEST_SPLITTERS
+//#define TEST_INDEXIFY
+//#define TEST_REFIT
+//#define TEST_DYNAMIC_BVH
+//#define TEST_INSTANCES
+//#define TEST_BACKGROUND_REBUILD
+//#define TEST_RAY_REORDERING
+//#define TEST_INTERLEAVED
+//#define TEST_PREFETCH
+//#define TEST_HUGE_PAGES
+//#define TEST_SHAPE_CAST
+//#define TEST_BOX_OVERLAP
+//#define TEST_CLOSEST_POINT
+//#define TEST_POINT_IN_MESH
+//#define TEST_RAY_HITS
+//#define TEST_MESH_INTERSECT
+//#define TEST_VISIBILITY_MATRIX
+//#define TEST_MATERIAL_FILTER
 //#define FLUSH_CACHE_AFTER_EVERY_RAY
+//#define RAY_FILE "Assets/rays.raystream"
+//#define DUMP_RAY_FILE "rays.raystream"
+// TREE_FILE is only supported by RayCastCPUQuadTreeHalfFloat, other TEST_TYPEs need the AABB tree which is not built when the file exists
+//#define TREE_FILE "mothers_heart.aabbtree"
+#ifndef TREE_FILE
+	#define TREE_FILE nullptr
+#endif
+
+//-----------------------------------------------------------------------------
+// Class declaration
+//-----------------------------------------------------------------------------
+class TestRaycast : public Application
+{
+private:
+	// Render modules
+	TriangleRenderer::Batch 	mModelBatch;
+
+	// Loaded model
+	Model *						mModel;
+#ifdef TEST_TYPE
+	AABBTreeBuilder::Tree *		mAABBTree;
+#endif
+
+	// Raycasts to perform
+	RayCasts 					mRayCasts;
+	RayStream					mRayStream;
+	const RayCastTestIn *		mRayCastsBegin;
+	const RayCastTestIn *		mRayCastsEnd;
+	RayCastTest *				mRayCastTest;
+
+	// Stats
+	StatsWriter					mStatsWriter;
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+TestRaycast() :
+	mModel(nullptr),
+#ifdef TEST_TYPE
+	mAABBTree(nullptr),
+#endif
+	mRayCastsBegin(nullptr),
+	mRayCastsEnd(nullptr),
+	mRayCastTest(nullptr)
+{
+	// Initialize cache trasher
+	CacheTrasher::sInit();
+	
+	// Read model
+	mModel = new Model;
+	mModel->ReadFromFile(TEST_FILE);
+
+	// Init model renderer
+#ifdef DRAW_MODEL
+	mModelBatch = TriangleRenderer::sInstance->CreateTriangleBatch(mModel->GetTriangles());
+#endif
+
+#ifdef TEST_TYPE
+	// Create AABB tree, this is not needed when the test can map a prebuilt tree
+	const char *tree_file = TREE_FILE;
+	if (tree_file == nullptr || !FileExists(tree_file))
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		StatsRow stats;
+
+		AABBTreeBuilderStats builder_stats;
+		mAABBTree = new AABBTreeBuilder::Tree;
+		AABBTreeBuilder(splitter, 8).Build(*mAABBTree, builder_stats);
+		stats.Set(builder_stats);
+	}
+#endif
+	
+#ifdef RAY_FILE
+	// Map recorded rays, they're used in place
+	mRayStream.ReadFromFile(RAY_FILE);
+	mRayCastsBegin = mRayStream.GetRaysBegin();
+	mRayCastsEnd = mRayStream.GetRaysEnd();
+	if (mRayStream.HasPayload())
+		Trace("Ray stream payload is not used by the tests\n");
+#else
+	// Make a bit bigger so we'll do some raycasts around the edges
+	Vec3 delta = mModel->mBounds.mMax - mModel->mBounds.mMin;
+	Vec3 min = mModel->mBounds.mMin - 0.1f * delta;
+	Vec3 max = mModel->mBounds.mMax + 0.1f * delta;
+	delta = max - min;
+
+	// Calculate rays to cast
+	mRayCasts.reserve(NUM_RAYS_PER_AXIS * NUM_RAYS_PER_AXIS);
+
+#ifdef RANDOM_RAYS
+	default_random_engine random(0x1ee7c0de);
+	float radius = 0.5f * delta.Length();
+	Vec3 mid = 0.5f * (min + max);
+	for (int i = 0; i < NUM_RAYS_PER_AXIS * NUM_RAYS_PER_AXIS; ++i)
+	{
+		Vec3 origin = radius * Vec3::sRandom(random);
+		Vec3 destination = 0.25f * radius * Vec3::sRandom(random);
+		Vec3 direction = (destination - origin).Normalized();
+		RayCastTestIn ray;
+		(mid + origin).StoreFloat3(&ray.mOrigin);
+		direction.StoreFloat3(&ray.mDirection);
+		mRayCasts.push_back(ray);
+	}
+#else
+	float xs = min.GetX(), dx = delta.GetX() / NUM_RAYS_PER_AXIS;
+	float ys = min.GetY(), dy = delta.GetY() / NUM_RAYS_PER_AXIS;
+	for (int i = 0; i < NUM_RAYS_PER_AXIS; ++i)
+		for (int j = 0; j < NUM_RAYS_PER_AXIS; ++j)
+		{
+			RayCastTestIn ray;
+			ray.mOrigin = Float3(xs + dx * i, ys + dy * j, 2.0f);
+			ray.mDirection = Float3(0.0f, 0.0f, -1.0f);
+			mRayCasts.push_back(ray);
+		}
+#endif
+
+	mRayCastsBegin = &mRayCasts[0];
+	mRayCastsEnd = &mRayCasts[0] + mRayCasts.size();
+
+#ifdef DUMP_RAY_FILE
+	// Store rays so they can be replayed later
+	RayStream::sWriteToFile(DUMP_RAY_FILE, mRayCasts);
+#endif
+#endif // RAY_FILE
+
+#if TEST_ITERATIONS_SLOW > 0 || TEST_ITERATIONS_FAST > 0
+	// Validate all algorithms
+	RunTests();
+#endif
+
+#ifdef TEST_INDEXIFY
+	// Benchmark vertex welding
+	RunIndexifyBenchmark();
+#endif
+
+#ifdef TEST_REFIT
+	// Benchmark updating trees of a deforming model
+	RunRefitBenchmark();
+#endif
+
+#ifdef TEST_DYNAMIC_BVH
+	// Benchmark modifying a dynamic tree
+	RunDynamicBVHBenchmark();
+#endif
+
+#ifdef TEST_INSTANCES
+	// Benchmark casting rays against many instances of the model
+	RunInstancesBenchmark();
+#endif
+
+#ifdef TEST_BACKGROUND_REBUILD
+	// Benchmark casting rays while the tree is rebuilt in the background
+	RunBackgroundRebuildBenchmark();
+#endif
+
+#ifdef TEST_RAY_REORDERING
+	// Benchmark sorting incoherent rays before casting them
+	RunRayReorderingBenchmark();
+#endif
+
+#ifdef TEST_INTERLEAVED
+	// Benchmark interleaving the traversal of multiple rays
+	RunInterleavedBenchmark();
+#endif
+
+#ifdef TEST_PREFETCH
+	// Benchmark the prefetch policies
+	RunPrefetchBenchmark();
+#endif
+
+#ifdef TEST_HUGE_PAGES
+	// Benchmark tree buffers backed by huge pages
+	RunHugePagesBenchmark();
+#endif
+
+#ifdef TEST_SHAPE_CAST
+	// Benchmark sphere and capsule casts
+	RunShapeCastBenchmark();
+#endif
+
+#ifdef TEST_BOX_OVERLAP
+	// Benchmark collecting the triangles that overlap with a box
+	RunBoxOverlapBenchmark();
+#endif
+
+#ifdef TEST_CLOSEST_POINT
+	// Benchmark finding the closest point on the mesh
+	RunClosestPointBenchmark();
+#endif
+
+#ifdef TEST_POINT_IN_MESH
+	// Benchmark testing points for being inside the mesh
+	RunPointInMeshBenchmark();
+#endif
+
+#ifdef TEST_RAY_HITS
+	// Benchmark collecting multiple hits per ray
+	RunRayHitsBenchmark();
+#endif
+
+#ifdef TEST_MESH_INTERSECT
+	// Benchmark intersecting two meshes
+	RunMeshIntersectBenchmark();
+#endif
+
+#ifdef TEST_VISIBILITY_MATRIX
+	// Benchmark computing the visibility between two sets of points
+	RunVisibilityMatrixBenchmark();
+#endif
+
+#ifdef TEST_MATERIAL_FILTER
+	// Benchmark casting rays that filter on material
+	RunMaterialFilterBenchmark();
+#endif
+
+#ifdef TEST_TYPE
+	// Initialize test
+	mRayCastTest = new TEST_TYPE;
+	mRayCastTest->SetSubSystems(mModel, mRenderer);
+	mRayCastTest->Initialize();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// This method is called after the application terminates.
+//-----------------------------------------------------------------------------
+virtual ~TestRaycast() override
+{
+	delete mRayCastTest;
+#ifdef TEST_TYPE
+	delete mAABBTree;
+#endif
+	delete mModel;
+	mModelBatch = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Get the number of rays to cast
+//-----------------------------------------------------------------------------
+uint GetRayCount() const
+{
+	return uint(mRayCastsEnd - mRayCastsBegin);
+}
+
+#ifdef TEST_TYPE
+
+//-----------------------------------------------------------------------------
+// Render the frame.
+//-----------------------------------------------------------------------------
+virtual bool RenderFrame(float inDeltaTime) override
+{
+	// Allocate space for raycast output
+	RayCastsOut out;
+	out.resize(GetRayCount());
+
+	static PerfTimer timer("CastRays");
+
+#ifdef FLUSH_CACHE_AFTER_EVERY_RAY
+	for (size_t j = 0; j < GetRayCount(); ++j)
+	{
+		// Trash the cache
+		CacheTrasher::sTrash(&mRayCastsBegin[j]);
+		CacheTrasher::sTrash(&out[j]);
+		mRayCastTest->TrashCache();
+
+		// Do raycasts
+		timer.Start();
+		mRayCastTest->CastRays(&mRayCastsBegin[j], &mRayCastsBegin[j] + 1, &out[j]);
+		timer.Stop(1);
+	}
+#else
+	// Trash the cache
+	CacheTrasher::sTrash(mRayCastsBegin, GetRayCount() * sizeof(RayCastTestIn));
+	CacheTrasher::sTrash(out);
+	mRayCastTest->TrashCache();
+
+	timer.Start();
+	mRayCastTest->CastRays(mRayCastsBegin, mRayCastsEnd, &out[0]);
+	timer.Stop((int)GetRayCount());
+#endif
+
+	timer.Output();
+
+	float model_size = 2.0f * mModel->mBounds.GetExtent().Length();
+	float marker_size = 0.002f * model_size;
+
+	// Draw raycast results
+	for (uint r = 0; r < GetRayCount(); ++r)
+		if (out[r].mDistance < FLT_MAX)
+		{
+			Vec3 hit_pos = Vec3(mRayCastsBegin[r].mOrigin) + Vec3(mRayCastsBegin[r].mDirection) * out[r].mDistance;
+			LineRenderer::sInstance->DrawMarker(hit_pos, Color::sGreen, marker_size);
+		}
+
+#ifdef DRAW_RAYS
+	// Draw rays
+	for (uint r = 0; r < GetRayCount(); ++r)
+	{
+		Vec3 origin(mRayCastsBegin[r].mOrigin);
+		Vec3 direction(mRayCastsBegin[r].mDirection);
+		LineRenderer::sInstance->DrawMarker(origin, Color::sRed, marker_size);
+		if (out[r].mDistance < FLT_MAX)
+			LineRenderer::sInstance->DrawLine(origin, origin + out[r].mDistance * direction, Color::sGreen);
+		else
+			LineRenderer::sInstance->DrawLine(origin, origin + model_size * direction, Color::sWhite);
+	}
+#endif
+
+	// Draw model
+#ifdef DRAW_MODEL
+	TriangleRenderer::sInstance->DrawTriangleBatch(Mat44::sIdentity(), Color(90, 90, 90, 255), mModelBatch);
+#endif
+
+	return true;
+}
+
+#endif
+
+#ifdef TEST_INDEXIFY
+
+//-----------------------------------------------------------------------------
+// Measure how long it takes to weld the vertices of large synthetic meshes
+//-----------------------------------------------------------------------------
+void RunIndexifyBenchmark()
+{
+	default_random_engine random(0x1ee7c0de);
+	uniform_real_distribution<float> jitter(-1.0e-5f, 1.0e-5f);
+
+	for (int grid_size = 256; grid_size <= 1024; grid_size <<= 1)
+	{
+		// Create a height field where every triangle has its own vertices that are slightly perturbed so that they need to be welded
+		TriangleList triangles;
+		triangles.reserve(2 * grid_size * grid_size);
+		auto vertex = [&random, &jitter](int inX, int inZ) {
+			return Vec3(0.01f * inX + jitter(random), 0.05f * sin(0.1f * inX) * cos(0.1f * inZ) + jitter(random), 0.01f * inZ + jitter(random));
+		};
+		for (int z = 0; z < grid_size; ++z)
+			for (int x = 0; x < grid_size; ++x)
+			{
+				triangles.push_back(Triangle(vertex(x, z), vertex(x, z + 1), vertex(x + 1, z + 1)));
+				triangles.push_back(Triangle(vertex(x, z), vertex(x + 1, z + 1), vertex(x + 1, z)));
+			}
+
+		// Weld with a single thread and with all threads, the result should be the same
+		VertexList vertices[2];
+		IndexedTriangleList indexed_triangles[2];
+		for (int i = 0; i < 2; ++i)
+		{
+			string name = "Indexify: triangles=" + ConvertToString(triangles.size()) + (i == 0? ", single thread" : ", all threads");
+			PerfTimer timer(name.c_str());
+			timer.Start();
+			Indexify(triangles, vertices[i], indexed_triangles[i], 1.0e-4f, i == 0? 1 : 0);
+			timer.Stop(1);
+			timer.Output();
+		}
+
+		if (vertices[0] != vertices[1] || indexed_triangles[0].size() != indexed_triangles[1].size())
+			FatalError("Indexify: Result depends on amount of threads");
+		for (size_t t = 0; t < indexed_triangles[0].size(); ++t)
+			for (int v = 0; v < 3; ++v)
+				if (indexed_triangles[0][t].mIdx[v] != indexed_triangles[1][t].mIdx[v])
+					FatalError("Indexify: Result depends on amount of threads");
+		Trace("Indexify: vertices=%d, welded_vertices=%d\n", (int)triangles.size() * 3, (int)vertices[0].size());
+	}
+}
+
+#endif
+
+#ifdef TEST_REFIT
+
+//-----------------------------------------------------------------------------
+// Deform the model every frame and compare refitting the converted tree with rebuilding it
+//-----------------------------------------------------------------------------
+template <class Test, class... Args>
+void RunRefitTest(const char *inRefitName, const char *inRebuildName, Args... inArgs)
+{
+	const VertexList &original = mModel->GetTriangleVertices();
+	VertexList vertices = original;
+
+	// Build the tree for the undeformed model
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(vertices, mModel->GetIndexedTriangles());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+	Test test(vertices, &tree, inArgs...);
+	test.SetSubSystems(mModel, mRenderer);
+	test.Initialize();
+
+	// Get max size of model
+	float max_size = mModel->mBounds.GetSize().ReduceMax();
+
+	PerfTimer refit_timer(inRefitName);
+	PerfTimer rebuild_timer(inRebuildName);
+	for (int frame = 1; frame <= 10; ++frame)
+	{
+		// Deform the model with a wave
+		float amplitude = 0.05f * max_size, frequency = 6.0f / max_size, phase = 0.7f * frame;
+		for (size_t v = 0; v < original.size(); ++v)
+		{
+			Vec3 pos(original[v]);
+			Vec3 offset(sin(frequency * pos.GetY() + phase), cos(frequency * pos.GetZ() + phase), sin(frequency * pos.GetX() - phase));
+			(pos + amplitude * offset).StoreFloat3(&vertices[v]);
+		}
+
+		// Refit the tree
+		refit_timer.Start();
+		test.Refit();
+		refit_timer.Stop(1);
+
+		// Rebuild and convert the tree
+		rebuild_timer.Start();
+		TriangleSplitterBinning splitter(vertices, mModel->GetIndexedTriangles());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder::Tree rebuilt_tree;
+		AABBTreeBuilder(splitter, 8).Build(rebuilt_tree, stats);
+		Test rebuilt(vertices, &rebuilt_tree, inArgs...);
+		rebuilt.SetSubSystems(mModel, mRenderer);
+		rebuilt.Initialize();
+		rebuild_timer.Stop(1);
+
+		// Both trees should give the same result
+		RayCastsOut refit_out, rebuilt_out;
+		refit_out.resize(GetRayCount());
+		rebuilt_out.resize(GetRayCount());
+		test.CastRays(mRayCastsBegin, mRayCastsEnd, &refit_out[0]);
+		rebuilt.CastRays(mRayCastsBegin, mRayCastsEnd, &rebuilt_out[0]);
+		for (uint j = 0; j < refit_out.size(); ++j)
+		{
+			float diff = abs(refit_out[j].mDistance - rebuilt_out[j].mDistance);
+			if (diff / max_size > 1e-5f)
+				Trace("%s: Mismatch for raycast %d, result: %g should be: %g, diff: %g\n", inRefitName, j, refit_out[j].mDistance, rebuilt_out[j].mDistance, diff);
+		}
+	}
+
+	refit_timer.Output();
+	rebuild_timer.Output();
+}
+
+//-----------------------------------------------------------------------------
+// Measure refitting for the node codecs that support it
+//-----------------------------------------------------------------------------
+void RunRefitBenchmark()
+{
+	RunRefitTest<RayCastCPUAABBTree1<TriangleCodecFloat3>>("RayCastCPUAABBTree1: Refit", "RayCastCPUAABBTree1: Rebuild", true);
+	RunRefitTest<RayCastCPUQuadTree<TriangleCodecBitPackSOA4<16, false>, 16>>("RayCastCPUQuadTree: Refit", "RayCastCPUQuadTree: Rebuild", EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST, true);
+	RunRefitTest<RayCastCPUQuadTreeHalfFloat<TriangleCodecIndexed8BitPackSOA4, 16>>("RayCastCPUQuadTreeHalfFloat: Refit", "RayCastCPUQuadTreeHalfFloat: Rebuild", EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST, (const char *)nullptr, true);
+}
+
+#endif
+
+#ifdef TEST_DYNAMIC_BVH
+
+//-----------------------------------------------------------------------------
+// Every frame move the triangles in a region of the model (like an editor would) and compare
+// updating a dynamic tree with rebuilding the tree
+//-----------------------------------------------------------------------------
+void RunDynamicBVHBenchmark()
+{
+	using TriangleCodec = TriangleCodecBitPackSOA4<16, false>;
+	using Test = RayCastCPUQuadTree<TriangleCodec, 16>;
+	using Buffer = DynamicAABBTreeToBuffer<TriangleCodec, Test::NodeCodec>;
+
+	// Moved triangles get their own vertices, so copy the vertices
+	VertexList vertices = mModel->GetTriangleVertices();
+
+	// Insert all triangles
+	DynamicAABBTree tree(vertices);
+	vector<uint32> leafs;
+	PerfTimer insert_timer("DynamicAABBTree: Insert");
+	insert_timer.Start();
+	for (const IndexedTriangle &t : mModel->GetIndexedTriangles())
+		leafs.push_back(tree.Insert(t));
+	insert_timer.Stop((int)leafs.size());
+	insert_timer.Output();
+
+	Buffer buffer, converted_buffer;
+	buffer.Update(tree);
+
+	default_random_engine random(0x1ee7c0de);
+	float max_size = mModel->mBounds.GetSize().ReduceMax();
+	uniform_real_distribution<float> offset(-0.01f * max_size, 0.01f * max_size);
+	uint num_moved = max(1u, (uint)leafs.size() / 100);
+
+	PerfTimer modify_timer("DynamicAABBTree: Remove + Insert");
+	PerfTimer update_timer("DynamicAABBTreeToBuffer: Update");
+	PerfTimer convert_timer("DynamicAABBTreeToBuffer: Convert all");
+	PerfTimer rebuild_timer("AABBTreeBuilder + AABBTreeToBuffer: Rebuild");
+	PerfTimer dynamic_ray_timer("DynamicAABBTree: Cast rays");
+	PerfTimer static_ray_timer("AABBTreeBuilder: Cast rays");
+	uint num_converted = 0;
+	for (int frame = 1; frame <= 10; ++frame)
+	{
+		// Select the triangles closest to a random triangle
+		Vec3 center = tree.GetNode(leafs[random() % leafs.size()]).mBounds.GetCenter();
+		vector<pair<float, uint>> distances;
+		for (uint i = 0; i < (uint)leafs.size(); ++i)
+			distances.push_back({ (tree.GetNode(leafs[i]).mBounds.GetCenter() - center).LengthSq(), i });
+		partial_sort(distances.begin(), distances.begin() + num_moved, distances.end());
+
+		// Move them by removing them and inserting a copy
+		modify_timer.Start();
+		Vec3 delta(offset(random), offset(random), offset(random));
+		for (uint i = 0; i < num_moved; ++i)
+		{
+			uint32 &leaf = leafs[distances[i].second];
+			IndexedTriangle triangle = tree.GetNode(leaf).mTriangle;
+			tree.Remove(leaf);
+			for (uint32 &idx : triangle.mIdx)
+			{
+				Float3 v;
+				(Vec3(vertices[idx]) + delta).StoreFloat3(&v);
+				idx = (uint32)vertices.size();
+				vertices.push_back(v);
+			}
+			leaf = tree.Insert(triangle);
+		}
+		modify_timer.Stop(num_moved);
+
+		// Update the buffer
+		update_timer.Start();
+		buffer.Update(tree);
+		update_timer.Stop(1);
+		num_converted += buffer.GetNumTrianglesConverted();
+
+		// Convert the entire tree
+		convert_timer.Start();
+		converted_buffer.Update(tree, true);
+		convert_timer.Stop(1);
+
+		// Rebuild a static tree
+		rebuild_timer.Start();
+		IndexedTriangleList triangles;
+		triangles.reserve(leafs.size());
+		for (uint32 leaf : leafs)
+			triangles.push_back(tree.GetNode(leaf).mTriangle);
+		TriangleSplitterBinning splitter(vertices, triangles);
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder::Tree rebuilt_tree;
+		AABBTreeBuilder(splitter, 8).Build(rebuilt_tree, stats);
+		Test rebuilt(vertices, &rebuilt_tree);
+		rebuilt.SetSubSystems(mModel, mRenderer);
+		rebuilt.Initialize();
+		rebuild_timer.Stop(1);
+
+		// All trees should give the same result
+		RayCastsOut updated_out, converted_out, rebuilt_out;
+		updated_out.resize(GetRayCount());
+		converted_out.resize(GetRayCount());
+		rebuilt_out.resize(GetRayCount());
+		dynamic_ray_timer.Start();
+		Test::sCastRays(&buffer.GetBuffer()[0], buffer.GetNodeHeader(), buffer.GetTriangleHeader(), mRayCastsBegin, mRayCastsEnd, &updated_out[0]);
+		dynamic_ray_timer.Stop(GetRayCount());
+		Test::sCastRays(&converted_buffer.GetBuffer()[0], converted_buffer.GetNodeHeader(), converted_buffer.GetTriangleHeader(), mRayCastsBegin, mRayCastsEnd, &converted_out[0]);
+		static_ray_timer.Start();
+		rebuilt.CastRays(mRayCastsBegin, mRayCastsEnd, &rebuilt_out[0]);
+		static_ray_timer.Stop(GetRayCount());
+		for (uint j = 0; j < updated_out.size(); ++j)
+		{
+			if (updated_out[j].mDistance != converted_out[j].mDistance)
+				Trace("DynamicAABBTreeToBuffer: Update and convert differ for raycast %d, result: %g should be: %g\n", j, updated_out[j].mDistance, converted_out[j].mDistance);
+			float diff = abs(updated_out[j].mDistance - rebuilt_out[j].mDistance);
+			if (diff / max_size > 1e-5f)
+				Trace("DynamicAABBTree: Mismatch for raycast %d, result: %g should be: %g, diff: %g\n", j, updated_out[j].mDistance, rebuilt_out[j].mDistance, diff);
+		}
+	}
+
+	modify_timer.Output();
+	update_timer.Output();
+	convert_timer.Output();
+	rebuild_timer.Output();
+	dynamic_ray_timer.Output();
+	static_ray_timer.Output();
+	Trace("DynamicAABBTree: SAH cost = %g, triangles converted per update = %d\n", tree.GetSAHCost(), num_converted / 10);
+}
+
+#endif
+
+#ifdef TEST_INSTANCES
+
+//-----------------------------------------------------------------------------
+// Place many instances of the model in a grid and cast rays against them with a two level tree,
+// for a small amount of instances compare with a single tree over the transformed triangles of all instances
+//-----------------------------------------------------------------------------
+void RunInstancesBenchmark()
+{
+	using Mesh = RayCastCPUQuadTreeHalfFloat<TriangleCodecIndexed8BitPackSOA4, 16>;
+
+	// Build the tree for the model, all instances share it
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+
+	default_random_engine random(0x1ee7c0de);
+	uniform_real_distribution<float> angle(0.0f, 2.0f * F_PI);
+	uniform_real_distribution<float> scale(0.5f, 1.5f);
+	float spacing = 2.0f * mModel->mBounds.GetSize().ReduceMax();
+
+	for (int grid_size = 2; grid_size <= 16; grid_size <<= 1)
+	{
+		// Create a grid of randomly rotated and scaled instances
+		vector<RayCastCPUInstances::Instance> instances;
+		AABox world_bounds;
+		for (int x = 0; x < grid_size; ++x)
+			for (int y = 0; y < grid_size; ++y)
+				for (int z = 0; z < grid_size; ++z)
+				{
+					Mat44 transform = Mat44::sTranslation(spacing * Vec3(float(x), float(y), float(z))) * Mat44::sRotationY(angle(random)) * Mat44::sRotationX(angle(random)) * Mat44::sScale(scale(random)) * Mat44::sTranslation(-mModel->mBounds.GetCenter());
+					instances.push_back({ transform, 0 });
+					world_bounds.Encapsulate(mModel->mBounds.Transformed(transform));
+				}
+
+		// Create rays around the instances
+		RayCasts rays;
+		float radius = 0.5f * world_bounds.GetSize().Length();
+		Vec3 mid = world_bounds.GetCenter();
+		for (uint i = 0; i < GetRayCount(); ++i)
+		{
+			Vec3 origin = radius * Vec3::sRandom(random);
+			Vec3 destination = 0.25f * radius * Vec3::sRandom(random);
+			RayCastTestIn ray;
+			(mid + origin).StoreFloat3(&ray.mOrigin);
+			(destination - origin).Normalized().StoreFloat3(&ray.mDirection);
+			rays.push_back(ray);
+		}
+		RayCastsOut instanced_out;
+		instanced_out.resize(rays.size());
+
+		// Build the top level tree
+		string name = "RayCastCPUInstances: instances=" + ConvertToString(instances.size());
+		Mesh *mesh = new Mesh(mModel->GetVertexView(), &tree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		mesh->SetSubSystems(mModel, mRenderer);
+		mesh->Initialize();
+		RayCastCPUInstances test({ mesh }, { mModel->mBounds }, instances);
+		test.SetSubSystems(mModel, mRenderer);
+		string build_name = name + ", build", cast_name = name + ", cast rays", flat_cast_name = name + ", flattened cast rays";
+		{
+			PerfTimer timer(build_name.c_str());
+			timer.Start();
+			test.Initialize();
+			timer.Stop(1);
+			timer.Output();
+		}
+
+		// Cast rays
+		{
+			PerfTimer timer(cast_name.c_str());
+			for (int iteration = 0; iteration < 10; ++iteration)
+			{
+				CacheTrasher::sTrash(rays);
+				CacheTrasher::sTrash(instanced_out);
+				test.TrashCache();
+				timer.Start();
+				test.CastRays(&rays[0], &rays[0] + rays.size(), &instanced_out[0]);
+				timer.Stop((int)rays.size());
+			}
+			timer.Output();
+		}
+		StatsRow instanced_stats;
+		test.GetStats(instanced_stats);
+		Trace("%s, size=%s\n", name.c_str(), instanced_stats.Get(StatsColumn::BufferTotalSize).c_str());
+
+		// Flattening a big grid takes too much memory, compare up to 64 instances
+		if (grid_size > 4)
+			continue;
+
+		// Transform the triangles of all instances into a single model
+		VertexList vertices;
+		IndexedTriangleList triangles;
+		for (const RayCastCPUInstances::Instance &instance : instances)
+		{
+			uint32 first_vertex = (uint32)vertices.size();
+			for (const Float3 &v : mModel->GetTriangleVertices())
+			{
+				Float3 transformed;
+				(instance.mTransform * Vec3(v)).StoreFloat3(&transformed);
+				vertices.push_back(transformed);
+			}
+			for (const IndexedTriangle &t : mModel->GetIndexedTriangles())
+				triangles.push_back(IndexedTriangle(first_vertex + t.mIdx[0], first_vertex + t.mIdx[1], first_vertex + t.mIdx[2], t.mMaterialIndex));
+		}
+		TriangleSplitterBinning splitter(vertices, triangles);
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder::Tree flat_tree;
+		AABBTreeBuilder(splitter, 8).Build(flat_tree, stats);
+		Mesh flat(vertices, &flat_tree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		flat.SetSubSystems(mModel, mRenderer);
+		flat.Initialize();
+		StatsRow flat_stats;
+		flat.GetStats(flat_stats);
+		Trace("%s, flattened size=%s\n", name.c_str(), flat_stats.Get(StatsColumn::BufferTotalSize).c_str());
+
+		// Both should give the same result
+		RayCastsOut flat_out;
+		flat_out.resize(rays.size());
+		{
+			PerfTimer timer(flat_cast_name.c_str());
+			for (int iteration = 0; iteration < 10; ++iteration)
+			{
+				CacheTrasher::sTrash(rays);
+				CacheTrasher::sTrash(flat_out);
+				flat.TrashCache();
+				timer.Start();
+				flat.CastRays(&rays[0], &rays[0] + rays.size(), &flat_out[0]);
+				timer.Stop((int)rays.size());
+			}
+			timer.Output();
+		}
+		for (uint j = 0; j < rays.size(); ++j)
+		{
+			float diff = abs(instanced_out[j].mDistance - flat_out[j].mDistance);
+			if (diff / spacing > 1e-4f)
+				Trace("%s: Mismatch for raycast %d, result: %g should be: %g, diff: %g\n", name.c_str(), j, instanced_out[j].mDistance, flat_out[j].mDistance, diff);
+		}
+	}
+}
+
+#endif
+
+#ifdef TEST_BACKGROUND_REBUILD
+
+//-----------------------------------------------------------------------------
+// Stream in the model in steps and rebuild the tree on a background thread after every step,
+// rays are cast against the latest published tree while the rebuild is running
+//-----------------------------------------------------------------------------
+void RunBackgroundRebuildBenchmark()
+{
+	using TriangleCodec = TriangleCodecBitPackSOA4<16, false>;
+	using Test = RayCastCPUQuadTree<TriangleCodec, 16>;
+	using Rebuilder = AABBTreeRebuilder<TriangleCodec, Test::NodeCodec>;
+
+	const IndexedTriangleList &all_triangles = mModel->GetIndexedTriangles();
+	const int num_steps = 10;
+
+	RayCastsOut out;
+	out.resize(GetRayCount());
+
+	Rebuilder rebuilder;
+	PerfTimer publish_timer("AABBTreeRebuilder: Request to publish");
+	PerfTimer query_timer("AABBTreeRebuilder: Cast rays during rebuild");
+	for (int step = 1; step <= num_steps; ++step)
+	{
+		VertexList vertices = mModel->GetTriangleVertices();
+		IndexedTriangleList triangles(all_triangles.begin(), all_triangles.begin() + all_triangles.size() * step / num_steps);
+		publish_timer.Start();
+		uint64 version = rebuilder.RequestRebuild(std::move(vertices), std::move(triangles));
+
+		// Keep casting rays against the previous tree until the new tree is published
+		for (;;)
+		{
+			RefConst<Rebuilder::Snapshot> snapshot = rebuilder.GetSnapshot();
+			if (snapshot.GetPtr() == nullptr)
+			{
+				// Nothing to cast against yet
+				this_thread::yield();
+				continue;
+			}
+			if (snapshot->mVersion >= version)
+				break;
+
+			query_timer.Start();
+			Test::sCastRays(&snapshot->mBuffer.GetBuffer()[0], snapshot->mBuffer.GetNodeHeader(), snapshot->mBuffer.GetTriangleHeader(), mRayCastsBegin, mRayCastsEnd, &out[0]);
+			query_timer.Stop(1);
+		}
+		publish_timer.Stop(1);
+	}
+
+	// Casting rays never waits for a rebuild, so the worst case latency of a batch should be close to the average
+	PerfTimer::Stats publish_stats, query_stats;
+	publish_timer.GetStats(publish_stats);
+	query_timer.GetStats(query_stats);
+	Trace("AABBTreeRebuilder: Request to publish: avg = %g, max = %g us\n", publish_stats.mTimeAvgUs, publish_stats.mTimeMaxUs);
+	Trace("AABBTreeRebuilder: Cast %d rays during rebuild: batches = %d, avg = %g, max = %g us\n", GetRayCount(), query_stats.mNumSamples, query_stats.mTimeAvgUs, query_stats.mTimeMaxUs);
+
+	// The last tree should give the same result as a tree built on this thread
+	AABBTreeBuilder::Tree tree;
+	TriangleSplitterBinning splitter(mModel->GetVertexView(), all_triangles);
+	AABBTreeBuilderStats stats;
+	AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	Test test(mModel->GetVertexView(), &tree);
+	test.SetSubSystems(mModel, mRenderer);
+	test.Initialize();
+	RayCastsOut expected_out;
+	expected_out.resize(GetRayCount());
+	test.CastRays(mRayCastsBegin, mRayCastsEnd, &expected_out[0]);
+	RefConst<Rebuilder::Snapshot> snapshot = rebuilder.GetSnapshot();
+	Test::sCastRays(&snapshot->mBuffer.GetBuffer()[0], snapshot->mBuffer.GetNodeHeader(), snapshot->mBuffer.GetTriangleHeader(), mRayCastsBegin, mRayCastsEnd, &out[0]);
+	for (uint j = 0; j < GetRayCount(); ++j)
+		if (out[j].mDistance != expected_out[j].mDistance)
+			Trace("AABBTreeRebuilder: Mismatch for raycast %d, result: %g should be: %g\n", j, out[j].mDistance, expected_out[j].mDistance);
+}
+
+#endif
+
+#ifdef TEST_RAY_REORDERING
+
+//-----------------------------------------------------------------------------
+// Cast incoherent rays that start on the surface of the model (like secondary rays) in input order
+// and sorted on origin and direction
+//-----------------------------------------------------------------------------
+void RunRayReorderingBenchmark()
+{
+	using Test = RayCastCPUQuadTreeHalfFloat<TriangleCodecIndexed8BitPackSOA4, 16>;
+
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+
+	// Create rays that start at a random point of a random triangle and go in a random direction
+	const uint num_rays = 1 << 18;
+	default_random_engine random(0x1ee7c0de);
+	uniform_int_distribution<uint> triangle_index(0, mModel->GetTriangleCount() - 1);
+	uniform_real_distribution<float> barycentric(0.0f, 1.0f);
+	float offset = 1.0e-4f * mModel->mBounds.GetSize().ReduceMax();
+	RayCasts rays;
+	rays.reserve(num_rays);
+	for (uint i = 0; i < num_rays; ++i)
+	{
+		Triangle triangle = mModel->GetTriangle(triangle_index(random));
+		float u = barycentric(random), v = barycentric(random);
+		if (u + v > 1.0f)
+		{
+			u = 1.0f - u;
+			v = 1.0f - v;
+		}
+		Vec3 v0(triangle.mV[0]), v1(triangle.mV[1]), v2(triangle.mV[2]);
+		Vec3 direction = Vec3::sRandom(random);
+		RayCastTestIn ray;
+		(v0 + u * (v1 - v0) + v * (v2 - v0) + offset * direction).StoreFloat3(&ray.mOrigin);
+		direction.StoreFloat3(&ray.mDirection);
+		rays.push_back(ray);
+	}
+
+	// Cast in input order
+	RayCastsOut expected_out;
+	expected_out.resize(num_rays);
+	{
+		Test test(mModel->GetVertexView(), &tree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		test.SetSubSystems(mModel, mRenderer);
+		test.Initialize();
+
+		PerfTimer timer("RayCastCPUReordered: Input order");
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			CacheTrasher::sTrash(rays);
+			CacheTrasher::sTrash(expected_out);
+			test.TrashCache();
+			timer.Start();
+			test.CastRays(&rays[0], &rays[0] + num_rays, &expected_out[0]);
+			timer.Stop(num_rays);
+		}
+		timer.Output();
+	}
+
+	// Sort and cast in sorted order
+	for (ERayReorder reorder : { ERayReorder::ORIGIN_MORTON, ERayReorder::OCTANT_ORIGIN_MORTON })
+	{
+		RayCastCPUReordered test(new Test(mModel->GetVertexView(), &tree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST), reorder);
+		test.SetSubSystems(mModel, mRenderer);
+		test.Initialize();
+
+		string sort_name = "RayCastCPUReordered: " + ConvertToString(reorder) + ", sort";
+		string cast_name = "RayCastCPUReordered: " + ConvertToString(reorder) + ", cast rays";
+		PerfTimer sort_timer(sort_name.c_str());
+		PerfTimer cast_timer(cast_name.c_str());
+		RayCastsOut out;
+		out.resize(num_rays);
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			CacheTrasher::sTrash(rays);
+			CacheTrasher::sTrash(out);
+			test.TrashCache();
+			sort_timer.Start();
+			test.Reorder(&rays[0], &rays[0] + num_rays);
+			sort_timer.Stop(num_rays);
+			cast_timer.Start();
+			test.CastReorderedRays(&out[0]);
+			cast_timer.Stop(num_rays);
+		}
+		sort_timer.Output();
+		cast_timer.Output();
+
+		// The order should not change the result
+		for (uint j = 0; j < num_rays; ++j)
+			if (out[j].mDistance != expected_out[j].mDistance)
+				Trace("RayCastCPUReordered: Mismatch for raycast %d, result: %g should be: %g\n", j, out[j].mDistance, expected_out[j].mDistance);
+	}
+}
+
+#endif
+
+#ifdef TEST_INTERLEAVED
+
+//-----------------------------------------------------------------------------
+// Compare casting one ray at a time with interleaving the traversal of multiple rays
+// for trees over increasing parts of the model
+//-----------------------------------------------------------------------------
+void RunInterleavedBenchmark()
+{
+	using Test = RayCastCPUQuadTreeHalfFloat<TriangleCodecIndexed8BitPackSOA4, 16>;
+
+	// Create incoherent rays through the model
+	const uint num_rays = 1 << 16;
+	Vec3 delta = mModel->mBounds.GetSize();
+	float radius = 0.6f * delta.Length();
+	Vec3 mid = mModel->mBounds.GetCenter();
+	default_random_engine random(0x1ee7c0de);
+	RayCasts rays;
+	rays.reserve(num_rays);
+	for (uint i = 0; i < num_rays; ++i)
+	{
+		Vec3 origin = radius * Vec3::sRandom(random);
+		Vec3 destination = 0.25f * radius * Vec3::sRandom(random);
+		RayCastTestIn ray;
+		(mid + origin).StoreFloat3(&ray.mOrigin);
+		(destination - origin).Normalized().StoreFloat3(&ray.mDirection);
+		rays.push_back(ray);
+	}
+
+	const IndexedTriangleList &all_triangles = mModel->GetIndexedTriangles();
+	for (uint fraction = 64; fraction >= 1; fraction /= 8)
+	{
+		// Build a tree for part of the model
+		IndexedTriangleList triangles(all_triangles.begin(), all_triangles.begin() + all_triangles.size() / fraction);
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), triangles);
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder::Tree tree;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+
+		RayCastsOut expected_out;
+		expected_out.resize(num_rays);
+		for (uint rays_in_flight = 1; rays_in_flight <= Test::cMaxRaysInFlight; rays_in_flight <<= 1)
+		{
+			Test test(mModel->GetVertexView(), &tree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST, nullptr, false, rays_in_flight);
+			test.SetSubSystems(mModel, mRenderer);
+			test.Initialize();
+			StatsRow test_stats;
+			test.GetStats(test_stats);
+
+			// Cast with a cold cache
+			string name = "RayCastCPUQuadTreeHalfFloat: triangles=" + ConvertToString(triangles.size()) + ", size=" + test_stats.Get(StatsColumn::BufferTotalSize) + ", rays in flight=" + ConvertToString(rays_in_flight);
+			PerfTimer timer(name.c_str());
+			RayCastsOut out;
+			out.resize(num_rays);
+			for (int iteration = 0; iteration < 5; ++iteration)
+			{
+				CacheTrasher::sTrash(rays);
+				CacheTrasher::sTrash(out);
+				test.TrashCache();
+				timer.Start();
+				test.CastRays(&rays[0], &rays[0] + num_rays, &out[0]);
+				timer.Stop(num_rays);
+			}
+			timer.Output();
+
+			// Interleaving should not change the result
+			if (rays_in_flight == 1)
+				expected_out = out;
+			else
+				for (uint j = 0; j < num_rays; ++j)
+					if (out[j].mDistance != expected_out[j].mDistance)
+						Trace("RayCastCPUQuadTreeHalfFloat: Mismatch for raycast %d, result: %g should be: %g\n", j, out[j].mDistance, expected_out[j].mDistance);
+		}
+	}
+}
+
+#endif
+
+#ifdef TEST_PREFETCH
+
+//-----------------------------------------------------------------------------
+// Compare the prefetch policies of RayCastCPUQuadTreeHalfFloat with a cold and a warm cache,
+// casting one ray at a time and interleaving 8 rays
+//-----------------------------------------------------------------------------
+void RunPrefetchBenchmark()
+{
+	using Test = RayCastCPUQuadTreeHalfFloat<TriangleCodecIndexed8BitPackSOA4, 16>;
+
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+
+	// Create incoherent rays through the model
+	const uint num_rays = 1 << 16;
+	float radius = 0.6f * mModel->mBounds.GetSize().Length();
+	Vec3 mid = mModel->mBounds.GetCenter();
+	default_random_engine random(0x1ee7c0de);
+	RayCasts rays;
+	rays.reserve(num_rays);
+	for (uint i = 0; i < num_rays; ++i)
+	{
+		Vec3 origin = radius * Vec3::sRandom(random);
+		Vec3 destination = 0.25f * radius * Vec3::sRandom(random);
+		RayCastTestIn ray;
+		(mid + origin).StoreFloat3(&ray.mOrigin);
+		(destination - origin).Normalized().StoreFloat3(&ray.mDirection);
+		rays.push_back(ray);
+	}
+
+	RayCastsOut expected_out;
+	for (uint rays_in_flight : { 1u, 8u })
+		for (EQuadTreePrefetch prefetch : { EQuadTreePrefetch::NONE, EQuadTreePrefetch::NEAREST_CHILD, EQuadTreePrefetch::HIT_CHILDREN, EQuadTreePrefetch::HIT_CHILDREN_AND_VERTICES })
+		{
+			Test test(mModel->GetVertexView(), &tree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST, nullptr, false, rays_in_flight, prefetch);
+			test.SetSubSystems(mModel, mRenderer);
+			test.Initialize();
+
+			RayCastsOut out;
+			out.resize(num_rays);
+			for (int cold = 1; cold >= 0; --cold)
+			{
+				string name = "RayCastCPUQuadTreeHalfFloat: Rays in flight " + ConvertToString(rays_in_flight) + ", prefetch " + ConvertToString(prefetch) + (cold? ", cold cache" : ", warm cache");
+				PerfTimer timer(name.c_str());
+				for (int iteration = 0; iteration < 5; ++iteration)
+				{
+					if (cold)
+					{
+						CacheTrasher::sTrash(rays);
+						CacheTrasher::sTrash(out);
+						test.TrashCache();
+					}
+					timer.Start();
+					test.CastRays(&rays[0], &rays[0] + num_rays, &out[0]);
+					timer.Stop(num_rays);
+				}
+				timer.Output();
+			}
+
+			// Prefetching should not change the result
+			if (expected_out.empty())
+				expected_out = out;
+			else
+				for (uint j = 0; j < num_rays; ++j)
+					if (out[j].mDistance != expected_out[j].mDistance)
+						Trace("RayCastCPUQuadTreeHalfFloat: Mismatch for raycast %d, result: %g should be: %g\n", j, out[j].mDistance, expected_out[j].mDistance);
+		}
+}
+
+#endif
+
+#ifdef TEST_HUGE_PAGES
+
+//-----------------------------------------------------------------------------
+// Compare tree buffers that are backed by regular pages with buffers that are backed by huge pages
+//-----------------------------------------------------------------------------
+void RunHugePagesBenchmark()
+{
+	using Test = RayCastCPUQuadTreeHalfFloat<TriangleCodecIndexed8BitPackSOA4, 16>;
+
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+
+	// Create incoherent rays through the model, these touch a different part of the tree for every ray
+	const uint num_rays = 1 << 16;
+	float radius = 0.6f * mModel->mBounds.GetSize().Length();
+	Vec3 mid = mModel->mBounds.GetCenter();
+	default_random_engine random(0x1ee7c0de);
+	RayCasts rays;
+	rays.reserve(num_rays);
+	for (uint i = 0; i < num_rays; ++i)
+	{
+		Vec3 origin = radius * Vec3::sRandom(random);
+		Vec3 destination = 0.25f * radius * Vec3::sRandom(random);
+		RayCastTestIn ray;
+		(mid + origin).StoreFloat3(&ray.mOrigin);
+		(destination - origin).Normalized().StoreFloat3(&ray.mDirection);
+		rays.push_back(ray);
+	}
+
+	RayCastsOut expected_out;
+	for (EHugePages huge_pages : { EHugePages::HUGE_PAGES_NONE, EHugePages::HUGE_PAGES_TRANSPARENT, EHugePages::HUGE_PAGES_EXPLICIT })
+	{
+		// Only the buffers that are allocated while huge pages are enabled use them
+		SetHugePages(huge_pages);
+		Test test(mModel->GetVertexView(), &tree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		test.SetSubSystems(mModel, mRenderer);
+		test.Initialize();
+		SetHugePages(EHugePages::HUGE_PAGES_NONE);
+
+		size_t allocated_size, page_size, transparent_size;
+		GetHugePageStats(allocated_size, page_size, transparent_size);
+		Trace("Huge pages %s: %.1f MB allocated in %u KB pages, transparent huge pages requested for %.1f MB\n", ConvertToString(huge_pages).c_str(), double(allocated_size) / (1024 * 1024), uint(page_size / 1024), double(transparent_size) / (1024 * 1024));
+
+		RayCastsOut out;
+		out.resize(num_rays);
+		for (int cold = 1; cold >= 0; --cold)
+		{
+			string name = "RayCastCPUQuadTreeHalfFloat: Huge pages " + ConvertToString(huge_pages) + (cold? ", cold cache" : ", warm cache");
+			PerfTimer timer(name.c_str());
+			for (int iteration = 0; iteration < 5; ++iteration)
+			{
+				if (cold)
+				{
+					CacheTrasher::sTrash(rays);
+					CacheTrasher::sTrash(out);
+					test.TrashCache();
+				}
+				timer.Start();
+				test.CastRays(&rays[0], &rays[0] + num_rays, &out[0]);
+				timer.Stop(num_rays);
+			}
+			timer.Output();
+		}
+
+		// The pages should not change the result
+		if (expected_out.empty())
+			expected_out = out;
+		else
+			for (uint j = 0; j < num_rays; ++j)
+				if (out[j].mDistance != expected_out[j].mDistance)
+					Trace("RayCastCPUQuadTreeHalfFloat: Mismatch for raycast %d, result: %g should be: %g\n", j, out[j].mDistance, expected_out[j].mDistance);
+	}
+}
+
+#endif
+
+#ifdef TEST_SHAPE_CAST
+
+//-----------------------------------------------------------------------------
+// Sweep spheres and capsules through the quad tree and compare with testing all triangles
+//-----------------------------------------------------------------------------
+void RunShapeCastBenchmark()
+{
+	using Cast = ShapeCastQuadTree<TriangleCodecIndexed8BitPackSOA4, 16>;
+
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+	Cast::Buffer buffer;
+	AABBTreeToBufferStats buffer_stats;
+	buffer.Convert(mModel->GetVertexView(), tree, buffer_stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+
+	// Create shapes outside of the model that move towards the model, the size of the shapes is a fraction of the size of the model
+	const uint num_casts = 1 << 12;
+	float size = mModel->mBounds.GetSize().Length();
+	float radius = 0.6f * size;
+	Vec3 mid = mModel->mBounds.GetCenter();
+	default_random_engine random(0x1ee7c0de);
+	uniform_real_distribution<float> shape_size(0.001f * size, 0.02f * size);
+	vector<SphereCast> spheres;
+	vector<CapsuleCast> capsules;
+	spheres.reserve(num_casts);
+	capsules.reserve(num_casts);
+	for (uint i = 0; i < num_casts; ++i)
+	{
+		Vec3 origin = mid + radius * Vec3::sRandom(random);
+		Vec3 displacement = mid + 0.25f * radius * Vec3::sRandom(random) - origin;
+		Vec3 axis = shape_size(random) * Vec3::sRandom(random);
+		float shape_radius = shape_size(random);
+
+		SphereCast sphere;
+		origin.StoreFloat3(&sphere.mCenter);
+		sphere.mRadius = shape_radius;
+		displacement.StoreFloat3(&sphere.mDisplacement);
+		spheres.push_back(sphere);
+
+		CapsuleCast capsule;
+		(origin - axis).StoreFloat3(&capsule.mPoint1);
+		(origin + axis).StoreFloat3(&capsule.mPoint2);
+		capsule.mRadius = shape_radius;
+		displacement.StoreFloat3(&capsule.mDisplacement);
+		capsules.push_back(capsule);
+	}
+
+	// Gather all triangles of the model in groups of 4 for the brute force test, the last group is padded with degenerate triangles
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	const IndexedTriangleList &triangles = mModel->GetIndexedTriangles();
+	uint num_groups = uint(triangles.size() + 3) / 4;
+	vector<Float4> groups(num_groups * 9);
+	for (uint t = 0; t < num_groups * 4; ++t)
+	{
+		const IndexedTriangle &triangle = triangles[min(t, uint(triangles.size()) - 1)];
+		for (int v = 0; v < 3; ++v)
+		{
+			const Float3 &vertex = vertices[triangle.mIdx[t < triangles.size()? v : 0]];
+			Float4 *group = &groups[(t >> 2) * 9 + v * 3];
+			reinterpret_cast<float *>(&group[0])[t & 3] = vertex.x;
+			reinterpret_cast<float *>(&group[1])[t & 3] = vertex.y;
+			reinterpret_cast<float *>(&group[2])[t & 3] = vertex.z;
+		}
+	}
+
+	// Returns the closest fraction of all groups for a triangle test
+	auto brute_force = [&groups, num_groups](const auto &inTriangleTest)
+	{
+		Vec4 closest = Vec4::sReplicate(FLT_MAX);
+		for (uint g = 0; g < num_groups; ++g)
+		{
+			const Float4 *group = &groups[g * 9];
+			Vec4 fraction = inTriangleTest(Vec4::sLoadFloat4(&group[0]), Vec4::sLoadFloat4(&group[1]), Vec4::sLoadFloat4(&group[2]), Vec4::sLoadFloat4(&group[3]), Vec4::sLoadFloat4(&group[4]), Vec4::sLoadFloat4(&group[5]), Vec4::sLoadFloat4(&group[6]), Vec4::sLoadFloat4(&group[7]), Vec4::sLoadFloat4(&group[8]));
+			closest = Vec4::sMin(closest, Vec4::sSelect(fraction, Vec4::sReplicate(FLT_MAX), Vec4::sGreater(fraction, Vec4::sReplicate(1.0f))));
+		}
+		return closest.ReduceMin();
+	};
+
+	// Check the results of the tree against the brute force results for the first casts
+	const uint num_validate = 256;
+	auto validate = [num_validate](const char *inName, const vector<ShapeCastResult> &inResults, const auto &inBruteForce)
+	{
+		for (uint i = 0; i < num_validate; ++i)
+		{
+			float expected = inBruteForce(i);
+			if (abs(inResults[i].mFraction - expected) > 1.0e-3f * max(1.0f, expected))
+				Trace("%s: Mismatch for cast %d, result: %g should be: %g\n", inName, i, inResults[i].mFraction, expected);
+		}
+	};
+
+	// Independent reference for the sweep math that doesn't use the swept tests: the distance between a segment (a sphere is a segment of length 0) and a triangle
+	// is calculated with scalar code and the shape is advanced along the displacement by that distance until it touches (conservative advancement)
+	auto segment_segment_dist_sq = [](const Vec3 &inP1, const Vec3 &inQ1, const Vec3 &inP2, const Vec3 &inQ2)
+	{
+		Vec3 d1 = inQ1 - inP1, d2 = inQ2 - inP2, r = inP1 - inP2;
+		float a = d1.Dot(d1), e = d2.Dot(d2), f = d2.Dot(r);
+		float s = 0.0f, t = 0.0f;
+		if (a <= FLT_MIN)
+			t = e <= FLT_MIN? 0.0f : Clamp(f / e, 0.0f, 1.0f);
+		else
+		{
+			float c = d1.Dot(r);
+			if (e <= FLT_MIN)
+				s = Clamp(-c / a, 0.0f, 1.0f);
+			else
+			{
+				float b = d1.Dot(d2);
+				float denom = a * e - b * b;
+				s = denom > 0.0f? Clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+				t = (b * s + f) / e;
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = Clamp(-c / a, 0.0f, 1.0f);
+				}
+				else if (t > 1.0f)
+				{
+					t = 1.0f;
+					s = Clamp((b - c) / a, 0.0f, 1.0f);
+				}
+			}
+		}
+		return (inP1 + s * d1 - inP2 - t * d2).LengthSq();
+	};
+	auto segment_triangle_dist_sq = [&segment_segment_dist_sq](const Vec3 &inP, const Vec3 &inQ, const Vec3 &inV0, const Vec3 &inV1, const Vec3 &inV2)
+	{
+		Vec3 n = (inV1 - inV0).Cross(inV2 - inV0);
+		float n_len_sq = n.LengthSq();
+		auto inside = [&](const Vec3 &inX) { return n.Dot((inV1 - inV0).Cross(inX - inV0)) >= 0.0f && n.Dot((inV2 - inV1).Cross(inX - inV1)) >= 0.0f && n.Dot((inV0 - inV2).Cross(inX - inV2)) >= 0.0f; };
+
+		// Segment crosses the triangle
+		float dp = n.Dot(inP - inV0), dq = n.Dot(inQ - inV0);
+		if (n_len_sq > 0.0f && ((dp <= 0.0f && dq >= 0.0f) || (dp >= 0.0f && dq <= 0.0f)) && dp != dq && inside(inP + (dp / (dp - dq)) * (inQ - inP)))
+			return 0.0f;
+
+		// End points vs the plane of the triangle
+		float dist_sq = FLT_MAX;
+		if (n_len_sq > 0.0f)
+		{
+			if (inside(inP))
+				dist_sq = min(dist_sq, Square(dp) / n_len_sq);
+			if (inside(inQ))
+				dist_sq = min(dist_sq, Square(dq) / n_len_sq);
+		}
+
+		// Segment vs the edges of the triangle
+		dist_sq = min(dist_sq, segment_segment_dist_sq(inP, inQ, inV0, inV1));
+		dist_sq = min(dist_sq, segment_segment_dist_sq(inP, inQ, inV1, inV2));
+		dist_sq = min(dist_sq, segment_segment_dist_sq(inP, inQ, inV2, inV0));
+		return dist_sq;
+	};
+	auto reference_cast = [&segment_triangle_dist_sq, size](const Vec3 &inPoint1, const Vec3 &inPoint2, float inRadius, const Vec3 &inDisplacement, const VertexList &inVertices, const IndexedTriangleList &inTriangles)
+	{
+		// Only triangles that overlap with the bounds of the sweep can be hit
+		AABox bounds;
+		bounds.Encapsulate(inPoint1);
+		bounds.Encapsulate(inPoint2);
+		bounds.Encapsulate(inPoint1 + inDisplacement);
+		bounds.Encapsulate(inPoint2 + inDisplacement);
+		bounds.WidenByConstant(Vec3::sReplicate(2.0f * inRadius));
+		vector<const IndexedTriangle *> candidates;
+		for (const IndexedTriangle &t : inTriangles)
+		{
+			AABox triangle_bounds;
+			triangle_bounds.Encapsulate(inVertices, t);
+			if (bounds.Overlaps(triangle_bounds))
+				candidates.push_back(&t);
+		}
+
+		float length = inDisplacement.Length();
+		float fraction = 0.0f;
+		for (int iteration = 0; iteration < 1000; ++iteration)
+		{
+			Vec3 offset = fraction * inDisplacement;
+			float dist_sq = FLT_MAX;
+			for (const IndexedTriangle *t : candidates)
+				dist_sq = min(dist_sq, segment_triangle_dist_sq(inPoint1 + offset, inPoint2 + offset, Vec3(inVertices[t->mIdx[0]]), Vec3(inVertices[t->mIdx[1]]), Vec3(inVertices[t->mIdx[2]])));
+			float dist = sqrt(dist_sq) - inRadius;
+			if (dist <= 1.0e-5f * size)
+				return fraction;
+			fraction += dist / length;
+			if (fraction > 1.0f)
+				break;
+		}
+		return FLT_MAX;
+	};
+
+	// Check the swept tests and the reference against contacts that can be calculated by hand: a triangle in the XY plane, spheres and capsules with radius 1
+	{
+		VertexList vertices = { Float3(0, 0, 0), Float3(4, 0, 0), Float3(0, 4, 0) };
+		IndexedTriangleList triangles = { IndexedTriangle(0, 1, 2) };
+		Vec4 v0x = Vec4::sReplicate(0), v0y = Vec4::sReplicate(0), v0z = Vec4::sReplicate(0);
+		Vec4 v1x = Vec4::sReplicate(4), v1y = Vec4::sReplicate(0), v1z = Vec4::sReplicate(0);
+		Vec4 v2x = Vec4::sReplicate(0), v2y = Vec4::sReplicate(4), v2z = Vec4::sReplicate(0);
+		auto check = [](const char *inName, float inFraction, float inExpected)
+		{
+			if (inExpected == FLT_MAX? inFraction <= 1.0f : abs(inFraction - inExpected) > 1.0e-4f)
+				FatalError("ShapeCastQuadTree: %s, result: %g should be: %g", inName, inFraction, inExpected);
+		};
+		struct Case { const char *mName; Vec3 mPoint1, mPoint2, mDisplacement; float mFraction; };
+		const Case cases[] = {
+			{ "Sphere face",					Vec3(1, 1, 3),		Vec3(1, 1, 3),		Vec3(0, 0, -4),		0.5f },
+			{ "Sphere back face",				Vec3(1, 1, -3),		Vec3(1, 1, -3),		Vec3(0, 0, 4),		0.5f },
+			{ "Sphere edge",					Vec3(2, -3, 0),		Vec3(2, -3, 0),		Vec3(0, 4, 0),		0.5f },
+			{ "Sphere vertex",					Vec3(-3, -3, 0),	Vec3(-3, -3, 0),	Vec3(3, 3, 0),		1.0f - sqrt(0.5f) / 3.0f },
+			{ "Sphere vertex along edge",		Vec3(-3, 0, 0),		Vec3(-3, 0, 0),		Vec3(4, 0, 0),		0.5f },
+			{ "Sphere initially overlapping",	Vec3(1, 1, 0.5f),	Vec3(1, 1, 0.5f),	Vec3(0, 0, 4),		0.0f },
+			{ "Sphere miss",					Vec3(5, 5, 3),		Vec3(5, 5, 3),		Vec3(0, 0, -6),		FLT_MAX },
+			{ "Capsule face",					Vec3(1, 1, 3),		Vec3(1, 1, 5),		Vec3(0, 0, -4),		0.5f },
+			{ "Capsule parallel to edge",		Vec3(1, -3, 0),		Vec3(3, -3, 0),		Vec3(0, 4, 0),		0.5f },
+			{ "Capsule crossing edge",			Vec3(2, -3, -1),	Vec3(2, -3, 1),		Vec3(0, 4, 0),		0.5f },
+			{ "Capsule through face",			Vec3(1, 1, -1),		Vec3(1, 1, 1),		Vec3(4, 4, 0),		0.0f },
+			{ "Capsule miss",					Vec3(5, 5, -1),		Vec3(5, 5, 1),		Vec3(4, 0, 0),		FLT_MAX },
+		};
+		for (const Case &c : cases)
+		{
+			float fraction = c.mPoint1 == c.mPoint2?
+				SweptSphereTriangle4(c.mPoint1, c.mDisplacement, 1.0f, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z).GetX() :
+				SweptCapsuleTriangle4(c.mPoint1, c.mPoint2, 1.0f, c.mDisplacement, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z).GetX();
+			check(c.mName, fraction, c.mFraction);
+			check(c.mName, reference_cast(c.mPoint1, c.mPoint2, 1.0f, c.mDisplacement, vertices, triangles), c.mFraction);
+		}
+	}
+
+	vector<ShapeCastResult> results(num_casts);
+
+	{
+		string name = "ShapeCastQuadTree: Spheres";
+		PerfTimer timer(name.c_str());
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			Cast::sCastSpheres(buffer, &spheres[0], &spheres[0] + num_casts, &results[0]);
+			timer.Stop(num_casts);
+		}
+		timer.Output();
+
+		validate(name.c_str(), results, [&](uint inIndex)
+		{
+			const SphereCast &sphere = spheres[inIndex];
+			Vec3 center(sphere.mCenter), displacement(sphere.mDisplacement);
+			return brute_force([center, displacement, &sphere](const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				return SweptSphereTriangle4(center, displacement, sphere.mRadius, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+			});
+		});
+
+		validate((name + " vs reference").c_str(), results, [&](uint inIndex)
+		{
+			const SphereCast &sphere = spheres[inIndex];
+			return reference_cast(Vec3(sphere.mCenter), Vec3(sphere.mCenter), sphere.mRadius, Vec3(sphere.mDisplacement), vertices, triangles);
+		});
+	}
+
+	{
+		string name = "ShapeCastQuadTree: Capsules";
+		PerfTimer timer(name.c_str());
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			Cast::sCastCapsules(buffer, &capsules[0], &capsules[0] + num_casts, &results[0]);
+			timer.Stop(num_casts);
+		}
+		timer.Output();
+
+		validate(name.c_str(), results, [&](uint inIndex)
+		{
+			const CapsuleCast &capsule = capsules[inIndex];
+			Vec3 point1(capsule.mPoint1), point2(capsule.mPoint2), displacement(capsule.mDisplacement);
+			return brute_force([point1, point2, displacement, &capsule](const Vec4 &inV0X, const Vec4 &inV0Y, const Vec4 &inV0Z, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z)
+			{
+				return SweptCapsuleTriangle4(point1, point2, capsule.mRadius, displacement, inV0X, inV0Y, inV0Z, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z);
+			});
+		});
+
+		validate((name + " vs reference").c_str(), results, [&](uint inIndex)
+		{
+			const CapsuleCast &capsule = capsules[inIndex];
+			return reference_cast(Vec3(capsule.mPoint1), Vec3(capsule.mPoint2), capsule.mRadius, Vec3(capsule.mDisplacement), vertices, triangles);
+		});
+	}
+
+	// A sweep through the bounds of the padding children (a point at HALF_FLT_MAX) should not hit anything
+	{
+		SphereCast sphere;
+		sphere.mCenter = Float3(60000.0f, 60000.0f, 60000.0f);
+		sphere.mRadius = 1.0f;
+		sphere.mDisplacement = Float3(10000.0f, 10000.0f, 10000.0f);
+		ShapeCastResult result;
+		Cast::sCastSpheres(buffer, &sphere, &sphere + 1, &result);
+		if (result.mFraction != FLT_MAX)
+			FatalError("ShapeCastQuadTree: Sweep through padding hit at fraction %g", result.mFraction);
+	}
+
+	// Count the hits
+	uint num_hits = 0;
+	for (const ShapeCastResult &result : results)
+		if (result.mFraction <= 1.0f)
+			++num_hits;
+	Trace("ShapeCastQuadTree: %u of %u capsules hit\n", num_hits, num_casts);
+}
+
+#endif
+
+#ifdef TEST_BOX_OVERLAP
+
+//-----------------------------------------------------------------------------
+// Collect the triangles around random boxes and compare with testing all triangles
+//-----------------------------------------------------------------------------
+void RunBoxOverlapBenchmark()
+{
+	// Use a lossless triangle codec so that the triangles can be compared with the triangles of the model
+	using Overlap = BoxOverlapQuadTree<TriangleCodecFloat3SOA4<16>, 16>;
+
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+	Overlap::Buffer buffer;
+	AABBTreeToBufferStats buffer_stats;
+	buffer.Convert(mModel->GetVertexView(), tree, buffer_stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+
+	// Create boxes around random vertices of the model, like the bodies of a physics simulation that rest on the mesh
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	const IndexedTriangleList &triangles = mModel->GetIndexedTriangles();
+	const uint num_boxes = 1 << 12;
+	float size = mModel->mBounds.GetSize().Length();
+	default_random_engine random(0x1ee7c0de);
+	uniform_int_distribution<uint> vertex_index(0, uint(vertices.size()) - 1);
+	uniform_real_distribution<float> box_size(0.005f * size, 0.05f * size);
+	uniform_real_distribution<float> angle(0.0f, 2.0f * 3.14159265f);
+	vector<AABox> aaboxes;
+	vector<OrientedBox> oriented_boxes;
+	aaboxes.reserve(num_boxes);
+	oriented_boxes.reserve(num_boxes);
+	for (uint i = 0; i < num_boxes; ++i)
+	{
+		Vec3 center(vertices[vertex_index(random)]);
+		Vec3 half_extent(box_size(random), box_size(random), box_size(random));
+		aaboxes.push_back(AABox(center - half_extent, center + half_extent));
+		oriented_boxes.push_back(OrientedBox(Mat44::sTranslation(center) * Mat44::sRotationX(angle(random)) * Mat44::sRotationY(angle(random)) * Mat44::sRotationZ(angle(random)), half_extent));
+	}
+
+	// Count the triangles that overlap with a box by testing all triangles, inBoxSpace transforms from world space to box space
+	auto brute_force = [&vertices, &triangles](const Mat44 &inBoxSpace, const Vec3 &inHalfExtent)
+	{
+		uint count = 0;
+		for (const IndexedTriangle &triangle : triangles)
+		{
+			Vec3 v0 = inBoxSpace * Vec3(vertices[triangle.mIdx[0]]);
+			Vec3 v1 = inBoxSpace * Vec3(vertices[triangle.mIdx[1]]);
+			Vec3 v2 = inBoxSpace * Vec3(vertices[triangle.mIdx[2]]);
+			if (AABoxTriangle4(inHalfExtent, v0.SplatX(), v0.SplatY(), v0.SplatZ(), v1.SplatX(), v1.SplatY(), v1.SplatZ(), v2.SplatX(), v2.SplatY(), v2.SplatZ()).TestAllTrue())
+				++count;
+		}
+		return count;
+	};
+
+	const uint max_triangles = 1024;
+	vector<OverlapTriangle> overlapping(max_triangles);
+	vector<uint> counts(num_boxes);
+	const uint num_validate = 256;
+
+	{
+		string name = "BoxOverlapQuadTree: Axis aligned boxes";
+		PerfTimer timer(name.c_str());
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			for (uint i = 0; i < num_boxes; ++i)
+				counts[i] = Overlap::sCollideAABox(buffer, aaboxes[i], &overlapping[0], max_triangles);
+			timer.Stop(num_boxes);
+		}
+		timer.Output();
+
+		for (uint i = 0; i < num_validate; ++i)
+		{
+			uint expected = brute_force(Mat44::sTranslation(-aaboxes[i].GetCenter()), 0.5f * aaboxes[i].GetSize());
+			if (counts[i] != expected)
+				Trace("%s: Mismatch for box %d, result: %u should be: %u\n", name.c_str(), i, counts[i], expected);
+		}
+	}
+
+	{
+		string name = "BoxOverlapQuadTree: Oriented boxes";
+		PerfTimer timer(name.c_str());
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			for (uint i = 0; i < num_boxes; ++i)
+				counts[i] = Overlap::sCollideOrientedBox(buffer, oriented_boxes[i], &overlapping[0], max_triangles);
+			timer.Stop(num_boxes);
+		}
+		timer.Output();
+
+		for (uint i = 0; i < num_validate; ++i)
+		{
+			// Triangles that touch the box can be classified differently because the transform to box space rounds differently
+			uint expected = brute_force(oriented_boxes[i].mOrientation.InversedRotationTranslation(), oriented_boxes[i].mHalfExtent);
+			if (abs(int(counts[i]) - int(expected)) > int(expected / 1000))
+				Trace("%s: Mismatch for box %d, result: %u should be: %u\n", name.c_str(), i, counts[i], expected);
+		}
+	}
+
+	// Report the average number of triangles per box
+	uint64 total = 0;
+	for (uint count : counts)
+		total += count;
+	Trace("BoxOverlapQuadTree: %.1f triangles per oriented box\n", double(total) / num_boxes);
+
+	// A huge box also overlaps the bounds of the padding children (a point at HALF_FLT_MAX), it should find every triangle exactly once
+	{
+		AABox huge(Vec3::sMin(mModel->mBounds.mMin, Vec3::sReplicate(-1.0e5f)), Vec3::sMax(mModel->mBounds.mMax, Vec3::sReplicate(1.0e5f)));
+		vector<OverlapTriangle> all(triangles.size());
+		uint count = Overlap::sCollideAABox(buffer, huge, &all[0], uint(all.size()));
+		if (count != triangles.size())
+			FatalError("BoxOverlapQuadTree: Huge box found %u triangles, should be: %u", count, uint(triangles.size()));
+	}
+}
+
+#endif
+
+#ifdef TEST_CLOSEST_POINT
+
+//-----------------------------------------------------------------------------
+// Find the closest point on the mesh for random points and compare with testing all triangles
+//-----------------------------------------------------------------------------
+template <class NodeCodec>
+void RunClosestPointBenchmark(const AABBTreeBuilder::Tree &inTree, const vector<Float3> &inPoints, const vector<float> &inExpectedDistances, const char *inNodeCodecName)
+{
+	// Use a lossless triangle codec so that the distances can be compared with the triangles of the model
+	using Query = ClosestPointQuadTree<TriangleCodecFloat3SOA4<16>, NodeCodec>;
+
+	typename Query::Buffer buffer;
+	AABBTreeToBufferStats buffer_stats;
+	buffer.Convert(mModel->GetVertexView(), inTree, buffer_stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+
+	uint num_points = uint(inPoints.size());
+	vector<ClosestPointResult> results(num_points);
+
+	string name = string("ClosestPointQuadTree: ") + inNodeCodecName;
+	PerfTimer timer(name.c_str());
+	for (int iteration = 0; iteration < 5; ++iteration)
+	{
+		timer.Start();
+		Query::sFindClosestPoints(buffer, &inPoints[0], &inPoints[0] + num_points, &results[0]);
+		timer.Stop(num_points);
+	}
+	timer.Output();
+
+	for (uint i = 0; i < uint(inExpectedDistances.size()); ++i)
+		if (abs(results[i].mDistance - inExpectedDistances[i]) > 1.0e-5f * max(1.0f, inExpectedDistances[i]))
+			Trace("%s: Mismatch for point %d, result: %g should be: %g\n", name.c_str(), i, results[i].mDistance, inExpectedDistances[i]);
+}
+
+void RunClosestPointBenchmark()
+{
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+
+	// Create random points in and around the bounds of the model
+	const uint num_points = 1 << 14;
+	Vec3 mid = mModel->mBounds.GetCenter();
+	Vec3 extent = 0.6f * mModel->mBounds.GetSize();
+	default_random_engine random(0x1ee7c0de);
+	uniform_real_distribution<float> minus_one_to_one(-1.0f, 1.0f);
+	vector<Float3> points(num_points);
+	for (Float3 &point : points)
+		(mid + extent * Vec3(minus_one_to_one(random), minus_one_to_one(random), minus_one_to_one(random))).StoreFloat3(&point);
+
+	// Calculate the distance for the first points by testing all triangles
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	const IndexedTriangleList &triangles = mModel->GetIndexedTriangles();
+	vector<float> expected(256);
+	for (uint i = 0; i < uint(expected.size()); ++i)
+	{
+		Vec3 point(points[i]);
+		float closest = FLT_MAX;
+		for (const IndexedTriangle &triangle : triangles)
+		{
+			Vec3 v0(vertices[triangle.mIdx[0]]), v1(vertices[triangle.mIdx[1]]), v2(vertices[triangle.mIdx[2]]);
+			Vec4 x, y, z;
+			closest = min(closest, ClosestPointOnTriangle4(point, v0.SplatX(), v0.SplatY(), v0.SplatZ(), v1.SplatX(), v1.SplatY(), v1.SplatZ(), v2.SplatX(), v2.SplatY(), v2.SplatZ(), x, y, z).GetX());
+		}
+		expected[i] = sqrt(closest);
+	}
+
+	RunClosestPointBenchmark<NodeCodecQuadTree<16>>(tree, points, expected, "NodeCodecQuadTree");
+	RunClosestPointBenchmark<NodeCodecQuadTreeHalfFloat<16>>(tree, points, expected, "NodeCodecQuadTreeHalfFloat");
+}
+
+#endif
+
+#ifdef TEST_POINT_IN_MESH
+
+//-----------------------------------------------------------------------------
+// Test the points of a voxel grid for being inside the mesh and compare with testing all triangles
+//-----------------------------------------------------------------------------
+void RunPointInMeshBenchmark()
+{
+	using Query = PointInMeshQuadTree<TriangleCodecIndexed8BitPackSOA4, NodeCodecQuadTreeHalfFloat<16>>;
+
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+	Query::Buffer buffer;
+	AABBTreeToBufferStats buffer_stats;
+	buffer.Convert(mModel->GetVertexView(), tree, buffer_stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+
+	// Create the centers of the voxels of a grid around the model, neighbouring points in the list are neighbours in the grid
+	const uint grid_size = 64;
+	Vec3 grid_min = mModel->mBounds.mMin - 0.05f * mModel->mBounds.GetSize();
+	Vec3 voxel_size = 1.1f * mModel->mBounds.GetSize() / float(grid_size);
+	vector<Float3> points;
+	points.reserve(grid_size * grid_size * grid_size);
+	for (uint z = 0; z < grid_size; ++z)
+		for (uint y = 0; y < grid_size; ++y)
+			for (uint x = 0; x < grid_size; ++x)
+				(grid_min + voxel_size * Vec3(x + 0.5f, y + 0.5f, z + 0.5f)).StoreFloat3(&points.emplace_back());
+	uint num_points = uint(points.size());
+
+	// Test with 4 points per traversal and with 1 point per traversal
+	bool *inside = new bool [num_points];
+	for (uint points_per_traversal : { 4, 1 })
+	{
+		string name = "PointInMeshQuadTree: " + ConvertToString(points_per_traversal) + " points per traversal";
+		PerfTimer timer(name.c_str());
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			if (points_per_traversal == 4)
+				Query::sTestPoints(buffer, &points[0], &points[0] + num_points, inside);
+			else
+				for (uint i = 0; i < num_points; ++i)
+					Query::sTestPoints(buffer, &points[i], &points[i] + 1, &inside[i]);
+			timer.Stop(num_points);
+		}
+		timer.Output();
+	}
+
+	// Count the hits of a sample of the rays with all triangles
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	const IndexedTriangleList &triangles = mModel->GetIndexedTriangles();
+	Vec3 direction = Query::sGetRayDirection();
+	uint num_inside = 0;
+	for (uint i = 0; i < num_points; ++i)
+	{
+		if (inside[i])
+			++num_inside;
+
+		if (i % 997 == 0)
+		{
+			Vec3 origin(points[i]);
+			uint num_hits = 0;
+			for (const IndexedTriangle &triangle : triangles)
+				if (RayTriangle(origin, direction, Vec3(vertices[triangle.mIdx[0]]), Vec3(vertices[triangle.mIdx[1]]), Vec3(vertices[triangle.mIdx[2]])) < FLT_MAX)
+					++num_hits;
+			if (inside[i] != ((num_hits & 1) != 0))
+				Trace("PointInMeshQuadTree: Mismatch for point %d, result: %d, number of hits: %u\n", i, inside[i]? 1 : 0, num_hits);
+		}
+	}
+	Trace("PointInMeshQuadTree: %u of %u points inside\n", num_inside, num_points);
+
+	delete [] inside;
+}
+
+#endif
+
+#ifdef TEST_RAY_HITS
 
 //-----------------------------------------------------------------------------
-// Class declaration
+// Collect all hits and the nearest hits of the rays and compare with testing all triangles
 //-----------------------------------------------------------------------------
-class TestRaycast : public Application
+void RunRayHitsBenchmark()
 {
-private:
-	// Render modules
-	TriangleRenderer::Batch 	mModelBatch;
+	using Query = RayHitsQuadTree<TriangleCodecFloat3SOA4<16>, NodeCodecQuadTreeHalfFloat<16>>;
+	using AllHits = RayAllHits<64>;
+	using NearestHits = RayKNearestHits<4>;
 
-	// Loaded model
-	Model *						mModel;
-#ifdef TEST_TYPE
-	AABBTreeBuilder::Node *		mAABBTreeRoot;
-#endif
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+	Query::Buffer buffer;
+	AABBTreeToBufferStats buffer_stats;
+	buffer.Convert(mModel->GetVertexView(), tree, buffer_stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
 
-	// Raycasts to perform
-	RayCasts 					mRayCasts;
-	RayCastTest *				mRayCastTest;
+	uint num_rays = GetRayCount();
+	vector<AllHits> all_hits(num_rays);
+	vector<NearestHits> nearest_hits(num_rays);
 
-	// Stats
-	StatsWriter					mStatsWriter;
+	{
+		PerfTimer timer("RayHitsQuadTree: All hits");
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			Query::sCastRays(buffer, mRayCastsBegin, mRayCastsEnd, &all_hits[0]);
+			timer.Stop(num_rays);
+		}
+		timer.Output();
+	}
+
+	{
+		PerfTimer timer("RayHitsQuadTree: 4 nearest hits");
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			Query::sCastRays(buffer, mRayCastsBegin, mRayCastsEnd, &nearest_hits[0]);
+			timer.Stop(num_rays);
+		}
+		timer.Output();
+	}
+
+	// Compare a sample of the rays with testing all triangles
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	const IndexedTriangleList &triangles = mModel->GetIndexedTriangles();
+	uint total_hits = 0;
+	for (uint i = 0; i < num_rays; ++i)
+	{
+		total_hits += all_hits[i].mNumHits;
+
+		if (i % 97 == 0)
+		{
+			const RayCastTestIn &ray = mRayCastsBegin[i];
+			vector<float> distances;
+			for (const IndexedTriangle &triangle : triangles)
+			{
+				float distance = RayTriangle(Vec3(ray.mOrigin), Vec3(ray.mDirection), Vec3(vertices[triangle.mIdx[0]]), Vec3(vertices[triangle.mIdx[1]]), Vec3(vertices[triangle.mIdx[2]]));
+				if (distance < FLT_MAX)
+					distances.push_back(distance);
+			}
+			sort(distances.begin(), distances.end());
+
+			if (all_hits[i].mNumHits != distances.size())
+				Trace("RayHitsQuadTree: Mismatch for ray %d, all hits: %u, expected: %u\n", i, all_hits[i].mNumHits, uint(distances.size()));
+
+			if (nearest_hits[i].GetNumStored() != min<size_t>(distances.size(), 4))
+				Trace("RayHitsQuadTree: Mismatch for ray %d, nearest hits: %u, expected: %u\n", i, nearest_hits[i].GetNumStored(), uint(min<size_t>(distances.size(), 4)));
+			else
+				for (uint h = 0; h < nearest_hits[i].GetNumStored(); ++h)
+					if (abs(nearest_hits[i].GetHit(h).mDistance - distances[h]) > 1.0e-4f * distances[h]
+						|| abs(all_hits[i].GetHit(h).mDistance - distances[h]) > 1.0e-4f * distances[h])
+						Trace("RayHitsQuadTree: Mismatch for ray %d, hit %u, nearest: %g, all: %g, expected: %g\n", i, h, nearest_hits[i].GetHit(h).mDistance, all_hits[i].GetHit(h).mDistance, distances[h]);
+		}
+	}
+	Trace("RayHitsQuadTree: %u hits for %u rays\n", total_hits, num_rays);
+}
+
+#endif
+
+#ifdef TEST_MESH_INTERSECT
 
-public:
 //-----------------------------------------------------------------------------
-// Constructor
+// Intersect the model with a rotated and translated copy of itself and compare a sample of the triangles with testing all triangles
 //-----------------------------------------------------------------------------
-TestRaycast() :
-	mModel(nullptr),
-#ifdef TEST_TYPE
-	mAABBTreeRoot(nullptr),
-#endif
-	mRayCastTest(nullptr)
+void RunMeshIntersectBenchmark()
 {
-	// Initialize cache trasher
-	CacheTrasher::sInit();
-	
-	// Read model
-	mModel = new Model;
-	mModel->ReadFromFile(TEST_FILE);
-
-	// Init model renderer
-	mModelBatch = TriangleRenderer::sInstance->CreateTriangleBatch(mModel->mTriangles);
+	using Query = MeshIntersectQuadTree<TriangleCodecFloat3SOA4<16>, 16>;
 
-#ifdef TEST_TYPE
-	// Create AABB tree
-	TriangleSplitterBinning splitter(mModel->mTriangleVertices, mModel->mIndexedTriangles);
-	StatsRow stats;
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+	Query::Buffer buffer;
+	AABBTreeToBufferStats buffer_stats;
+	buffer.Convert(mModel->GetVertexView(), tree, buffer_stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
 
-	AABBTreeBuilderStats builder_stats;
-	mAABBTreeRoot = AABBTreeBuilder(splitter, 8).Build(builder_stats);
-	stats.Set(builder_stats);
-#endif
-	
-	// Make a bit bigger so we'll do some raycasts around the edges
-	Vec3 delta = mModel->mBounds.mMax - mModel->mBounds.mMin;
-	Vec3 min = mModel->mBounds.mMin - 0.1f * delta;
-	Vec3 max = mModel->mBounds.mMax + 0.1f * delta;
-	delta = max - min;
+	// Rotate the copy around its center and move it a bit
+	Vec3 center = mModel->mBounds.GetCenter();
+	Mat44 transform = Mat44::sTranslation(center + 0.05f * mModel->mBounds.GetSize()) * Mat44::sRotationY(0.3f) * Mat44::sRotationX(0.2f) * Mat44::sTranslation(-center);
 
-	// Calculate rays to cast
-	mRayCasts.reserve(NUM_RAYS_PER_AXIS * NUM_RAYS_PER_AXIS);
+	vector<TrianglePair> pairs;
+	for (uint num_threads : { 1u, 0u })
+	{
+		string name = "MeshIntersectQuadTree: " + string(num_threads == 1? "single thread" : "all threads");
+		PerfTimer timer(name.c_str());
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			vector<TrianglePair> result;
+			timer.Start();
+			Query::sCollide(buffer, buffer, transform, result, num_threads);
+			timer.Stop(1);
+
+			// The result should not depend on the amount of threads
+			if (pairs.empty())
+				pairs.swap(result);
+			else if (result.size() != pairs.size() || memcmp(&result[0], &pairs[0], pairs.size() * sizeof(TrianglePair)) != 0)
+				FatalError("MeshIntersectQuadTree: Result depends on amount of threads");
+		}
+		timer.Output();
+	}
 
-#ifdef RANDOM_RAYS
-	default_random_engine random(0x1ee7c0de);
-	float radius = 0.5f * delta.Length();
-	Vec3 mid = 0.5f * (min + max);
-	for (int i = 0; i < NUM_RAYS_PER_AXIS * NUM_RAYS_PER_AXIS; ++i)
+	// Independent reference that doesn't use separating axes: two triangles that are not coplanar intersect when an edge of one crosses the other,
+	// coplanar triangles intersect when two edges cross or a vertex of one is inside the other. Touching counts as intersecting.
+	auto orient = [](const Vec3 &inNormal, const Vec3 &inA, const Vec3 &inB, const Vec3 &inC) { return inNormal.Dot((inB - inA).Cross(inC - inA)); };
+	auto inside_triangle = [&orient](const Vec3 &inNormal, const Vec3 *inTriangle, const Vec3 &inPoint)
 	{
-		Vec3 origin = radius * Vec3::sRandom(random);
-		Vec3 destination = 0.25f * radius * Vec3::sRandom(random);
-		Vec3 direction = (destination - origin).Normalized();
-		RayCastTestIn ray;
-		(mid + origin).StoreFloat3(&ray.mOrigin);
-		direction.StoreFloat3(&ray.mDirection);
-		mRayCasts.push_back(ray);
+		return orient(inNormal, inTriangle[0], inTriangle[1], inPoint) >= 0.0f && orient(inNormal, inTriangle[1], inTriangle[2], inPoint) >= 0.0f && orient(inNormal, inTriangle[2], inTriangle[0], inPoint) >= 0.0f;
+	};
+	auto triangle_triangle = [&orient, &inside_triangle](const Vec3 *inA, const Vec3 *inB)
+	{
+		Vec3 na = (inA[1] - inA[0]).Cross(inA[2] - inA[0]), nb = (inB[1] - inB[0]).Cross(inB[2] - inB[0]);
+		float db[3], da[3];
+		for (int v = 0; v < 3; ++v)
+		{
+			db[v] = na.Dot(inB[v] - inA[0]);
+			da[v] = nb.Dot(inA[v] - inB[0]);
+		}
+
+		if (db[0] == 0.0f && db[1] == 0.0f && db[2] == 0.0f)
+		{
+			// Coplanar: test the edges against each other in the plane
+			for (int i = 0; i < 3; ++i)
+				for (int j = 0; j < 3; ++j)
+				{
+					const Vec3 &p1 = inA[i], &q1 = inA[(i + 1) % 3], &p2 = inB[j], &q2 = inB[(j + 1) % 3];
+					float o1 = orient(na, p1, q1, p2), o2 = orient(na, p1, q1, q2), o3 = orient(na, p2, q2, p1), o4 = orient(na, p2, q2, q1);
+					if (o1 == 0.0f && o2 == 0.0f)
+					{
+						// Collinear edges, check if they overlap
+						Vec3 d = q1 - p1;
+						float s1 = 0.0f, e1 = d.Dot(d), s2 = d.Dot(p2 - p1), e2 = d.Dot(q2 - p1);
+						if (max(s1, min(s2, e2)) <= min(e1, max(s2, e2)))
+							return true;
+					}
+					else if (o1 * o2 <= 0.0f && o3 * o4 <= 0.0f)
+						return true;
+				}
+			return inside_triangle(na, inA, inB[0]) || inside_triangle(nb, inB, inA[0]);
+		}
+
+		// Test if an edge of one triangle crosses the other triangle
+		auto edge_crosses = [&inside_triangle](const Vec3 &inNormal, const Vec3 *inTriangle, const Vec3 &inP, const Vec3 &inQ, float inDP, float inDQ)
+		{
+			if ((inDP > 0.0f && inDQ > 0.0f) || (inDP < 0.0f && inDQ < 0.0f) || inDP == inDQ)
+				return false;
+			return inside_triangle(inNormal, inTriangle, inP + (inDP / (inDP - inDQ)) * (inQ - inP));
+		};
+		for (int v = 0; v < 3; ++v)
+		{
+			int w = (v + 1) % 3;
+			if (edge_crosses(na, inA, inB[v], inB[w], db[v], db[w]) || edge_crosses(nb, inB, inA[v], inA[w], da[v], da[w]))
+				return true;
+		}
+		return false;
+	};
+
+	// Check the triangle test and the reference against hand built cases, mesh A is a triangle in the XY plane
+	{
+		const Vec3 a[3] = { Vec3(0, 0, 0), Vec3(4, 0, 0), Vec3(0, 4, 0) };
+		struct Case { const char *mName; Vec3 mB[3]; bool mIntersects; };
+		const Case cases[] = {
+			{ "Crossing",					{ Vec3(1, 1, -1),		Vec3(1, 1, 1),		Vec3(1, 3, 0) },		true },
+			{ "Parallel",					{ Vec3(0, 0, 1),		Vec3(4, 0, 1),		Vec3(0, 4, 1) },		false },
+			{ "Separated",					{ Vec3(2, 3, -1),		Vec3(2, 3, 1),		Vec3(3, 3, 0) },		false },
+			{ "Vertex touching face",		{ Vec3(1, 1, 0),		Vec3(1, 1, 2),		Vec3(2, 1, 2) },		true },
+			{ "Edge touching edge",			{ Vec3(2, 0, -1),		Vec3(2, 0, 1),		Vec3(2, -2, 0) },		true },
+			{ "Coplanar overlapping",		{ Vec3(1, 1, 0),		Vec3(5, 1, 0),		Vec3(1, 5, 0) },		true },
+			{ "Coplanar contained",			{ Vec3(0.5f, 0.5f, 0),	Vec3(1, 0.5f, 0),	Vec3(0.5f, 1, 0) },		true },
+			{ "Coplanar containing",		{ Vec3(-1, -1, 0),		Vec3(-1, 9, 0),		Vec3(9, -1, 0) },		true },
+			{ "Coplanar touching",			{ Vec3(2, 2, 0),		Vec3(4, 4, 0),		Vec3(5, 1, 0) },		true },
+			{ "Coplanar separated",			{ Vec3(3, 3, 0),		Vec3(5, 3, 0),		Vec3(3, 5, 0) },		false },
+		};
+		for (const Case &c : cases)
+		{
+			bool sat = TriangleTriangle4(c.mB[0], c.mB[1], c.mB[2], a[0].SplatX(), a[0].SplatY(), a[0].SplatZ(), a[1].SplatX(), a[1].SplatY(), a[1].SplatZ(), a[2].SplatX(), a[2].SplatY(), a[2].SplatZ()).TestAllTrue();
+			if (sat != c.mIntersects)
+				FatalError("MeshIntersectQuadTree: TriangleTriangle4 failed for case: %s", c.mName);
+			if (triangle_triangle(a, c.mB) != c.mIntersects || triangle_triangle(c.mB, a) != c.mIntersects)
+				FatalError("MeshIntersectQuadTree: Reference failed for case: %s", c.mName);
+		}
 	}
-#else
-	float xs = min.GetX(), dx = delta.GetX() / NUM_RAYS_PER_AXIS;
-	float ys = min.GetY(), dy = delta.GetY() / NUM_RAYS_PER_AXIS;
-	for (int i = 0; i < NUM_RAYS_PER_AXIS; ++i)
-		for (int j = 0; j < NUM_RAYS_PER_AXIS; ++j)
+
+	// Every pair that was found should intersect according to the reference
+	uint num_false_pairs = 0;
+	for (const TrianglePair &pair : pairs)
+	{
+		const Vec3 a[3] = { Vec3(pair.mTriangleA[0]), Vec3(pair.mTriangleA[1]), Vec3(pair.mTriangleA[2]) };
+		const Vec3 b[3] = { Vec3(pair.mTriangleB[0]), Vec3(pair.mTriangleB[1]), Vec3(pair.mTriangleB[2]) };
+		if (!triangle_triangle(a, b))
+			++num_false_pairs;
+	}
+	if (num_false_pairs > 0)
+		Trace("MeshIntersectQuadTree: %u of %u pairs don't intersect according to the reference\n", num_false_pairs, uint(pairs.size()));
+
+	// Test a sample of the triangles of the copy against all triangles: a regular sample (which mostly doesn't intersect anything) and the triangles of a sample of the pairs
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	const IndexedTriangleList &triangles = mModel->GetIndexedTriangles();
+	auto same_triangle = [](const Float3 *inTriangle, const Vec3 *inVertices)
+	{
+		for (int v = 0; v < 3; ++v)
+			if (inTriangle[v] != Float3(inVertices[v].GetX(), inVertices[v].GetY(), inVertices[v].GetZ()))
+				return false;
+		return true;
+	};
+	vector<Float3> samples;
+	for (size_t i = 0; i < triangles.size(); i += max<size_t>(1, triangles.size() / 100))
+		for (int v = 0; v < 3; ++v)
+			(transform * Vec3(vertices[triangles[i].mIdx[v]])).StoreFloat3(&samples.emplace_back());
+	for (size_t i = 0; i < pairs.size(); i += max<size_t>(1, pairs.size() / 100))
+		samples.insert(samples.end(), pairs[i].mTriangleB, pairs[i].mTriangleB + 3);
+	for (size_t i = 0; i < samples.size(); i += 3)
+	{
+		const Vec3 b[3] = { Vec3(samples[i]), Vec3(samples[i + 1]), Vec3(samples[i + 2]) };
+
+		AABox bounds_b;
+		for (const Vec3 &v : b)
+			bounds_b.Encapsulate(v);
+
+		uint expected = 0;
+		for (const IndexedTriangle &triangle : triangles)
 		{
-			RayCastTestIn ray;
-			ray.mOrigin = Float3(xs + dx * i, ys + dy * j, 2.0f);
-			ray.mDirection = Float3(0.0f, 0.0f, -1.0f);
-			mRayCasts.push_back(ray);
+			AABox bounds_a;
+			bounds_a.Encapsulate(vertices, triangle);
+			if (!bounds_a.Overlaps(bounds_b))
+				continue;
+
+			const Vec3 a[3] = { Vec3(vertices[triangle.mIdx[0]]), Vec3(vertices[triangle.mIdx[1]]), Vec3(vertices[triangle.mIdx[2]]) };
+			if (triangle_triangle(a, b))
+				++expected;
 		}
-#endif
 
-#if TEST_ITERATIONS_SLOW > 0 || TEST_ITERATIONS_FAST > 0
-	// Validate all algorithms
-	RunTests();
-#endif
+		uint found = 0;
+		for (const TrianglePair &pair : pairs)
+			if (same_triangle(pair.mTriangleB, b))
+				++found;
 
-#ifdef TEST_TYPE
-	// Initialize test
-	mRayCastTest = new TEST_TYPE;
-	mRayCastTest->SetSubSystems(mModel, mRenderer);
-	mRayCastTest->Initialize();
-#endif
+		if (found != expected)
+			Trace("MeshIntersectQuadTree: Mismatch for sample %d, pairs: %u, expected: %u\n", int(i / 3), found, expected);
+	}
+	Trace("MeshIntersectQuadTree: %u intersecting triangle pairs\n", uint(pairs.size()));
 }
 
+#endif
+
+#ifdef TEST_VISIBILITY_MATRIX
+
 //-----------------------------------------------------------------------------
-// This method is called after the application terminates.
+// Compute the visibility between points around the model and points in the model and compare a sample of the pairs with testing all triangles
 //-----------------------------------------------------------------------------
-virtual ~TestRaycast() override
+void RunVisibilityMatrixBenchmark()
 {
-	delete mRayCastTest;
-#ifdef TEST_TYPE
-	delete mAABBTreeRoot;
-#endif
-	delete mModel;
-	mModelBatch = nullptr;
+	using Test = RayCastCPUQuadTreeHalfFloat<TriangleCodecIndexed8BitPackSOA4, 16>;
+
+	AABBTreeBuilder::Tree tree;
+	{
+		TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+	}
+	Test test(mModel->GetVertexView(), &tree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+	test.SetSubSystems(mModel, mRenderer);
+	test.Initialize();
+
+	// Sources on a sphere around the model and targets in the bounds of the model
+	const uint num_sources = 256, num_targets = 2048;
+	float radius = 0.6f * mModel->mBounds.GetSize().Length();
+	Vec3 mid = mModel->mBounds.GetCenter();
+	default_random_engine random(0x1ee7c0de);
+	uniform_real_distribution<float> zero_to_one(0.0f, 1.0f);
+	vector<Float3> sources(num_sources), targets(num_targets);
+	for (Float3 &s : sources)
+		(mid + radius * Vec3::sRandom(random)).StoreFloat3(&s);
+	for (Float3 &t : targets)
+		(mModel->mBounds.mMin + mModel->mBounds.GetSize() * Vec3(zero_to_one(random), zero_to_one(random), zero_to_one(random))).StoreFloat3(&t);
+
+	// Doesn't override CastOcclusionRays so that the closest hit of the unbounded rays is used, to compare with the early out of the test
+	class ClosestHitTest : public RayCastTest
+	{
+	public:
+							ClosestHitTest(RayCastTest &inTest) : mTest(inTest) { }
+
+		virtual void		GetStats(StatsRow &ioRow) const override { mTest.GetStats(ioRow); }
+		virtual void		CastRays(const RayCastTestIn *inRayCastsBegin, const RayCastTestIn *inRayCastsEnd, RayCastTestOut *outRayCasts) override { mTest.CastRays(inRayCastsBegin, inRayCastsEnd, outRayCasts); }
+
+	private:
+		RayCastTest &		mTest;
+	};
+	ClosestHitTest closest_hit_test(test);
+
+	VisibilityMatrix matrix, matrix_single_thread, matrix_closest_hit;
+	for (uint num_threads : { 1u, 0u })
+	{
+		string name = "VisibilityMatrix: " + string(num_threads == 1? "single thread" : "all threads");
+		PerfTimer timer(name.c_str());
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			matrix.Compute(test, &sources[0], &sources[0] + num_sources, &targets[0], &targets[0] + num_targets, 1.0e-4f, num_threads);
+			timer.Stop(num_sources * num_targets);
+		}
+		timer.Output();
+
+		if (num_threads == 1)
+			matrix_single_thread = matrix;
+	}
+
+	{
+		PerfTimer timer("VisibilityMatrix: single thread, closest hit");
+		for (int iteration = 0; iteration < 5; ++iteration)
+		{
+			timer.Start();
+			matrix_closest_hit.Compute(closest_hit_test, &sources[0], &sources[0] + num_sources, &targets[0], &targets[0] + num_targets, 1.0e-4f, 1);
+			timer.Stop(num_sources * num_targets);
+		}
+		timer.Output();
+	}
+
+	// The result should not depend on the amount of threads or on stopping at the first hit
+	for (uint s = 0; s < num_sources; ++s)
+	{
+		if (memcmp(matrix.GetRow(s), matrix_single_thread.GetRow(s), matrix.GetWordsPerRow() * sizeof(uint64)) != 0)
+			FatalError("VisibilityMatrix: Result depends on amount of threads");
+		if (memcmp(matrix.GetRow(s), matrix_closest_hit.GetRow(s), matrix.GetWordsPerRow() * sizeof(uint64)) != 0)
+			FatalError("VisibilityMatrix: Result differs from closest hit");
+	}
+
+	// Test a sample of the pairs against all triangles, the tree uses compressed vertices so a segment that grazes a triangle can differ
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	const IndexedTriangleList &triangles = mModel->GetIndexedTriangles();
+	uint num_tested = 0, num_mismatches = 0;
+	for (uint pair = 0; pair < num_sources * num_targets; pair += 997)
+	{
+		uint s = pair / num_targets, t = pair % num_targets;
+		Vec3 origin = Vec3(sources[s]) + 1.0e-4f * (Vec3(targets[t]) - Vec3(sources[s]));
+		Vec3 direction = (1.0f - 2.0e-4f) * (Vec3(targets[t]) - Vec3(sources[s]));
+		bool visible = true;
+		for (const IndexedTriangle &triangle : triangles)
+			if (RayTriangle(origin, direction, Vec3(vertices[triangle.mIdx[0]]), Vec3(vertices[triangle.mIdx[1]]), Vec3(vertices[triangle.mIdx[2]])) <= 1.0f)
+			{
+				visible = false;
+				break;
+			}
+		++num_tested;
+		if (visible != matrix.IsVisible(s, t))
+			++num_mismatches;
+	}
+	Trace("VisibilityMatrix: %u of %u pairs visible, %u of %u tested pairs differ from testing all triangles\n", uint(matrix.GetNumVisible()), num_sources * num_targets, num_mismatches, num_tested);
 }
 
-#ifdef TEST_TYPE
+#endif
+
+#ifdef TEST_MATERIAL_FILTER
 
 //-----------------------------------------------------------------------------
-// Render the frame.
+// Cast rays that include or exclude a single material against one tree with materials and compare with a separate tree per material
+// that is cast with the same query, codec and an all pass filter
 //-----------------------------------------------------------------------------
-virtual bool RenderFrame(float inDeltaTime) override
+template <class TriangleCodec>
+void RunMaterialFilterBenchmarkWithCodec(const char *inCodecName, const IndexedTriangleList &inTriangles, const vector<IndexedTriangleList> &inMaterialTriangles)
 {
-	// Allocate space for raycast output
-	RayCastsOut out;
-	out.resize(mRayCasts.size());
+	using Query = RayCastFilteredQuadTree<TriangleCodec, NodeCodecQuadTreeHalfFloat<16>>;
 
-	static PerfTimer timer("CastRays");
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	const uint num_materials = (uint)inMaterialTriangles.size();
 
-#ifdef FLUSH_CACHE_AFTER_EVERY_RAY
-	for (size_t j = 0; j < mRayCasts.size(); ++j)
+	// One tree with all materials
+	typename Query::Buffer buffer;
 	{
-		// Trash the cache
-		CacheTrasher::sTrash(&mRayCasts[j]);
-		CacheTrasher::sTrash(&out[j]);
-		mRayCastTest->TrashCache();
+		AABBTreeBuilder::Tree tree;
+		TriangleSplitterBinning splitter(vertices, inTriangles);
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+		AABBTreeToBufferStats buffer_stats;
+		buffer.Convert(vertices, tree, buffer_stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+	}
 
-		// Do raycasts
-		timer.Start();
-		mRayCastTest->CastRays(&mRayCasts[j], &mRayCasts[j] + 1, &out[j]);
-		timer.Stop(1);
+	// A tree per material, the way the materials would be separated without filtering
+	vector<typename Query::Buffer> material_buffers(num_materials);
+	for (uint m = 0; m < num_materials; ++m)
+	{
+		AABBTreeBuilder::Tree tree;
+		TriangleSplitterBinning splitter(vertices, inMaterialTriangles[m]);
+		AABBTreeBuilderStats stats;
+		AABBTreeBuilder(splitter, 8).Build(tree, stats);
+		AABBTreeToBufferStats buffer_stats;
+		material_buffers[m].Convert(vertices, tree, buffer_stats, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
 	}
-#else
-	// Trash the cache
-	CacheTrasher::sTrash(mRayCasts);
-	CacheTrasher::sTrash(out);
-	mRayCastTest->TrashCache();
 
-	timer.Start();
-	mRayCastTest->CastRays(&mRayCasts[0], &mRayCasts[0] + mRayCasts.size(), &out[0]);
-	timer.Stop((int)mRayCasts.size());
-#endif
+	// Divide the rays over the materials, the rays of a material are cast against the trees in one go
+	uint num_rays = GetRayCount();
+	RayCasts rays(mRayCastsBegin, mRayCastsEnd);
+	vector<uint> material_start(num_materials + 1);
+	for (uint m = 0; m <= num_materials; ++m)
+		material_start[m] = m * num_rays / num_materials;
 
-	timer.Output();
+	// Rays that only hit material m and rays that hit all materials except m
+	for (bool exclude : { false, true })
+	{
+		vector<RayMaterialFilter> filters(num_rays);
+		for (uint m = 0; m < num_materials; ++m)
+			for (uint i = material_start[m]; i < material_start[m + 1]; ++i)
+				if (exclude)
+					filters[i].mExcludeMask = 1u << m;
+				else
+					filters[i].mIncludeMask = 1u << m;
 
-	float model_size = 2.0f * mModel->mBounds.GetExtent().Length();
-	float marker_size = 0.002f * model_size;
+		RayCastsOut filtered_out(num_rays);
+		{
+			string name = string("MaterialFilter: ") + inCodecName + ", one tree, " + (exclude? "exclude" : "include") + " 1 material";
+			PerfTimer timer(name.c_str());
+			for (int iteration = 0; iteration < 5; ++iteration)
+			{
+				timer.Start();
+				Query::sCastRays(buffer, &rays[0], &rays[0] + num_rays, &filters[0], &filtered_out[0]);
+				timer.Stop(num_rays);
+			}
+			timer.Output();
+		}
 
-	// Draw raycast results
-	for (uint r = 0; r < mRayCasts.size(); ++r)
-		if (out[r].mDistance < FLT_MAX)
+		// Cast against the tree of every material that passes the filter and take the closest hit
+		vector<RayMaterialFilter> pass_all(num_rays);
+		RayCastsOut material_out(num_rays);
+		vector<float> material_closest(num_rays);
 		{
-			Vec3 hit_pos = Vec3(mRayCasts[r].mOrigin) + Vec3(mRayCasts[r].mDirection) * out[r].mDistance;
-			LineRenderer::sInstance->DrawMarker(hit_pos, Color::sGreen, marker_size);
+			string name = string("MaterialFilter: ") + inCodecName + ", tree per material, " + (exclude? "exclude" : "include") + " 1 material";
+			PerfTimer timer(name.c_str());
+			for (int iteration = 0; iteration < 5; ++iteration)
+			{
+				timer.Start();
+				for (uint m = 0; m < num_materials; ++m)
+				{
+					uint begin = material_start[m], end = material_start[m + 1];
+					for (uint i = begin; i < end; ++i)
+						material_closest[i] = FLT_MAX;
+					for (uint tree = 0; tree < num_materials; ++tree)
+						if (filters[begin].GetMaterialMask() & (1u << tree))
+						{
+							Query::sCastRays(material_buffers[tree], &rays[begin], &rays[end], &pass_all[begin], &material_out[begin]);
+							for (uint i = begin; i < end; ++i)
+								material_closest[i] = min(material_closest[i], material_out[i].mDistance);
+						}
+				}
+				timer.Stop(num_rays);
+			}
+			timer.Output();
 		}
 
-#ifdef DRAW_RAYS
-	// Draw rays
-	for (uint r = 0; r < mRayCasts.size(); ++r)
-	{
-		Vec3 origin(mRayCasts[r].mOrigin);
-		Vec3 direction(mRayCasts[r].mDirection);
-		LineRenderer::sInstance->DrawMarker(origin, Color::sRed, marker_size);
-		if (out[r].mDistance < FLT_MAX)
-			LineRenderer::sInstance->DrawLine(origin, origin + out[r].mDistance * direction, Color::sGreen);
-		else
-			LineRenderer::sInstance->DrawLine(origin, origin + model_size * direction, Color::sWhite);
+		// Both should find the same hits. Codecs that quantize the vertices relative to the tree bounds don't give exactly the same
+		// distances for separate trees, so allow for a small error (a ray that grazes an edge may still hit in one tree and miss in the other).
+		uint num_hits = 0, num_mismatches = 0;
+		float tolerance = 1.0e-4f * mModel->mBounds.GetSize().Length();
+		for (uint i = 0; i < num_rays; ++i)
+		{
+			if (filtered_out[i].mDistance < FLT_MAX)
+				++num_hits;
+			float delta = filtered_out[i].mDistance == material_closest[i]? 0.0f : abs(filtered_out[i].mDistance - material_closest[i]) * Vec3(rays[i].mDirection).Length();
+			if (delta > tolerance)
+				++num_mismatches;
+		}
+		Trace("MaterialFilter: %s, %u of %u rays hit, %u differ from tree per material\n", inCodecName, num_hits, num_rays, num_mismatches);
 	}
-#endif
 
-	// Draw model
-#ifdef DRAW_MODEL
-	TriangleRenderer::sInstance->DrawTriangleBatch(Mat44::sIdentity(), Color(90, 90, 90, 255), mModelBatch);
-#endif
+	size_t material_trees_size = 0;
+	for (uint m = 0; m < num_materials; ++m)
+		material_trees_size += material_buffers[m].GetBuffer().size();
+	Trace("MaterialFilter: %s, one tree: %u bytes, tree per material: %u bytes\n", inCodecName, uint(buffer.GetBuffer().size()), uint(material_trees_size));
+}
 
-	return true;
+void RunMaterialFilterBenchmark()
+{
+	// Assign materials to horizontal slices of the model so that the materials are spatially coherent
+	constexpr uint num_materials = 8;
+	const VertexList &vertices = mModel->GetTriangleVertices();
+	IndexedTriangleList triangles = mModel->GetIndexedTriangles();
+	vector<IndexedTriangleList> material_triangles(num_materials);
+	for (IndexedTriangle &triangle : triangles)
+	{
+		float fraction = (triangle.GetCentroid(vertices).GetY() - mModel->mBounds.mMin.GetY()) / mModel->mBounds.GetSize().GetY();
+		triangle.mMaterialIndex = min(uint(fraction * num_materials), num_materials - 1);
+		material_triangles[triangle.mMaterialIndex].push_back(triangle);
+	}
+
+	RunMaterialFilterBenchmarkWithCodec<TriangleCodecFloat3SOA4Material<16>>("Float3SOA4Material", triangles, material_triangles);
+	RunMaterialFilterBenchmarkWithCodec<TriangleCodecIndexed8BitPackSOA4Material>("Indexed8BitPackSOA4Material", triangles, material_triangles);
 }
 
 #endif
@@ -319,14 +2394,14 @@ void RunTests()
 	row.Set(StatsColumn::ModelName, TEST_FILE);
 
 	RayCastsOut reference_data;
-	reference_data.resize(mRayCasts.size());
+	reference_data.resize(GetRayCount());
 
 	// Calculate reference output
 	{
 		RayCastCPUBruteForce<TriangleCodecFloat3Original> reference_test;
 		reference_test.SetSubSystems(mModel, mRenderer);
 		reference_test.Initialize();
-		reference_test.CastRays(&mRayCasts[0], &mRayCasts[0] + mRayCasts.size(), &reference_data[0]);
+		reference_test.CastRays(mRayCastsBegin, mRayCastsEnd, &reference_data[0]);
 	}
 
 	// Trace how many rays hit the target
@@ -368,7 +2443,7 @@ void RunTests()
 		RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
 	}
 #endif
-	if (mModel->mTriangleVertices.size() <= 0xffff)
+	if (mModel->GetVertexCount() <= 0xffff)
 	{
 		RayCastCPUBruteForce<TriangleCodecIndexed<uint16>> test;
 		RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
@@ -377,7 +2452,7 @@ void RunTests()
 		RayCastCPUBruteForce<TriangleCodecIndexed<uint32>> test;
 		RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
 	}
-	if (mModel->mTriangleVertices.size() <= 0xffff)
+	if (mModel->GetVertexCount() <= 0xffff)
 	{
 		RayCastCPUBruteForce<TriangleCodecIndexedSOA4<uint16>> test;
 		RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
@@ -386,7 +2461,7 @@ void RunTests()
 		RayCastCPUBruteForce<TriangleCodecIndexedSOA4<uint32>> test;
 		RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
 	}
-	if (mModel->mTriangleVertices.size() <= 0xffff)
+	if (mModel->GetVertexCount() <= 0xffff)
 	{
 		RayCastCPUBruteForce<TriangleCodecIndexedBitPackSOA4<uint16>> test;
 		RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
@@ -485,6 +2560,48 @@ void RunTests()
 				RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
 			}
 		}
+
+		// Same grouping as the closest centroid grouper but O(N log(N)) so it can be used on big models
+		{
+			RayCastCPUAABBList<TriangleCodecFloat3, 1> test(ERayCastCPUAABBListVariant::BOUNDS_PLAIN, ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID_KD_TREE, tri_per_batch);
+			RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
+		}
+		{
+			RayCastCPUAABBList<TriangleCodecFloat3SOA4<16>, 16> test(ERayCastCPUAABBListVariant::BOUNDS_SOA4, ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID_KD_TREE, tri_per_batch);
+			RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
+		}
+		{
+			RayCastCPUAABBList<TriangleCodecFloat3SOA8<32>, 32> test(ERayCastCPUAABBListVariant::BOUNDS_SOA8, ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID_KD_TREE, tri_per_batch);
+			RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
+		}
+		{
+			RayCastCPUAABBList<TriangleCodecFloat3SOA4<16>, 16> test(ERayCastCPUAABBListVariant::BOUNDS_HALFFLOAT_SOA4, ERayCastCPUAABBGrouper::GROUPER_CLOSEST_CENTROID_KD_TREE, tri_per_batch);
+			RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
+		}
+	}
+
+	// CPU grid
+#ifndef QUICK_TEST
+	for (uint triangles_per_batch = 4; triangles_per_batch <= 16; triangles_per_batch <<= 1)
+#else
+	uint triangles_per_batch = 4;
+#endif
+	{
+		for (ERayCastCPUGridVariant variant : { ERayCastCPUGridVariant::GRID_UNIFORM, ERayCastCPUGridVariant::GRID_HASHED })
+		{
+			{
+				RayCastCPUGrid<TriangleCodecFloat3> test(variant, triangles_per_batch, 2.0f);
+				RunTest(test, reference_data, row, TEST_ITERATIONS_FAST);
+			}
+			{
+				RayCastCPUGrid<TriangleCodecFloat3SOA4<16>> test(variant, triangles_per_batch, 2.0f);
+				RunTest(test, reference_data, row, TEST_ITERATIONS_FAST);
+			}
+			{
+				RayCastCPUGrid<TriangleCodecIndexed8BitPackSOA4> test(variant, triangles_per_batch, 2.0f);
+				RunTest(test, reference_data, row, TEST_ITERATIONS_FAST);
+			}
+		}
 	}
 
 	// AABBTree
@@ -495,24 +2612,24 @@ void RunTests()
 #endif
 	{
 		{
-			TriangleSplitterBinning splitter(mModel->mTriangleVertices, mModel->mIndexedTriangles);
+			TriangleSplitterBinning splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
 			RunAABBTreeTest(splitter, triangles_per_leaf, reference_data, row);
 		}
 #ifdef TEST_SPLITTERS
 		{
-			TriangleSplitterFixedLeafSize splitter(mModel->mTriangleVertices, mModel->mIndexedTriangles, triangles_per_leaf);
+			TriangleSplitterFixedLeafSize splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView(), triangles_per_leaf);
 			RunAABBTreeTest(splitter, triangles_per_leaf, reference_data, row);
 		}
 		{
-			TriangleSplitterMean splitter(mModel->mTriangleVertices, mModel->mIndexedTriangles);
+			TriangleSplitterMean splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
 			RunAABBTreeTest(splitter, triangles_per_leaf, reference_data, row);
 		}
 		{
-			TriangleSplitterLongestAxis splitter(mModel->mTriangleVertices, mModel->mIndexedTriangles);
+			TriangleSplitterLongestAxis splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
 			RunAABBTreeTest(splitter, triangles_per_leaf, reference_data, row);
 		}
 		{
-			TriangleSplitterMorton splitter(mModel->mTriangleVertices, mModel->mIndexedTriangles);
+			TriangleSplitterMorton splitter(mModel->GetVertexView(), mModel->GetIndexedTriangleView());
 			RunAABBTreeTest(splitter, triangles_per_leaf, reference_data, row);
 		}
 #endif
@@ -542,6 +2659,10 @@ void RunTests()
 		RayCastGPUAABBList test(RayCastGPUAABBList::GROUPER_CLOSEST_CENTROID);
 		RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
 	}
+	{
+		RayCastGPUAABBList test(RayCastGPUAABBList::GROUPER_CLOSEST_CENTROID_KD_TREE);
+		RunTest(test, reference_data, row, TEST_ITERATIONS_SLOW);
+	}
 #endif
 }
 
@@ -601,135 +2722,135 @@ void RunGPUBruteForceTest(RayCastGPUBruteForce::EVariant inVariant, const RayCas
 #endif
 
 template <class TriangleCodec>
-void RunAABBTreeTestWithCodec(TriangleSplitter &inSplitter, const AABBTreeBuilder::Node *inRoot, const RayCastsOut &inReference, const StatsRow &inRow)
+void RunAABBTreeTestWithCodec(TriangleSplitter &inSplitter, const AABBTreeBuilder::Tree *inTree, const RayCastsOut &inReference, const StatsRow &inRow)
 {
 	if (!TriangleCodec::ChangesOffsetOnPack)
 	{
 		// Variant 1: Tests bounds at each level of the tree and recurses to left and right child if it intersects
-		RayCastCPUAABBTree1<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUAABBTree1<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 	
 	if (!TriangleCodec::ChangesOffsetOnPack)
 	{
 		// Variant 2: Tests bounds at each level of the tree, then checks left and right subtrees to decide if / which child to visit first
-		RayCastCPUAABBTree2<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUAABBTree2<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	if (!TriangleCodec::ChangesOffsetOnPack)
 	{
 		// Variant 3: Never check root, only check left and right subtrees to decide if / which child to visit first
-		RayCastCPUAABBTree3<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUAABBTree3<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	if (!TriangleCodec::ChangesOffsetOnPack)
 	{
 		// Variant 4: Never check root, only check left and right subtrees to decide if / which child to visit first. Only check current nodes bounds if testing against triangles.
-		RayCastCPUAABBTree4<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUAABBTree4<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	if (!TriangleCodec::ChangesOffsetOnPack)
 	{
 		// Variant 5: Test bounding box for each entry from the stack, recurse to leaf node without retesting bounding box
-		RayCastCPUAABBTree5<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUAABBTree5<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	if (!TriangleCodec::ChangesOffsetOnPack)
 	{
 		// Compressed AABB Tree
-		RayCastCPUAABBTreeCompressed<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUAABBTreeCompressed<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	if (!TriangleCodec::ChangesOffsetOnPack)
 	{
 		// Test with Precomputed Node Sorting
-		RayCastCPUAABBTreePNS<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUAABBTreePNS<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);	
 	}
 
 	if (!TriangleCodec::ChangesOffsetOnPack && inSplitter.CalculatesSplitDimension())
 	{
 		// Includes split axis test
-		RayCastCPUAABBTreeSplitAxis<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUAABBTreeSplitAxis<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	if (!TriangleCodec::ChangesOffsetOnPack)
 	{
 		// SKDTree test on CPU
-		RayCastCPUSKDTree<TriangleCodec> test(inSplitter.GetVertices(), inRoot);
+		RayCastCPUSKDTree<TriangleCodec> test(inSplitter.GetVertices(), inTree);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree, not aligned
-		RayCastCPUQuadTree<TriangleCodec, 1> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		RayCastCPUQuadTree<TriangleCodec, 1> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree, nodes aligned to 16 bytes
-		RayCastCPUQuadTree<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST);
+		RayCastCPUQuadTree<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree, nodes aligned to 16 bytes
-		RayCastCPUQuadTree<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_BREADTH_FIRST);
+		RayCastCPUQuadTree<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_BREADTH_FIRST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree, nodes aligned to 16 bytes
-		RayCastCPUQuadTree<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		RayCastCPUQuadTree<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree, nodes aligned to 16 bytes
-		RayCastCPUQuadTree<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_BREADTH_FIRST_TRIANGLES_LAST);
+		RayCastCPUQuadTree<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_BREADTH_FIRST_TRIANGLES_LAST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree with half floats, not aligned
-		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 1> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 1> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree with half floats, nodes aligned to 16 bytes
-		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST);
+		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 	
 	{
 		// Quad tree with half floats, nodes aligned to 16 bytes
-		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_BREADTH_FIRST);
+		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_BREADTH_FIRST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree with half floats, nodes aligned to 16 bytes
-		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree with half floats, nodes aligned to 16 bytes
 		// different data loading strategy
-		RayCastCPUQuadTreeHalfFloat2<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
+		RayCastCPUQuadTreeHalfFloat2<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_DEPTH_FIRST_TRIANGLES_LAST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Quad tree with half floats, nodes aligned to 16 bytes
-		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 16> test(inSplitter.GetVertices(), inRoot, EAABBTreeToBufferConvertMode::CONVERT_BREADTH_FIRST_TRIANGLES_LAST);
+		RayCastCPUQuadTreeHalfFloat<TriangleCodec, 16> test(inSplitter.GetVertices(), inTree, EAABBTreeToBufferConvertMode::CONVERT_BREADTH_FIRST_TRIANGLES_LAST);
 		RunTest(test, inReference, inRow, TEST_ITERATIONS_FAST);
 	}	
 }
@@ -740,88 +2861,87 @@ void RunAABBTreeTest(TriangleSplitter &inSplitter, int inMaxTrianglesPerLeaf, co
 	StatsRow row = inRow;
 	AABBTreeBuilder builder(inSplitter, inMaxTrianglesPerLeaf);
 	AABBTreeBuilderStats builder_stats;
-	AABBTreeBuilder::Node *root = builder.Build(builder_stats);
+	AABBTreeBuilder::Tree tree;
+	builder.Build(tree, builder_stats);
 	row.Set(builder_stats);
 
 	// Run tests that can handle multiple codecs
-	RunAABBTreeTestWithCodec<TriangleCodecFloat3Original>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecFloat3>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA4<1>>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA4<16>>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA4Packed>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA8<1>>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA8<32>>(inSplitter, root, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecFloat3Original>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecFloat3>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA4<1>>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA4<16>>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA4Packed>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA8<1>>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecFloat3SOA8<32>>(inSplitter, &tree, inReference, row);
 #ifdef _WIN32
-	RunAABBTreeTestWithCodec<TriangleCodecFloat3ISPC>(inSplitter, root, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecFloat3ISPC>(inSplitter, &tree, inReference, row);
 #endif
-	RunAABBTreeTestWithCodec<TriangleCodecStripUncompressed>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecStripCompressed>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecIndexed8BitPackSOA4>(inSplitter, root, inReference, row);
-	if (mModel->mTriangleVertices.size() <= 0xffff)
-	{
-		RunAABBTreeTestWithCodec<TriangleCodecIndexed<uint16>>(inSplitter, root, inReference, row);
-		RunAABBTreeTestWithCodec<TriangleCodecIndexedSOA4<uint16>>(inSplitter, root, inReference, row);
-		RunAABBTreeTestWithCodec<TriangleCodecIndexedBitPackSOA4<uint16>>(inSplitter, root, inReference, row);
-	}
-	RunAABBTreeTestWithCodec<TriangleCodecIndexed<uint32>>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecIndexedSOA4<uint32>>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecIndexedBitPackSOA4<uint32>>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecBitPack>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecBitPackSOA4<1, false>>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecBitPackSOA4<16, false>>(inSplitter, root, inReference, row);
-	RunAABBTreeTestWithCodec<TriangleCodecBitPackSOA4<16, true>>(inSplitter, root, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecStripUncompressed>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecStripCompressed>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecIndexed8BitPackSOA4>(inSplitter, &tree, inReference, row);
+	if (mModel->GetVertexCount() <= 0xffff)
+	{
+		RunAABBTreeTestWithCodec<TriangleCodecIndexed<uint16>>(inSplitter, &tree, inReference, row);
+		RunAABBTreeTestWithCodec<TriangleCodecIndexedSOA4<uint16>>(inSplitter, &tree, inReference, row);
+		RunAABBTreeTestWithCodec<TriangleCodecIndexedBitPackSOA4<uint16>>(inSplitter, &tree, inReference, row);
+	}
+	RunAABBTreeTestWithCodec<TriangleCodecIndexed<uint32>>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecIndexedSOA4<uint32>>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecIndexedBitPackSOA4<uint32>>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecBitPack>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecBitPackSOA4<1, false>>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecBitPackSOA4<16, false>>(inSplitter, &tree, inReference, row);
+	RunAABBTreeTestWithCodec<TriangleCodecBitPackSOA4<16, true>>(inSplitter, &tree, inReference, row);
 
 #ifdef _WIN32
 	{
 		//// Entire tree traversal is done using ISPC
-		RayCastCPUAABBTreeISPC test(mModel->mTriangleVertices, root);
+		RayCastCPUAABBTreeISPC test(mModel->GetVertexView(), &tree);
 		RunTest(test, inReference, row, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		//// Entire tree traversal is done using ISPC, stripped version
-		RayCastCPUAABBTreeStripISPC test(mModel->mTriangleVertices, root);
+		RayCastCPUAABBTreeStripISPC test(mModel->GetVertexView(), &tree);
 		RunTest(test, inReference, row, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Variant 1: Tests bounds at each level of the tree and recurses to left and right child if it intersects
-		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>> test(mModel->mTriangleVertices, root, "RayCastGPUAABBTree1.hlsl");
+		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>> test(mModel->GetVertexView(), &tree, "RayCastGPUAABBTree1.hlsl");
 		RunTest(test, inReference, row, TEST_ITERATIONS_FAST);
 	}
 	
 	{
 		// Variant 2: Tests bounds at each level of the tree, then checks left and right subtrees to decide if / which child to visit first
-		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>> test(mModel->mTriangleVertices, root, "RayCastGPUAABBTree2.hlsl");
+		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>> test(mModel->GetVertexView(), &tree, "RayCastGPUAABBTree2.hlsl");
 		RunTest(test, inReference, row, TEST_ITERATIONS_FAST);
 	}
 	
 	{
 		// Variant 3: Never check root, only check left and right subtrees to decide if / which child to visit first
-		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>> test(mModel->mTriangleVertices, root, "RayCastGPUAABBTree3.hlsl");
+		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>> test(mModel->GetVertexView(), &tree, "RayCastGPUAABBTree3.hlsl");
 		RunTest(test, inReference, row, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Variant 4: Never check root, only check left and right subtrees to decide if / which child to visit first. Only check current nodes bounds if testing against triangles.
-		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>> test(mModel->mTriangleVertices, root, "RayCastGPUAABBTree4.hlsl");
+		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecAABBTree>> test(mModel->GetVertexView(), &tree, "RayCastGPUAABBTree4.hlsl");
 		RunTest(test, inReference, row, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// Triangles are stripped
-		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecStripUncompressed, NodeCodecAABBTree>> test(mModel->mTriangleVertices, root, "RayCastGPUAABBTreeStrip.hlsl");
+		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecStripUncompressed, NodeCodecAABBTree>> test(mModel->GetVertexView(), &tree, "RayCastGPUAABBTreeStrip.hlsl");
 		RunTest(test, inReference, row, TEST_ITERATIONS_FAST);
 	}
 
 	{
 		// SKDTree test on GPU
-		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecSKDTree>> test(mModel->mTriangleVertices, root, "RayCastGPUSKDTree.hlsl");
+		RayCastGPUTree<AABBTreeToBuffer<TriangleCodecFloat3, NodeCodecSKDTree>> test(mModel->GetVertexView(), &tree, "RayCastGPUSKDTree.hlsl");
 		RunTest(test, inReference, row, TEST_ITERATIONS_FAST);
 	}
 #endif
-
-	delete root;
 }
 
 //-----------------------------------------------------------------------------
@@ -852,8 +2972,8 @@ void RunTest(RayCastTest &inTest, const RayCastsOut &inReference, const StatsRow
 
 		// Allow shaders to be compiled, buffers to be uploaded etc.
 		RayCastsOut dummy;
-		dummy.resize(mRayCasts.size());
-		inTest.CastRays(&mRayCasts[0], &mRayCasts[0] + mRayCasts.size(), &dummy[0]);
+		dummy.resize(GetRayCount());
+		inTest.CastRays(mRayCastsBegin, mRayCastsEnd, &dummy[0]);
 
 		// Get max size of model
 		const AABox &bounds = mModel->mBounds;
@@ -866,35 +2986,35 @@ void RunTest(RayCastTest &inTest, const RayCastsOut &inReference, const StatsRow
 		{
 			// Prepare output
 			RayCastsOut out;
-			out.resize(mRayCasts.size());
+			out.resize(GetRayCount());
 
 	#ifdef FLUSH_CACHE_AFTER_EVERY_RAY
-			for (size_t j = 0; j < mRayCasts.size(); ++j)
+			for (size_t j = 0; j < GetRayCount(); ++j)
 			{
 				// Trash the cache
-				CacheTrasher::sTrash(&mRayCasts[j]);
+				CacheTrasher::sTrash(&mRayCastsBegin[j]);
 				CacheTrasher::sTrash(&out[j]);
 				inTest.TrashCache();
 
 				// Do raycasts
 				timer.Start();
-				inTest.CastRays(&mRayCasts[j], &mRayCasts[j] + 1, &out[j]);
+				inTest.CastRays(&mRayCastsBegin[j], &mRayCastsBegin[j] + 1, &out[j]);
 				timer.Stop(1);
 			}
 	#else
 			// Trash the cache
-			CacheTrasher::sTrash(mRayCasts);
+			CacheTrasher::sTrash(mRayCastsBegin, GetRayCount() * sizeof(RayCastTestIn));
 			CacheTrasher::sTrash(out);
 			inTest.TrashCache();
 
 			// Do raycasts
 			timer.Start();
-			inTest.CastRays(&mRayCasts[0], &mRayCasts[0] + mRayCasts.size(), &out[0]);
-			timer.Stop((uint)mRayCasts.size());
+			inTest.CastRays(mRayCastsBegin, mRayCastsEnd, &out[0]);
+			timer.Stop((uint)GetRayCount());
 	#endif
 
 			// Validate that there is no difference
-			assert(out.size() == mRayCasts.size());
+			assert(out.size() == GetRayCount());
 			for (uint j = 0; j < out.size(); ++j)
 			{
 				float diff = abs(out[j].mDistance - inReference[j].mDistance);
@@ -20,7 +20,7 @@ public:
 			return inTriangleCount * 3 * sizeof(Vertex);
 		}
 
-		uint						Pack(const VertexList &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
 		{
 			// Determine position of triangles start
 			uint offset = (uint)ioBuffer.size();
@@ -61,7 +61,7 @@ public:
 	class DecodingContext
 	{
 	public:
-		f_inline					DecodingContext(const TriangleHeader *inHeader, const ByteBuffer &inBuffer)
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart)
 		{
 		}		
 		
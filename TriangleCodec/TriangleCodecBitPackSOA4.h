@@ -46,7 +46,7 @@ public:
 			return inTriangleCount * (4 * 3 * 3 * sizeof(uint16) + 2 * sizeof(Float3) + Alignment - 1); // Worst case every triangle goes into a group of 4 triangles
 		}
 
-		uint						Pack(const VertexList &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
 		{
 			// Realign buffer
 			ioBuffer.Align(Alignment);
@@ -59,30 +59,71 @@ public:
 			TriangleGrouperMorton grouper;
 			grouper.Group(inVertices, inTriangles, 4, sorted_triangle_idx);
 
-			// Pack vertices
+			// Remember the order so that Refit can use the same blocks
+			mSortedTriangleIdx.insert(mSortedTriangleIdx.end(), sorted_triangle_idx.begin(), sorted_triangle_idx.end());
+
+			// Allocate and fill the blocks
+			uint8 *blocks = ioBuffer.Allocate<uint8>(((uint)inTriangles.size() + 3) / 4 * BlockSize);
+			PackBlocks(inVertices, inTriangles, sorted_triangle_idx.data(), blocks);
+
+			return offset;
+		}
+
+		void						Finalize(TriangleHeader *ioHeader, ByteBuffer &ioBuffer) const
+		{
+		}
+
+		// Requantize the triangles that were packed at inTriangleStart.
+		// Refit is called in the same order as Pack, so the triangles can be put in the same blocks without grouping them again.
+		void						Refit(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, uint inTriangleStart, ByteBuffer &ioBuffer)
+		{
+			PackBlocks(inVertices, inTriangles, &mSortedTriangleIdx[mRefitSortedTriangleIdx], ioBuffer.Get<uint8>(inTriangleStart));
+			mRefitSortedTriangleIdx += (uint)inTriangles.size();
+		}
+
+		void						RefitFinalize(const VertexView &inVertices, TriangleHeader *ioHeader, ByteBuffer &ioBuffer)
+		{
+			mRefitSortedTriangleIdx = 0;
+		}
+
+		void						GetStats(string &outTriangleCodecName, float &outVerticesPerTriangle)
+		{
+			// Store stats
+			outTriangleCodecName = "BitPackSOA4Align" + ConvertToString(Alignment) + "IntToFloat" + ConvertToString(IntToFloatTrick);
+			outVerticesPerTriangle = 3;
+		}
+
+	private:
+		// Size of a block of 4 triangles: the vertices followed by the decompression scale and offset
+		static constexpr uint		BlockSize = 4 * 3 * 3 * sizeof(uint16) + 2 * sizeof(Float3);
+
+		// Write the blocks for inTriangles in the order given by inSortedTriangleIdx to outBlocks
+		void						PackBlocks(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const uint *inSortedTriangleIdx, uint8 *outBlocks) const
+		{
 			uint triangle_count = (uint)inTriangles.size();
 			for (uint b = 0; b < triangle_count; b += 4)
 			{
 				// Calculate bounding box for this batch of 4 triangles
 				AABox bounds;
 				for (uint t = 0; t < 4; ++t)
-					bounds.Encapsulate(inVertices, inTriangles[sorted_triangle_idx[b + t < triangle_count ? b + t : triangle_count - 1]]);
+					bounds.Encapsulate(inVertices, inTriangles[inSortedTriangleIdx[b + t < triangle_count ? b + t : triangle_count - 1]]);
 
 				// Determine scale based on bounding box
 				Vec3 compress_scale = Vec3::sSelect(Vec3::sReplicate(COMPONENT_MASK) / (bounds.mMax - bounds.mMin), Vec3::sZero(), Vec3::sLess(bounds.mMax - bounds.mMin, Vec3::sReplicate(1.0e-20f)));
 
-				// Allocate vertices
-				uint16 *vertex = ioBuffer.Allocate<uint16>(4 * 3 * 3);
-
-				for (int v = 0; v < 3; ++v)
-					for (int c = 0; c < 3; ++c)
-						for (uint t = 0; t < 4; ++t)
-						{
-							float component = inVertices[b + t < triangle_count? inTriangles[sorted_triangle_idx[b + t]].mIdx[v] : inTriangles[sorted_triangle_idx[triangle_count - 1]].mIdx[0]][c];
-							uint32 compressed = (uint32)((component - bounds.mMin[c]) * compress_scale[c] + 0.5f);
-							assert(compressed <= COMPONENT_MASK);
-							*vertex++ = uint16(compressed);
-						}
+				// Pack vertices, create degenerate triangles for padding triangles
+				uint16 *vertex = reinterpret_cast<uint16 *>(outBlocks);
+				for (uint t = 0; t < 4; ++t)
+					for (int v = 0; v < 3; ++v)
+					{
+						uint32 src_vertex_index = b + t < triangle_count? inTriangles[inSortedTriangleIdx[b + t]].mIdx[v] : inTriangles[inSortedTriangleIdx[triangle_count - 1]].mIdx[0];
+						UVec4 compressed = ((Vec3(inVertices[src_vertex_index]) - bounds.mMin) * compress_scale + Vec3::sReplicate(0.5f)).ToInt();
+						assert(compressed.GetX() <= COMPONENT_MASK && compressed.GetY() <= COMPONENT_MASK && compressed.GetZ() <= COMPONENT_MASK);
+						vertex[(v * 3 + 0) * 4 + t] = uint16(compressed.GetX());
+						vertex[(v * 3 + 1) * 4 + t] = uint16(compressed.GetY());
+						vertex[(v * 3 + 2) * 4 + t] = uint16(compressed.GetZ());
+					}
+				vertex += 4 * 3 * 3;
 
 				// Decompression scale
 				Vec3 decompress_scale;
@@ -99,31 +140,23 @@ public:
 				}
 
 				// Store decompression scale and offset
-				Float3 *scale_and_offset = ioBuffer.Allocate<Float3>(2);
+				Float3 *scale_and_offset = reinterpret_cast<Float3 *>(vertex);
 				decompress_scale.StoreFloat3(scale_and_offset);
 				++scale_and_offset;
 				bounds.mMin.StoreFloat3(scale_and_offset);
-			}
-
-			return offset;
-		}
 
-		void						Finalize(TriangleHeader *ioHeader, ByteBuffer &ioBuffer) const
-		{
+				outBlocks += BlockSize;
+			}
 		}
 
-		void						GetStats(string &outTriangleCodecName, float &outVerticesPerTriangle)
-		{
-			// Store stats
-			outTriangleCodecName = "BitPackSOA4Align" + ConvertToString(Alignment) + "IntToFloat" + ConvertToString(IntToFloatTrick);
-			outVerticesPerTriangle = 3;
-		}
+		vector<uint>				mSortedTriangleIdx;							// Order of the triangles of all calls to Pack
+		uint						mRefitSortedTriangleIdx = 0;				// Position in mSortedTriangleIdx of the next call to Refit
 	};
 
 	class DecodingContext
 	{
 	public:
-		f_inline					DecodingContext(const TriangleHeader *inHeader, const ByteBuffer &inBuffer)
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart)
 		{
 		}
 
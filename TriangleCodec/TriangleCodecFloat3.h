@@ -22,7 +22,7 @@ public:
 			return inTriangleCount * 3 * sizeof(Float3);
 		}
 
-		uint						Pack(const VertexList &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
 		{
 			// Determine position of triangles start
 			uint offset = (uint)ioBuffer.size();
@@ -40,6 +40,19 @@ public:
 		{
 		}
 
+		void						Refit(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, uint inTriangleStart, ByteBuffer &ioBuffer)
+		{
+			// Overwrite vertices
+			Float3 *vertices = ioBuffer.Get<Float3>(inTriangleStart);
+			for (const IndexedTriangle &t : inTriangles)
+				for (int v = 0; v < 3; ++v)
+					*vertices++ = inVertices[t.mIdx[v]];
+		}
+
+		void						RefitFinalize(const VertexView &inVertices, TriangleHeader *ioHeader, ByteBuffer &ioBuffer)
+		{
+		}
+
 		void						GetStats(string &outTriangleCodecName, float &outVerticesPerTriangle)
 		{
 			// Store stats
@@ -51,7 +64,7 @@ public:
 	class DecodingContext
 	{
 	public:
-		f_inline					DecodingContext(const TriangleHeader *inHeader, const ByteBuffer &inBuffer)
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart)
 		{
 		}		
 		
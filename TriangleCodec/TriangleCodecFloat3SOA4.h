@@ -21,7 +21,7 @@ public:
 			return inTriangleCount * (4 * 3 * sizeof(Float3) + Alignment - 1); // Worst case every triangle goes into a group of 4 triangles
 		}
 
-		uint						Pack(const VertexList &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
 		{
 			// Align buffer
 			ioBuffer.Align(Alignment);
@@ -57,7 +57,7 @@ public:
 	class DecodingContext
 	{
 	public:
-		f_inline					DecodingContext(const TriangleHeader *inHeader, const ByteBuffer &inBuffer)
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart)
 		{
 		}		
 		
@@ -86,6 +86,30 @@ public:
 
 			ioClosest = closest.ReduceMin();
 		}
+
+		// Decode the triangles 4 at a time, calls inCallback(index of the first of the 4 triangles, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z) for every group of 4.
+		// If inNumTriangles is not a multiple of 4, the last group is padded with degenerate triangles.
+		template <class Callback>
+		f_inline void				DecodeTriangles4(const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, const Callback &inCallback) const
+		{
+			const Float4 *vertex = reinterpret_cast<const Float4 *>(inTriangleStart);
+			assert(IsAligned(vertex, Alignment));
+
+			for (uint b = 0; b < inNumTriangles; b += 4)
+			{
+				Vec4 v0x = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+				Vec4 v0y = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+				Vec4 v0z = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+				Vec4 v1x = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+				Vec4 v1y = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+				Vec4 v1z = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+				Vec4 v2x = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+				Vec4 v2y = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+				Vec4 v2z = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(vertex++);
+
+				inCallback(b, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z);
+			}
+		}
 	};
 };
 
@@ -0,0 +1,177 @@
+#pragma once
+
+// Uncompressed triangle codec like TriangleCodecFloat3SOA4 that also stores the material of the triangles so that rays can filter on them.
+// The material index of a triangle (IndexedTriangle::mMaterialIndex, should be < 32) is stored as a mask with bit 1 << mMaterialIndex set.
+// A block starts with the OR of the masks of all triangles so that a block without any of the requested materials can be skipped without
+// decoding the triangles, followed by groups of 4 triangles that store the masks of the 4 triangles after their vertices.
+template <int Alignment>
+class TriangleCodecFloat3SOA4Material
+{
+public:
+	class TriangleHeader
+	{
+	};
+
+	enum { TriangleHeaderSize = 0 };
+
+	enum { ChangesOffsetOnPack = (Alignment != 1) }; // If this codec could return a different offset than the current buffer size when calling Pack()
+
+	// Header of a block of triangles, padded to 16 bytes so that the vertices stay aligned
+	struct BlockHeader
+	{
+		uint32						mMaterialMask;						// OR of the material masks of all triangles in the block
+		uint32						mPadding[3];
+	};
+
+	static_assert(sizeof(BlockHeader) == 16, "BlockHeader should be 16 bytes");
+
+	// A group of 4 triangles
+	struct TriangleGroup
+	{
+		float						mVertices[9][4];					// v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z of 4 triangles
+		uint32						mMaterialMask[4];					// Material masks of the 4 triangles, 0 for padding triangles
+	};
+
+	static_assert(sizeof(TriangleGroup) == 160, "TriangleGroup should be 160 bytes");
+
+	class EncodingContext
+	{
+	public:
+		uint						GetPessimisticMemoryEstimate(uint inTriangleCount) const
+		{
+			return inTriangleCount * (sizeof(BlockHeader) + sizeof(TriangleGroup) + Alignment - 1); // Worst case every triangle goes into its own block
+		}
+
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		{
+			// Align buffer
+			ioBuffer.Align(Alignment);
+
+			// Determine position of triangles start
+			uint offset = (uint)ioBuffer.size();
+
+			// Allocate the block
+			uint triangle_count = (uint)inTriangles.size();
+			uint padded_triangle_count = AlignUp(triangle_count, 4);
+			uint8 *block = ioBuffer.Allocate<uint8>(sizeof(BlockHeader) + (padded_triangle_count / 4) * sizeof(TriangleGroup));
+			BlockHeader *header = reinterpret_cast<BlockHeader *>(block);
+			TriangleGroup *group = reinterpret_cast<TriangleGroup *>(header + 1);
+
+			// Pack vertices and materials
+			header->mMaterialMask = 0;
+			for (int i = 0; i < 3; ++i)
+				header->mPadding[i] = 0;
+			for (uint b = 0; b < padded_triangle_count; b += 4, ++group)
+				for (uint t = 0; t < 4; ++t)
+				{
+					const IndexedTriangle &triangle = inTriangles[b + t < triangle_count? b + t : triangle_count - 1];
+					for (int v = 0; v < 3; ++v)
+					{
+						const Float3 &vertex = inVertices[b + t < triangle_count? triangle.mIdx[v] : triangle.mIdx[0]]; // Pad with degenerate triangles
+						for (int c = 0; c < 3; ++c)
+							group->mVertices[3 * v + c][t] = vertex[c];
+					}
+
+					if (b + t < triangle_count)
+					{
+						if (triangle.mMaterialIndex >= 32)
+							FatalError("TriangleCodecFloat3SOA4Material: Material index should be less than 32");
+						group->mMaterialMask[t] = 1u << triangle.mMaterialIndex;
+						header->mMaterialMask |= group->mMaterialMask[t];
+					}
+					else
+						group->mMaterialMask[t] = 0;
+				}
+
+			return offset;
+		}
+
+		void						Finalize(TriangleHeader *ioHeader, ByteBuffer &ioBuffer) const
+		{
+		}
+
+		void						GetStats(string &outTriangleCodecName, float &outVerticesPerTriangle)
+		{
+			// Store stats
+			outTriangleCodecName = "Float3SOA4MaterialAlign" + ConvertToString(Alignment);
+			outVerticesPerTriangle = 3;
+		}
+	};
+
+	class DecodingContext
+	{
+	public:
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart)
+		{
+		}
+
+		// Get the OR of the material masks of all triangles in a block
+		static f_inline uint32		sGetMaterialMask(const void *inTriangleStart)
+		{
+			return reinterpret_cast<const BlockHeader *>(inTriangleStart)->mMaterialMask;
+		}
+
+		// Test a ray against all triangles of a block
+		f_inline void				TestRay(const Vec3 &inRayOrigin, const Vec3 &inRayDirection, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, float &ioClosest) const
+		{
+			TestRayFiltered(inRayOrigin, inRayDirection, inBoundsMin, inBoundsMax, inTriangleStart, inNumTriangles, 0xffffffff, ioClosest);
+		}
+
+		// Test a ray against the triangles of a block that have a material in inMaterialMask
+		f_inline void				TestRayFiltered(const Vec3 &inRayOrigin, const Vec3 &inRayDirection, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, uint32 inMaterialMask, float &ioClosest) const
+		{
+			assert(IsAligned(inTriangleStart, Alignment));
+
+			// Skip the block when none of the triangles has one of the materials
+			if ((sGetMaterialMask(inTriangleStart) & inMaterialMask) == 0)
+				return;
+
+			Vec4 closest = Vec4::sReplicate(ioClosest);
+			UVec4 material_mask = UVec4::sReplicate(inMaterialMask);
+
+			const TriangleGroup *group = reinterpret_cast<const TriangleGroup *>(reinterpret_cast<const BlockHeader *>(inTriangleStart) + 1);
+			for (uint b = 0; b < inNumTriangles; b += 4, ++group)
+			{
+				Vec4 v0x = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[0]));
+				Vec4 v0y = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[1]));
+				Vec4 v0z = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[2]));
+				Vec4 v1x = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[3]));
+				Vec4 v1y = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[4]));
+				Vec4 v1z = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[5]));
+				Vec4 v2x = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[6]));
+				Vec4 v2y = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[7]));
+				Vec4 v2z = Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[8]));
+				UVec4 triangle_mask = UVec4LoadInt4ConditionallyAligned<Alignment % 16 == 0>(&group->mMaterialMask[0]);
+
+				// Ignore the triangles that don't have one of the materials (this includes the padding triangles)
+				Vec4 distance = RayTriangle4(inRayOrigin, inRayDirection, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z);
+				UVec4 ignore = UVec4::sEquals(UVec4::sAnd(triangle_mask, material_mask), UVec4::sZero());
+				distance = Vec4::sSelect(distance, Vec4::sReplicate(FLT_MAX), ignore);
+				closest = Vec4::sMin(distance, closest);
+			}
+
+			ioClosest = closest.ReduceMin();
+		}
+
+		// Decode the triangles 4 at a time, calls inCallback(index of the first of the 4 triangles, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z) for every group of 4.
+		// If inNumTriangles is not a multiple of 4, the last group is padded with degenerate triangles.
+		template <class Callback>
+		f_inline void				DecodeTriangles4(const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, const Callback &inCallback) const
+		{
+			assert(IsAligned(inTriangleStart, Alignment));
+
+			const TriangleGroup *group = reinterpret_cast<const TriangleGroup *>(reinterpret_cast<const BlockHeader *>(inTriangleStart) + 1);
+			for (uint b = 0; b < inNumTriangles; b += 4, ++group)
+				inCallback(b,
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[0])),
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[1])),
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[2])),
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[3])),
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[4])),
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[5])),
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[6])),
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[7])),
+					Vec4LoadFloat4ConditionallyAligned<Alignment % 16 == 0>(reinterpret_cast<const Float4 *>(group->mVertices[8])));
+		}
+	};
+};
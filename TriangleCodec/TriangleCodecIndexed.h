@@ -30,7 +30,7 @@ public:
 			return inTriangleCount * 3 * (sizeof(Index) + sizeof(Float3)) + 3;
 		}
 
-		uint						Pack(const VertexList &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
 		{
 			// Determine position of triangles start
 			uint offset = (uint)ioBuffer.size();
@@ -101,8 +101,8 @@ public:
 	class DecodingContext
 	{
 	public:
-		f_inline					DecodingContext(const TriangleHeader *inHeader, const ByteBuffer &inBuffer) :
-			mVertices(reinterpret_cast<const Float3 *>(inBuffer.Get<uint8>(0) + inHeader->mVertexOffset))
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart) :
+			mVertices(reinterpret_cast<const Float3 *>(inBufferStart + inHeader->mVertexOffset))
 		{
 		}
 
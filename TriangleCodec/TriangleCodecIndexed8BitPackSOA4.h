@@ -98,7 +98,7 @@ public:
 		}
 
 		// Pack the triangles in inContainer to ioBuffer
-		uint						Pack(const VertexList &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
 		{
 			// Determine position of triangles start
 			uint offset = (uint)ioBuffer.size();
@@ -137,6 +137,7 @@ public:
 							vertex_index = (uint32)mVertices.size();
 							mVertexMap[src_vertex_index] = vertex_index;
 							mVertices.push_back(inVertices[src_vertex_index]);
+							mSourceVertices.push_back(src_vertex_index);
 						}
 						else
 						{
@@ -156,7 +157,7 @@ public:
 		}
 
 		// After all triangles have been packed, this finalizes the header and triangle buffer
-		void						Finalize(TriangleHeader *ioHeader, ByteBuffer &ioBuffer) const
+		void						Finalize(TriangleHeader *ioHeader, ByteBuffer &ioBuffer)
 		{
 			// Align buffer to 4 bytes
 			uint vertices_idx = (uint)ioBuffer.Align(4);
@@ -165,13 +166,43 @@ public:
 			for (uint o : mOffsetsToPatch)
 				*ioBuffer.Get<uint32>(o) += vertices_idx - o;
 
+			// Compress vertices
+			mVerticesStart = vertices_idx;
+			CompressVertices(ioHeader, ioBuffer.Allocate<VertexData>(mVertices.size()));
+		}
+
+		// The triangle blocks only contain indices, so they don't change when the vertices move
+		void						Refit(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, uint inTriangleStart, ByteBuffer &ioBuffer)
+		{
+		}
+
+		// Fetch the new vertex positions and requantize all vertices against their new bounding box
+		void						RefitFinalize(const VertexView &inVertices, TriangleHeader *ioHeader, ByteBuffer &ioBuffer)
+		{
+			for (size_t v = 0; v < mVertices.size(); ++v)
+				mVertices[v] = inVertices[mSourceVertices[v]];
+
+			CompressVertices(ioHeader, ioBuffer.Get<VertexData>(mVerticesStart));
+		}
+
+		void						GetStats(string &outTriangleCodecName, float &outVerticesPerTriangle)
+		{
+			// Store stats
+			outTriangleCodecName = "Indexed8BitPackSOA4";
+			outVerticesPerTriangle = (float)mVertices.size() / mNumTriangles;
+		}
+
+	private:
+		// Quantize mVertices to outVertices and store the decompression information in ioHeader
+		void						CompressVertices(TriangleHeader *ioHeader, VertexData *outVertices) const
+		{
 			// Calculate bounding box
 			AABox bounds;
 			for (const Float3 &v : mVertices)
 				bounds.Encapsulate(Vec3(v));
 
 			// Compress vertices
-			VertexData *vertices = ioBuffer.Allocate<VertexData>(mVertices.size());
+			VertexData *vertices = outVertices;
 			Vec3 compress_scale = Vec3::sSelect(Vec3::sReplicate(COMPONENT_MASK) / bounds.GetSize(), Vec3::sZero(), Vec3::sLess(bounds.GetSize(), Vec3::sReplicate(1.0e-20f)));
 			for (const Float3 &v : mVertices)
 			{
@@ -189,16 +220,10 @@ public:
 			(bounds.GetSize() / Vec3::sReplicate(COMPONENT_MASK)).StoreFloat3(&ioHeader->mScale);
 		}
 
-		void						GetStats(string &outTriangleCodecName, float &outVerticesPerTriangle)
-		{
-			// Store stats
-			outTriangleCodecName = "Indexed8BitPackSOA4";
-			outVerticesPerTriangle = (float)mVertices.size() / mNumTriangles;
-		}
-
-	private:
 		uint						mNumTriangles;
 		vector<Float3>				mVertices;				// Output vertices, sorted according to occurance
+		vector<uint32>				mSourceVertices;		// For each output vertex the original mesh vertex index (inVertices), used to refit
+		uint						mVerticesStart = 0;		// Start of the compressed vertices in the buffer
 		map<uint32, uint32>			mVertexMap;				// Maps from the original mesh vertex index (inVertices) to the index in our output vertices (mVertices)
 		vector<uint>				mOffsetsToPatch;		// Offsets to the vertex buffer that need to be patched in once all nodes have been packed
 	};
@@ -226,7 +251,7 @@ public:
 		}
 
 	public:
-		f_inline					DecodingContext(const TriangleHeader *inHeader, const ByteBuffer &inBuffer) :
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart) :
 			mOffsetX(Vec4::sReplicate(inHeader->mOffset.x)),
 			mOffsetY(Vec4::sReplicate(inHeader->mOffset.y)),
 			mOffsetZ(Vec4::sReplicate(inHeader->mOffset.z)),
@@ -236,6 +261,13 @@ public:
 		{
 		}
 
+		// Prefetch the vertices that the triangles starting at inTriangleStart use, reads the header of the triangles
+		f_inline void				PrefetchVertices(const void *inTriangleStart) const
+		{
+			const TriangleBlockHeader *header = reinterpret_cast<const TriangleBlockHeader *>(inTriangleStart);
+			_mm_prefetch(reinterpret_cast<const char *>(header->GetVertexData()), _MM_HINT_T0);
+		}
+
 		// Tests a ray against the packed triangles
 		f_inline void				TestRay(const Vec3 &inRayOrigin, const Vec3 &inRayDirection, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, float &ioClosest) const
 		{
@@ -271,6 +303,33 @@ public:
 			ioClosest = closest.ReduceMin();
 		}
 
+		// Decode the triangles 4 at a time, calls inCallback(index of the first of the 4 triangles, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z) for every group of 4.
+		// If inNumTriangles is not a multiple of 4, the last group is padded with degenerate triangles.
+		template <class Callback>
+		f_inline void				DecodeTriangles4(const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, const Callback &inCallback) const
+		{
+			assert(inNumTriangles > 0);
+			const TriangleBlockHeader *header = reinterpret_cast<const TriangleBlockHeader *>(inTriangleStart);
+			const VertexData *vertices = header->GetVertexData();
+			const TriangleBlock *t = header->GetTriangleBlock();
+
+			for (uint b = 0; b < inNumTriangles; b += 4, ++t)
+			{
+				// Get the indices for the three vertices
+				UVec4 iv1 = UVec4::sLoadInt(reinterpret_cast<const uint32 *>(&t->mIndices[0])).Expand4Byte0();
+				UVec4 iv2 = UVec4::sLoadInt(reinterpret_cast<const uint32 *>(&t->mIndices[1])).Expand4Byte0();
+				UVec4 iv3 = UVec4::sLoadInt(reinterpret_cast<const uint32 *>(&t->mIndices[2])).Expand4Byte0();
+
+				// Decompress the triangle data
+				Vec4 v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z;
+				Unpack(vertices, iv1, v1x, v1y, v1z);
+				Unpack(vertices, iv2, v2x, v2y, v2z);
+				Unpack(vertices, iv3, v3x, v3y, v3z);
+
+				inCallback(b, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z);
+			}
+		}
+
 	private:
 		Vec4						mOffsetX;
 		Vec4						mOffsetY;
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <TriangleCodec/TriangleCodecIndexed8BitPackSOA4.h>
+
+// Compressed triangle codec like TriangleCodecIndexed8BitPackSOA4 that also stores the material of the triangles so that rays can filter on them.
+// The triangles are packed exactly like TriangleCodecIndexed8BitPackSOA4 does, followed by:
+//
+// MaterialHeader (OR of the masks 1 << IndexedTriangle::mMaterialIndex of all triangles, the material index should be < 32),
+// uint8 material index for every triangle, padded to a multiple of 4 triangles
+//
+// A block without any of the requested materials can be skipped without decoding the triangles and the data that the unfiltered TestRay reads is unchanged.
+class TriangleCodecIndexed8BitPackSOA4Material : public TriangleCodecIndexed8BitPackSOA4
+{
+public:
+	using Base = TriangleCodecIndexed8BitPackSOA4;
+
+	// Material information that follows the triangle blocks
+	struct MaterialHeader
+	{
+		const uint8 *				GetMaterials() const		{ return reinterpret_cast<const uint8 *>(this) + sizeof(MaterialHeader); }
+
+		uint32						mMaterialMask;				// OR of the material masks of all triangles in the block
+	};
+
+	static_assert(sizeof(MaterialHeader) == 4, "Compiler added padding");
+
+	// Get the material information of a block of inNumTriangles triangles
+	static f_inline const MaterialHeader *sGetMaterialHeader(const void *inTriangleStart, uint32 inNumTriangles)
+	{
+		return reinterpret_cast<const MaterialHeader *>(reinterpret_cast<const uint8 *>(inTriangleStart) + sizeof(TriangleBlockHeader) + ((inNumTriangles + 3) >> 2) * sizeof(TriangleBlock));
+	}
+
+	// This class is used to encode and compress triangle data into a byte buffer
+	class EncodingContext : public Base::EncodingContext
+	{
+	public:
+		// Get an upper bound on the amount of bytes needed to store inTriangleCount triangles
+		uint						GetPessimisticMemoryEstimate(uint inTriangleCount) const
+		{
+			// Worst case each triangle is alone in a block, so every triangle needs a material header and 4 material indices
+			return Base::EncodingContext::GetPessimisticMemoryEstimate(inTriangleCount) + inTriangleCount * (sizeof(MaterialHeader) + 4);
+		}
+
+		// Pack the triangles in inContainer to ioBuffer
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		{
+			uint offset = Base::EncodingContext::Pack(inVertices, inTriangles, inBoundsMin, inBoundsMax, ioBuffer);
+
+			// Store materials, padding triangles are degenerate so they get the material of the last triangle
+			uint tri_count = (uint)inTriangles.size();
+			uint padded_triangle_count = AlignUp(tri_count, 4);
+			MaterialHeader *header = ioBuffer.Allocate<MaterialHeader>();
+			uint8 *materials = ioBuffer.Allocate<uint8>(padded_triangle_count);
+			header->mMaterialMask = 0;
+			for (uint t = 0; t < padded_triangle_count; ++t)
+			{
+				uint32 material_index = inTriangles[min(t, tri_count - 1)].mMaterialIndex;
+				if (material_index >= 32)
+					FatalError("TriangleCodecIndexed8BitPackSOA4Material: Material index should be less than 32");
+				materials[t] = (uint8)material_index;
+				header->mMaterialMask |= 1u << material_index;
+			}
+
+			return offset;
+		}
+
+		void						GetStats(string &outTriangleCodecName, float &outVerticesPerTriangle)
+		{
+			Base::EncodingContext::GetStats(outTriangleCodecName, outVerticesPerTriangle);
+			outTriangleCodecName = "Indexed8BitPackSOA4Material";
+		}
+	};
+
+	// This class is used to decode and decompress triangle data packed by the EncodingContext
+	class DecodingContext : public Base::DecodingContext
+	{
+	public:
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart) :
+			Base::DecodingContext(inHeader, inBufferStart)
+		{
+		}
+
+		// Tests a ray against the packed triangles that have a material in inMaterialMask
+		f_inline void				TestRayFiltered(const Vec3 &inRayOrigin, const Vec3 &inRayDirection, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, uint32 inMaterialMask, float &ioClosest) const
+		{
+			const MaterialHeader *header = sGetMaterialHeader(inTriangleStart, inNumTriangles);
+
+			// Skip the block when none of the triangles has one of the materials
+			if ((header->mMaterialMask & inMaterialMask) == 0)
+				return;
+
+			// All triangles pass the filter, no need to look at the individual materials
+			if ((header->mMaterialMask & ~inMaterialMask) == 0)
+			{
+				TestRay(inRayOrigin, inRayDirection, inBoundsMin, inBoundsMax, inTriangleStart, inNumTriangles, ioClosest);
+				return;
+			}
+
+			const uint8 *materials = header->GetMaterials();
+			Vec4 closest = Vec4::sReplicate(ioClosest);
+			DecodeTriangles4(inBoundsMin, inBoundsMax, inTriangleStart, inNumTriangles, [&inRayOrigin, &inRayDirection, inMaterialMask, materials, &closest](uint inTriangle, const Vec4 &inV1X, const Vec4 &inV1Y, const Vec4 &inV1Z, const Vec4 &inV2X, const Vec4 &inV2Y, const Vec4 &inV2Z, const Vec4 &inV3X, const Vec4 &inV3Y, const Vec4 &inV3Z)
+			{
+				// Determine which triangles don't have one of the materials
+				const uint8 *m = materials + inTriangle;
+				UVec4 ignore(
+					((inMaterialMask >> m[0]) & 1) - 1,
+					((inMaterialMask >> m[1]) & 1) - 1,
+					((inMaterialMask >> m[2]) & 1) - 1,
+					((inMaterialMask >> m[3]) & 1) - 1);
+
+				// Perform ray vs triangle test
+				Vec4 distance = RayTriangle4(inRayOrigin, inRayDirection, inV1X, inV1Y, inV1Z, inV2X, inV2Y, inV2Z, inV3X, inV3Y, inV3Z);
+				distance = Vec4::sSelect(distance, Vec4::sReplicate(FLT_MAX), ignore);
+				closest = Vec4::sMin(distance, closest);
+			});
+
+			ioClosest = closest.ReduceMin();
+		}
+	};
+};
@@ -61,7 +61,7 @@ public:
 			return AlignUp(inTriangleCount, 4) * 3 * sizeof(Index) + inTriangleCount * 3 * 2 * sizeof(uint32) + 3;
 		}
 
-		uint						Pack(const VertexList &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
 		{
 			// Determine position of triangles start
 			uint offset = (uint)ioBuffer.size();
@@ -157,14 +157,14 @@ public:
 	class DecodingContext
 	{
 	public:
-		f_inline					DecodingContext(const TriangleHeader *inHeader, const ByteBuffer &inBuffer) :
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart) :
 			mOffsetX(Vec4::sReplicate(inHeader->mOffset.x)),
 			mOffsetY(Vec4::sReplicate(inHeader->mOffset.y)),
 			mOffsetZ(Vec4::sReplicate(inHeader->mOffset.z)),
 			mScaleX(Vec4::sReplicate(inHeader->mScale.x)),
 			mScaleY(Vec4::sReplicate(inHeader->mScale.y)),
 			mScaleZ(Vec4::sReplicate(inHeader->mScale.z)),
-			mVertices(reinterpret_cast<const uint32 *>(inBuffer.Get<uint8>(0) + inHeader->mVertexOffset))
+			mVertices(reinterpret_cast<const uint32 *>(inBufferStart + inHeader->mVertexOffset))
 		{
 		}
 
@@ -229,6 +229,45 @@ public:
 			ioClosest = closest.ReduceMin();
 		}
 
+		// Decode the triangles 4 at a time, calls inCallback(index of the first of the 4 triangles, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z) for every group of 4.
+		// If inNumTriangles is not a multiple of 4, the last group is padded with degenerate triangles.
+		template <class Callback>
+		f_inline void				DecodeTriangles4(const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, const Callback &inCallback) const
+		{
+			assert(inNumTriangles > 0);
+			const Index *t = reinterpret_cast<const Index *>(inTriangleStart);
+
+			for (uint b = 0; b < inNumTriangles; b += 4)
+			{
+				// Get the indices for the three vertices
+				UVec4 iv1, iv2, iv3;
+				if (sizeof(Index) == 2)
+				{
+					UVec4 iv1to3pack = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 8;
+					iv1 = iv1to3pack.Expand4Uint16Lo();
+					iv2 = iv1to3pack.Expand4Uint16Hi();
+					UVec4 iv4pack = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 4; // Note this reads 2 uint32's extra that we don't use, but loading 2 floats is more instructions
+					iv3 = iv4pack.Expand4Uint16Lo();
+				}
+				else if (sizeof(Index) == 4)
+				{
+					iv1 = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 4;
+					iv2 = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 4;
+					iv3 = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 4;
+				}
+				else
+					assert(false);
+
+				// Decompress the triangle data
+				Vec4 v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z;
+				Unpack(iv1, v1x, v1y, v1z);
+				Unpack(iv2, v2x, v2y, v2z);
+				Unpack(iv3, v3x, v3y, v3z);
+
+				inCallback(b, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z);
+			}
+		}
+
 	private:
 		Vec4						mOffsetX;
 		Vec4						mOffsetY;
@@ -36,7 +36,7 @@ public:
 			return AlignUp(inTriangleCount, 4) * 3 * sizeof(Index) + inTriangleCount * 3 * sizeof(Float3) + 3;
 		}
 
-		uint						Pack(const VertexList &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
+		uint						Pack(const VertexView &inVertices, const IndexedTriangleList &inTriangles, const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, ByteBuffer &ioBuffer)
 		{
 			// Determine position of triangles start
 			uint offset = (uint)ioBuffer.size();
@@ -111,8 +111,8 @@ public:
 	class DecodingContext
 	{
 	public:
-		f_inline					DecodingContext(const TriangleHeader *inHeader, const ByteBuffer &inBuffer) :
-			mVertices(reinterpret_cast<const float *>(inBuffer.Get<uint8>(0) + inHeader->mVertexOffset))
+		f_inline					DecodingContext(const TriangleHeader *inHeader, const uint8 *inBufferStart) :
+			mVertices(reinterpret_cast<const float *>(inBufferStart + inHeader->mVertexOffset))
 		{
 		}
 
@@ -170,6 +170,56 @@ public:
 			ioClosest = closest.ReduceMin();
 		}
 
+		// Decode the triangles 4 at a time, calls inCallback(index of the first of the 4 triangles, v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z) for every group of 4.
+		// If inNumTriangles is not a multiple of 4, the last group is padded with degenerate triangles.
+		template <class Callback>
+		f_inline void				DecodeTriangles4(const Vec3 &inBoundsMin, const Vec3 &inBoundsMax, const void *inTriangleStart, uint32 inNumTriangles, const Callback &inCallback) const
+		{
+			assert(inNumTriangles > 0);
+			const Index *t = reinterpret_cast<const Index *>(inTriangleStart);
+
+			for (uint b = 0; b < inNumTriangles; b += 4)
+			{
+				// Get the indices for the three vertices
+				UVec4 iv1, iv2, iv3;
+				if (sizeof(Index) == 2)
+				{
+					UVec4 iv1to3pack = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 8;
+					iv1 = iv1to3pack.Expand4Uint16Lo();
+					iv2 = iv1to3pack.Expand4Uint16Hi();
+					UVec4 iv4pack = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 4; // Note this reads 2 uint32's extra that we don't use, but loading 2 floats is more instructions
+					iv3 = iv4pack.Expand4Uint16Lo();
+				}
+				else if (sizeof(Index) == 4)
+				{
+					iv1 = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 4;
+					iv2 = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 4;
+					iv3 = UVec4::sLoadInt4(reinterpret_cast<const uint32 *>(t)); t += 4;
+				}
+				else
+					assert(false);
+
+				// Multiply by 3 to get the offset in the mVertices array (because 1 vertex = 3 floats)
+				UVec4 three = UVec4::sReplicate(3);
+				iv1 = iv1 * three;
+				iv2 = iv2 * three;
+				iv3 = iv3 * three;
+
+				// Load the vertices of the 4 triangles
+				Vec4 v1x = Vec4::sGatherFloat4<4>(mVertices + 0, iv1);
+				Vec4 v1y = Vec4::sGatherFloat4<4>(mVertices + 1, iv1);
+				Vec4 v1z = Vec4::sGatherFloat4<4>(mVertices + 2, iv1);
+				Vec4 v2x = Vec4::sGatherFloat4<4>(mVertices + 0, iv2);
+				Vec4 v2y = Vec4::sGatherFloat4<4>(mVertices + 1, iv2);
+				Vec4 v2z = Vec4::sGatherFloat4<4>(mVertices + 2, iv2);
+				Vec4 v3x = Vec4::sGatherFloat4<4>(mVertices + 0, iv3);
+				Vec4 v3y = Vec4::sGatherFloat4<4>(mVertices + 1, iv3);
+				Vec4 v3z = Vec4::sGatherFloat4<4>(mVertices + 2, iv3);
+
+				inCallback(b, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z);
+			}
+		}
+
 	private:
 		const float *				mVertices;
 	};
@@ -10,5 +10,5 @@ public:
 	virtual					~TriangleGrouper() { }
 
 	// Group a batch of triangles
-	virtual void			Group(const VertexList &inVertices, const IndexedTriangleList &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices) = 0;
+	virtual void			Group(const VertexView &inVertices, const IndexedTriangleView &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices) = 0;
 };
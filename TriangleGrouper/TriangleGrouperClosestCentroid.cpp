@@ -5,7 +5,7 @@
 #include <Core/ProgressIndicator.h>
 #include <Geometry/MortonCode.h>
 
-void TriangleGrouperClosestCentroid::Group(const VertexList &inVertices, const IndexedTriangleList &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices)
+void TriangleGrouperClosestCentroid::Group(const VertexView &inVertices, const IndexedTriangleView &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices)
 {
 	const uint triangle_count = (uint)inTriangles.size();
 	const uint num_batches = (triangle_count + inGroupSize - 1) / inGroupSize;
@@ -9,5 +9,5 @@ class TriangleGrouperClosestCentroid : public TriangleGrouper
 {
 public:
 	// Group a batch of triangles
-	virtual void			Group(const VertexList &inVertices, const IndexedTriangleList &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices);
+	virtual void			Group(const VertexView &inVertices, const IndexedTriangleView &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices);
 };
@@ -0,0 +1,250 @@
+#include <pch.h> // IWYU pragma: keep
+
+#include <TriangleGrouper/TriangleGrouperClosestCentroidKDTree.h>
+#include <Core/AlignedAllocator.h>
+#include <Core/ProgressIndicator.h>
+#include <Geometry/AABox.h>
+#include <thread>
+
+namespace {
+
+using CentroidList = vector<Vec3, AlignedAllocator<Vec3, 16>>;
+
+// Balanced k-d tree over the triangle centroids that supports removing centroids.
+// The tree is stored implicitly: node i has children 2 * i + 1 and 2 * i + 2 and every node covers a contiguous range of mIndices.
+class CentroidKDTree
+{
+public:
+	// Max amount of centroids in a leaf
+	enum { MAX_LEAF_SIZE = 8 };
+
+							CentroidKDTree(const CentroidList &inCentroids) :
+		mCentroids(inCentroids),
+		mCount((uint)inCentroids.size()),
+		mLeafLevel(0)
+	{
+		// Determine depth of the tree
+		while ((mCount >> mLeafLevel) > MAX_LEAF_SIZE)
+			++mLeafLevel;
+		mNodes.resize((size_t(2) << mLeafLevel) - 1);
+
+		// Initialize the centroid order
+		mIndices.resize(mCount);
+		for (uint t = 0; t < mCount; ++t)
+			mIndices[t] = t;
+		mRemoved.resize(mCount, 0);
+
+		// Build the top levels of the tree on multiple threads, each thread builds a sub tree
+		uint num_threads = max(1u, thread::hardware_concurrency());
+		uint thread_level = 0;
+		while ((1u << thread_level) < num_threads && thread_level < mLeafLevel && (mCount >> thread_level) > 65536)
+			++thread_level;
+		Build(0, 0, thread_level);
+
+		// Store where every centroid ended up
+		mPosition.resize(mCount);
+		for (uint i = 0; i < mCount; ++i)
+			mPosition[mIndices[i]] = i;
+	}
+
+	// Remove a centroid from the tree so that it will no longer be returned by FindClosest
+	void					Remove(uint inTriangle)
+	{
+		assert(!mRemoved[inTriangle]);
+		mRemoved[inTriangle] = 1;
+
+		// Update the remaining counts on the path from the root to the leaf
+		uint position = mPosition[inTriangle];
+		uint node = 0;
+		for (uint level = 0; ; ++level)
+		{
+			--mNodes[node].mRemaining;
+			if (level == mLeafLevel)
+				break;
+			node = 2 * node + (position < GetRangeStart(level + 1, 2 * GetIndexInLevel(node, level) + 1)? 1 : 2);
+		}
+	}
+
+	// Check if a centroid was removed
+	bool					IsRemoved(uint inTriangle) const
+	{
+		return mRemoved[inTriangle] != 0;
+	}
+
+	// Find the inMaxResults closest centroids to inPosition that have not been removed, sorted on distance (closest first)
+	void					FindClosest(const Vec3 &inPosition, uint inMaxResults, vector<pair<float, uint>> &outResults) const
+	{
+		outResults.clear();
+		if (inMaxResults > 0)
+			FindClosest(0, 0, inPosition, inMaxResults, outResults);
+		sort_heap(outResults.begin(), outResults.end());
+	}
+
+private:
+	struct Node
+	{
+		Vec3				mMin;
+		Vec3				mMax;
+		uint				mRemaining;											// Amount of centroids in this sub tree that have not been removed
+	};
+
+	// Get the index of a node relative to the first node in its level
+	static uint				GetIndexInLevel(uint inNode, uint inLevel)
+	{
+		return inNode + 1 - (1u << inLevel);
+	}
+
+	// Get the start of the range of mIndices that node inIndex in level inLevel covers, inIndex = 2^inLevel gives the end of the last node
+	uint					GetRangeStart(uint inLevel, uint inIndex) const
+	{
+		return uint((uint64(mCount) * inIndex) >> inLevel);
+	}
+
+	// Build the sub tree for inNode, spawns threads for the left children while inLevel < inThreadLevel
+	void					Build(uint inNode, uint inLevel, uint inThreadLevel)
+	{
+		uint index = GetIndexInLevel(inNode, inLevel);
+		uint start = GetRangeStart(inLevel, index);
+		uint end = GetRangeStart(inLevel, index + 1);
+
+		// Calculate bounds
+		AABox bounds;
+		for (uint i = start; i < end; ++i)
+			bounds.Encapsulate(mCentroids[mIndices[i]]);
+		Node &node = mNodes[inNode];
+		node.mMin = bounds.mMin;
+		node.mMax = bounds.mMax;
+		node.mRemaining = end - start;
+
+		if (inLevel == mLeafLevel)
+			return;
+
+		// Split at the median of the longest axis, the children cover the same ranges as the implicit tree layout
+		int axis = bounds.GetSize().GetHighestComponentIndex();
+		uint mid = GetRangeStart(inLevel + 1, 2 * index + 1);
+		nth_element(mIndices.begin() + start, mIndices.begin() + mid, mIndices.begin() + end, [this, axis](uint inLHS, uint inRHS) { return mCentroids[inLHS][axis] < mCentroids[inRHS][axis]; });
+
+		if (inLevel < inThreadLevel)
+		{
+			thread left(&CentroidKDTree::Build, this, 2 * inNode + 1, inLevel + 1, inThreadLevel);
+			Build(2 * inNode + 2, inLevel + 1, inThreadLevel);
+			left.join();
+		}
+		else
+		{
+			Build(2 * inNode + 1, inLevel + 1, inThreadLevel);
+			Build(2 * inNode + 2, inLevel + 1, inThreadLevel);
+		}
+	}
+
+	// Get squared distance from inPosition to the bounds of a node
+	static float			GetDistanceSq(const Node &inNode, const Vec3 &inPosition)
+	{
+		Vec3 delta = Vec3::sMax(Vec3::sMax(inNode.mMin - inPosition, inPosition - inNode.mMax), Vec3::sZero());
+		return delta.LengthSq();
+	}
+
+	// Collect the closest centroids in sub tree inNode, ioResults is a max heap on distance
+	void					FindClosest(uint inNode, uint inLevel, const Vec3 &inPosition, uint inMaxResults, vector<pair<float, uint>> &ioResults) const
+	{
+		if (inLevel == mLeafLevel)
+		{
+			uint index = GetIndexInLevel(inNode, inLevel);
+			uint end = GetRangeStart(inLevel, index + 1);
+			for (uint i = GetRangeStart(inLevel, index); i < end; ++i)
+			{
+				uint t = mIndices[i];
+				if (mRemoved[t])
+					continue;
+
+				// Ties are resolved on triangle index so the result doesn't depend on the tree layout
+				pair<float, uint> candidate((mCentroids[t] - inPosition).LengthSq(), t);
+				if (ioResults.size() < inMaxResults)
+				{
+					ioResults.push_back(candidate);
+					push_heap(ioResults.begin(), ioResults.end());
+				}
+				else if (candidate < ioResults.front())
+				{
+					pop_heap(ioResults.begin(), ioResults.end());
+					ioResults.back() = candidate;
+					push_heap(ioResults.begin(), ioResults.end());
+				}
+			}
+			return;
+		}
+
+		// Visit the closest child first
+		uint child[2] = { 2 * inNode + 1, 2 * inNode + 2 };
+		float dist[2] = { GetDistanceSq(mNodes[child[0]], inPosition), GetDistanceSq(mNodes[child[1]], inPosition) };
+		if (dist[1] < dist[0])
+		{
+			swap(child[0], child[1]);
+			swap(dist[0], dist[1]);
+		}
+		for (int c = 0; c < 2; ++c)
+			if (mNodes[child[c]].mRemaining > 0
+				&& (ioResults.size() < inMaxResults || dist[c] <= ioResults.front().first))
+				FindClosest(child[c], inLevel + 1, inPosition, inMaxResults, ioResults);
+	}
+
+	const CentroidList &	mCentroids;
+	uint					mCount;
+	uint					mLeafLevel;
+	vector<Node, AlignedAllocator<Node, 16>> mNodes;
+	vector<uint>			mIndices;											// Triangle indices in tree order
+	vector<uint>			mPosition;											// Position of each triangle in mIndices
+	vector<uint8>			mRemoved;
+};
+
+} // namespace
+
+void TriangleGrouperClosestCentroidKDTree::Group(const VertexView &inVertices, const IndexedTriangleView &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices)
+{
+	const uint triangle_count = (uint)inTriangles.size();
+
+	ProgressIndicator progress("TriangleGrouperClosestCentroidKDTree", triangle_count);
+
+	CentroidList centroids;
+	centroids.resize(triangle_count);
+
+	outGroupedTriangleIndices.clear();
+	outGroupedTriangleIndices.reserve(triangle_count);
+
+	// Store centroids
+	for (uint t = 0; t < triangle_count; ++t)
+		centroids[t] = inTriangles[t].GetCentroid(inVertices);
+
+	// Sort triangles on centroid X coordinate, the first triangle that has not been removed starts the next batch
+	vector<uint> sorted_x;
+	sorted_x.resize(triangle_count);
+	for (uint t = 0; t < triangle_count; ++t)
+		sorted_x[t] = t;
+	sort(sorted_x.begin(), sorted_x.end(), [&centroids](uint inLHS, uint inRHS) { float lhs = centroids[inLHS].GetX(), rhs = centroids[inRHS].GetX(); return lhs < rhs || (lhs == rhs && inLHS < inRHS); });
+
+	CentroidKDTree tree(centroids);
+
+	vector<pair<float, uint>> closest;
+	closest.reserve(inGroupSize);
+	vector<uint>::const_iterator next_first = sorted_x.begin();
+	while (outGroupedTriangleIndices.size() < triangle_count)
+	{
+		// Find triangle with centroid with lowest X coordinate and make it the first in a new batch
+		while (tree.IsRemoved(*next_first))
+			++next_first;
+		uint first = *next_first;
+		tree.Remove(first);
+		outGroupedTriangleIndices.push_back(first);
+
+		// Add the closest remaining triangles in order of distance to the first triangle
+		tree.FindClosest(centroids[first], inGroupSize - 1, closest);
+		for (const pair<float, uint> &c : closest)
+		{
+			tree.Remove(c.second);
+			outGroupedTriangleIndices.push_back(c.second);
+		}
+
+		// Update progress
+		progress.Update(uint(closest.size() + 1));
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <TriangleGrouper/TriangleGrouper.h>
+
+// A class that groups triangles in batches of N
+// Same grouping as TriangleGrouperClosestCentroid: starts with centroid with lowest X coordinate and finds N closest centroids, repeat.
+// The closest centroids are found using a k-d tree over the centroids instead of scanning all remaining triangles.
+// Time complexity: O(N log(N))
+class TriangleGrouperClosestCentroidKDTree : public TriangleGrouper
+{
+public:
+	// Group a batch of triangles
+	virtual void			Group(const VertexView &inVertices, const IndexedTriangleView &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices);
+};
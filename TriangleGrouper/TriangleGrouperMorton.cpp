@@ -4,7 +4,7 @@
 #include <Core/AlignedAllocator.h>
 #include <Geometry/MortonCode.h>
 
-void TriangleGrouperMorton::Group(const VertexList &inVertices, const IndexedTriangleList &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices)
+void TriangleGrouperMorton::Group(const VertexView &inVertices, const IndexedTriangleView &inTriangles, int inGroupSize, vector<uint> &outGroupedTriangleIndices)
 {
 	const uint triangle_count = (uint)inTriangles.size();
 
@@ -2,7 +2,7 @@
 
 #include <TriangleSplitter/TriangleSplitter.h>
 
-TriangleSplitter::TriangleSplitter(const VertexList &inVertices, const IndexedTriangleList &inTriangles) :
+TriangleSplitter::TriangleSplitter(const VertexView &inVertices, const IndexedTriangleView &inTriangles) :
 	mVertices(inVertices),
 	mTriangles(inTriangles)
 {
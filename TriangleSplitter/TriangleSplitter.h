@@ -7,7 +7,7 @@ class TriangleSplitter
 {
 public:
 	// Constructor
-								TriangleSplitter(const VertexList &inVertices, const IndexedTriangleList &inTriangles);
+								TriangleSplitter(const VertexView &inVertices, const IndexedTriangleView &inTriangles);
 
 	// Virtual destructor
 	virtual						~TriangleSplitter() { }
@@ -54,13 +54,13 @@ public:
 	virtual bool				Split(const Range &inTriangles, Range &outLeft, Range &outRight, uint &outDimension, float &outSplit) = 0;
 
 	// Get the list of vertices
-	const VertexList &			GetVertices() const
+	const VertexView &			GetVertices() const
 	{
 		return mVertices;
 	}
 
 	// Get triangle by index
-	const IndexedTriangle &		GetTriangle(uint inIdx) const
+	IndexedTriangle				GetTriangle(uint inIdx) const
 	{
 		return mTriangles[mSortedTriangleIdx[inIdx]];
 	}
@@ -69,8 +69,8 @@ protected:
 	// Helper function to split triangles based on dimension and split value
 	bool						SplitInternal(const Range &inTriangles, uint inDimension, float inSplit, Range &outLeft, Range &outRight);
 
-	const VertexList &			mVertices;				// Vertices of the indexed triangles
-	const IndexedTriangleList &	mTriangles;				// Unsorted triangles
+	VertexView					mVertices;				// Vertices of the indexed triangles
+	IndexedTriangleView			mTriangles;				// Unsorted triangles
 	vector<Float3>				mCentroids;				// Unsorted centroids of triangles
 	vector<uint>				mSortedTriangleIdx;		// Indices to sort triangles
 };
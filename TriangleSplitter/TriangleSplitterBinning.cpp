@@ -2,99 +2,157 @@
 
 #include <TriangleSplitter/TriangleSplitterBinning.h>
 
-TriangleSplitterBinning::TriangleSplitterBinning(const VertexList &inVertices, const IndexedTriangleList &inTriangles, uint inMinNumBins, uint inMaxNumBins, uint inNumTrianglesPerBin) :
+TriangleSplitterBinning::TriangleSplitterBinning(const VertexView &inVertices, const IndexedTriangleView &inTriangles, uint inMinNumBins, uint inMaxNumBins, uint inNumTrianglesPerBin) :
 	TriangleSplitter(inVertices, inTriangles),
 	mMinNumBins(inMinNumBins),
 	mMaxNumBins(inMaxNumBins),
 	mNumTrianglesPerBin(inNumTrianglesPerBin)
 {
+	// Precalculate bounds and centroids, triangles start unsorted
+	mTriangleBoundsMin.resize(inTriangles.size());
+	mTriangleBoundsMax.resize(inTriangles.size());
+	mTriangleCentroids.resize(inTriangles.size());
+	for (size_t t = 0; t < inTriangles.size(); ++t)
+	{
+		AABox bounds;
+		bounds.Encapsulate(inVertices, inTriangles[t]);
+		mTriangleBoundsMin[t] = bounds.mMin;
+		mTriangleBoundsMax[t] = bounds.mMax;
+		mTriangleCentroids[t] = Vec3(mCentroids[t]);
+	}
+
+	mBins.resize(3 * size_t(inMaxNumBins));
+	mAreaLeft.resize(inMaxNumBins);
+	mNumTrianglesLeft.resize(inMaxNumBins);
 }
 
-bool TriangleSplitterBinning::Split(const Range &inTriangles, Range &outLeft, Range &outRight, uint &outDimension, float &outSplit)
+// Calculate the surface area of 3 boxes at once, the result for box i is in component i
+static f_inline Vec4 sGetSurfaceArea3(const Vec3 inMin[3], const Vec3 inMax[3])
 {
-	// Calculate bounds for this range
-	AABox centroid_bounds;
-	for (uint t = inTriangles.mBegin; t < inTriangles.mEnd; ++t)
-		centroid_bounds.Encapsulate(Vec3(mCentroids[mSortedTriangleIdx[t]]));
+	// Transpose the extents so that each column holds the same component of all boxes
+	Mat44 extent = Mat44(Vec4(inMax[0] - inMin[0], 0), Vec4(inMax[1] - inMin[1], 0), Vec4(inMax[2] - inMin[2], 0), Vec4::sZero()).Transposed();
+	Vec4 x = extent.GetColumn4(0), y = extent.GetColumn4(1), z = extent.GetColumn4(2);
 
-	float best_cp = FLT_MAX;
-	uint best_dim = 0xffffffff;
-	float best_split = 0;
+	// Same order of operations as AABox::GetSurfaceArea
+	return 2.0f * (x * y + x * z + y * z);
+}
 
-	// Bin in all dimensions
-	uint num_bins = Clamp(inTriangles.Count() / mNumTrianglesPerBin, mMinNumBins, mMaxNumBins);	
-	vector<Bin> bins(num_bins);
-	for (uint dim = 0; dim < 3; ++dim)
+bool TriangleSplitterBinning::Split(const Range &inTriangles, Range &outLeft, Range &outRight, uint &outDimension, float &outSplit)
+{
+	const Vec3 *bounds_min_begin = mTriangleBoundsMin.data();
+	const Vec3 *bounds_max_begin = mTriangleBoundsMax.data();
+	const Vec3 *centroids_begin = mTriangleCentroids.data();
+
+	// Calculate bounds for this range
+	Vec3 centroid_min = Vec3::sReplicate(FLT_MAX);
+	Vec3 centroid_max = Vec3::sReplicate(-FLT_MAX);
+	for (const Vec3 *c = centroids_begin + inTriangles.mBegin, *c_end = centroids_begin + inTriangles.mEnd; c < c_end; ++c)
 	{
-		float bounds_min = centroid_bounds.mMin[dim];
-		float bounds_size = centroid_bounds.mMax[dim] - bounds_min;
+		centroid_min = Vec3::sMin(centroid_min, *c);
+		centroid_max = Vec3::sMax(centroid_max, *c);
+	}
+	Vec4 bounds_min(centroid_min, 0);
+	Vec4 bounds_size(centroid_max - centroid_min, 1);
 
-		// Skip axis if too small
-		if (bounds_size < 1.0e-5f)
-			continue;
+	// Skip axis if too small, W is never used
+	UVec4 valid_axis = UVec4::sAnd(Vec4::sGreaterOrEqual(bounds_size, Vec4::sReplicate(1.0e-5f)), UVec4(0xffffffff, 0xffffffff, 0xffffffff, 0));
+	if (!valid_axis.TestAnyTrue())
+		return false;
+	bounds_size = Vec4::sSelect(Vec4::sReplicate(1.0f), bounds_size, valid_axis);
 
-		// Initialize bins
-		for (uint b = 0; b < num_bins; ++b)
+	// Initialize bins
+	uint num_bins = Clamp(inTriangles.Count() / mNumTrianglesPerBin, mMinNumBins, mMaxNumBins);
+	Bin *bins[3] = { &mBins[0], &mBins[num_bins], &mBins[2 * num_bins] };
+	for (uint b = 0; b < num_bins; ++b)
+	{
+		Vec3 min_centroid(bounds_min + bounds_size * float(b + 1) / float(num_bins));
+		for (uint dim = 0; dim < 3; ++dim)
 		{
-			Bin &bin = bins[b];
-			bin.mBounds.SetEmpty();
-			bin.mMinCentroid = bounds_min + bounds_size * (b + 1) / num_bins;
+			Bin &bin = bins[dim][b];
+			bin.mBoundsMin = Vec3::sReplicate(FLT_MAX);
+			bin.mBoundsMax = Vec3::sReplicate(-FLT_MAX);
+			bin.mMinCentroid = min_centroid;
 			bin.mNumTriangles = 0;
 		}
+	}
 
-		// Bin all triangles
-		for (uint t = inTriangles.mBegin; t < inTriangles.mEnd; ++t)
-		{
-			float centroid_pos = mCentroids[mSortedTriangleIdx[t]][dim];
+	// Bin all triangles in all dimensions
+	Vec4 num_bins_float = Vec4::sReplicate(float(num_bins));
+	UVec4 max_bin = UVec4::sReplicate(num_bins - 1);
+	for (uint t = inTriangles.mBegin; t < inTriangles.mEnd; ++t)
+	{
+		Vec3 centroid = centroids_begin[t];
+		Vec3 triangle_min = bounds_min_begin[t];
+		Vec3 triangle_max = bounds_max_begin[t];
 
-			// Select bin 
-			uint bin_no = min(uint((centroid_pos - bounds_min) / bounds_size * num_bins), num_bins - 1);
-			Bin &bin = bins[bin_no];
+		// Select bin for all axes at once
+		UVec4 bin_no = UVec4::sMin(((Vec4(centroid, 0) - bounds_min) / bounds_size * num_bins_float).ToInt(), max_bin);
 
-			// Accumulate triangle in bin
-			bin.mBounds.Encapsulate(mVertices, GetTriangle(t));
-			bin.mMinCentroid = min(bin.mMinCentroid, centroid_pos);
+		// Accumulate triangle in bins
+		for (uint dim = 0; dim < 3; ++dim)
+		{
+			Bin &bin = bins[dim][bin_no[dim]];
+			bin.mBoundsMin = Vec3::sMin(bin.mBoundsMin, triangle_min);
+			bin.mBoundsMax = Vec3::sMax(bin.mBoundsMax, triangle_max);
+			bin.mMinCentroid = Vec3::sMin(bin.mMinCentroid, centroid);
 			bin.mNumTriangles++;
 		}
+	}
 
-		// Calculate totals left to right
-		AABox prev_bounds;
-		int prev_triangles = 0;
-		for (uint b = 0; b < num_bins; ++b)
+	// Calculate totals left to right, for every bin we store what's left of it as we'll take a split on the left side of the bin
+	Vec3 acc_min[3] = { Vec3::sReplicate(FLT_MAX), Vec3::sReplicate(FLT_MAX), Vec3::sReplicate(FLT_MAX) };
+	Vec3 acc_max[3] = { Vec3::sReplicate(-FLT_MAX), Vec3::sReplicate(-FLT_MAX), Vec3::sReplicate(-FLT_MAX) };
+	UVec4 acc_triangles = UVec4::sReplicate(0);
+	for (uint b = 0; b < num_bins; ++b)
+	{
+		mAreaLeft[b] = sGetSurfaceArea3(acc_min, acc_max);
+		mNumTrianglesLeft[b] = acc_triangles.ToFloat();
+		for (uint dim = 0; dim < 3; ++dim)
 		{
-			Bin &bin = bins[b];
-			bin.mBoundsAccumulatedLeft = prev_bounds; // Don't include this node as we'll take a split on the left side of the bin
-			bin.mNumTrianglesAccumulatedLeft = prev_triangles;
-			prev_bounds.Encapsulate(bin.mBounds);
-			prev_triangles += bin.mNumTriangles;
+			const Bin &bin = bins[dim][b];
+			acc_min[dim] = Vec3::sMin(acc_min[dim], bin.mBoundsMin);
+			acc_max[dim] = Vec3::sMax(acc_max[dim], bin.mBoundsMax);
 		}
+		acc_triangles = acc_triangles + UVec4(bins[0][b].mNumTriangles, bins[1][b].mNumTriangles, bins[2][b].mNumTriangles, 0);
+	}
 
-		// Calculate totals right to left
-		prev_bounds.SetEmpty();
-		prev_triangles = 0;
-		for (int b = num_bins - 1; b >= 0; --b)
+	// Calculate totals right to left and get the best splitting plane for all axes at once.
+	// We go from right to left and accept equal cost so that the left most bin wins, like when searching from left to right.
+	Vec4 flt_max = Vec4::sReplicate(FLT_MAX);
+	Vec4 best_cp = flt_max;
+	Vec4 best_split = Vec4::sZero();
+	for (uint dim = 0; dim < 3; ++dim)
+	{
+		acc_min[dim] = Vec3::sReplicate(FLT_MAX);
+		acc_max[dim] = Vec3::sReplicate(-FLT_MAX);
+	}
+	acc_triangles = UVec4::sReplicate(0);
+	for (uint b = num_bins - 1; b > 0; --b) // Stop at 1 since selecting bin 0 would result in everything ending up on the right side
+	{
+		for (uint dim = 0; dim < 3; ++dim)
 		{
-			Bin &bin = bins[b];
-			prev_bounds.Encapsulate(bin.mBounds);
-			prev_triangles += bin.mNumTriangles;
-			bin.mBoundsAccumulatedRight = prev_bounds;
-			bin.mNumTrianglesAccumulatedRight = prev_triangles;
+			const Bin &bin = bins[dim][b];
+			acc_min[dim] = Vec3::sMin(acc_min[dim], bin.mBoundsMin);
+			acc_max[dim] = Vec3::sMax(acc_max[dim], bin.mBoundsMax);
 		}
+		acc_triangles = acc_triangles + UVec4(bins[0][b].mNumTriangles, bins[1][b].mNumTriangles, bins[2][b].mNumTriangles, 0);
 
-		// Get best splitting plane
-		for (uint b = 1; b < num_bins; ++b) // Start at 1 since selecting bin 0 would result in everything ending up on the right side
+		// Calculate surface area heuristic and see if it is better than the current best
+		Vec4 cp = mAreaLeft[b] * mNumTrianglesLeft[b] + sGetSurfaceArea3(acc_min, acc_max) * acc_triangles.ToFloat();
+		UVec4 better = UVec4::sAnd(UVec4::sAnd(Vec4::sLessOrEqual(cp, best_cp), Vec4::sLess(cp, flt_max)), valid_axis);
+		best_cp = Vec4::sSelect(best_cp, cp, better);
+		best_split = Vec4::sSelect(best_split, Vec4(bins[0][b].mMinCentroid.GetX(), bins[1][b].mMinCentroid.GetY(), bins[2][b].mMinCentroid.GetZ(), 0), better);
+	}
+
+	// Select the best axis, on equal cost the lowest axis wins
+	uint best_dim = 0xffffffff;
+	float best_cp_dim = FLT_MAX;
+	for (uint dim = 0; dim < 3; ++dim)
+		if (best_cp[dim] < best_cp_dim)
 		{
-			// Calculate surface area heuristic and see if it is better than the current best
-			Bin &bin = bins[b];
-			float cp = bin.mBoundsAccumulatedLeft.GetSurfaceArea() * bin.mNumTrianglesAccumulatedLeft + bin.mBoundsAccumulatedRight.GetSurfaceArea() * bin.mNumTrianglesAccumulatedRight;
-			if (cp < best_cp)
-			{
-				best_cp = cp;
-				best_dim = dim;
-				best_split = bin.mMinCentroid;
-			}
+			best_cp_dim = best_cp[dim];
+			best_dim = dim;
 		}
-	}
 
 	// No split found?
 	if (best_dim == 0xffffffff)
@@ -102,7 +160,44 @@ bool TriangleSplitterBinning::Split(const Range &inTriangles, Range &outLeft, Ra
 
 	// Store best split
 	outDimension = best_dim;
-	outSplit = best_split;
+	outSplit = best_split[best_dim];
+
+	return Partition(inTriangles, best_dim, outSplit, outLeft, outRight);
+}
+
+bool TriangleSplitterBinning::Partition(const Range &inTriangles, uint inDimension, float inSplit, Range &outLeft, Range &outRight)
+{
+	// Swap a triangle and its precalculated data
+	auto swap_triangles = [this](uint inLHS, uint inRHS) {
+		swap(mSortedTriangleIdx[inLHS], mSortedTriangleIdx[inRHS]);
+		swap(mTriangleBoundsMin[inLHS], mTriangleBoundsMin[inRHS]);
+		swap(mTriangleBoundsMax[inLHS], mTriangleBoundsMax[inRHS]);
+		swap(mTriangleCentroids[inLHS], mTriangleCentroids[inRHS]);
+	};
+
+	// Divide triangles, this is the same algorithm as SplitInternal so the resulting order is the same
+	uint start = inTriangles.mBegin, end = inTriangles.mEnd;
+	while (start < end)
+	{
+		// Search for first element that is on the right hand side of the split plane
+		while (start < end && mTriangleCentroids[start][inDimension] < inSplit)
+			++start;
+
+		// Search for the first element that is on the left hand side of the split plane
+		while (start < end && mTriangleCentroids[end - 1][inDimension] >= inSplit)
+			--end;
+
+		if (start < end)
+		{
+			// Swap the two elements
+			swap_triangles(start, end - 1);
+			++start;
+			--end;
+		}
+	}
+	assert(start == end);
 
-	return SplitInternal(inTriangles, best_dim, best_split, outLeft, outRight);
+	outLeft = Range(inTriangles.mBegin, start);
+	outRight = Range(start, inTriangles.mEnd);
+	return outLeft.Count() > 0 && outRight.Count() > 0;
 }
@@ -2,13 +2,16 @@
 
 #include <TriangleSplitter/TriangleSplitter.h>
 #include <Geometry/AABox.h>
+#include <Core/AlignedAllocator.h>
 
 // Binning splitter approach taken from: Realtime Ray Tracing on GPU with BVH-based Packet Traversal by Johannes Gunther et al.
+// The bounds and centroids of the triangles are precalculated and kept in the same order as mSortedTriangleIdx so that
+// binning can read them sequentially. All 3 axes are binned in a single pass over the triangles.
 class TriangleSplitterBinning : public TriangleSplitter
 {
 public:
 	// Constructor
-							TriangleSplitterBinning(const VertexList &inVertices, const IndexedTriangleList &inTriangles, uint inMinNumBins = 8, uint inMaxNumBins = 128, uint inNumTrianglesPerBin = 6);
+							TriangleSplitterBinning(const VertexView &inVertices, const IndexedTriangleView &inTriangles, uint inMinNumBins = 8, uint inMaxNumBins = 128, uint inNumTrianglesPerBin = 6);
 
 	// Get stats of splitter
 	virtual void			GetStats(Stats &outStats) const override
@@ -28,22 +31,34 @@ public:
 	virtual bool			Split(const Range &inTriangles, Range &outLeft, Range &outRight, uint &outDimension, float &outSplit) override;
 
 private:
+	// Split the range in the same way as SplitInternal while keeping the precalculated triangle data in sync with mSortedTriangleIdx
+	bool					Partition(const Range &inTriangles, uint inDimension, float inSplit, Range &outLeft, Range &outRight);
+
 	// Configuration
 	const uint				mMinNumBins;
 	const uint				mMaxNumBins;
 	const uint				mNumTrianglesPerBin;
 
+	using Vec3List = vector<Vec3, AlignedAllocator<Vec3, 16>>;
+	using Vec4List = vector<Vec4, AlignedAllocator<Vec4, 16>>;
+
+	// Precalculated triangle data, in sorted order
+	Vec3List				mTriangleBoundsMin;
+	Vec3List				mTriangleBoundsMax;
+	Vec3List				mTriangleCentroids;
+
 	struct Bin
 	{
-		// Properties of this bin
-		AABox				mBounds;
-		float				mMinCentroid;
+		Vec3				mBoundsMin;
+		Vec3				mBoundsMax;
+		Vec3				mMinCentroid;						// Only the component of the axis that the bin belongs to is used
 		uint				mNumTriangles;
-
-		// Accumulated data from left most / right most bin to current (including this bin)
-		AABox				mBoundsAccumulatedLeft;				
-		AABox				mBoundsAccumulatedRight;			
-		uint				mNumTrianglesAccumulatedLeft;		
-		uint				mNumTrianglesAccumulatedRight;		
 	};
+
+	// Bins for the X axis followed by the Y and Z axis, allocated once
+	vector<Bin, AlignedAllocator<Bin, 16>> mBins;
+
+	// Surface area and triangle count of everything left of a bin for the 3 axes (X, Y, Z in the first 3 components)
+	Vec4List				mAreaLeft;
+	Vec4List				mNumTrianglesLeft;
 };
@@ -3,7 +3,7 @@
 #include <TriangleSplitter/TriangleSplitterFixedLeafSize.h>
 #include <TriangleGrouper/TriangleGrouperClosestCentroid.h>
 
-TriangleSplitterFixedLeafSize::TriangleSplitterFixedLeafSize(const VertexList &inVertices, const IndexedTriangleList &inTriangles, uint inLeafSize, uint inMinNumBins, uint inMaxNumBins, uint inNumTrianglesPerBin) :
+TriangleSplitterFixedLeafSize::TriangleSplitterFixedLeafSize(const VertexView &inVertices, const IndexedTriangleView &inTriangles, uint inLeafSize, uint inMinNumBins, uint inMaxNumBins, uint inNumTrianglesPerBin) :
 	TriangleSplitter(inVertices, inTriangles),
 	mLeafSize(inLeafSize),
 	mMinNumBins(inMinNumBins),
@@ -9,7 +9,7 @@ class TriangleSplitterFixedLeafSize : public TriangleSplitter
 {
 public:
 	// Constructor
-							TriangleSplitterFixedLeafSize(const VertexList &inVertices, const IndexedTriangleList &inTriangles, uint inLeafSize, uint inMinNumBins = 8, uint inMaxNumBins = 128, uint inNumTrianglesPerBin = 6);
+							TriangleSplitterFixedLeafSize(const VertexView &inVertices, const IndexedTriangleView &inTriangles, uint inLeafSize, uint inMinNumBins = 8, uint inMaxNumBins = 128, uint inNumTrianglesPerBin = 6);
 
 	// Get stats of splitter
 	virtual void			GetStats(Stats &outStats) const override
@@ -3,7 +3,7 @@
 #include <TriangleSplitter/TriangleSplitterLongestAxis.h>
 #include <Geometry/AABox.h>
 
-TriangleSplitterLongestAxis::TriangleSplitterLongestAxis(const VertexList &inVertices, const IndexedTriangleList &inTriangles) :
+TriangleSplitterLongestAxis::TriangleSplitterLongestAxis(const VertexView &inVertices, const IndexedTriangleView &inTriangles) :
 	TriangleSplitter(inVertices, inTriangles)
 {
 }
@@ -7,7 +7,7 @@ class TriangleSplitterLongestAxis : public TriangleSplitter
 {
 public:
 	// Constructor
-							TriangleSplitterLongestAxis(const VertexList &inVertices, const IndexedTriangleList &inTriangles);
+							TriangleSplitterLongestAxis(const VertexView &inVertices, const IndexedTriangleView &inTriangles);
 
 	// Get stats of splitter
 	virtual void			GetStats(Stats &outStats) const override
@@ -2,7 +2,7 @@
 
 #include <TriangleSplitter/TriangleSplitterMean.h>
 
-TriangleSplitterMean::TriangleSplitterMean(const VertexList &inVertices, const IndexedTriangleList &inTriangles) :
+TriangleSplitterMean::TriangleSplitterMean(const VertexView &inVertices, const IndexedTriangleView &inTriangles) :
 	TriangleSplitter(inVertices, inTriangles)
 {
 }
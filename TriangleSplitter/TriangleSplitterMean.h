@@ -7,7 +7,7 @@ class TriangleSplitterMean : public TriangleSplitter
 {
 public:
 	// Constructor
-							TriangleSplitterMean(const VertexList &inVertices, const IndexedTriangleList &inTriangles);
+							TriangleSplitterMean(const VertexView &inVertices, const IndexedTriangleView &inTriangles);
 
 	// Get stats of splitter
 	virtual void			GetStats(Stats &outStats) const override
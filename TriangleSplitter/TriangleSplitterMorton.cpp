@@ -3,7 +3,7 @@
 #include <TriangleSplitter/TriangleSplitterMorton.h>
 #include <Geometry/MortonCode.h>
 
-TriangleSplitterMorton::TriangleSplitterMorton(const VertexList &inVertices, const IndexedTriangleList &inTriangles) :
+TriangleSplitterMorton::TriangleSplitterMorton(const VertexView &inVertices, const IndexedTriangleView &inTriangles) :
 	TriangleSplitter(inVertices, inTriangles)
 {
 	// Calculate bounds of centroids
@@ -7,7 +7,7 @@ class TriangleSplitterMorton : public TriangleSplitter
 {
 public:
 	// Constructor
-							TriangleSplitterMorton(const VertexList &inVertices, const IndexedTriangleList &inTriangles);
+							TriangleSplitterMorton(const VertexView &inVertices, const IndexedTriangleView &inTriangles);
 
 	// Get stats of splitter
 	virtual void			GetStats(Stats &outStats) const override
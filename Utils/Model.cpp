@@ -3,46 +3,320 @@
 #include <Utils/Model.h>
 #include <Geometry/Indexify.h>
 
+void Model::ValidateRange(uint64 inOffset, uint64 inSize) const
+{
+	if (inOffset > mFile.GetSize() || inSize > mFile.GetSize() - inOffset)
+		FatalError("File truncated");
+}
+
 void Model::ReadFromFile(const char *inFileName)
 {
-	// Read the entire file
-	vector<uint8> data = ReadData(inFileName);
+	// Release previous data
+	mChunks.clear();
+	mTriangleVertices.clear();
+	mIndexedTriangles.clear();
+	mTriangles.clear();
+	mMappedIndicesValidated = false;
+
+	// Map the entire file
+	mFile.Open(inFileName);
 
 	// Check header
-	if (data.size() < sizeof(ModelHeaderV1))
+	if (mFile.GetSize() < sizeof(uint32))
 		FatalError("File truncated");
-	const ModelHeaderV1 *header = reinterpret_cast<const ModelHeaderV1 *>(&data[0]);
-	if (header->mVersion != ModelHeaderV1::sVersion)
+	uint32 version = *mFile.Get<uint32>(0);
+	if (version == ModelHeaderV1::sVersion)
+	{
+		ValidateRange(0, sizeof(ModelHeaderV1));
+		const ModelHeaderV1 *header = mFile.Get<ModelHeaderV1>(0);
+		mNumVertices = header->mNumVertices;
+		mNumTriangles = header->mNumTriangles;
+
+		// Vertices follow the header, triangles follow the vertices
+		uint64 vertices_offset = sizeof(ModelHeaderV1);
+		uint64 triangles_offset = vertices_offset + uint64(mNumVertices) * sizeof(Float3);
+		ValidateRange(triangles_offset, uint64(mNumTriangles) * sizeof(IndexedTriangleNoMaterial));
+
+		Chunk chunk;
+		chunk.mVertices = reinterpret_cast<const Float3 *>(mFile.GetData() + vertices_offset);
+		chunk.mNumVertices = mNumVertices;
+		chunk.mTriangles = reinterpret_cast<const IndexedTriangleNoMaterial *>(mFile.GetData() + triangles_offset);
+		chunk.mNumTriangles = mNumTriangles;
+		mChunks.push_back(chunk);
+
+		// Version 1 doesn't store the bounding box
+		mBounds = AABox();
+		for (const Float3 *v = chunk.mVertices, *v_end = v + chunk.mNumVertices; v < v_end; ++v)
+			mBounds.Encapsulate(Vec3(*v));
+	}
+	else if (version == ModelHeaderV2::sVersion)
+	{
+		ValidateRange(0, sizeof(ModelHeaderV2));
+		const ModelHeaderV2 *header = mFile.Get<ModelHeaderV2>(0);
+		if (header->mHeaderSize != sizeof(ModelHeaderV2))
+			FatalError("Invalid header");
+		if (header->mAlignment == 0 || !IsPowerOf2(header->mAlignment) || header->mAlignment < alignof(Float3))
+			FatalError("Invalid alignment");
+		mNumVertices = header->mNumVertices;
+		mNumTriangles = header->mNumTriangles;
+
+		// Read chunks
+		ValidateRange(header->mChunksOffset, uint64(header->mNumChunks) * sizeof(ModelChunkV2));
+		const ModelChunkV2 *chunks = reinterpret_cast<const ModelChunkV2 *>(mFile.GetData() + header->mChunksOffset);
+		uint num_vertices = 0, num_triangles = 0;
+		for (const ModelChunkV2 *c = chunks, *c_end = chunks + header->mNumChunks; c < c_end; ++c)
+		{
+			if (!IsAligned(c->mVerticesOffset, header->mAlignment) || !IsAligned(c->mTrianglesOffset, header->mAlignment))
+				FatalError("Invalid alignment");
+			ValidateRange(c->mVerticesOffset, uint64(c->mNumVertices) * sizeof(Float3));
+			ValidateRange(c->mTrianglesOffset, uint64(c->mNumTriangles) * sizeof(IndexedTriangleNoMaterial));
+
+			Chunk chunk;
+			chunk.mVertices = reinterpret_cast<const Float3 *>(mFile.GetData() + c->mVerticesOffset);
+			chunk.mNumVertices = c->mNumVertices;
+			chunk.mTriangles = reinterpret_cast<const IndexedTriangleNoMaterial *>(mFile.GetData() + c->mTrianglesOffset);
+			chunk.mNumTriangles = c->mNumTriangles;
+			mChunks.push_back(chunk);
+
+			num_vertices += c->mNumVertices;
+			num_triangles += c->mNumTriangles;
+		}
+		if (num_vertices != mNumVertices || num_triangles != mNumTriangles)
+			FatalError("Chunks don't match header");
+
+		mBounds = AABox(Vec3(header->mBoundsMin), Vec3(header->mBoundsMax));
+	}
+	else
 		FatalError("Invalid header");
-	if (header->mNumVertices == 0)
+
+	if (mNumVertices == 0)
 		FatalError("No vertices");
-	if (header->mNumTriangles == 0)
+	if (mNumTriangles == 0)
 		FatalError("No triangles");
 
-	// Copy vertex data
-	mTriangleVertices.resize(header->mNumVertices);
-	memcpy(&mTriangleVertices[0], &data[sizeof(ModelHeaderV1)], header->mNumVertices * sizeof(Float3));
+	// Trace result
+	Trace("Model '%s' loaded, triangle_count=%d, chunk_count=%d\n", inFileName, GetTriangleCount(), (int)mChunks.size());
+}
+
+VertexView Model::GetVertexView() const
+{
+	// Use the vertices in place when possible
+	const Float3 *vertices = GetMappedVertices();
+	if (vertices != nullptr)
+		return VertexView(vertices, mNumVertices);
+
+	return GetTriangleVertices();
+}
+
+IndexedTriangleView Model::GetIndexedTriangleView() const
+{
+	// Use the triangles in place when possible
+	const IndexedTriangleNoMaterial *triangles = GetMappedTriangles();
+	if (triangles != nullptr)
+	{
+		// Users of the view don't check the vertex indices, validate them once
+		if (!mMappedIndicesValidated)
+		{
+			for (const IndexedTriangleNoMaterial *t = triangles, *t_end = triangles + mNumTriangles; t < t_end; ++t)
+				for (int i = 0; i < 3; ++i)
+					if (t->mIdx[i] >= mNumVertices)
+						FatalError("Vertex index out of range");
+			mMappedIndicesValidated = true;
+		}
+
+		return IndexedTriangleView(triangles, mNumTriangles);
+	}
+
+	return GetIndexedTriangles();
+}
+
+const VertexList &Model::GetTriangleVertices() const
+{
+	if (mTriangleVertices.empty())
+	{
+		// Concatenate the vertices of all chunks
+		mTriangleVertices.reserve(mNumVertices);
+		for (const Chunk &c : mChunks)
+			mTriangleVertices.insert(mTriangleVertices.end(), c.mVertices, c.mVertices + c.mNumVertices);
+	}
 
-	// Copy index data
-	mIndexedTrianglesNoMaterial.resize(header->mNumTriangles);
-	memcpy(&mIndexedTrianglesNoMaterial[0], &data[sizeof(ModelHeaderV1) + header->mNumVertices * sizeof(Float3)], header->mNumTriangles * sizeof(IndexedTriangleNoMaterial));
-	
-	// Get rid of loaded data
-	data.clear();
+	return mTriangleVertices;
+}
 
-	// Create index data with material
-	mIndexedTriangles.resize(mIndexedTrianglesNoMaterial.size());
-	for (size_t i = 0; i < mIndexedTriangles.size(); ++i)
-		static_cast<IndexedTriangleNoMaterial &>(mIndexedTriangles[i]) = mIndexedTrianglesNoMaterial[i];
+const IndexedTriangleList &Model::GetIndexedTriangles() const
+{
+	if (mIndexedTriangles.empty())
+	{
+		// Create index data with material
+		mIndexedTriangles.resize(mNumTriangles);
+		IndexedTriangle *t = mIndexedTriangles.data();
+		for (const Chunk &c : mChunks)
+			for (const IndexedTriangleNoMaterial *s = c.mTriangles, *s_end = s + c.mNumTriangles; s < s_end; ++s, ++t)
+			{
+				for (int i = 0; i < 3; ++i)
+					if (s->mIdx[i] >= mNumVertices)
+						FatalError("Vertex index out of range");
+				static_cast<IndexedTriangleNoMaterial &>(*t) = *s;
+			}
+	}
 
-	// Convert to triangle list
-	Deindexify(mTriangleVertices, mIndexedTriangles, mTriangles);
+	return mIndexedTriangles;
+}
+
+Triangle Model::GetTriangle(uint inIdx) const
+{
+	assert(inIdx < mNumTriangles);
+
+	// Read directly from the mapped file when possible
+	const Float3 *vertices = GetMappedVertices();
+	if (vertices != nullptr)
+	{
+		const IndexedTriangleNoMaterial &t = GetMappedTriangles()[inIdx];
+		assert(t.mIdx[0] < mNumVertices && t.mIdx[1] < mNumVertices && t.mIdx[2] < mNumVertices);
+		return Triangle(vertices[t.mIdx[0]], vertices[t.mIdx[1]], vertices[t.mIdx[2]]);
+	}
+
+	// The vertices of multiple chunks need to be concatenated
+	const VertexList &vertex_list = GetTriangleVertices();
+	const IndexedTriangle &t = GetIndexedTriangles()[inIdx];
+	return Triangle(vertex_list[t.mIdx[0]], vertex_list[t.mIdx[1]], vertex_list[t.mIdx[2]]);
+}
+
+const TriangleList &Model::GetTriangles() const
+{
+	if (mTriangles.empty())
+	{
+		// Convert to triangle list
+		Deindexify(GetTriangleVertices(), GetIndexedTriangles(), mTriangles);
+	}
+
+	return mTriangles;
+}
 
-	// Update bounding box
+void Model::sWriteToFile(const char *inFileName, const VertexList &inVertices, const IndexedTriangleList &inTriangles, uint inMaxTrianglesPerChunk)
+{
+	ModelWriter writer;
+	writer.Open(inFileName);
+
+	// Split the triangles in chunks, each chunk stores the vertices that were not used by the previous chunks
+	uint max_triangles = inMaxTrianglesPerChunk > 0? inMaxTrianglesPerChunk : max(1u, (uint)inTriangles.size());
+	uint32 vertices_written = 0;
+	for (size_t t = 0; t < inTriangles.size(); t += max_triangles)
+	{
+		size_t t_end = min(inTriangles.size(), t + max_triangles);
+
+		// Determine which vertices are needed by this chunk. Vertices are written in order, so this assumes the
+		// vertices of a triangle are mostly close in the vertex list (which is true for the output of Indexify).
+		uint32 vertices_end = vertices_written;
+		for (size_t i = t; i < t_end; ++i)
+			for (int v = 0; v < 3; ++v)
+				vertices_end = max(vertices_end, inTriangles[i].mIdx[v] + 1);
+		if (t_end == inTriangles.size())
+			vertices_end = (uint32)inVertices.size();
+
+		writer.AddChunk(inVertices.data() + vertices_written, vertices_end - vertices_written, &inTriangles[t], uint(t_end - t));
+		vertices_written = vertices_end;
+	}
+
+	writer.Close();
+}
+
+void ModelWriter::Open(const char *inFileName)
+{
+	mFileName = inFileName;
+	mOutput.open(inFileName, ios::binary | ios::trunc);
+	if (!mOutput)
+		FatalError("Unable to open file: %s", inFileName);
+
+	// Reserve space for the header, it is written when all chunks are known
+	mPosition = 0;
+	mHeader = Model::ModelHeaderV2();
+	mHeader.mAlignment = Model::MODEL_ALIGNMENT;
+	mChunks.clear();
 	mBounds = AABox();
-	for (const Float3 &v : mTriangleVertices)
-		mBounds.Encapsulate(Vec3(v));
-		
-	// Trace result
-	Trace("Model '%s' loaded, triangle_count=%d\n", inFileName, GetTriangleCount());
+	mMaxIndex = 0;
+	Write(&mHeader, sizeof(mHeader));
+}
+
+void ModelWriter::Write(const void *inData, size_t inSize)
+{
+	mOutput.write(reinterpret_cast<const char *>(inData), streamsize(inSize));
+	mPosition += inSize;
+}
+
+void ModelWriter::Align()
+{
+	static const char zeros[Model::MODEL_ALIGNMENT] = { };
+
+	Write(zeros, size_t(AlignUp(mPosition, Model::MODEL_ALIGNMENT) - mPosition));
+}
+
+void ModelWriter::AddChunk(const Float3 *inVertices, uint inNumVertices, const IndexedTriangle *inTriangles, uint inNumTriangles)
+{
+	Model::ModelChunkV2 chunk;
+	chunk.mNumVertices = inNumVertices;
+	chunk.mNumTriangles = inNumTriangles;
+
+	// Write vertices
+	Align();
+	chunk.mVerticesOffset = mPosition;
+	if (inNumVertices > 0)
+		Write(inVertices, inNumVertices * sizeof(Float3));
+	for (const Float3 *v = inVertices, *v_end = inVertices + inNumVertices; v < v_end; ++v)
+		mBounds.Encapsulate(Vec3(*v));
+
+	// Write triangles
+	Align();
+	chunk.mTrianglesOffset = mPosition;
+	WriteTriangles(inTriangles, inNumTriangles);
+
+	mHeader.mNumVertices += inNumVertices;
+	mChunks.push_back(chunk);
+}
+
+void ModelWriter::AddTriangles(const IndexedTriangle *inTriangles, uint inNumTriangles)
+{
+	if (mChunks.empty())
+		FatalError("%s: No chunk to add triangles to", mFileName.c_str());
+
+	// The triangles of the last chunk are the last thing in the file, so they can be extended
+	Model::ModelChunkV2 &chunk = mChunks.back();
+	assert(mPosition == chunk.mTrianglesOffset + uint64(chunk.mNumTriangles) * sizeof(IndexedTriangleNoMaterial));
+	WriteTriangles(inTriangles, inNumTriangles);
+	chunk.mNumTriangles += inNumTriangles;
+}
+
+void ModelWriter::WriteTriangles(const IndexedTriangle *inTriangles, uint inNumTriangles)
+{
+	for (const IndexedTriangle *t = inTriangles, *t_end = inTriangles + inNumTriangles; t < t_end; ++t)
+	{
+		Write(t, sizeof(IndexedTriangleNoMaterial));
+		for (int v = 0; v < 3; ++v)
+			mMaxIndex = max(mMaxIndex, t->mIdx[v]);
+	}
+
+	mHeader.mNumTriangles += inNumTriangles;
+}
+
+void ModelWriter::Close()
+{
+	if (mHeader.mNumTriangles > 0 && mMaxIndex >= mHeader.mNumVertices)
+		FatalError("%s: Vertex index out of range", mFileName.c_str());
+
+	// Write chunk table
+	Align();
+	mHeader.mNumChunks = (uint32)mChunks.size();
+	mHeader.mChunksOffset = mPosition;
+	if (!mChunks.empty())
+		Write(&mChunks[0], mChunks.size() * sizeof(Model::ModelChunkV2));
+
+	// Write header
+	mBounds.mMin.StoreFloat3(&mHeader.mBoundsMin);
+	mBounds.mMax.StoreFloat3(&mHeader.mBoundsMax);
+	mOutput.seekp(0);
+	mOutput.write(reinterpret_cast<const char *>(&mHeader), sizeof(mHeader));
+
+	if (!mOutput)
+		FatalError("Unable to write file: %s", mFileName.c_str());
+	mOutput.close();
 }
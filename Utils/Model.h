@@ -3,8 +3,16 @@
 #include <Geometry/AABox.h>
 #include <Geometry/Triangle.h>
 #include <Geometry/IndexedTriangle.h>
+#include <Core/MappedFile.h>
+#include <fstream>
 
 // Simple model
+//
+// The model file is memory mapped, vertices and indices are used in place. The tree builders and codecs
+// take views, for a model with a single chunk these point directly into the mapped file. Lists are only
+// created on first access (or when a view is requested for a model with multiple chunks). Creating them is
+// not thread safe, so access them once from the main thread before sharing the model between threads.
+// Single triangles are read from the mapped data, the triangle list is only created when it is requested.
 class Model
 {
 public:
@@ -19,27 +27,153 @@ public:
 		uint32						mNumTriangles;
 	};
 
-	// Read model file data
+	// Version 2 of the file format
+	//
+	// File layout:
+	//
+	// ModelHeaderV2
+	// For every chunk, each block aligned to mAlignment:
+	//   Float3[ModelChunkV2::mNumVertices]
+	//   IndexedTriangleNoMaterial[ModelChunkV2::mNumTriangles]
+	// ModelChunkV2[mNumChunks], aligned to mAlignment
+	//
+	// Vertex indices are global, the vertices of all chunks concatenated form the vertex list of the model.
+	// Chunks allow writing a model without knowing its size up front, a model with a single chunk can be used without any copying.
+	struct ModelHeaderV2
+	{
+		static inline const uint32	sVersion = uint32('M') + (uint32('D') << 8) + (uint32('V') << 16) + (uint32('2') << 24);
+
+									ModelHeaderV2() : mVersion(sVersion), mHeaderSize(sizeof(ModelHeaderV2)), mAlignment(0), mNumChunks(0), mNumVertices(0), mNumTriangles(0), mChunksOffset(0), mBoundsMin(0, 0, 0), mBoundsMax(0, 0, 0) { }
+
+		uint32						mVersion;
+		uint32						mHeaderSize;						// Size of this header, to detect mismatching struct layouts
+		uint32						mAlignment;							// Alignment of all data blocks in the file
+		uint32						mNumChunks;
+		uint32						mNumVertices;						// Total amount of vertices in all chunks
+		uint32						mNumTriangles;						// Total amount of triangles in all chunks
+		uint64						mChunksOffset;						// Offset from start of file to ModelChunkV2 array
+		Float3						mBoundsMin;							// Bounding box of all vertices so that loading doesn't need to touch the vertices
+		Float3						mBoundsMax;
+	};
+
+	struct ModelChunkV2
+	{
+		uint64						mVerticesOffset;					// Offset from start of file to the vertices
+		uint64						mTrianglesOffset;					// Offset from start of file to the triangles
+		uint32						mNumVertices;
+		uint32						mNumTriangles;
+	};
+
+	// Alignment of data blocks when writing a version 2 file
+	enum { MODEL_ALIGNMENT = CACHE_LINE_SIZE };
+
+	// Part of the model, points directly into the mapped file
+	struct Chunk
+	{
+		const Float3 *				mVertices;
+		uint						mNumVertices;
+		const IndexedTriangleNoMaterial *mTriangles;
+		uint						mNumTriangles;
+	};
+
+	// Read model file data (version 1 or 2)
 	void							ReadFromFile(const char *inFileName);
 
+	// Write a version 2 model file, when inMaxTrianglesPerChunk is 0 the model will be stored as a single chunk
+	static void						sWriteToFile(const char *inFileName, const VertexList &inVertices, const IndexedTriangleList &inTriangles, uint inMaxTrianglesPerChunk = 0);
+
+	// Get number of vertices in this model
+	uint							GetVertexCount() const
+	{
+		return mNumVertices;
+	}
+
 	// Get number of triangles in this model
 	uint							GetTriangleCount() const
 	{
-		return (uint)mIndexedTriangles.size();
+		return mNumTriangles;
 	}
 
-	// Access a triangle
-	const Triangle &				GetTriangle(uint inIdx) const
+	// Access the mapped data of the model
+	const vector<Chunk> &			GetChunks() const
+	{
+		return mChunks;
+	}
+
+	// Vertices and triangles of a model that consists of a single chunk (always the case for a version 1 file), used in place in the mapped file.
+	// Returns nullptr when the model has multiple chunks. The vertex indices are not validated, GetIndexedTriangleView and GetIndexedTriangles do that.
+	const Float3 *					GetMappedVertices() const
+	{
+		return mChunks.size() == 1? mChunks[0].mVertices : nullptr;
+	}
+
+	const IndexedTriangleNoMaterial *GetMappedTriangles() const
 	{
-		return mTriangles[inIdx];
+		return mChunks.size() == 1? mChunks[0].mTriangles : nullptr;
 	}
 
-	// Triangles
-	VertexList						mTriangleVertices;
-	IndexedTriangleNoMaterialList	mIndexedTrianglesNoMaterial;
-	IndexedTriangleList				mIndexedTriangles;
-	TriangleList					mTriangles;
+	// Access a triangle
+	Triangle						GetTriangle(uint inIdx) const;
+
+	// Views on the vertices and triangles, these don't copy the mapped data when the model has a single chunk
+	VertexView						GetVertexView() const;
+	IndexedTriangleView				GetIndexedTriangleView() const;
+
+	// Lists of vertices and triangles, created on first access
+	const VertexList &				GetTriangleVertices() const;
+	const IndexedTriangleList &		GetIndexedTriangles() const;
+	const TriangleList &			GetTriangles() const;
 
 	// Bounding box
 	AABox							mBounds;
+
+private:
+	// Validate that the file contains the range [inOffset, inOffset + inSize)
+	void							ValidateRange(uint64 inOffset, uint64 inSize) const;
+
+	MappedFile						mFile;
+	vector<Chunk>					mChunks;
+	uint							mNumVertices = 0;
+	uint							mNumTriangles = 0;
+	mutable bool					mMappedIndicesValidated = false;
+
+	// Derived data
+	mutable VertexList				mTriangleVertices;
+	mutable IndexedTriangleList		mIndexedTriangles;
+	mutable TriangleList			mTriangles;
+};
+
+// Writes a version 2 model file one chunk at a time so that the model doesn't need to be in memory as a whole
+class ModelWriter
+{
+public:
+	// Create the output file
+	void							Open(const char *inFileName);
+
+	// Append a chunk. Vertex indices are global, triangles can use vertices of earlier or later chunks.
+	void							AddChunk(const Float3 *inVertices, uint inNumVertices, const IndexedTriangle *inTriangles, uint inNumTriangles);
+
+	// Append triangles to the last chunk, so that a model whose triangles are produced in parts can still be written as a single chunk
+	void							AddTriangles(const IndexedTriangle *inTriangles, uint inNumTriangles);
+
+	// Write the chunk table and the header and close the file
+	void							Close();
+
+private:
+	// Write data and update mPosition
+	void							Write(const void *inData, size_t inSize);
+
+	// Write zeros until mPosition is aligned to Model::MODEL_ALIGNMENT
+	void							Align();
+
+	// Write triangles without material
+	void							WriteTriangles(const IndexedTriangle *inTriangles, uint inNumTriangles);
+
+	string							mFileName;
+	ofstream						mOutput;
+	uint64							mPosition = 0;
+	Model::ModelHeaderV2			mHeader;
+	vector<Model::ModelChunkV2>		mChunks;
+	AABox							mBounds;
+	uint32							mMaxIndex = 0;
 };
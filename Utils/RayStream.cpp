@@ -0,0 +1,97 @@
+#include <pch.h> // IWYU pragma: keep
+
+#include <Utils/RayStream.h>
+#include <fstream>
+
+// Write padding bytes so that the stream position becomes a multiple of inAlignment
+static uint64 sWritePadding(ofstream &ioStream, uint64 inPosition, uint64 inAlignment)
+{
+	static const char zeros[RayStream::RAY_STREAM_ALIGNMENT] = { };
+
+	uint64 aligned = AlignUp(inPosition, inAlignment);
+	ioStream.write(zeros, streamsize(aligned - inPosition));
+	return aligned;
+}
+
+void RayStream::sWriteToFile(const char *inFileName, const RayCasts &inRays, const RayCastPayloads *inPayload)
+{
+	if (inPayload != nullptr && inPayload->size() != inRays.size())
+		FatalError("RayStream: Payload size doesn't match amount of rays");
+	if (inRays.size() > 0xffffffff)
+		FatalError("RayStream: Too many rays");
+
+	ofstream output(inFileName, ios::binary | ios::trunc);
+	if (!output)
+		FatalError("Unable to open file: %s", inFileName);
+
+	// Determine layout
+	RayStreamHeaderV1 header;
+	header.mNumRays = (uint32)inRays.size();
+	header.mRaysOffset = AlignUp(uint64(sizeof(RayStreamHeaderV1)), uint64(RAY_STREAM_ALIGNMENT));
+	if (inPayload != nullptr)
+	{
+		header.mFlags |= RayStreamHeaderV1::HAS_PAYLOAD;
+		header.mPayloadOffset = AlignUp(header.mRaysOffset + inRays.size() * sizeof(RayCastTestIn), uint64(RAY_STREAM_ALIGNMENT));
+	}
+
+	// Write header
+	output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	uint64 position = sWritePadding(output, sizeof(header), RAY_STREAM_ALIGNMENT);
+	assert(position == header.mRaysOffset);
+
+	// Write rays
+	if (!inRays.empty())
+		output.write(reinterpret_cast<const char *>(&inRays[0]), streamsize(inRays.size() * sizeof(RayCastTestIn)));
+	position += inRays.size() * sizeof(RayCastTestIn);
+
+	// Write payload
+	if (inPayload != nullptr)
+	{
+		position = sWritePadding(output, position, RAY_STREAM_ALIGNMENT);
+		assert(position == header.mPayloadOffset);
+		if (!inPayload->empty())
+			output.write(reinterpret_cast<const char *>(&(*inPayload)[0]), streamsize(inPayload->size() * sizeof(RayCastPayload)));
+	}
+
+	if (!output)
+		FatalError("Unable to write file: %s", inFileName);
+}
+
+void RayStream::ReadFromFile(const char *inFileName)
+{
+	mRays = nullptr;
+	mPayload = nullptr;
+	mNumRays = 0;
+
+	// Map the file
+	mFile.Open(inFileName);
+
+	// Check header
+	if (mFile.GetSize() < sizeof(RayStreamHeaderV1))
+		FatalError("File truncated");
+	const RayStreamHeaderV1 *header = mFile.Get<RayStreamHeaderV1>(0);
+	if (header->mVersion != RayStreamHeaderV1::sVersion)
+		FatalError("Invalid header");
+	if (header->mNumRays == 0)
+		FatalError("No rays");
+
+	// Check rays
+	uint64 rays_size = uint64(header->mNumRays) * sizeof(RayCastTestIn);
+	if (!IsAligned(header->mRaysOffset, RAY_STREAM_ALIGNMENT) || header->mRaysOffset < sizeof(RayStreamHeaderV1) || header->mRaysOffset + rays_size > mFile.GetSize())
+		FatalError("Invalid ray offset");
+	mRays = reinterpret_cast<const RayCastTestIn *>(mFile.GetData() + header->mRaysOffset);
+
+	// Check payload
+	if (header->mFlags & RayStreamHeaderV1::HAS_PAYLOAD)
+	{
+		uint64 payload_size = uint64(header->mNumRays) * sizeof(RayCastPayload);
+		if (!IsAligned(header->mPayloadOffset, RAY_STREAM_ALIGNMENT) || header->mPayloadOffset < header->mRaysOffset + rays_size || header->mPayloadOffset + payload_size > mFile.GetSize())
+			FatalError("Invalid payload offset");
+		mPayload = reinterpret_cast<const RayCastPayload *>(mFile.GetData() + header->mPayloadOffset);
+	}
+
+	mNumRays = header->mNumRays;
+
+	// Trace result
+	Trace("Ray stream '%s' loaded, ray_count=%d, payload=%d\n", inFileName, mNumRays, HasPayload()? 1 : 0);
+}
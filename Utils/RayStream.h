@@ -0,0 +1,69 @@
+#pragma once
+
+#include <RayCastTest/RayCastTest.h>
+#include <Core/MappedFile.h>
+
+// Optional per ray data that can be stored in a ray stream
+struct RayCastPayload
+{
+	float							mMinDistance;							// Start of the ray interval along mDirection
+	float							mMaxDistance;							// End of the ray interval along mDirection
+	uint32							mFlags;									// User defined flags
+};
+
+typedef vector<RayCastPayload> RayCastPayloads;
+
+// Binary file containing a list of rays that can be loaded without parsing.
+//
+// File layout:
+//
+// RayStreamHeaderV1
+// padding to RAY_STREAM_ALIGNMENT
+// RayCastTestIn[mNumRays]
+// padding to RAY_STREAM_ALIGNMENT
+// RayCastPayload[mNumRays] (only if HAS_PAYLOAD is set)
+class RayStream
+{
+public:
+	enum { RAY_STREAM_ALIGNMENT = CACHE_LINE_SIZE };
+
+	struct RayStreamHeaderV1
+	{
+		static inline const uint32	sVersion = uint32('R') + (uint32('S') << 8) + (uint32('V') << 16) + (uint32('1') << 24);
+
+		// Flags
+		static inline const uint32	HAS_PAYLOAD = 1;
+
+									RayStreamHeaderV1() : mVersion(sVersion), mFlags(0), mNumRays(0), mReserved(0), mRaysOffset(0), mPayloadOffset(0) { }
+
+		uint32						mVersion;
+		uint32						mFlags;
+		uint32						mNumRays;
+		uint32						mReserved;
+		uint64						mRaysOffset;							// Offset from start of file to the rays
+		uint64						mPayloadOffset;							// Offset from start of file to the payload, 0 if there is no payload
+	};
+
+	// Write inRays to a file, inPayload is optional and must contain an entry for every ray
+	static void						sWriteToFile(const char *inFileName, const RayCasts &inRays, const RayCastPayloads *inPayload = nullptr);
+
+	// Map a ray stream into memory
+	void							ReadFromFile(const char *inFileName);
+
+	// Get number of rays in this stream
+	uint							GetRayCount() const						{ return mNumRays; }
+
+	// Access the rays, these point directly into the mapped file
+	const RayCastTestIn *			GetRaysBegin() const					{ return mRays; }
+	const RayCastTestIn *			GetRaysEnd() const						{ return mRays + mNumRays; }
+
+	// Access the payload (nullptr if the stream has no payload)
+	bool							HasPayload() const						{ return mPayload != nullptr; }
+	const RayCastPayload *			GetPayload() const						{ return mPayload; }
+
+private:
+	MappedFile						mFile;
+	const RayCastTestIn *			mRays = nullptr;
+	const RayCastPayload *			mPayload = nullptr;
+	uint							mNumRays = 0;
+};